@@ -0,0 +1,555 @@
+/*
+ * bench.c --
+ *
+ * Micro-benchmarks of the core kernels and drivers of µPlot.
+ *
+ * Usage: muBench [-t TOL] [BASELINE]
+ *
+ * Each benchmark is run by batches of repetitions lasting at least
+ * `MIN_BATCH_TIME` seconds, the best of `NUMBER_OF_BATCHES` batches is
+ * reported.  The results are printed as tab separated columns (lines starting
+ * with `#` are comments): the name of the benchmark, the number of items
+ * processed by one repetition, the time per item in nanoseconds, the number of
+ * items processed per second and the number of megabytes per second.  The
+ * data are generated by a fixed pseudo-random sequence so that the results are
+ * reproducible.
+ *
+ * If a baseline file (the output of a previous run) is given, two columns are
+ * added with the time per item of the baseline and the speedup (the ratio of
+ * the baseline time to the measured time).  The exit status is 2 if any
+ * benchmark is slower than its baseline by more than the relative tolerance
+ * `TOL` (0.25 by default).
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "muPlot.h"
+#include "muPlotPriv.h"
+
+#define MIN_BATCH_TIME    0.02
+#define NUMBER_OF_BATCHES 5
+#define MAX_BASELINES     64
+#define MAX_NAME          64
+
+/* Number of vertices or segments for the geometric kernels. */
+#define NPOINTS 4096
+
+/* Sink to prevent the compiler from discarding the results. */
+static volatile double sink;
+
+static double
+elapsedTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1E-9*(double)ts.tv_nsec;
+}
+
+/* Pseudo-random generator (xorshift64*), uniform in [0,1). */
+static uint64_t seed;
+
+static double
+uniform(void)
+{
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return (double)((seed*2685821657736338717ull) >> 11)*0x1p-53;
+}
+
+/*---------------------------------------------------------------------------*/
+/* REPORTING */
+
+static struct {
+    char name[MAX_NAME];
+    double nsPerItem;
+} baselines[MAX_BASELINES];
+static int nbaselines = 0;
+static double tolerance = 0.25;
+static int nslower = 0;
+
+static int
+loadBaselines(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL &&
+           nbaselines < MAX_BASELINES) {
+        double items, ns;
+        if (line[0] == '#' ||
+            sscanf(line, "%63s %lf %lf", baselines[nbaselines].name,
+                   &items, &ns) != 3) {
+            continue;
+        }
+        baselines[nbaselines].nsPerItem = ns;
+        ++nbaselines;
+    }
+    fclose(file);
+    return 0;
+}
+
+static double
+findBaseline(const char* name)
+{
+    for (int i = 0; i < nbaselines; ++i) {
+        if (strcmp(baselines[i].name, name) == 0) {
+            return baselines[i].nsPerItem;
+        }
+    }
+    return NAN;
+}
+
+/*
+ * Measure the time taken by `run(ctx)` which processes `items` items and
+ * `bytes` bytes, and print the results.
+ */
+static void
+measure(const char* name, void (*run)(void*), void* ctx,
+        double items, double bytes)
+{
+    /* Calibrate the number of repetitions per batch. */
+    long reps = 1;
+    for (;;) {
+        double t0 = elapsedTime();
+        for (long r = 0; r < reps; ++r) {
+            run(ctx);
+        }
+        if (elapsedTime() - t0 >= MIN_BATCH_TIME) {
+            break;
+        }
+        reps *= 2;
+    }
+
+    /* Keep the best batch. */
+    double best = INFINITY;
+    for (int k = 0; k < NUMBER_OF_BATCHES; ++k) {
+        double t0 = elapsedTime();
+        for (long r = 0; r < reps; ++r) {
+            run(ctx);
+        }
+        double t = (elapsedTime() - t0)/(double)reps;
+        if (t < best) {
+            best = t;
+        }
+    }
+    printf("%s\t%.0f\t%.3f\t%.4g\t%.4g", name, items, 1E9*best/items,
+           items/best, 1E-6*bytes/best);
+    if (nbaselines > 0) {
+        double ref = findBaseline(name);
+        double speedup = ref/(1E9*best/items);
+        printf("\t%.3f\t%.3f", ref, speedup);
+        if (speedup < 1/(1 + tolerance)) {
+            ++nslower;
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/*---------------------------------------------------------------------------*/
+/* CLIPPING */
+
+/*
+ * The points are uniformly distributed in the unit square and the clipping
+ * box is `[0,r]×[0,1]` so that a fraction `r` of the vertices are inside.
+ */
+typedef struct {
+    const MpBoxFlt* box;
+    float *x, *y, *xc, *yc;
+    MpInt n;
+} ClipFlt;
+
+typedef struct {
+    const MpBoxDbl* box;
+    double *x, *y, *xc, *yc;
+    MpInt n;
+} ClipDbl;
+
+static void
+clipPolylineFlt(void* ctx)
+{
+    ClipFlt* c = ctx;
+    sink = MpClipPolylineFlt(c->xc, c->yc, c->box, c->x, c->y, c->n);
+}
+
+static void
+clipPolylineDbl(void* ctx)
+{
+    ClipDbl* c = ctx;
+    sink = MpClipPolylineDbl(c->xc, c->yc, c->box, c->x, c->y, c->n);
+}
+
+static void
+clipSegmentsFlt(void* ctx)
+{
+    ClipFlt* c = ctx;
+    sink = MpClipSegmentsFlt(c->xc, c->yc, c->box, c->x, c->y, c->n/2);
+}
+
+static void
+clipSegmentsDbl(void* ctx)
+{
+    ClipDbl* c = ctx;
+    sink = MpClipSegmentsDbl(c->xc, c->yc, c->box, c->x, c->y, c->n/2);
+}
+
+static void
+benchClipping(void)
+{
+    const MpInt n = NPOINTS;
+    float* xf = malloc(6*n*sizeof(float));
+    double* xd = malloc(6*n*sizeof(double));
+    if (xf == NULL || xd == NULL) {
+        fprintf(stderr, "insufficient memory\n");
+        exit(1);
+    }
+    float* yf = xf + n;
+    double* yd = xd + n;
+    seed = 1;
+    for (MpInt i = 0; i < n; ++i) {
+        xd[i] = uniform();
+        yd[i] = uniform();
+        xf[i] = (float)xd[i];
+        yf[i] = (float)yd[i];
+    }
+    static const int percents[] = {100, 50, 10};
+    for (int k = 0; k < 3; ++k) {
+        MpBoxFlt bf = {0, percents[k]/100.0f, 0, 1};
+        MpBoxDbl bd = {0, percents[k]/100.0, 0, 1};
+        ClipFlt cf = {&bf, xf, yf, xf + 2*n, xf + 4*n, n};
+        ClipDbl cd = {&bd, xd, yd, xd + 2*n, xd + 4*n, n};
+        char name[MAX_NAME];
+        sprintf(name, "MpClipPolylineFlt/%d%%", percents[k]);
+        measure(name, clipPolylineFlt, &cf, n, 2*n*sizeof(float));
+        sprintf(name, "MpClipPolylineDbl/%d%%", percents[k]);
+        measure(name, clipPolylineDbl, &cd, n, 2*n*sizeof(double));
+        sprintf(name, "MpClipSegmentsFlt/%d%%", percents[k]);
+        measure(name, clipSegmentsFlt, &cf, n/2, 2*n*sizeof(float));
+        sprintf(name, "MpClipSegmentsDbl/%d%%", percents[k]);
+        measure(name, clipSegmentsDbl, &cd, n/2, 2*n*sizeof(double));
+    }
+    free(xf);
+    free(xd);
+}
+
+/*---------------------------------------------------------------------------*/
+/* MAPPINGS AND AFFINE TRANSFORMS */
+
+typedef struct {
+    float *x, *y, *xo, *yo;
+    double *xd, *yd, *xdo, *ydo;
+    MpInt n;
+} Points;
+
+static MpMappingFlt mapFlt = {2.0f, 0.5f, -3.0f, 1.0f};
+static MpMappingDbl mapDbl = {2.0, 0.5, -3.0, 1.0};
+static MpAffineTransformFlt affFlt = {0.8f, -0.6f, 1.0f, 0.6f, 0.8f, 2.0f};
+static MpAffineTransformDbl affDbl = {0.8, -0.6, 1.0, 0.6, 0.8, 2.0};
+
+static void
+applyMappingFlt(void* ctx)
+{
+    Points* p = ctx;
+    MpApplyMappingFlt(&mapFlt, p->xo, p->yo, p->x, p->y, p->n);
+    sink = p->xo[p->n - 1];
+}
+
+static void
+applyMappingDbl(void* ctx)
+{
+    Points* p = ctx;
+    MpApplyMappingDbl(&mapDbl, p->xdo, p->ydo, p->xd, p->yd, p->n);
+    sink = p->xdo[p->n - 1];
+}
+
+static void
+applyAffineTransformFlt(void* ctx)
+{
+    Points* p = ctx;
+    MpApplyAffineTransformFlt(&affFlt, p->xo, p->yo, p->x, p->y, p->n);
+    sink = p->xo[p->n - 1];
+}
+
+static void
+applyAffineTransformDbl(void* ctx)
+{
+    Points* p = ctx;
+    MpApplyAffineTransformDbl(&affDbl, p->xdo, p->ydo, p->xd, p->yd, p->n);
+    sink = p->xdo[p->n - 1];
+}
+
+static void
+benchTransforms(void)
+{
+    const MpInt n = NPOINTS;
+    float* f = malloc(4*n*sizeof(float));
+    double* d = malloc(4*n*sizeof(double));
+    if (f == NULL || d == NULL) {
+        fprintf(stderr, "insufficient memory\n");
+        exit(1);
+    }
+    Points p = {f, f + n, f + 2*n, f + 3*n, d, d + n, d + 2*n, d + 3*n, n};
+    seed = 2;
+    for (MpInt i = 0; i < n; ++i) {
+        d[i] = uniform();
+        d[n + i] = uniform();
+        f[i] = (float)d[i];
+        f[n + i] = (float)d[n + i];
+    }
+    measure("MpApplyMappingFlt", applyMappingFlt, &p, n,
+            4*n*sizeof(float));
+    measure("MpApplyMappingDbl", applyMappingDbl, &p, n,
+            4*n*sizeof(double));
+    measure("MpApplyAffineTransformFlt", applyAffineTransformFlt, &p, n,
+            4*n*sizeof(float));
+    measure("MpApplyAffineTransformDbl", applyAffineTransformDbl, &p, n,
+            4*n*sizeof(double));
+    free(f);
+    free(d);
+}
+
+/*---------------------------------------------------------------------------*/
+/* CELLS */
+
+/* A device which draws nothing. */
+static MpStatus
+drawNullPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    return MP_OK;
+}
+
+static MpStatus
+drawNullRectangle(MpDevice* dev, MpPoint x0, MpPoint y0,
+                  MpPoint x1, MpPoint y1)
+{
+    return MP_OK;
+}
+
+static MpStatus
+drawNullPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    return MP_OK;
+}
+
+static MpStatus
+openNullDevice(MpDevice** devptr, const char* ident, const char* arg)
+{
+    MpDevice* dev = MpAllocateDevice(sizeof(MpDevice));
+    *devptr = dev;
+    if (dev == NULL) {
+        return MP_NO_MEMORY;
+    }
+    dev->drawPoint = drawNullPoint;
+    dev->drawRectangle = drawNullRectangle;
+    dev->drawPolyline = drawNullPolyline;
+    dev->drawPolygon = drawNullPolyline;
+    dev->pageWidth = 1024;
+    dev->pageHeight = 1024;
+    dev->horizontalResolution = 1;
+    dev->verticalResolution = 1;
+    dev->colormapSize1 = 16;
+    dev->colormapSize2 = 240;
+    return MP_OK;
+}
+
+typedef struct {
+    MpDevice* dev;
+    const MpColorIndex* z;
+    MpInt n;
+} Cells;
+
+static void
+drawCellsHelper(void* ctx)
+{
+    Cells* c = ctx;
+    sink = MpDrawCellsHelper(c->dev, c->z, c->n, c->n, c->n,
+                             0, 0, 1023, 1023);
+}
+
+static void
+benchCells(void)
+{
+    MpDevice* dev;
+    MpStatus status = MpInstallDriver("null", openNullDevice);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&dev, "null", NULL);
+    }
+    if (status != MP_OK) {
+        fprintf(stderr, "MpOpenDevice(\"null\") -> %s\n",
+                MpGetReason(status));
+        exit(1);
+    }
+
+    /* A smooth image quantized in the secondary colormap, with some noise
+       so that the runs of cells of the same color are short. */
+    static const MpInt sizes[] = {16, 256, 1024};
+    const MpInt nmax = 1024;
+    MpColorIndex* z = malloc(nmax*nmax*sizeof(MpColorIndex));
+    if (z == NULL) {
+        fprintf(stderr, "insufficient memory\n");
+        exit(1);
+    }
+    for (int k = 0; k < 3; ++k) {
+        MpInt n = sizes[k];
+        seed = 3;
+        for (MpInt i2 = 0; i2 < n; ++i2) {
+            for (MpInt i1 = 0; i1 < n; ++i1) {
+                double v = 0.5 + 0.25*(sin(6.0*i1/n) + cos(5.0*i2/n)) +
+                    0.02*uniform();
+                MpInt ci = 16 + (MpInt)(239*v);
+                z[i1 + i2*n] = (ci < 16 ? 16 : ci > 255 ? 255 : ci);
+            }
+        }
+        Cells c = {dev, z, n};
+        char name[MAX_NAME];
+        sprintf(name, "MpDrawCellsHelper/%ldx%ld", (long)n, (long)n);
+        measure(name, drawCellsHelper, &c, n*n, n*n*sizeof(MpColorIndex));
+    }
+    free(z);
+    MpCloseDevice(&dev);
+}
+
+/*---------------------------------------------------------------------------*/
+/* FILE OUTPUT */
+
+/* Number of polylines and polygons and number of vertices per polyline in a
+   figure. */
+#define FIGURE_POLYLINES 200
+#define FIGURE_POLYGONS   50
+#define FIGURE_VERTICES  100
+
+typedef struct {
+    MpDevice* dev;
+    const char* output;
+    double* x;
+    double* y;
+} Figure;
+
+/* Draw a figure to a new output.  The polylines are random walks which partly
+   leave the plotting area. */
+static void
+drawFigure(void* ctx)
+{
+    Figure* f = ctx;
+    MpDevice* dev = f->dev;
+    MpStatus status = MpReopenDevice(dev, f->output, false);
+    if (status == MP_OK) {
+        status = MpBeginPage(dev);
+    }
+    for (int k = 0; k < FIGURE_POLYLINES && status == MP_OK; ++k) {
+        MpSetColorIndex(dev, k%8);
+        status = MpDrawPolylineDbl(dev, f->x + k, f->y + k, FIGURE_VERTICES);
+    }
+    for (int k = 0; k < FIGURE_POLYGONS && status == MP_OK; ++k) {
+        status = MpDrawPolygonDbl(dev, f->x + 3*k, f->y + 3*k, 6);
+    }
+    if (status == MP_OK) {
+        status = MpEndPage(dev);
+    }
+    if (status != MP_OK) {
+        fprintf(stderr, "Figure output -> %s\n", MpGetReason(status));
+        exit(1);
+    }
+}
+
+/* Measure the speed of a file driver, `label` is the name of the
+   benchmark. */
+static void
+benchFigure(const char* ident,
+            MpStatus (*open)(MpDevice** dev, const char* ident,
+                             const char* arg),
+            const char* label)
+{
+    MpDevice* dev;
+    MpStatus status = MpInstallDriver(ident, open);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&dev, ident, "/dev/null");
+    }
+    if (status != MP_OK) {
+        fprintf(stderr, "MpOpenDevice(\"%s\") -> %s\n",
+                ident, MpGetReason(status));
+        exit(1);
+    }
+    const MpInt n = FIGURE_POLYLINES + FIGURE_VERTICES;
+    double* x = malloc(2*n*sizeof(double));
+    if (x == NULL) {
+        fprintf(stderr, "insufficient memory\n");
+        exit(1);
+    }
+    double* y = x + n;
+    seed = 4;
+    x[0] = y[0] = 0.5;
+    for (MpInt i = 1; i < n; ++i) {
+        x[i] = x[i-1] + 0.05*(uniform() - 0.5);
+        y[i] = y[i-1] + 0.05*(uniform() - 0.5);
+    }
+
+    /* Measure the size of a figure written to a temporary file. */
+    char name[24];
+    strcpy(name, "/tmp/muBenchXXXXXX");
+    int fd = mkstemp(name);
+    if (fd == -1) {
+        fprintf(stderr, "cannot create temporary file\n");
+        exit(1);
+    }
+    close(fd);
+    Figure f = {dev, name, x, y};
+    drawFigure(&f);
+    f.output = "/dev/null";
+    drawFigure(&f);
+    struct stat st;
+    double bytes = (stat(name, &st) == 0 ? (double)st.st_size : 0);
+    remove(name);
+
+    measure(label, drawFigure, &f, FIGURE_POLYLINES + FIGURE_POLYGONS, bytes);
+    free(x);
+    MpCloseDevice(&dev);
+}
+
+int main(int argc, char** argv)
+{
+    const char* baseline = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tolerance = strtod(argv[++i], NULL);
+        } else if (argv[i][0] != '-' && baseline == NULL) {
+            baseline = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-t TOL] [BASELINE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (baseline != NULL && loadBaselines(baseline) != 0) {
+        fprintf(stderr, "cannot read baseline \"%s\"\n", baseline);
+        return 1;
+    }
+    printf("# benchmark\titems\tns/item\titems/s\tMB/s%s\n",
+           (nbaselines > 0 ? "\tbaseline\tspeedup" : ""));
+    benchClipping();
+    benchTransforms();
+    benchCells();
+    benchFigure("xfig", MpOpenXFigDevice, "XFig/figure");
+    benchFigure("pdf", MpOpenPDFDevice, "PDF/figure");
+    MpUninstallAllDrivers();
+    if (nslower > 0) {
+        fprintf(stderr, "%d benchmark(s) slower than the baseline by more "
+                "than %g%%\n", nslower, 100*tolerance);
+        return 2;
+    }
+    return 0;
+}
@@ -14,11 +14,35 @@
 #ifndef _MUPLOT_CLIPPING_C
 #define _MUPLOT_CLIPPING_C 1
 
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "muPlot.h"
+#include "muPlotPriv.h"
+#include "muPlotXForms.h"
 
 #define JOIN(a,b)     a##b
 #define JOIN2(a,b)    JOIN(a,b)
 
+/*
+ * Clipping of polylines and segments is done by blocks of points.  The
+ * clipping bits of all the points of a block are computed first.  If they are
+ * all zero, the segments of the block are all inside the box and are copied
+ * to the output without further tests; otherwise, the segments are clipped one
+ * by one given their clipping bits.
+ */
+#define BLOCK_SIZE 256
+
+/*
+ * The bounds of chunks of points are summarized by a hierarchy of boxes: each
+ * box of an upper level covers `CHUNK_FANOUT` boxes of the level below.
+ * `LANES` is the number of independent accumulators used to compute the
+ * bounds of the points of a chunk.
+ */
+#define CHUNK_FANOUT     16
+#define MAX_CHUNK_LEVELS 24
+#define LANES             8
+
 #define T                     float
 #define SFX                   Flt
 #define BOX                   MpBoxFlt
@@ -30,9 +54,15 @@
 #define CLIP_SEGMENT          MpClipSegmentFlt
 #define CLIP_POLYLINE         MpClipPolylineFlt
 #define CLIP_SEGMENTS         MpClipSegmentsFlt
+#define CLIP_POLYGON          MpClipPolygonFlt
 #define DRAW_CLIPPED_SEGMENT  MpDrawClippedSegmentFlt
 #define DRAW_CLIPPED_POLYLINE MpDrawClippedPolylineFlt
 #define DRAW_CLIPPED_SEGMENTS MpDrawClippedSegmentsFlt
+#define CHUNK_BOUNDS          MpChunkBoundsFlt
+#define INIT_CHUNK_BOUNDS     MpInitializeChunkBoundsFlt
+#define FINALIZE_CHUNK_BOUNDS MpFinalizeChunkBoundsFlt
+#define CLASSIFY_CHUNKS       MpClassifyChunksFlt
+#define CLIP_INDEXED_POLYLINE MpClipIndexedPolylineFlt
 #include __FILE__
 
 #define T                     double
@@ -46,11 +76,28 @@
 #define CLIP_SEGMENT          MpClipSegmentDbl
 #define CLIP_POLYLINE         MpClipPolylineDbl
 #define CLIP_SEGMENTS         MpClipSegmentsDbl
+#define CLIP_POLYGON          MpClipPolygonDbl
 #define DRAW_CLIPPED_SEGMENT  MpDrawClippedSegmentDbl
 #define DRAW_CLIPPED_POLYLINE MpDrawClippedPolylineDbl
 #define DRAW_CLIPPED_SEGMENTS MpDrawClippedSegmentsDbl
+#define CHUNK_BOUNDS          MpChunkBoundsDbl
+#define INIT_CHUNK_BOUNDS     MpInitializeChunkBoundsDbl
+#define FINALIZE_CHUNK_BOUNDS MpFinalizeChunkBoundsDbl
+#define CLASSIFY_CHUNKS       MpClassifyChunksDbl
+#define CLIP_INDEXED_POLYLINE MpClipIndexedPolylineDbl
 #include __FILE__
 
+MpInt
+MpCountChunkBoxes(MpInt chunks)
+{
+    MpInt nboxes = chunks;
+    for (MpInt m = chunks; m > 1; ) {
+        m = (m + CHUNK_FANOUT - 1)/CHUNK_FANOUT;
+        nboxes += m;
+    }
+    return nboxes;
+}
+
 #else /* _MUPLOT_CLIPPING_C defined */
 
 #ifdef CLIP_INIT
@@ -122,29 +169,17 @@ CLIP_NEXT(CLIP_STATE* w, T x, T y)
 }
 #endif /* CLIP_NEXT */
 
-#ifdef CLIP_SEGMENT
-int
-CLIP_SEGMENT(T* x1c, T* y1c, T* x2c, T* y2c, const BOX* box,
-             T x1, T y1, T x2, T y2)
+#if defined(CLIP_SEGMENT) || defined(CLIP_POLYLINE) || defined(CLIP_SEGMENTS)
+/*
+ * Clip a segment whose clipping bits `c1` and `c2` are known.  Returns the
+ * same code as MpClipSegmentFlt() or MpClipSegmentDbl().
+ */
+static inline int
+JOIN2(clipSegmentWithBits,SFX)(T* x1c, T* y1c, T* x2c, T* y2c,
+                               unsigned c1, unsigned c2,
+                               T x1, T y1, T x2, T y2,
+                               T xmin, T xmax, T ymin, T ymax)
 {
-    unsigned c1, c2;
-    T xmin, xmax, ymin, ymax;
-    if (box->xmin <= box->xmax) {
-        xmin = box->xmin;
-        xmax = box->xmax;
-    } else {
-        xmin = box->xmax;
-        xmax = box->xmin;
-    }
-    if (box->ymin <= box->ymax) {
-        ymin = box->ymin;
-        ymax = box->ymax;
-    } else {
-        ymin = box->ymax;
-        ymax = box->ymin;
-    }
-    c1 = MP_CLIP_TBRL(x1, y1, xmin, xmax, ymin, ymax);
-    c2 = MP_CLIP_TBRL(x2, y2, xmin, xmax, ymin, ymax);
     if (c1 == 0 && c2 == 0) {
         /* Accept unclipped segment. */
         *x1c = x1;
@@ -157,29 +192,22 @@ CLIP_SEGMENT(T* x1c, T* y1c, T* x2c, T* y2c, const BOX* box,
            intersections of the segment with box edges. */
         T dx = x2 - x1;
         T dy = y2 - y1;
-        if (c1 == 0) {
-            /* No needs to move first point. */
-            *x1c = x1;
-            *y1c = y1;
-        } else {
+        T x1t = x1, y1t = y1, x2t = x2, y2t = y2;
+        if (c1 != 0) {
             /* Try to move first point at box edges. */
-            MP_CLIP_INTERSECT(T, goto reject, *x1c, *y1c, dx, dy,
-                              x1, y1, x2, y2,
-                              box->xmin, box->xmax,
-                              box->ymin, box->ymax);
+            MP_CLIP_INTERSECT(T, goto reject, x1t, y1t, dx, dy,
+                              x1, y1, x2, y2, xmin, xmax, ymin, ymax);
         }
-        if (c2 == 0) {
-            /* No needs to move second point. */
-            *x2c = x2;
-            *y2c = y2;
-        } else {
+        if (c2 != 0) {
             /* Try to move second point at box edges. */
-            MP_CLIP_INTERSECT(T, goto reject, *x2c, *y2c, dx, dy,
-                              x2, y2, x1, y1,
-                              box->xmin, box->xmax,
-                              box->ymin, box->ymax);
+            MP_CLIP_INTERSECT(T, goto reject, x2t, y2t, dx, dy,
+                              x2, y2, x1, y1, xmin, xmax, ymin, ymax);
         }
         /* Accept the clipped segment. */
+        *x1c = x1t;
+        *y1c = y1t;
+        *x2c = x2t;
+        *y2c = y2t;
         return 2;
     }
 
@@ -188,35 +216,111 @@ CLIP_SEGMENT(T* x1c, T* y1c, T* x2c, T* y2c, const BOX* box,
  reject:
     return 0;
 }
+#endif /* CLIP_SEGMENT || CLIP_POLYLINE || CLIP_SEGMENTS */
+
+#ifdef CLIP_SEGMENT
+int
+CLIP_SEGMENT(T* x1c, T* y1c, T* x2c, T* y2c, const BOX* box,
+             T x1, T y1, T x2, T y2)
+{
+    T xmin, xmax, ymin, ymax;
+    if (box->xmin <= box->xmax) {
+        xmin = box->xmin;
+        xmax = box->xmax;
+    } else {
+        xmin = box->xmax;
+        xmax = box->xmin;
+    }
+    if (box->ymin <= box->ymax) {
+        ymin = box->ymin;
+        ymax = box->ymax;
+    } else {
+        ymin = box->ymax;
+        ymax = box->ymin;
+    }
+    return JOIN2(clipSegmentWithBits,SFX)(
+        x1c, y1c, x2c, y2c,
+        MP_CLIP_TBRL(x1, y1, xmin, xmax, ymin, ymax),
+        MP_CLIP_TBRL(x2, y2, xmin, xmax, ymin, ymax),
+        x1, y1, x2, y2, xmin, xmax, ymin, ymax);
+}
 #endif /* CLIP_SEGMENT */
 
+#if defined(CLIP_POLYLINE) || defined(CLIP_SEGMENTS)
+/*
+ * Compute the clipping bits of `n` points.  The bits of the point at
+ * `(x[i*inc],y[i*inc])` are stored in `c[i]` and the bitwise OR of all bits is
+ * returned, hence a zero result indicates that all points are inside the box.
+ * This loop has no branches and is vectorized by the compiler.
+ */
+static unsigned
+JOIN2(clipBits,SFX)(unsigned* restrict c, const T* restrict x,
+                    const T* restrict y, MpInt inc, MpInt n,
+                    T xmin, T xmax, T ymin, T ymax)
+{
+    unsigned any = 0;
+    for (MpInt i = 0; i < n; ++i) {
+        unsigned ci = MP_CLIP_TBRL(x[i*inc], y[i*inc], xmin, xmax, ymin, ymax);
+        c[i] = ci;
+        any |= ci;
+    }
+    return any;
+}
+#endif /* CLIP_POLYLINE || CLIP_SEGMENTS */
+
 #ifdef CLIP_POLYLINE
 MpInt
 CLIP_POLYLINE(T* xc, T* yc, const BOX* box,
               const T* x, const T* y, MpInt n)
 {
-    MpInt i, j = 0;
+    MpInt j = 0;
     if (n >= 2) {
-        CLIP_STATE w;
-        CLIP_INIT(&w, x[0], y[0], box);
-        for (i = 1; i < n; ++i) {
-            switch (CLIP_NEXT(&w, x[i], y[i])) {
-            case 1:
-                /* Append the unclipped segment. */
-                xc[j]   = w.x1;
-                yc[j]   = w.y1;
-                xc[j+1] = w.x2;
-                yc[j+1] = w.y2;
-                j += 2;
-                break;
-            case 2:
-                /* Append the clipped segment. */
-                xc[j]   = w.x1c;
-                yc[j]   = w.y1c;
-                xc[j+1] = w.x2c;
-                yc[j+1] = w.y2c;
-                j += 2;
-                break;
+        unsigned c[BLOCK_SIZE + 1];
+        T xmin, xmax, ymin, ymax;
+        if (box->xmin <= box->xmax) {
+            xmin = box->xmin;
+            xmax = box->xmax;
+        } else {
+            xmin = box->xmax;
+            xmax = box->xmin;
+        }
+        if (box->ymin <= box->ymax) {
+            ymin = box->ymin;
+            ymax = box->ymax;
+        } else {
+            ymin = box->ymax;
+            ymax = box->ymin;
+        }
+        for (MpInt i0 = 0; i0 < n - 1; i0 += BLOCK_SIZE) {
+            /* Segments of the block join the points i0, ..., i0 + m. */
+            MpInt m = n - 1 - i0;
+            if (m > BLOCK_SIZE) {
+                m = BLOCK_SIZE;
+            }
+            const T* xb = x + i0;
+            const T* yb = y + i0;
+            if (JOIN2(clipBits,SFX)(c, xb, yb, 1, m + 1,
+                                    xmin, xmax, ymin, ymax) == 0) {
+                /* Append all the unclipped segments of the block. */
+                T* xo = xc + j;
+                T* yo = yc + j;
+                for (MpInt k = 0; k < m; ++k) {
+                    xo[2*k]   = xb[k];
+                    yo[2*k]   = yb[k];
+                    xo[2*k+1] = xb[k+1];
+                    yo[2*k+1] = yb[k+1];
+                }
+                j += 2*m;
+            } else {
+                /* Append the (clipped) segments. */
+                for (MpInt k = 0; k < m; ++k) {
+                    if (JOIN2(clipSegmentWithBits,SFX)(
+                            &xc[j], &yc[j], &xc[j+1], &yc[j+1],
+                            c[k], c[k+1], xb[k], yb[k], xb[k+1], yb[k+1],
+                            xmin, xmax, ymin, ymax) != 0) {
+                        j += 2;
+                    }
+                }
             }
         }
     }
@@ -229,7 +333,8 @@ MpInt
 CLIP_SEGMENTS(T* xc, T* yc, const BOX* box,
               const T* x, const T* y, MpInt n)
 {
-    MpInt i, j = 0;
+    unsigned c1[BLOCK_SIZE], c2[BLOCK_SIZE];
+    MpInt j = 0;
     T xmin, xmax, ymin, ymax;
     if (box->xmin <= box->xmax) {
         xmin = box->xmin;
@@ -245,53 +350,159 @@ CLIP_SEGMENTS(T* xc, T* yc, const BOX* box,
         ymin = box->ymax;
         ymax = box->ymin;
     }
-    for (i = 1; i < n; ++i) {
-        T x1 = x[2*i];
-        T y1 = y[2*i];
-        T x2 = x[2*i+1];
-        T y2 = y[2*i+1];
-        unsigned c1 = MP_CLIP_TBRL(x1, y1, xmin, xmax, ymin, ymax);
-        unsigned c2 = MP_CLIP_TBRL(x2, y2, xmin, xmax, ymin, ymax);
-        if (c1 == 0 && c2 == 0) {
-            /* Accept unclipped segment. */
-            xc[2*j]   = x1;
-            yc[2*j]   = y1;
-            xc[2*j+1] = x2;
-            yc[2*j+1] = y2;
-            ++j;
-        } else if ((c1 & c2) == 0) {
-            /* The segment is not trivially outside box, try to find
-               intersections of the segment with box edges. */
-            T dx = x2 - x1;
-            T dy = y2 - y1;
-            if (c1 == 0) {
-                /* No needs to move first point. */
-                xc[2*j] = x1;
-                yc[2*j] = y1;
-            } else {
-                /* Try to move first point at box edges. */
-                MP_CLIP_INTERSECT(T, goto reject, xc[2*j], yc[2*j], dx, dy,
-                                  x1, y1, x2, y2, xmin, xmax, ymin, ymax);
+    for (MpInt i0 = 0; i0 < n; i0 += BLOCK_SIZE) {
+        /* Segments of the block are i0, ..., i0 + m - 1. */
+        MpInt m = n - i0;
+        if (m > BLOCK_SIZE) {
+            m = BLOCK_SIZE;
+        }
+        const T* xb = x + 2*i0;
+        const T* yb = y + 2*i0;
+        unsigned any = (JOIN2(clipBits,SFX)(c1, xb, yb, 2, m,
+                                            xmin, xmax, ymin, ymax) |
+                        JOIN2(clipBits,SFX)(c2, xb + 1, yb + 1, 2, m,
+                                            xmin, xmax, ymin, ymax));
+        if (any == 0) {
+            /* Append all the unclipped segments of the block (the operation
+               may be done in-place and the destination is never after the
+               source). */
+            if (xc + 2*j != xb) {
+                memmove(xc + 2*j, xb, 2*m*sizeof(T));
             }
-            if (c2 == 0) {
-                /* No needs to move second point. */
-                xc[2*j+1] = x2;
-                yc[2*j+1] = y2;
-            } else {
-                /* Try to move second point at box edges. */
-                MP_CLIP_INTERSECT(T, goto reject, xc[2*j+1], yc[2*j+1], dx, dy,
-                                  x2, y2, x1, y1, xmin, xmax, ymin, ymax);
+            if (yc + 2*j != yb) {
+                memmove(yc + 2*j, yb, 2*m*sizeof(T));
+            }
+            j += m;
+        } else {
+            /* Append the (clipped) segments. */
+            for (MpInt k = 0; k < m; ++k) {
+                if (JOIN2(clipSegmentWithBits,SFX)(
+                        &xc[2*j], &yc[2*j], &xc[2*j+1], &yc[2*j+1],
+                        c1[k], c2[k], xb[2*k], yb[2*k], xb[2*k+1], yb[2*k+1],
+                        xmin, xmax, ymin, ymax) != 0) {
+                    ++j;
+                }
             }
-            /* Accept the clipped segment. */
-            ++j;
         }
-    reject:
-        continue;
     }
     return j;
 }
 #endif /* CLIP_SEGMENTS */
 
+#ifdef CLIP_POLYGON
+/*
+ * Clip a polygon of `n` vertices against the slab `lo ≤ u ≤ hi` by the
+ * Sutherland-Hodgman algorithm and return the number of vertices of the
+ * result.  Depending on the order of the arguments, `(u,v)` are `(x,y)` or
+ * `(y,x)`.  Each edge yields at most 2 output vertices, all on the edge (the
+ * intersections with the slab limits and the end of the edge).  The vertices
+ * are read before being overwritten, so the input may be stored at offset
+ * `m ≥ n` after the output.
+ */
+static MpInt
+JOIN2(clipSlab,SFX)(T* uo, T* vo, const T* ui, const T* vi, MpInt n,
+                    T lo, T hi)
+{
+#define CROSS(c)                                     \
+    do {                                             \
+        uo[j] = (c);                                 \
+        vo[j] = vp + ((c) - up)*(vq - vp)/(uq - up); \
+        ++j;                                         \
+    } while (0)
+    MpInt j = 0;
+    T up = ui[n-1], vp = vi[n-1];
+    int sp = (up < lo ? -1 : (up > hi ? 1 : 0));
+    for (MpInt k = 0; k < n; ++k) {
+        T uq = ui[k], vq = vi[k];
+        int sq = (uq < lo ? -1 : (uq > hi ? 1 : 0));
+        if (sq != sp) {
+            /* Leave the side of the previous vertex, then enter the one of
+               the current vertex. */
+            if (sp < 0) {
+                CROSS(lo);
+            } else if (sp > 0) {
+                CROSS(hi);
+            }
+            if (sq < 0) {
+                CROSS(lo);
+            } else if (sq > 0) {
+                CROSS(hi);
+            }
+        }
+        if (sq == 0) {
+            uo[j] = uq;
+            vo[j] = vq;
+            ++j;
+        }
+        up = uq;
+        vp = vq;
+        sp = sq;
+    }
+    return j;
+#undef CROSS
+}
+
+MpInt
+CLIP_POLYGON(T* xc, T* yc, const BOX* box,
+             const T* x, const T* y, MpInt n)
+{
+    if (n < 3) {
+        return 0;
+    }
+    T xmin, xmax, ymin, ymax;
+    if (box->xmin <= box->xmax) {
+        xmin = box->xmin;
+        xmax = box->xmax;
+    } else {
+        xmin = box->xmax;
+        xmax = box->xmin;
+    }
+    if (box->ymin <= box->ymax) {
+        ymin = box->ymin;
+        ymax = box->ymax;
+    } else {
+        ymin = box->ymax;
+        ymax = box->ymin;
+    }
+
+    /* The polygon is rejected if all its vertices are beyond the same edge
+       of the box and accepted if they are all inside.  Otherwise, only the
+       limits crossed by some vertices are considered.  This loop has no
+       branches and is vectorized by the compiler. */
+    unsigned any = 0, all = ~0U;
+    for (MpInt i = 0; i < n; ++i) {
+        unsigned c = MP_CLIP_TBRL(x[i], y[i], xmin, xmax, ymin, ymax);
+        any |= c;
+        all &= c;
+    }
+    if (all != 0) {
+        return 0;
+    }
+    if (any == 0) {
+        memcpy(xc, x, n*sizeof(T));
+        memcpy(yc, y, n*sizeof(T));
+        return n;
+    }
+
+    /* Clip against the vertical limits, then against the horizontal ones.
+       There are at most 2n vertices after the first pass, 4n after the
+       second one.  The result of the first pass is stored in the second half
+       of the output arrays if the second pass is needed. */
+    MpInt m;
+    if ((any & 12U) == 0) {
+        m = JOIN2(clipSlab,SFX)(xc, yc, x, y, n, xmin, xmax);
+    } else if ((any & 3U) == 0) {
+        m = JOIN2(clipSlab,SFX)(yc, xc, y, x, n, ymin, ymax);
+    } else {
+        T* xw = xc + 2*n;
+        T* yw = yc + 2*n;
+        m = JOIN2(clipSlab,SFX)(xw, yw, x, y, n, xmin, xmax);
+        m = (m < 3 ? 0 : JOIN2(clipSlab,SFX)(yc, xc, yw, xw, m, ymin, ymax));
+    }
+    return (m < 3 ? 0 : m);
+}
+#endif /* CLIP_POLYGON */
+
 #ifdef DRAW_CLIPPED_SEGMENT
 MpStatus
 DRAW_CLIPPED_SEGMENT(void* ctx,
@@ -424,7 +635,7 @@ DRAW_CLIPPED_SEGMENTS(void* ctx,
         ymin = box->ymax;
         ymax = box->ymin;
     }
-    for (i = 1; i < n; ++i) {
+    for (i = 0; i < n; ++i) {
         T x1 = x[2*i];
         T y1 = y[2*i];
         T x2 = x[2*i+1];
@@ -478,6 +689,265 @@ DRAW_CLIPPED_SEGMENTS(void* ctx,
 }
 #endif /* DRAW_CLIPPED_SEGMENTS */
 
+#ifdef INIT_CHUNK_BOUNDS
+/*
+ * Compute the bounds of `n` points.  Bounds are accumulated in `LANES`
+ * independent lanes so that the loop is vectorized by the compiler, NaN are
+ * ignored.
+ */
+static void
+JOIN2(pointsBounds,SFX)(BOX* b, const T* restrict x, const T* restrict y,
+                        MpInt n)
+{
+    T x0[LANES], x1[LANES], y0[LANES], y1[LANES];
+    for (int k = 0; k < LANES; ++k) {
+        x0[k] = y0[k] = +(T)INFINITY;
+        x1[k] = y1[k] = -(T)INFINITY;
+    }
+    MpInt i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int k = 0; k < LANES; ++k) {
+            T xi = x[i+k], yi = y[i+k];
+            x0[k] = (xi < x0[k] ? xi : x0[k]);
+            x1[k] = (xi > x1[k] ? xi : x1[k]);
+            y0[k] = (yi < y0[k] ? yi : y0[k]);
+            y1[k] = (yi > y1[k] ? yi : y1[k]);
+        }
+    }
+    for (int k = 0; i < n; ++i, ++k) {
+        T xi = x[i], yi = y[i];
+        x0[k] = (xi < x0[k] ? xi : x0[k]);
+        x1[k] = (xi > x1[k] ? xi : x1[k]);
+        y0[k] = (yi < y0[k] ? yi : y0[k]);
+        y1[k] = (yi > y1[k] ? yi : y1[k]);
+    }
+    for (int k = 1; k < LANES; ++k) {
+        x0[0] = (x0[k] < x0[0] ? x0[k] : x0[0]);
+        x1[0] = (x1[k] > x1[0] ? x1[k] : x1[0]);
+        y0[0] = (y0[k] < y0[0] ? y0[k] : y0[0]);
+        y1[0] = (y1[k] > y1[0] ? y1[k] : y1[0]);
+    }
+    b->xmin = x0[0];
+    b->xmax = x1[0];
+    b->ymin = y0[0];
+    b->ymax = y1[0];
+}
+
+MpStatus
+INIT_CHUNK_BOUNDS(CHUNK_BOUNDS* cb, const T* x, const T* y, MpInt n,
+                  MpInt size)
+{
+    if (cb == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    memset(cb, 0, sizeof(*cb));
+    if (n < 0) {
+        return MP_BAD_SIZE;
+    }
+    if (n > 0 && (x == NULL || y == NULL)) {
+        return MP_BAD_ADDRESS;
+    }
+    if (size <= 0) {
+        size = MP_DEFAULT_CHUNK_SIZE;
+    }
+
+    /* Count the chunks and the boxes of all levels. */
+    MpInt nchunks = (n < 2 ? n : (n - 2)/size + 1);
+    MpInt nboxes = nchunks, levels = (nchunks > 0);
+    for (MpInt m = nchunks; m > 1; ++levels) {
+        m = (m + CHUNK_FANOUT - 1)/CHUNK_FANOUT;
+        nboxes += m;
+    }
+    if (nboxes > 0) {
+        cb->boxes = (BOX*)malloc(nboxes*sizeof(BOX));
+        if (cb->boxes == NULL) {
+            return MP_NO_MEMORY;
+        }
+    }
+    cb->count = n;
+    cb->chunkSize = size;
+    cb->chunks = nchunks;
+    cb->levels = levels;
+
+    /* Bounds of the chunks, the last point of a chunk is the first one of
+       the next chunk. */
+    BOX* b = cb->boxes;
+    for (MpInt k = 0; k < nchunks; ++k) {
+        MpInt i0 = k*size;
+        MpInt i1 = (n - 1 - i0 > size ? i0 + size : n - 1);
+        JOIN2(pointsBounds,SFX)(&b[k], x + i0, y + i0, i1 + 1 - i0);
+    }
+
+    /* Bounds of the upper levels. */
+    for (MpInt m = nchunks; m > 1; ) {
+        BOX* c = b + m;
+        MpInt p = (m + CHUNK_FANOUT - 1)/CHUNK_FANOUT;
+        for (MpInt k = 0; k < p; ++k) {
+            BOX u = b[k*CHUNK_FANOUT];
+            MpInt l = (m - k*CHUNK_FANOUT < CHUNK_FANOUT ?
+                       m - k*CHUNK_FANOUT : CHUNK_FANOUT);
+            for (MpInt i = 1; i < l; ++i) {
+                const BOX* v = &b[k*CHUNK_FANOUT + i];
+                u.xmin = (v->xmin < u.xmin ? v->xmin : u.xmin);
+                u.xmax = (v->xmax > u.xmax ? v->xmax : u.xmax);
+                u.ymin = (v->ymin < u.ymin ? v->ymin : u.ymin);
+                u.ymax = (v->ymax > u.ymax ? v->ymax : u.ymax);
+            }
+            c[k] = u;
+        }
+        b = c;
+        m = p;
+    }
+    return MP_OK;
+}
+
+void
+FINALIZE_CHUNK_BOUNDS(CHUNK_BOUNDS* cb)
+{
+    if (cb != NULL) {
+        if (cb->boxes != NULL) {
+            free((void*)cb->boxes);
+        }
+        memset(cb, 0, sizeof(*cb));
+    }
+}
+
+/*
+ * Classify the chunks of the node `k` at level `l` whose first box is
+ * `boxes[offset[l] + k]`.  The result is the number of chunks which are not
+ * outside.
+ */
+static MpInt
+JOIN2(classifyNode,SFX)(uint8_t* code, const CHUNK_BOUNDS* cb,
+                        const MpInt* offset, MpInt l, MpInt k,
+                        const MpCoordinateTransform* C,
+                        double xmin, double xmax, double ymin, double ymax)
+{
+    /* Range of chunks of the node. */
+    MpInt span = 1;
+    for (MpInt i = 0; i < l; ++i) {
+        span *= CHUNK_FANOUT;
+    }
+    MpInt k0 = k*span, k1 = k0 + span;
+    if (k1 > cb->chunks) {
+        k1 = cb->chunks;
+    }
+
+    /* Bounds of the node in the coordinates of the box. */
+    const BOX* b = &cb->boxes[offset[l] + k];
+    int result;
+    if (b->xmin > b->xmax || b->ymin > b->ymax) {
+        /* Empty node (no finite points). */
+        result = MP_CHUNK_OUTSIDE;
+    } else {
+        double u0, u1, v0, v1;
+        if (C == NULL) {
+            u0 = b->xmin;
+            u1 = b->xmax;
+            v0 = b->ymin;
+            v1 = b->ymax;
+        } else {
+            /* Interval arithmetic, zero coefficients are skipped to avoid
+               `0*Inf`. */
+            u0 = u1 = C->x;
+            v0 = v1 = C->y;
+#define ADD_TERM(w0, w1, a, t0, t1)                     \
+            do {                                        \
+                if ((a) > 0) {                          \
+                    w0 += (a)*(t0);                     \
+                    w1 += (a)*(t1);                     \
+                } else if ((a) < 0) {                   \
+                    w0 += (a)*(t1);                     \
+                    w1 += (a)*(t0);                     \
+                }                                       \
+            } while (0)
+            ADD_TERM(u0, u1, C->xx, b->xmin, b->xmax);
+            ADD_TERM(u0, u1, C->xy, b->ymin, b->ymax);
+            ADD_TERM(v0, v1, C->yx, b->xmin, b->xmax);
+            ADD_TERM(v0, v1, C->yy, b->ymin, b->ymax);
+#undef ADD_TERM
+        }
+        /* NaN (e.g. `Inf - Inf`) yield the straddling case. */
+        if (u1 < xmin || u0 > xmax || v1 < ymin || v0 > ymax) {
+            result = MP_CHUNK_OUTSIDE;
+        } else if (u0 >= xmin && u1 <= xmax && v0 >= ymin && v1 <= ymax) {
+            result = MP_CHUNK_INSIDE;
+        } else if (l > 0) {
+            /* Descend in the hierarchy. */
+            MpInt cnt = 0;
+            MpInt m = (k1 - k0 + span/CHUNK_FANOUT - 1)/(span/CHUNK_FANOUT);
+            for (MpInt i = 0; i < m; ++i) {
+                cnt += JOIN2(classifyNode,SFX)(code, cb, offset, l - 1,
+                                               k*CHUNK_FANOUT + i, C,
+                                               xmin, xmax, ymin, ymax);
+            }
+            return cnt;
+        } else {
+            result = MP_CHUNK_STRADDLING;
+        }
+    }
+    memset(code + k0, result, k1 - k0);
+    return (result == MP_CHUNK_OUTSIDE ? 0 : k1 - k0);
+}
+
+MpInt
+CLASSIFY_CHUNKS(uint8_t* code, const CHUNK_BOUNDS* cb,
+                const MpCoordinateTransform* C, const BOX* box)
+{
+    if (cb->chunks < 1) {
+        return 0;
+    }
+    MpInt offset[MAX_CHUNK_LEVELS];
+    offset[0] = 0;
+    for (MpInt l = 1, m = cb->chunks; l < cb->levels; ++l) {
+        offset[l] = offset[l-1] + m;
+        m = (m + CHUNK_FANOUT - 1)/CHUNK_FANOUT;
+    }
+    double xmin = (box->xmin <= box->xmax ? box->xmin : box->xmax);
+    double xmax = (box->xmin <= box->xmax ? box->xmax : box->xmin);
+    double ymin = (box->ymin <= box->ymax ? box->ymin : box->ymax);
+    double ymax = (box->ymin <= box->ymax ? box->ymax : box->ymin);
+    return JOIN2(classifyNode,SFX)(code, cb, offset, cb->levels - 1, 0, C,
+                                   xmin, xmax, ymin, ymax);
+}
+#endif /* INIT_CHUNK_BOUNDS */
+
+#ifdef CLIP_INDEXED_POLYLINE
+MpInt
+CLIP_INDEXED_POLYLINE(T* xc, T* yc, const BOX* box,
+                      const T* x, const T* y, MpInt n,
+                      const CHUNK_BOUNDS* cb, uint8_t* code)
+{
+    MpInt nchunks = cb->chunks, size = cb->chunkSize;
+    if (n < 2 || n != cb->count) {
+        return 0;
+    }
+    CLASSIFY_CHUNKS(code, cb, NULL, box);
+    MpInt j = 0;
+    for (MpInt k = 0; k < nchunks; ++k) {
+        if (code[k] == MP_CHUNK_OUTSIDE) {
+            continue;
+        }
+        MpInt i0 = k*size;
+        MpInt i1 = (n - 1 - i0 > size ? i0 + size : n - 1);
+        if (code[k] == MP_CHUNK_INSIDE) {
+            /* Append all the unclipped segments of the chunk. */
+            for (MpInt i = i0; i < i1; ++i) {
+                xc[j]   = x[i];
+                yc[j]   = y[i];
+                xc[j+1] = x[i+1];
+                yc[j+1] = y[i+1];
+                j += 2;
+            }
+        } else {
+            j += 2*CLIP_POLYLINE(xc + j, yc + j, box,
+                                 x + i0, y + i0, i1 + 1 - i0);
+        }
+    }
+    return (j >> 1);
+}
+#endif /* CLIP_INDEXED_POLYLINE */
+
 #undef T
 #undef SFX
 #undef BOX
@@ -489,8 +959,14 @@ DRAW_CLIPPED_SEGMENTS(void* ctx,
 #undef CLIP_SEGMENT
 #undef CLIP_POLYLINE
 #undef CLIP_SEGMENTS
+#undef CLIP_POLYGON
 #undef DRAW_CLIPPED_SEGMENT
 #undef DRAW_CLIPPED_POLYLINE
 #undef DRAW_CLIPPED_SEGMENTS
+#undef CHUNK_BOUNDS
+#undef INIT_CHUNK_BOUNDS
+#undef FINALIZE_CHUNK_BOUNDS
+#undef CLASSIFY_CHUNKS
+#undef CLIP_INDEXED_POLYLINE
 
 #endif /* _MUPLOT_CLIPPING_C */
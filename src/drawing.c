@@ -0,0 +1,1089 @@
+/*
+ * drawing.c --
+ *
+ * Implementation of the user-level drawing routines which convert user-defined
+ * coordinates into device coordinates.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#ifndef _MUPLOT_DRAWING_C
+#define _MUPLOT_DRAWING_C 1
+
+#include <stdlib.h>
+#include <string.h>
+#include "muPlotPriv.h"
+
+/*
+ * Maximum number of vertices sent to the driver in a single call.  Longer
+ * polylines are sent in several pieces, each piece starting at the last
+ * vertex of the previous one.  This bounds the size of the scratch buffers of
+ * the device.
+ */
+#define CHUNK_SIZE 4096
+
+/*
+ * With nonlinear axis scales, the coordinates are scaled by blocks of
+ * `SCALE_BLOCK` vertices in buffers on the stack right before being
+ * transformed, so that no temporary copy of the data is needed.
+ */
+#define SCALE_BLOCK 256
+
+/*
+ * Round device coordinate to the nearest sample.  The argument is assumed to
+ * be non-negative which holds after clipping.
+ */
+#define ROUND_POINT(u) ((MpPoint)((u) + 0.5))
+
+void
+MpInitializeDecimator(MpDecimator* d)
+{
+    d->count = 0;
+}
+
+/* Store the vertices kept in the current column of the decimator, skipping
+   consecutive duplicates, and return their number. */
+static MpInt
+emitColumn(const MpDecimator* d, MpPoint* xout, MpPoint* yout)
+{
+    MpPoint y[4];
+    MpInt m = 0;
+    y[m++] = d->yfirst;
+    if (d->minFirst) {
+        if (d->ymin != y[m-1]) y[m++] = d->ymin;
+        if (d->ymax != y[m-1]) y[m++] = d->ymax;
+    } else {
+        if (d->ymax != y[m-1]) y[m++] = d->ymax;
+        if (d->ymin != y[m-1]) y[m++] = d->ymin;
+    }
+    if (d->ylast != y[m-1]) y[m++] = d->ylast;
+    for (MpInt k = 0; k < m; ++k) {
+        xout[k] = d->x;
+        yout[k] = y[k];
+    }
+    return m;
+}
+
+MpInt
+MpDecimatePolyline(MpDecimator* d, MpPoint* xout, MpPoint* yout,
+                   const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    /* Vertices of a column are only written when the column is complete and
+       they are stored before the first vertex of the next column, hence the
+       operation can be done in-place for a fresh decimator. */
+    MpInt j = 0;
+    for (MpInt i = 0; i < n; ++i) {
+        MpPoint xi = x[i], yi = y[i];
+        if (d->count > 0 && xi == d->x) {
+            if (yi < d->ymin) {
+                d->ymin = yi;
+                d->minFirst = false;
+            } else if (yi > d->ymax) {
+                d->ymax = yi;
+                d->minFirst = true;
+            }
+            d->ylast = yi;
+            ++d->count;
+        } else {
+            if (d->count > 0) {
+                j += emitColumn(d, xout + j, yout + j);
+            }
+            d->count = 1;
+            d->minFirst = true;
+            d->x = xi;
+            d->yfirst = yi;
+            d->ymin = yi;
+            d->ymax = yi;
+            d->ylast = yi;
+        }
+    }
+    return j;
+}
+
+MpInt
+MpFlushDecimator(MpDecimator* d, MpPoint* xout, MpPoint* yout)
+{
+    MpInt j = 0;
+    if (d->count > 0) {
+        j = emitColumn(d, xout, yout);
+        d->count = 0;
+    }
+    return j;
+}
+
+/*
+ * Check whether the vertex 1 is on the segment joining vertices 0 and 2 and
+ * distinct of them, that is whether the segments joining vertices 0 to 1 and
+ * 1 to 2 are collinear and have the same direction.  Computations are exact.
+ */
+static inline bool
+isAligned(MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1,
+          MpPoint x2, MpPoint y2)
+{
+    int64_t dx1 = x1 - x0, dy1 = y1 - y0;
+    int64_t dx2 = x2 - x1, dy2 = y2 - y1;
+    return (dx1*dy2 == dy1*dx2 && dx1*dx2 + dy1*dy2 > 0);
+}
+
+MpInt
+MpSimplifyPolyline(MpPoint* x, MpPoint* y, MpInt n)
+{
+    if (n < 2) {
+        return n;
+    }
+    MpInt j = 0; /* index of last kept vertex */
+    for (MpInt i = 1; i < n; ++i) {
+        MpPoint xi = x[i], yi = y[i];
+        if (xi == x[j] && yi == y[j]) {
+            /* Skip repeated vertex. */
+            continue;
+        }
+        if (j < 1 || ! isAligned(x[j-1], y[j-1], x[j], y[j], xi, yi)) {
+            /* Keep last vertex. */
+            ++j;
+        }
+        x[j] = xi;
+        y[j] = yi;
+    }
+    return j + 1;
+}
+
+MpInt
+MpSimplifyPolygon(MpPoint* x, MpPoint* y, MpInt n)
+{
+    n = MpSimplifyPolyline(x, y, n);
+    while (n > 1 && x[n-1] == x[0] && y[n-1] == y[0]) {
+        --n;
+    }
+    /* Owing to the simplification of the polyline, a vertex is merged at
+       most once at each end of the polygon. */
+    if (n >= 3 && isAligned(x[n-2], y[n-2], x[n-1], y[n-1], x[0], y[0])) {
+        --n;
+    }
+    if (n >= 3 && isAligned(x[n-1], y[n-1], x[0], y[0], x[1], y[1])) {
+        --n;
+        memmove(x, x + 1, n*sizeof(MpPoint));
+        memmove(y, y + 1, n*sizeof(MpPoint));
+    }
+    return n;
+}
+
+/*
+ * Send a piece of polyline in device coordinates to the driver, decimating
+ * and/or simplifying it first if requested.  The vertices may be overwritten.
+ */
+static MpStatus
+drawPiece(MpDevice* dev, MpPoint* x, MpPoint* y, MpInt n)
+{
+    if (dev->decimate) {
+        MpDecimator d;
+        MpInitializeDecimator(&d);
+        MpInt m = MpDecimatePolyline(&d, x, y, x, y, n);
+        n = m + MpFlushDecimator(&d, x + m, y + m);
+    }
+    if (dev->simplify) {
+        n = MpSimplifyPolyline(x, y, n);
+    }
+    if (n < 2) {
+        /* All vertices are the same, draw a segment of null length. */
+        x[1] = x[0];
+        y[1] = y[0];
+        n = 2;
+    }
+    MpStatus status = MpApplySettings(dev);
+    if (status != MP_OK) {
+        return status;
+    }
+    return dev->drawPolyline(dev, x, y, n);
+}
+
+MpStatus
+MpDrawDevicePolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y,
+                     MpInt n)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n < 2) {
+        return (n < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+    if (! dev->decimate && ! dev->simplify) {
+        MpStatus status = MpApplySettings(dev);
+        return (status != MP_OK ? status : dev->drawPolyline(dev, x, y, n));
+    }
+    MpStatus status = MpReserveScratch(dev, n);
+    if (status != MP_OK) {
+        return status;
+    }
+    memcpy(dev->xscratch, x, n*sizeof(MpPoint));
+    memcpy(dev->yscratch, y, n*sizeof(MpPoint));
+    return drawPiece(dev, dev->xscratch, dev->yscratch, n);
+}
+
+MpStatus
+MpDrawPointsHelper(MpDevice* dev, const MpPoint* x, const MpPoint* y,
+                   MpInt n)
+{
+    MpStatus status = MP_OK;
+    for (MpInt i = 0; i < n && status == MP_OK; ++i) {
+        status = dev->drawPoint(dev, x[i], y[i]);
+    }
+    return status;
+}
+
+MpStatus
+MpDrawDevicePoints(MpDevice* dev, const MpPoint* x, const MpPoint* y,
+                   MpInt n)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n < 1) {
+        return (n < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+    MpStatus status = MpApplySettings(dev);
+    return (status != MP_OK ? status : dev->drawPoints(dev, x, y, n));
+}
+
+MpStatus
+MpDrawDevicePolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y,
+                    MpInt n)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n < 1) {
+        return (n < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+    MpStatus status = MpApplySettings(dev);
+    if (status != MP_OK) {
+        return status;
+    }
+    if (dev->simplify) {
+        status = MpReserveScratch(dev, n);
+        if (status != MP_OK) {
+            return status;
+        }
+        memcpy(dev->xscratch, x, n*sizeof(MpPoint));
+        memcpy(dev->yscratch, y, n*sizeof(MpPoint));
+        MpInt m = MpSimplifyPolygon(dev->xscratch, dev->yscratch, n);
+        if (m >= 3) {
+            /* Only draw the simplified polygon if it is not degenerated,
+               otherwise let the driver deal with the original one. */
+            return dev->drawPolygon(dev, dev->xscratch, dev->yscratch, m);
+        }
+    }
+    return dev->drawPolygon(dev, x, y, n);
+}
+
+/*
+ * Send the polygon whose `n` vertices are stored at the beginning of the
+ * scratch buffers to the driver, simplifying it first if requested.  The
+ * scratch buffers must have at least `2n` elements, the second half is used
+ * for the simplified polygon.
+ */
+static MpStatus
+drawScratchPolygon(MpDevice* dev, MpInt n)
+{
+    MpPoint* x = dev->xscratch;
+    MpPoint* y = dev->yscratch;
+    MpStatus status = MpApplySettings(dev);
+    if (status != MP_OK) {
+        return status;
+    }
+    if (dev->simplify) {
+        memcpy(x + n, x, n*sizeof(MpPoint));
+        memcpy(y + n, y, n*sizeof(MpPoint));
+        MpInt m = MpSimplifyPolygon(x + n, y + n, n);
+        if (m >= 3) {
+            /* Only draw the simplified polygon if it is not degenerated,
+               otherwise let the driver deal with the original one. */
+            return dev->drawPolygon(dev, x + n, y + n, m);
+        }
+    }
+    return dev->drawPolygon(dev, x, y, n);
+}
+
+void
+MpInitializeCellEdges(MpCellEdges* s, MpPoint a, MpPoint b, MpInt n)
+{
+    /* Quotient and remainder of the step for a division rounded toward
+       minus infinity. */
+    MpInt d = (MpInt)b - (MpInt)a;
+    s->q = d/n;
+    s->r = d%n;
+    if (s->r < 0) {
+        s->r += n;
+        s->q -= 1;
+    }
+    s->n = n;
+    s->acc = 0;
+    s->e = a;
+}
+
+/*
+ * State of a polyline drawn by pieces.  For a polyline drawn by
+ * MpBeginPolyline(), MpAppendPolyline...() and MpEndPolyline(), this
+ * structure and its vertices are allocated as a single block of memory.
+ */
+typedef struct _MpPolylineStream {
+    MpClipStateDbl clip; /* State of clipping */
+    MpPoint* x; /* Abscissae of the vertices of the current piece */
+    MpPoint* y; /* Ordinates of the vertices of the current piece */
+    MpInt count; /* Number of vertices in the current piece */
+    bool restart; /* Clipping must be (re)started? */
+    bool active; /* Polyline has begun? */
+    double xp, yp; /* Last (unrounded) vertex of the current piece */
+} PolylineStream;
+
+MpStatus
+MpBeginPolyline(MpDevice* dev)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    PolylineStream* s = dev->stream;
+    if (s == NULL) {
+        s = (PolylineStream*)malloc(sizeof(PolylineStream) +
+                                    2*CHUNK_SIZE*sizeof(MpPoint));
+        if (s == NULL) {
+            return MP_NO_MEMORY;
+        }
+        s->x = (MpPoint*)(s + 1);
+        s->y = s->x + CHUNK_SIZE;
+        dev->stream = s;
+    } else if (s->active) {
+        return MP_NOT_PERMITTED;
+    }
+    s->count = 0;
+    s->restart = true;
+    s->active = true;
+    s->xp = s->yp = 0;
+    return MP_OK;
+}
+
+void
+MpDropPolyline(MpDevice* dev)
+{
+    if (dev->stream != NULL) {
+        dev->stream->active = false;
+    }
+}
+
+MpStatus
+MpEndPolyline(MpDevice* dev)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    PolylineStream* s = dev->stream;
+    if (s == NULL || ! s->active) {
+        return MP_NOT_PERMITTED;
+    }
+    s->active = false;
+    return (s->count >= 2 ? drawPiece(dev, s->x, s->y, s->count) : MP_OK);
+}
+
+#define T                     float
+#define DRAW_POLYLINE         MpDrawPolylineFlt
+#define APPEND_POLYLINE       MpAppendPolylineFlt
+#define APPEND_VERTICES       appendVerticesFlt
+#define APPEND_INSIDE         appendInsideVerticesFlt
+#define APPLY_AXIS_SCALE      MpApplyAxisScaleFlt
+#define TRANSFORM_BLOCK       transformBlockFlt
+#define DRAW_INDEXED_POLYLINE MpDrawIndexedPolylineFlt
+#define CHUNK_BOUNDS          MpChunkBoundsFlt
+#define CLASSIFY_CHUNKS       MpClassifyChunksFlt
+#define BOX                   MpBoxFlt
+#define DRAW_POLYGON          MpDrawPolygonFlt
+#define DRAW_POINTS           MpDrawPointsFlt
+#include __FILE__
+
+#define T                     double
+#define DRAW_POLYLINE         MpDrawPolylineDbl
+#define APPEND_POLYLINE       MpAppendPolylineDbl
+#define APPEND_VERTICES       appendVerticesDbl
+#define APPEND_INSIDE         appendInsideVerticesDbl
+#define APPLY_AXIS_SCALE      MpApplyAxisScaleDbl
+#define TRANSFORM_BLOCK       transformBlockDbl
+#define DRAW_INDEXED_POLYLINE MpDrawIndexedPolylineDbl
+#define CHUNK_BOUNDS          MpChunkBoundsDbl
+#define CLASSIFY_CHUNKS       MpClassifyChunksDbl
+#define BOX                   MpBoxDbl
+#define DRAW_POLYGON          MpDrawPolygonDbl
+#define DRAW_POINTS           MpDrawPointsDbl
+#include __FILE__
+
+#define CELL                  MpColorIndex
+#define DRAW_CELLS            MpDrawCells
+#define DRAW_CELLS_METHOD     drawCells
+#define DRAW_CELLS_HELPER     MpDrawCellsHelper
+#include __FILE__
+
+#define CELL                  uint8_t
+#define DRAW_CELLS            MpDrawCells8
+#define DRAW_CELLS_METHOD     drawCells8
+#define DRAW_CELLS_HELPER     MpDrawCellsHelper8
+#include __FILE__
+
+#define CELL                  uint16_t
+#define DRAW_CELLS            MpDrawCells16
+#define DRAW_CELLS_METHOD     drawCells16
+#define DRAW_CELLS_HELPER     MpDrawCellsHelper16
+#include __FILE__
+
+#else /* _MUPLOT_DRAWING_C defined */
+
+#ifdef TRANSFORM_BLOCK
+/*
+ * Apply the data to device transform `C` of kind `kind` to a block of `n`
+ * points.  The kind is examined once so that each case is a simple loop that
+ * the compiler can vectorize.
+ */
+static void
+TRANSFORM_BLOCK(double* restrict u, double* restrict v,
+                const T* restrict x, const T* restrict y, MpInt n,
+                const MpCoordinateTransform* C, MpTransformKind kind)
+{
+    const double Cxx = C->xx, Cxy = C->xy, Cx = C->x;
+    const double Cyx = C->yx, Cyy = C->yy, Cy = C->y;
+    switch (kind) {
+    case MP_IDENTITY_TRANSFORM:
+        for (MpInt k = 0; k < n; ++k) {
+            u[k] = x[k];
+            v[k] = y[k];
+        }
+        break;
+    case MP_TRANSLATION_TRANSFORM:
+        for (MpInt k = 0; k < n; ++k) {
+            u[k] = x[k] + Cx;
+            v[k] = y[k] + Cy;
+        }
+        break;
+    case MP_DIAGONAL_TRANSFORM:
+        for (MpInt k = 0; k < n; ++k) {
+            u[k] = Cxx*x[k] + Cx;
+            v[k] = Cyy*y[k] + Cy;
+        }
+        break;
+    default:
+        for (MpInt k = 0; k < n; ++k) {
+            double xk = x[k], yk = y[k];
+            u[k] = Cxx*xk + Cxy*yk + Cx;
+            v[k] = Cyx*xk + Cyy*yk + Cy;
+        }
+    }
+}
+#endif /* TRANSFORM_BLOCK */
+
+#ifdef DRAW_POLYLINE
+/*
+ * Transform, clip and round coordinates of vertices appended to a polyline in
+ * a single pass, sending pieces to the driver as they are completed.  The
+ * last piece is left in the stream.
+ */
+static MpStatus
+APPEND_VERTICES(MpDevice* dev, PolylineStream* s,
+                const T* x, const T* y, MpInt n)
+{
+    const MpCoordinateTransform* C = MpGetDataToDeviceTransform(dev);
+    const MpTransformKind kind = dev->dataToDeviceKind;
+    const MpBoxDbl box = {0, dev->horizontalSamples - 1,
+                          0, dev->verticalSamples - 1};
+    MpStatus status = MP_OK;
+    MpPoint* xs = s->x;
+    MpPoint* ys = s->y;
+    MpClipStateDbl w = s->clip;
+    MpInt j = s->count; /* number of vertices in current piece */
+    bool restart = s->restart; /* clipping must be (re)started? */
+    double xp = s->xp, yp = s->yp; /* last (unrounded) vertex of current
+                                      piece */
+    T xb[SCALE_BLOCK], yb[SCALE_BLOCK];
+    double ub[SCALE_BLOCK], vb[SCALE_BLOCK];
+    for (MpInt i0 = 0; i0 < n; i0 += SCALE_BLOCK) {
+        MpInt nb = (n - i0 < SCALE_BLOCK ? n - i0 : SCALE_BLOCK);
+        const T* xv = x + i0;
+        const T* yv = y + i0;
+        if (dev->scaledAxes) {
+            APPLY_AXIS_SCALE(&dev->xscale, xb, xv, nb);
+            APPLY_AXIS_SCALE(&dev->yscale, yb, yv, nb);
+            xv = xb;
+            yv = yb;
+        }
+        TRANSFORM_BLOCK(ub, vb, xv, yv, nb, C, kind);
+        for (MpInt k = 0; k < nb; ++k) {
+            double u = ub[k], v = vb[k];
+            if (! MP_IS_FINITE(u) || ! MP_IS_FINITE(v)) {
+                /* Non-finite coordinates break the polyline. */
+                if (j >= 2) {
+                    status = drawPiece(dev, xs, ys, j);
+                    if (status != MP_OK) {
+                        goto done;
+                    }
+                }
+                j = 0;
+                restart = true;
+                continue;
+            }
+            if (restart) {
+                MpInitializeClipDbl(&w, u, v, &box);
+                restart = false;
+                continue;
+            }
+            double x1, y1, x2, y2;
+            switch (MpClipNextDbl(&w, u, v)) {
+            case 1:
+                x1 = w.x1;
+                y1 = w.y1;
+                x2 = w.x2;
+                y2 = w.y2;
+                break;
+            case 2:
+                x1 = w.x1c;
+                y1 = w.y1c;
+                x2 = w.x2c;
+                y2 = w.y2c;
+                break;
+            default:
+                continue;
+            }
+            if (j == 0 || x1 != xp || y1 != yp) {
+                /* Segment is not connected to the current piece. */
+                if (j >= 2) {
+                    status = drawPiece(dev, xs, ys, j);
+                    if (status != MP_OK) {
+                        goto done;
+                    }
+                }
+                xs[0] = ROUND_POINT(x1);
+                ys[0] = ROUND_POINT(y1);
+                j = 1;
+            }
+            xs[j] = ROUND_POINT(x2);
+            ys[j] = ROUND_POINT(y2);
+            xp = x2;
+            yp = y2;
+            if (++j == CHUNK_SIZE) {
+                /* Send the current piece and start the next one with its
+                   last vertex. */
+                MpPoint xl = xs[j-1], yl = ys[j-1];
+                status = drawPiece(dev, xs, ys, j);
+                if (status != MP_OK) {
+                    goto done;
+                }
+                xs[0] = xl;
+                ys[0] = yl;
+                j = 1;
+            }
+        }
+    }
+
+    /* Save the state of the stream, the current piece is dropped on error. */
+ done:
+    if (status != MP_OK) {
+        j = 0;
+        restart = true;
+    }
+    s->clip = w;
+    s->count = j;
+    s->restart = restart;
+    s->xp = xp;
+    s->yp = yp;
+    return status;
+}
+
+/*
+ * Transform and round coordinates of vertices known to be inside the device
+ * and append them to a polyline without clipping.  The first vertex joins
+ * the current piece if it is its last vertex, pieces are sent to the driver
+ * as they are completed and the last piece is left in the stream.  The state
+ * of clipping is not updated, it must be restarted for the next vertices.
+ */
+static MpStatus
+APPEND_INSIDE(MpDevice* dev, PolylineStream* s,
+              const T* x, const T* y, MpInt n)
+{
+    const MpCoordinateTransform* C = MpGetDataToDeviceTransform(dev);
+    const MpTransformKind kind = dev->dataToDeviceKind;
+    MpStatus status = MP_OK;
+    MpPoint* xs = s->x;
+    MpPoint* ys = s->y;
+    MpInt j = s->count; /* number of vertices in current piece */
+    double xp = s->xp, yp = s->yp; /* last (unrounded) vertex of current
+                                      piece */
+    T xb[SCALE_BLOCK], yb[SCALE_BLOCK];
+    double ub[SCALE_BLOCK], vb[SCALE_BLOCK];
+    for (MpInt i0 = 0; i0 < n; i0 += SCALE_BLOCK) {
+        MpInt nb = (n - i0 < SCALE_BLOCK ? n - i0 : SCALE_BLOCK);
+        const T* xv = x + i0;
+        const T* yv = y + i0;
+        if (dev->scaledAxes) {
+            APPLY_AXIS_SCALE(&dev->xscale, xb, xv, nb);
+            APPLY_AXIS_SCALE(&dev->yscale, yb, yv, nb);
+            xv = xb;
+            yv = yb;
+        }
+        TRANSFORM_BLOCK(ub, vb, xv, yv, nb, C, kind);
+        for (MpInt k = 0; k < nb; ++k) {
+            double u = ub[k], v = vb[k];
+            if (! MP_IS_FINITE(u) || ! MP_IS_FINITE(v)) {
+                /* Non-finite coordinates break the polyline. */
+                if (j >= 2) {
+                    status = drawPiece(dev, xs, ys, j);
+                    if (status != MP_OK) {
+                        goto done;
+                    }
+                }
+                j = 0;
+                continue;
+            }
+            if (j > 0 && i0 + k == 0 && (u != xp || v != yp)) {
+                /* First vertex is not connected to the current piece. */
+                if (j >= 2) {
+                    status = drawPiece(dev, xs, ys, j);
+                    if (status != MP_OK) {
+                        goto done;
+                    }
+                }
+                j = 0;
+            }
+            if (j == 0 || i0 + k > 0) {
+                xs[j] = ROUND_POINT(u);
+                ys[j] = ROUND_POINT(v);
+                if (++j == CHUNK_SIZE) {
+                    /* Send the current piece and start the next one with its
+                       last vertex. */
+                    MpPoint xl = xs[j-1], yl = ys[j-1];
+                    status = drawPiece(dev, xs, ys, j);
+                    if (status != MP_OK) {
+                        goto done;
+                    }
+                    xs[0] = xl;
+                    ys[0] = yl;
+                    j = 1;
+                }
+            }
+            xp = u;
+            yp = v;
+        }
+    }
+
+    /* Save the state of the stream, the current piece is dropped on error. */
+ done:
+    if (status != MP_OK) {
+        j = 0;
+    }
+    s->count = j;
+    s->restart = true;
+    s->xp = xp;
+    s->yp = yp;
+    return status;
+}
+
+MpStatus
+DRAW_POLYLINE(MpDevice* dev, const T* x, const T* y, MpInt n)
+{
+    /* Check arguments. */
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n < 2) {
+        return (n < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+    MpStatus status = MpReserveScratch(dev, CHUNK_SIZE);
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Draw the polyline as a stream using the scratch buffers. */
+    PolylineStream s;
+    s.x = dev->xscratch;
+    s.y = dev->yscratch;
+    s.count = 0;
+    s.restart = true;
+    s.xp = s.yp = 0;
+    status = APPEND_VERTICES(dev, &s, x, y, n);
+    if (status == MP_OK && s.count >= 2) {
+        status = drawPiece(dev, s.x, s.y, s.count);
+    }
+    return status;
+}
+
+MpStatus
+DRAW_INDEXED_POLYLINE(MpDevice* dev, const T* x, const T* y, MpInt n,
+                      const CHUNK_BOUNDS* cb)
+{
+    /* Check arguments. */
+    if (dev == NULL || cb == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n != cb->count) {
+        return MP_BAD_SIZE;
+    }
+    if (n < 2) {
+        return MP_OK;
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+    MpInt nboxes = (dev->scaledAxes ? MpCountChunkBoxes(cb->chunks) : 0);
+    MpStatus status = MpReserveScratch(dev, CHUNK_SIZE);
+    if (status == MP_OK) {
+        status = MpReserveWorkspace(dev, nboxes*sizeof(BOX) + cb->chunks);
+    }
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* With nonlinear axes, classify the chunks given their scaled bounds.  The
+       scales are monotonic so the bounds of a box map to the bounds of the
+       scaled box; bounds without an image (non-positive bounds for a
+       logarithmic axis) yield NaN and the box is considered as straddling. */
+    CHUNK_BOUNDS scb = *cb;
+    if (dev->scaledAxes) {
+        BOX* boxes = (BOX*)dev->workspace;
+        for (MpInt i = 0; i < nboxes; ++i) {
+            const BOX* b = cb->boxes + i;
+            boxes[i].xmin = MpScaleCoordinate(&dev->xscale, b->xmin);
+            boxes[i].xmax = MpScaleCoordinate(&dev->xscale, b->xmax);
+            boxes[i].ymin = MpScaleCoordinate(&dev->yscale, b->ymin);
+            boxes[i].ymax = MpScaleCoordinate(&dev->yscale, b->ymax);
+        }
+        scb.boxes = boxes;
+    }
+
+    /* Select the chunks which may be visible. */
+    uint8_t* code = (uint8_t*)dev->workspace + nboxes*sizeof(BOX);
+    const BOX box = {0, dev->horizontalSamples - 1,
+                     0, dev->verticalSamples - 1};
+    if (CLASSIFY_CHUNKS(code, &scb, MpGetDataToDeviceTransform(dev),
+                        &box) == 0) {
+        return MP_OK;
+    }
+
+    /* Draw runs of consecutive visible chunks as a stream.  Only the runs of
+       straddling chunks are clipped, clipping is restarted for each of them;
+       the vertices of the runs of inside chunks are directly appended. */
+    PolylineStream s;
+    s.x = dev->xscratch;
+    s.y = dev->yscratch;
+    s.count = 0;
+    s.xp = s.yp = 0;
+    MpInt nchunks = cb->chunks, size = cb->chunkSize;
+    for (MpInt k = 0; k < nchunks && status == MP_OK; ) {
+        uint8_t c = code[k];
+        if (c == MP_CHUNK_OUTSIDE) {
+            ++k;
+            continue;
+        }
+        MpInt i0 = k*size;
+        while (k < nchunks && code[k] == c) {
+            ++k;
+        }
+        MpInt i1 = (k*size < n - 1 ? k*size : n - 1);
+        if (c == MP_CHUNK_INSIDE) {
+            status = APPEND_INSIDE(dev, &s, x + i0, y + i0, i1 + 1 - i0);
+        } else {
+            s.restart = true;
+            status = APPEND_VERTICES(dev, &s, x + i0, y + i0, i1 + 1 - i0);
+        }
+    }
+    if (status == MP_OK && s.count >= 2) {
+        status = drawPiece(dev, s.x, s.y, s.count);
+    }
+    return status;
+}
+
+MpStatus
+APPEND_POLYLINE(MpDevice* dev, const T* x, const T* y, MpInt n)
+{
+    /* Check arguments. */
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (dev->stream == NULL || ! dev->stream->active) {
+        return MP_NOT_PERMITTED;
+    }
+    if (n < 1) {
+        return (n < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+    return APPEND_VERTICES(dev, dev->stream, x, y, n);
+}
+#endif /* DRAW_POLYLINE */
+
+#ifdef DRAW_POLYGON
+MpStatus
+DRAW_POLYGON(MpDevice* dev, const T* x, const T* y, MpInt n)
+{
+    /* Check arguments. */
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n < 3) {
+        return (n < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+
+    /* Transform the coordinates, skipping non-finite ones, and clip the
+       polygon.  The workspace stores the transformed vertices followed by
+       the `4n` vertices of the clipped polygon. */
+    MpStatus status = MpReserveWorkspace(dev, 10*n*sizeof(double));
+    if (status != MP_OK) {
+        return status;
+    }
+    double* xd = (double*)dev->workspace;
+    double* yd = xd + n;
+    double* xc = yd + n;
+    double* yc = xc + 4*n;
+    const MpCoordinateTransform* C = MpGetDataToDeviceTransform(dev);
+    const MpTransformKind kind = dev->dataToDeviceKind;
+    MpInt m = 0;
+    T xb[SCALE_BLOCK], yb[SCALE_BLOCK];
+    double ub[SCALE_BLOCK], vb[SCALE_BLOCK];
+    for (MpInt i0 = 0; i0 < n; i0 += SCALE_BLOCK) {
+        MpInt nb = (n - i0 < SCALE_BLOCK ? n - i0 : SCALE_BLOCK);
+        const T* xv = x + i0;
+        const T* yv = y + i0;
+        if (dev->scaledAxes) {
+            APPLY_AXIS_SCALE(&dev->xscale, xb, xv, nb);
+            APPLY_AXIS_SCALE(&dev->yscale, yb, yv, nb);
+            xv = xb;
+            yv = yb;
+        }
+        TRANSFORM_BLOCK(ub, vb, xv, yv, nb, C, kind);
+        for (MpInt k = 0; k < nb; ++k) {
+            double u = ub[k], v = vb[k];
+            if (MP_IS_FINITE(u) && MP_IS_FINITE(v)) {
+                xd[m] = u;
+                yd[m] = v;
+                ++m;
+            }
+        }
+    }
+    const MpBoxDbl box = {0, dev->horizontalSamples - 1,
+                          0, dev->verticalSamples - 1};
+    m = MpClipPolygonDbl(xc, yc, &box, xd, yd, m);
+    if (m < 3) {
+        return MP_OK;
+    }
+
+    /* Round the coordinates and draw the polygon. */
+    status = MpReserveScratch(dev, 2*m);
+    if (status != MP_OK) {
+        return status;
+    }
+    for (MpInt i = 0; i < m; ++i) {
+        dev->xscratch[i] = ROUND_POINT(xc[i]);
+        dev->yscratch[i] = ROUND_POINT(yc[i]);
+    }
+    return drawScratchPolygon(dev, m);
+}
+#endif /* DRAW_POLYGON */
+
+#ifdef DRAW_POINTS
+MpStatus
+DRAW_POINTS(MpDevice* dev, const T* x, const T* y, MpInt n)
+{
+    /* Check arguments. */
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n < 1) {
+        return (n < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (x == NULL || y == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MP_COUNT(dev, submittedVertices, n);
+    MpStatus status = MpReserveScratch(dev, CHUNK_SIZE);
+    if (status == MP_OK) {
+        status = MpApplySettings(dev);
+    }
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Transform the coordinates, keep the points whose nearest sample is in
+       the device (this also discards non-finite coordinates) and send them
+       to the driver by chunks. */
+    const MpCoordinateTransform* C = MpGetDataToDeviceTransform(dev);
+    const MpTransformKind kind = dev->dataToDeviceKind;
+    const double umax = dev->horizontalSamples - 0.5;
+    const double vmax = dev->verticalSamples - 0.5;
+    MpPoint* xs = dev->xscratch;
+    MpPoint* ys = dev->yscratch;
+    MpInt j = 0;
+    T xb[SCALE_BLOCK], yb[SCALE_BLOCK];
+    double ub[SCALE_BLOCK], vb[SCALE_BLOCK];
+    for (MpInt i0 = 0; i0 < n; i0 += SCALE_BLOCK) {
+        MpInt nb = (n - i0 < SCALE_BLOCK ? n - i0 : SCALE_BLOCK);
+        const T* xv = x + i0;
+        const T* yv = y + i0;
+        if (dev->scaledAxes) {
+            APPLY_AXIS_SCALE(&dev->xscale, xb, xv, nb);
+            APPLY_AXIS_SCALE(&dev->yscale, yb, yv, nb);
+            xv = xb;
+            yv = yb;
+        }
+        TRANSFORM_BLOCK(ub, vb, xv, yv, nb, C, kind);
+        for (MpInt k = 0; k < nb; ++k) {
+            double u = ub[k], v = vb[k];
+            if (u > -0.5 && u < umax && v > -0.5 && v < vmax) {
+                xs[j] = ROUND_POINT(u);
+                ys[j] = ROUND_POINT(v);
+                if (++j == CHUNK_SIZE) {
+                    status = dev->drawPoints(dev, xs, ys, j);
+                    if (status != MP_OK) {
+                        return status;
+                    }
+                    j = 0;
+                }
+            }
+        }
+    }
+    return (j > 0 ? dev->drawPoints(dev, xs, ys, j) : MP_OK);
+}
+#endif /* DRAW_POINTS */
+
+#ifdef DRAW_CELLS
+MpStatus
+DRAW_CELLS(MpDevice* dev, const CELL* z, MpInt n1, MpInt n2, MpInt stride,
+           MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    /* Check arguments. */
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n1 < 1 || n2 < 1) {
+        return (n1 < 0 || n2 < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (z == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (stride < n1) {
+        return MP_BAD_SIZE;
+    }
+    MpStatus status = MpApplySettings(dev);
+    if (status != MP_OK) {
+        return status;
+    }
+    return dev->DRAW_CELLS_METHOD(dev, z, n1, n2, stride, x0, y0, x1, y1);
+}
+#endif /* DRAW_CELLS */
+
+#ifdef DRAW_CELLS_HELPER
+MpStatus
+DRAW_CELLS_HELPER(MpDevice* dev, const CELL* z,
+                  MpInt n1, MpInt n2, MpInt stride,
+                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    /* Early return if nothing to do. */
+    if (n1 < 1 || n2 < 1) {
+        return MP_OK;
+    }
+
+    /* Draw all cells by runs of the same color, skipping empty runs.  The
+       color index is only checked and changed when needed. */
+    MpStatus status = MP_OK;
+    MpColorIndex ci0 = dev->colorIndex; /* initial color index */
+    MpColorIndex cip = ci0; /* current color index */
+    MpCellEdges ex0, ey;
+    MpInitializeCellEdges(&ex0, x0, x1, n1);
+    MpInitializeCellEdges(&ey, y0, y1, n2);
+    MpPoint cy0 = y0;
+    for (MpInt i2 = 0; i2 < n2; ++i2) {
+        MpPoint cy1 = MpStepCellEdge(&ey);
+        if (cy1 == cy0) {
+            continue;
+        }
+        const CELL* c = z + i2*stride;
+        MpCellEdges ex = ex0;
+        MpPoint cx0 = x0;
+        MpInt i1 = 0;
+        while (i1 < n1) {
+            CELL ci = c[i1];
+            MpPoint cx1;
+            do {
+                cx1 = MpStepCellEdge(&ex);
+            } while (++i1 < n1 && c[i1] == ci);
+            if (cx1 != cx0) {
+                if ((MpColorIndex)ci != cip) {
+                    if ((MpColorIndex)ci < 0 ||
+                        (MpColorIndex)ci >= dev->colormapSize) {
+                        status = MP_OUT_OF_RANGE;
+                        goto done;
+                    }
+                    status = dev->setColorIndex(dev, ci);
+                    if (status != MP_OK) {
+                        goto done;
+                    }
+                    cip = ci;
+                }
+                status = dev->drawRectangle(dev, cx0, cy0, cx1, cy1);
+                if (status != MP_OK) {
+                    goto done;
+                }
+            }
+            cx0 = cx1;
+        }
+        cy0 = cy1;
+    }
+
+    /* The initial color index is not restored right away, it will be by the
+       next drawing operation if needed. */
+ done:
+    if (cip != ci0) {
+        dev->pendingSettings = true;
+    }
+    return status;
+}
+#endif /* DRAW_CELLS_HELPER */
+
+#undef T
+#undef DRAW_POLYLINE
+#undef APPEND_POLYLINE
+#undef APPEND_VERTICES
+#undef APPEND_INSIDE
+#undef APPLY_AXIS_SCALE
+#undef TRANSFORM_BLOCK
+#undef DRAW_INDEXED_POLYLINE
+#undef CHUNK_BOUNDS
+#undef CLASSIFY_CHUNKS
+#undef BOX
+#undef DRAW_POLYGON
+#undef DRAW_POINTS
+#undef CELL
+#undef DRAW_CELLS
+#undef DRAW_CELLS_METHOD
+#undef DRAW_CELLS_HELPER
+
+#endif /* _MUPLOT_DRAWING_C */
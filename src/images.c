@@ -0,0 +1,474 @@
+/*
+ * images.c --
+ *
+ * Implementation of the mapping of the values of an image to colormap indices
+ * and of the drawing of images.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#ifndef _MUPLOT_IMAGES_C
+#define _MUPLOT_IMAGES_C 1
+
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "muPlotPriv.h"
+
+#define JOIN(a,b)     a##b
+#define JOIN2(a,b)    JOIN(a,b)
+
+/*
+ * Images are split in bands of rows mapped by different threads when they
+ * have at least MAP_VALUES_PER_THREAD values per thread.  The number of
+ * threads is at most the number of processors and MAP_MAX_THREADS.
+ */
+#define MAP_VALUES_PER_THREAD (1 << 18)
+#define MAP_MAX_THREADS       16
+
+/*
+ * The context of a mapping stores the mapping in a form suitable for the
+ * kernels: the value `v` of a pixel is first converted into `u = f(v)` with
+ * `f` the scaling function, then into `t = (u - u0)*q` clamped in the range
+ * `[0,tmax]`, the colormap index being `cmin + floor(t)`.
+ */
+typedef struct _MapContext MapContext;
+struct _MapContext {
+    void (*rows)(const MapContext* ctx, MpInt j0, MpInt j1);
+    void* dst;
+    const void* src;
+    const void* lut;
+    MpInt dstStride, srcStride;
+    MpInt n1, n2;
+    MpScaling scaling;
+    double vmin;   /* value mapped to cmin */
+    double r;      /* reciprocal of the softening of the asinh scaling */
+    double u0;     /* scaled value of vmin */
+    double q;      /* number of colors per unit of the scaled values */
+    double tmax;   /* number of colors minus 1 */
+    MpColorIndex cmin, cbad;
+};
+
+typedef struct _MapTask {
+    const MapContext* ctx;
+    pthread_t thread;
+    MpInt j0, j1;
+} MapTask;
+
+MpStatus
+MpInitializeValueMapping(MpValueMapping* map, MpDevice* dev,
+                         MpScaling scaling, double vmin, double vmax)
+{
+    if (map == NULL || dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (dev->colormapSize2 < 1) {
+        return MP_BAD_SETTINGS;
+    }
+    map->scaling = scaling;
+    map->vmin = vmin;
+    map->vmax = vmax;
+    map->softening = fabs(vmax - vmin)/10;
+    map->cmin = dev->colormapSize1;
+    map->cmax = dev->colormapSize - 1;
+    map->cbad = MP_COLOR_BACKGROUND;
+    return MP_OK;
+}
+
+/* Check the mapping and store it in the context for indices not greater than
+   `cellMax`. */
+static MpStatus
+prepareMapping(MapContext* ctx, const MpValueMapping* map, MpInt cellMax)
+{
+    const double vmin = map->vmin, vmax = map->vmax;
+    if (!isfinite(vmin) || !isfinite(vmax) || vmin == vmax) {
+        return MP_BAD_ARGUMENT;
+    }
+    if (map->cmin < 0 || map->cmin > map->cmax || map->cmax > cellMax ||
+        map->cbad < 0 || map->cbad > cellMax) {
+        return MP_OUT_OF_RANGE;
+    }
+    double ncolors = (double)(map->cmax - map->cmin + 1);
+    ctx->scaling = map->scaling;
+    ctx->vmin = vmin;
+    ctx->r = 1;
+    ctx->tmax = ncolors - 1;
+    ctx->cmin = map->cmin;
+    ctx->cbad = map->cbad;
+    switch (map->scaling) {
+    case MP_LINEAR_SCALING:
+        ctx->u0 = vmin;
+        ctx->q = ncolors/(vmax - vmin);
+        break;
+    case MP_LOG_SCALING:
+        if (vmin <= 0 || vmax <= 0) {
+            return MP_BAD_ARGUMENT;
+        }
+        ctx->u0 = log(vmin);
+        ctx->q = ncolors/(log(vmax) - ctx->u0);
+        break;
+    case MP_ASINH_SCALING:
+        if (!(map->softening > 0) || !isfinite(map->softening)) {
+            return MP_BAD_ARGUMENT;
+        }
+        ctx->r = 1/map->softening;
+        ctx->u0 = 0;
+        ctx->q = ncolors/asinh((vmax - vmin)*ctx->r);
+        break;
+    default:
+        return MP_BAD_ARGUMENT;
+    }
+    return MP_OK;
+}
+
+/* Map a single value with the context, this is used to build lookup tables
+   and must yield the same result as the kernels. */
+static MpColorIndex
+mapValue(const MapContext* ctx, double v)
+{
+    if (isnan(v)) {
+        return ctx->cbad;
+    }
+    double u;
+    switch (ctx->scaling) {
+    case MP_LOG_SCALING:
+        u = (v > 0 ? log(v) : -HUGE_VAL);
+        break;
+    case MP_ASINH_SCALING:
+        u = asinh((v - ctx->vmin)*ctx->r);
+        break;
+    default:
+        u = v;
+    }
+    double t = (u - ctx->u0)*ctx->q;
+    t = (t > 0 ? t : 0);
+    t = (t < ctx->tmax ? t : ctx->tmax);
+    return ctx->cmin + (MpColorIndex)t;
+}
+
+static void*
+runMapTask(void* arg)
+{
+    MapTask* task = (MapTask*)arg;
+    task->ctx->rows(task->ctx, task->j0, task->j1);
+    return NULL;
+}
+
+/* Map all the rows of the image of the context, possibly in parallel. */
+static void
+mapRows(const MapContext* ctx)
+{
+    MpInt nthreads = (ctx->n1*ctx->n2)/MAP_VALUES_PER_THREAD;
+    if (nthreads > 1) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (nthreads > ncpus) {
+            nthreads = (ncpus > 1 ? ncpus : 1);
+        }
+        if (nthreads > MAP_MAX_THREADS) {
+            nthreads = MAP_MAX_THREADS;
+        }
+        if (nthreads > ctx->n2) {
+            nthreads = ctx->n2;
+        }
+    }
+    if (nthreads <= 1) {
+        ctx->rows(ctx, 0, ctx->n2);
+        return;
+    }
+
+    /* The first band is mapped by the caller.  Bands which cannot be given
+       to a new thread are also mapped by the caller. */
+    MapTask tasks[MAP_MAX_THREADS];
+    for (MpInt k = 0; k < nthreads; ++k) {
+        tasks[k].ctx = ctx;
+        tasks[k].j0 = (k*ctx->n2)/nthreads;
+        tasks[k].j1 = ((k + 1)*ctx->n2)/nthreads;
+    }
+    MpInt started = 1;
+    while (started < nthreads &&
+           pthread_create(&tasks[started].thread, NULL,
+                          runMapTask, &tasks[started]) == 0) {
+        ++started;
+    }
+    for (MpInt k = started; k < nthreads; ++k) {
+        runMapTask(&tasks[k]);
+    }
+    runMapTask(&tasks[0]);
+    for (MpInt k = 1; k < started; ++k) {
+        pthread_join(tasks[k].thread, NULL);
+    }
+}
+
+/* Check that the indices of a mapping are in the colormap of a device. */
+static MpStatus
+checkImageMapping(MpDevice* dev, const MpValueMapping* map)
+{
+    if (map->cmax >= dev->colormapSize || map->cbad >= dev->colormapSize) {
+        return MP_OUT_OF_RANGE;
+    }
+    return MP_OK;
+}
+
+#define T                     float
+#define SFX                   Flt
+#define REAL                  float
+#define LOG                   logf
+#define ASINH                 asinhf
+#include __FILE__
+
+#define T                     double
+#define SFX                   Dbl
+#define REAL                  double
+#define LOG                   log
+#define ASINH                 asinh
+#include __FILE__
+
+#define T                     uint8_t
+#define SFX                   U8
+#define LUT_SIZE              256
+#include __FILE__
+
+#define T                     uint16_t
+#define SFX                   U16
+#define LUT_SIZE              65536
+#include __FILE__
+
+#define T                     int32_t
+#define SFX                   I32
+#define REAL                  double
+#define LOG                   log
+#define ASINH                 asinh
+#include __FILE__
+
+#else /* _MUPLOT_IMAGES_C defined */
+
+#ifndef CELL
+
+/*
+ * First level of the template: instantiate the kernels for both sizes of
+ * indices and then the drawing of images.
+ */
+#define CELL                  uint8_t
+#define BITS                  8
+#define CELL_MAX              255
+#include __FILE__
+#undef CELL
+#undef BITS
+#undef CELL_MAX
+
+#define CELL                  uint16_t
+#define BITS                  16
+#define CELL_MAX              65535
+#include __FILE__
+#undef CELL
+#undef BITS
+#undef CELL_MAX
+
+MpStatus
+JOIN2(MpDrawImage,SFX)(MpDevice* dev, const T* z,
+                       MpInt n1, MpInt n2, MpInt stride,
+                       const MpValueMapping* map,
+                       MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    /* Check arguments. */
+    if (dev == NULL || map == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n1 < 1 || n2 < 1) {
+        return (n1 < 0 || n2 < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (z == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (stride < n1) {
+        return MP_BAD_SIZE;
+    }
+    MpStatus status = checkImageMapping(dev, map);
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Map the whole image into the workspace with the smallest indices that
+       are possible.  The image is not drawn by bands of rows as the edges of
+       the cells would not be the same as for the whole image. */
+    const MpInt n = n1*n2;
+    if (map->cmax <= 255 && map->cbad <= 255) {
+        status = MpReserveWorkspace(dev, n*sizeof(uint8_t));
+        if (status == MP_OK) {
+            uint8_t* cells = (uint8_t*)dev->workspace;
+            status = JOIN2(JOIN2(MpMapValues,SFX),8)(
+                cells, n1, z, stride, n1, n2, map);
+            if (status == MP_OK) {
+                status = MpDrawCells8(dev, cells, n1, n2, n1, x0, y0, x1, y1);
+            }
+        }
+    } else {
+        status = MpReserveWorkspace(dev, n*sizeof(uint16_t));
+        if (status == MP_OK) {
+            uint16_t* cells = (uint16_t*)dev->workspace;
+            status = JOIN2(JOIN2(MpMapValues,SFX),16)(
+                cells, n1, z, stride, n1, n2, map);
+            if (status == MP_OK) {
+                status = MpDrawCells16(dev, cells, n1, n2, n1, x0, y0, x1, y1);
+            }
+        }
+    }
+    return status;
+}
+
+#undef T
+#undef SFX
+#undef REAL
+#undef LOG
+#undef ASINH
+#undef LUT_SIZE
+
+#else /* CELL defined */
+
+/*
+ * Second level of the template: the kernels for a given type of values and a
+ * given size of indices.
+ */
+#define MAP_ROWS    JOIN2(JOIN2(mapRows,SFX),BITS)
+#define MAP_VALUES  JOIN2(JOIN2(MpMapValues,SFX),BITS)
+
+#ifdef LUT_SIZE
+
+/* Small integers are mapped by a lookup table built for all their possible
+   values, unless the image has fewer values than the table. */
+static void
+MAP_ROWS(const MapContext* ctx, MpInt j0, MpInt j1)
+{
+    const CELL* lut = (const CELL*)ctx->lut;
+    const MpInt n1 = ctx->n1;
+    for (MpInt j = j0; j < j1; ++j) {
+        const T* src = (const T*)ctx->src + j*ctx->srcStride;
+        CELL* dst = (CELL*)ctx->dst + j*ctx->dstStride;
+        if (lut != NULL) {
+            for (MpInt i = 0; i < n1; ++i) {
+                dst[i] = lut[src[i]];
+            }
+        } else {
+            for (MpInt i = 0; i < n1; ++i) {
+                dst[i] = (CELL)mapValue(ctx, (double)src[i]);
+            }
+        }
+    }
+}
+
+#else /* LUT_SIZE not defined */
+
+/* The inner loops have no branches (the conditional expressions are merely
+   selections) so that they can be vectorized by the compiler, at least for
+   the linear scaling. */
+static void
+MAP_ROWS(const MapContext* ctx, MpInt j0, MpInt j1)
+{
+    const REAL vmin = (REAL)ctx->vmin;
+    const REAL r = (REAL)ctx->r;
+    const REAL u0 = (REAL)ctx->u0;
+    const REAL q = (REAL)ctx->q;
+    const REAL tmax = (REAL)ctx->tmax;
+    const CELL cmin = (CELL)ctx->cmin;
+    const CELL cbad = (CELL)ctx->cbad;
+    const REAL zero = 0;
+    const MpInt n1 = ctx->n1;
+    for (MpInt j = j0; j < j1; ++j) {
+        const T* src = (const T*)ctx->src + j*ctx->srcStride;
+        CELL* dst = (CELL*)ctx->dst + j*ctx->dstStride;
+        switch (ctx->scaling) {
+        case MP_LOG_SCALING:
+            for (MpInt i = 0; i < n1; ++i) {
+                REAL v = (REAL)src[i];
+                REAL u = (v > zero ? LOG(v) : (REAL)-HUGE_VAL);
+                REAL t = (u - u0)*q;
+                t = (t > zero ? t : zero);
+                t = (t < tmax ? t : tmax);
+                dst[i] = (v == v ? cmin + (CELL)t : cbad);
+            }
+            break;
+        case MP_ASINH_SCALING:
+            for (MpInt i = 0; i < n1; ++i) {
+                REAL v = (REAL)src[i];
+                REAL t = (ASINH((v - vmin)*r) - u0)*q;
+                t = (t > zero ? t : zero);
+                t = (t < tmax ? t : tmax);
+                dst[i] = (v == v ? cmin + (CELL)t : cbad);
+            }
+            break;
+        default:
+            for (MpInt i = 0; i < n1; ++i) {
+                REAL v = (REAL)src[i];
+                REAL t = (v - u0)*q;
+                t = (t > zero ? t : zero);
+                t = (t < tmax ? t : tmax);
+                dst[i] = (v == v ? cmin + (CELL)t : cbad);
+            }
+        }
+    }
+}
+
+#endif /* LUT_SIZE */
+
+MpStatus
+MAP_VALUES(CELL* dst, MpInt dstStride, const T* src, MpInt srcStride,
+           MpInt n1, MpInt n2, const MpValueMapping* map)
+{
+    /* Check arguments. */
+    if (map == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n1 < 1 || n2 < 1) {
+        return (n1 < 0 || n2 < 0 ? MP_BAD_SIZE : MP_OK);
+    }
+    if (dst == NULL || src == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (dstStride < n1 || srcStride < n1) {
+        return MP_BAD_SIZE;
+    }
+    MapContext ctx;
+    MpStatus status = prepareMapping(&ctx, map, CELL_MAX);
+    if (status != MP_OK) {
+        return status;
+    }
+    ctx.rows = MAP_ROWS;
+    ctx.dst = dst;
+    ctx.src = src;
+    ctx.lut = NULL;
+    ctx.dstStride = dstStride;
+    ctx.srcStride = srcStride;
+    ctx.n1 = n1;
+    ctx.n2 = n2;
+#ifdef LUT_SIZE
+    CELL* lut = NULL;
+    if (n1*n2 >= LUT_SIZE) {
+        lut = malloc(LUT_SIZE*sizeof(CELL));
+        if (lut == NULL) {
+            return MP_NO_MEMORY;
+        }
+        for (MpInt k = 0; k < LUT_SIZE; ++k) {
+            lut[k] = (CELL)mapValue(&ctx, (double)k);
+        }
+        ctx.lut = lut;
+    }
+    mapRows(&ctx);
+    free(lut);
+#else
+    mapRows(&ctx);
+#endif
+    return MP_OK;
+}
+
+#undef MAP_ROWS
+#undef MAP_VALUES
+
+#endif /* CELL */
+
+#endif /* _MUPLOT_IMAGES_C */
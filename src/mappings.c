@@ -14,8 +14,13 @@
 #ifndef _MUPLOT_MAPPINGS_C
 #define _MUPLOT_MAPPINGS_C 1
 
+#include <string.h>
+#include <math.h>
 #include "muPlot.h"
 
+#define JOIN(a,b)     a##b
+#define JOIN2(a,b)    JOIN(a,b)
+
 #define T                   float
 #define SFX                 Flt
 #define BOX                 MpBoxFlt
@@ -27,6 +32,13 @@
 #define DEFINE_MAPPING      MpDefineMappingFlt
 #define COMPOSE_MAPPINGS    MpComposeMappingsFlt
 #define INVERT_MAPPING      MpInvertMappingFlt
+#define APPLY_MAPPING       MpApplyMappingFlt
+#define APPLY_AXIS_SCALE    MpApplyAxisScaleFlt
+#define LOG10               log10f
+#define LOG1P               log1pf
+#define ASINH               asinhf
+#define FABS                fabsf
+#define COPYSIGN            copysignf
 #include __FILE__
 
 #define T                   double
@@ -40,8 +52,64 @@
 #define DEFINE_MAPPING      MpDefineMappingDbl
 #define COMPOSE_MAPPINGS    MpComposeMappingsDbl
 #define INVERT_MAPPING      MpInvertMappingDbl
+#define APPLY_MAPPING       MpApplyMappingDbl
+#define APPLY_AXIS_SCALE    MpApplyAxisScaleDbl
+#define LOG10               log10
+#define LOG1P               log1p
+#define ASINH               asinh
+#define FABS                fabs
+#define COPYSIGN            copysign
 #include __FILE__
 
+MpStatus
+MpCheckAxisScale(const MpAxisScale* s)
+{
+    if (s == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    switch (s->scaling) {
+    case MP_LINEAR_SCALING:
+    case MP_LOG_SCALING:
+        return MP_OK;
+    case MP_SYMLOG_SCALING:
+    case MP_ASINH_SCALING:
+        return (s->param > 0 && MP_IS_FINITE(s->param) ?
+                MP_OK : MP_BAD_ARGUMENT);
+    default:
+        return MP_BAD_ARGUMENT;
+    }
+}
+
+double
+MpScaleCoordinate(const MpAxisScale* s, double v)
+{
+    switch (s->scaling) {
+    case MP_LOG_SCALING:
+        return (v > 0 ? log10(v) : NAN);
+    case MP_SYMLOG_SCALING:
+        return copysign(log1p(fabs(v)/s->param)*M_LOG10E, v);
+    case MP_ASINH_SCALING:
+        return asinh(v/s->param);
+    default:
+        return v;
+    }
+}
+
+double
+MpUnscaleCoordinate(const MpAxisScale* s, double u)
+{
+    switch (s->scaling) {
+    case MP_LOG_SCALING:
+        return pow(10, u);
+    case MP_SYMLOG_SCALING:
+        return copysign(s->param*expm1(fabs(u)*M_LN10), u);
+    case MP_ASINH_SCALING:
+        return s->param*sinh(u);
+    default:
+        return u;
+    }
+}
+
 #else /* _MUPLOT_MAPPINGS_C defined */
 
 #ifdef IS_EMPTY_BOX
@@ -174,6 +242,104 @@ INVERT_MAPPING(MAPPING* dst, const MAPPING* A)
 }
 #endif /* INVERT_MAPPING */
 
+#ifdef APPLY_MAPPING
+/* The kernels are written so that the compiler is able to vectorize them;
+   in-place operation has its own kernel so that `restrict` remains valid. */
+static void
+JOIN2(applyMappingInPlace,SFX)(T* restrict x, T* restrict y, MpInt n,
+                               T Axx, T Ax, T Ayy, T Ay)
+{
+    for (MpInt i = 0; i < n; ++i) {
+        x[i] = Axx*x[i] + Ax;
+        y[i] = Ayy*y[i] + Ay;
+    }
+}
+
+static void
+JOIN2(applyMapping,SFX)(T* restrict xout, T* restrict yout,
+                        const T* restrict xin, const T* restrict yin,
+                        MpInt n, T Axx, T Ax, T Ayy, T Ay)
+{
+    for (MpInt i = 0; i < n; ++i) {
+        xout[i] = Axx*xin[i] + Ax;
+        yout[i] = Ayy*yin[i] + Ay;
+    }
+}
+
+MpStatus
+APPLY_MAPPING(const MAPPING* A, T* xout, T* yout,
+              const T* xin, const T* yin, MpInt n)
+{
+    if (A == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n <= 0) {
+        return (n == 0 ? MP_OK : MP_BAD_SIZE);
+    }
+    if (xout == NULL || yout == NULL || xin == NULL || yin == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (xout == xin && yout == yin) {
+        JOIN2(applyMappingInPlace,SFX)(xout, yout, n, A->xx, A->x, A->yy, A->y);
+    } else {
+        JOIN2(applyMapping,SFX)(xout, yout, xin, yin, n,
+                                A->xx, A->x, A->yy, A->y);
+    }
+    return MP_OK;
+}
+#endif /* APPLY_MAPPING */
+
+#ifdef APPLY_AXIS_SCALE
+/* The kernels have no branches (the choice in the logarithmic case is a
+   selection) and no `restrict` so that in-place operation is allowed, the
+   compiler vectorizes them after checking that the arrays do not overlap. */
+MpStatus
+APPLY_AXIS_SCALE(const MpAxisScale* s, T* dst, const T* src, MpInt n)
+{
+    MpStatus status = MpCheckAxisScale(s);
+    if (status != MP_OK) {
+        return status;
+    }
+    if (n <= 0) {
+        return (n == 0 ? MP_OK : MP_BAD_SIZE);
+    }
+    if (dst == NULL || src == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    const T nan = (T)NAN;
+    const T zero = 0;
+    switch (s->scaling) {
+    case MP_LOG_SCALING:
+        for (MpInt i = 0; i < n; ++i) {
+            T v = src[i];
+            dst[i] = (v > zero ? LOG10(v) : nan);
+        }
+        break;
+    case MP_SYMLOG_SCALING: {
+        const T r = (T)(1/s->param);
+        const T c = (T)M_LOG10E;
+        for (MpInt i = 0; i < n; ++i) {
+            T v = src[i];
+            dst[i] = COPYSIGN(LOG1P(FABS(v)*r)*c, v);
+        }
+        break;
+    }
+    case MP_ASINH_SCALING: {
+        const T r = (T)(1/s->param);
+        for (MpInt i = 0; i < n; ++i) {
+            dst[i] = ASINH(src[i]*r);
+        }
+        break;
+    }
+    default:
+        if (dst != src) {
+            memmove(dst, src, n*sizeof(T));
+        }
+    }
+    return MP_OK;
+}
+#endif /* APPLY_AXIS_SCALE */
+
 #undef T
 #undef SFX
 #undef BOX
@@ -185,5 +351,12 @@ INVERT_MAPPING(MAPPING* dst, const MAPPING* A)
 #undef DEFINE_MAPPING
 #undef COMPOSE_MAPPINGS
 #undef INVERT_MAPPING
+#undef APPLY_MAPPING
+#undef APPLY_AXIS_SCALE
+#undef LOG10
+#undef LOG1P
+#undef ASINH
+#undef FABS
+#undef COPYSIGN
 
 #endif /* _MUPLOT_MAPPINGS_C */
@@ -0,0 +1,640 @@
+/*
+ * muAsyncDevice.c --
+ *
+ * Implementation of asynchronous devices for µPlot.  An asynchronous device
+ * wraps another device: the calls to its methods are queued in a ring buffer
+ * and executed by the methods of the wrapped device in a dedicated thread.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "muPlotPriv.h"
+
+/* Default and minimal sizes of the ring buffer (in bytes). */
+#define ASYNC_DEFAULT_SIZE (1 << 22)
+#define ASYNC_MINIMAL_SIZE (1 << 12)
+
+/* Number of attempts before waiting for the other thread. */
+#define ASYNC_SPIN_COUNT 100
+
+#define ASYNC_ALIGN(n) (((n) + (size_t)7) & ~(size_t)7)
+#define ASYNC_HEADER_SIZE ASYNC_ALIGN(sizeof(AsyncCommand))
+#define ASYNC_PAYLOAD(cmd) ((void*)((char*)(cmd) + ASYNC_HEADER_SIZE))
+
+typedef enum {
+    ASYNC_PADDING = 0, /* Unused space up to the end of the ring */
+    ASYNC_START_BUFFERING,
+    ASYNC_STOP_BUFFERING,
+    ASYNC_BEGIN_PAGE,
+    ASYNC_END_PAGE,
+    ASYNC_SET_COLOR_INDEX,
+    ASYNC_SET_COLOR,
+    ASYNC_SET_LINE_STYLE,
+    ASYNC_SET_LINE_WIDTH,
+    ASYNC_DRAW_POINT,
+    ASYNC_DRAW_POINTS,
+    ASYNC_DRAW_RECTANGLE,
+    ASYNC_DRAW_POLYLINE,
+    ASYNC_DRAW_POLYGON,
+    ASYNC_DRAW_CELLS,
+    ASYNC_DRAW_CELLS8,
+    ASYNC_DRAW_CELLS16,
+} AsyncCommandKind;
+
+/* Queued command, the copied coordinates or cells (if any) follow the
+   header. */
+typedef struct _AsyncCommand {
+    uint32_t kind; /* Kind of command */
+    uint32_t size; /* Size of command (header and payload) in bytes */
+    MpInt n1, n2; /* Number of points or of cells, color index, line style */
+    MpPoint x0, y0, x1, y1; /* Point, rectangle or corners of cells */
+    MpReal r, g, b; /* Colorants or line width */
+} AsyncCommand;
+
+/*
+ * The ring buffer has a single producer (the caller's thread) and a single
+ * consumer (the driver thread).  The producer only writes `head` and the
+ * consumer only writes `tail`, both are offsets which are never wrapped.  The
+ * consumer moves `tail` after a command has been executed, hence the queue is
+ * empty when all commands have been executed.  Threads only lock the mutex to
+ * wait for the other one.
+ */
+typedef struct _AsyncDevice {
+    MpDevice pub;
+
+    MpDevice*          target; /* Wrapped device */
+    unsigned char*       ring; /* Ring buffer */
+    size_t               size; /* Size of ring buffer (a power of 2) */
+    atomic_size_t        head; /* Offset of end of queued commands */
+    atomic_size_t        tail; /* Offset of first unexecuted command */
+    atomic_int         status; /* First error of the driver thread */
+    atomic_bool          quit; /* Driver thread must exit? */
+    atomic_bool  consumerIdle; /* Driver thread waits for commands? */
+    atomic_bool producerBlocked; /* Caller waits for space? */
+    pthread_mutex_t     mutex;
+    pthread_cond_t       data; /* Signaled when commands are queued */
+    pthread_cond_t      space; /* Signaled when commands are executed */
+    pthread_t          thread; /* Driver thread */
+    MpBool            running; /* Driver thread has been started? */
+    size_t            pending; /* Size of the command being queued */
+} AsyncDevice;
+
+/*---------------------------------------------------------------------------*/
+/* DRIVER THREAD */
+
+static MpStatus
+executeCommand(MpDevice* dev, const AsyncCommand* cmd)
+{
+    /* Settings are applied to the wrapped device as the high-level interface
+       does, that is only right before drawing. */
+    const void* data = ASYNC_PAYLOAD(cmd);
+    if (cmd->kind >= ASYNC_DRAW_POINT) {
+        MpStatus status = MpApplySettings(dev);
+        if (status != MP_OK) {
+            return status;
+        }
+    }
+    switch (cmd->kind) {
+    case ASYNC_PADDING:
+        return MP_OK;
+    case ASYNC_START_BUFFERING:
+        return dev->startBuffering(dev);
+    case ASYNC_STOP_BUFFERING:
+        return dev->stopBuffering(dev);
+    case ASYNC_BEGIN_PAGE:
+        return dev->beginPage(dev);
+    case ASYNC_END_PAGE:
+        return dev->endPage(dev);
+    case ASYNC_SET_COLOR_INDEX:
+        return MpSetColorIndex(dev, cmd->n1);
+    case ASYNC_SET_COLOR:
+        return MpSetColor(dev, cmd->n1, cmd->r, cmd->g, cmd->b);
+    case ASYNC_SET_LINE_STYLE:
+        return MpSetLineStyle(dev, (MpLineStyle)cmd->n1);
+    case ASYNC_SET_LINE_WIDTH:
+        return MpSetLineWidth(dev, cmd->r);
+    case ASYNC_DRAW_POINT:
+        return dev->drawPoint(dev, cmd->x0, cmd->y0);
+    case ASYNC_DRAW_RECTANGLE:
+        return dev->drawRectangle(dev, cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+    case ASYNC_DRAW_POINTS:
+        return dev->drawPoints(dev, (const MpPoint*)data,
+                               (const MpPoint*)data + cmd->n1, cmd->n1);
+    case ASYNC_DRAW_POLYLINE:
+        return dev->drawPolyline(dev, (const MpPoint*)data,
+                                 (const MpPoint*)data + cmd->n1, cmd->n1);
+    case ASYNC_DRAW_POLYGON:
+        return dev->drawPolygon(dev, (const MpPoint*)data,
+                                (const MpPoint*)data + cmd->n1, cmd->n1);
+    case ASYNC_DRAW_CELLS:
+        return dev->drawCells(dev, (const MpColorIndex*)data, cmd->n1, cmd->n2,
+                              cmd->n1, cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+    case ASYNC_DRAW_CELLS8:
+        return dev->drawCells8(dev, (const uint8_t*)data, cmd->n1, cmd->n2,
+                               cmd->n1, cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+    case ASYNC_DRAW_CELLS16:
+        return dev->drawCells16(dev, (const uint16_t*)data, cmd->n1, cmd->n2,
+                                cmd->n1, cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+    }
+    return MP_ASSERTION_FAILED;
+}
+
+static void*
+runDriverThread(void* arg)
+{
+    AsyncDevice* a = (AsyncDevice*)arg;
+    size_t mask = a->size - 1;
+    size_t tail = atomic_load_explicit(&a->tail, memory_order_relaxed);
+    int spin = 0;
+    for (;;) {
+        size_t head = atomic_load_explicit(&a->head, memory_order_acquire);
+        if (tail == head) {
+            if (atomic_load(&a->quit)) {
+                break;
+            }
+            if (++spin < ASYNC_SPIN_COUNT) {
+                sched_yield();
+                continue;
+            }
+            /* Wait for commands.  The producer checks the flag after having
+               moved `head` and signals under the lock, so no wake-up can be
+               missed. */
+            pthread_mutex_lock(&a->mutex);
+            atomic_store(&a->consumerIdle, true);
+            while (atomic_load(&a->head) == tail && !atomic_load(&a->quit)) {
+                pthread_cond_wait(&a->data, &a->mutex);
+            }
+            atomic_store(&a->consumerIdle, false);
+            pthread_mutex_unlock(&a->mutex);
+            continue;
+        }
+        spin = 0;
+        while (tail != head) {
+            const AsyncCommand* cmd = (const AsyncCommand*)(a->ring +
+                                                            (tail & mask));
+            MpStatus status = executeCommand(a->target, cmd);
+            if (status != MP_OK) {
+                int expected = MP_OK;
+                atomic_compare_exchange_strong(&a->status, &expected, status);
+            }
+            tail += cmd->size;
+            atomic_store(&a->tail, tail);
+            if (atomic_load(&a->producerBlocked)) {
+                pthread_mutex_lock(&a->mutex);
+                pthread_cond_signal(&a->space);
+                pthread_mutex_unlock(&a->mutex);
+            }
+        }
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* QUEUE */
+
+/* Wait until at most `size - n` bytes are used in the ring. */
+static void
+waitForSpace(AsyncDevice* a, size_t n)
+{
+    size_t head = atomic_load_explicit(&a->head, memory_order_relaxed);
+    for (int spin = 0; ; ++spin) {
+        size_t tail = atomic_load_explicit(&a->tail, memory_order_acquire);
+        if (a->size - (head - tail) >= n) {
+            return;
+        }
+        if (spin < ASYNC_SPIN_COUNT) {
+            sched_yield();
+            continue;
+        }
+        pthread_mutex_lock(&a->mutex);
+        atomic_store(&a->producerBlocked, true);
+        while (a->size - (head - atomic_load(&a->tail)) < n) {
+            pthread_cond_wait(&a->space, &a->mutex);
+        }
+        atomic_store(&a->producerBlocked, false);
+        pthread_mutex_unlock(&a->mutex);
+        return;
+    }
+}
+
+/* Size of a command with a payload of `nbytes` bytes.  Commands larger than
+   half the ring buffer are not queued. */
+#define COMMAND_SIZE(nbytes) (ASYNC_HEADER_SIZE + ASYNC_ALIGN(nbytes))
+#define CAN_BE_QUEUED(a, nbytes) (COMMAND_SIZE(nbytes) <= (a)->size/2)
+
+/* Reserve space for a command with a payload of `nbytes` bytes and copy the
+   header `src` in it.  The command must then be published by calling
+   pushCommand(). */
+static AsyncCommand*
+newCommand(AsyncDevice* a, const AsyncCommand* src, size_t nbytes)
+{
+    size_t size = COMMAND_SIZE(nbytes);
+    size_t head = atomic_load_explicit(&a->head, memory_order_relaxed);
+    size_t offset = head & (a->size - 1);
+    size_t room = a->size - offset;
+    a->pending = (size <= room ? size : room + size);
+    waitForSpace(a, a->pending);
+    if (size > room) {
+        /* Skip the end of the ring.  The padding is published along with the
+           command. */
+        AsyncCommand* pad = (AsyncCommand*)(a->ring + offset);
+        pad->kind = ASYNC_PADDING;
+        pad->size = room;
+        offset = 0;
+    }
+    AsyncCommand* cmd = (AsyncCommand*)(a->ring + offset);
+    *cmd = *src;
+    cmd->size = size;
+    return cmd;
+}
+
+static MpStatus
+pushCommand(AsyncDevice* a)
+{
+    size_t head = atomic_load_explicit(&a->head, memory_order_relaxed);
+    atomic_store(&a->head, head + a->pending);
+    if (atomic_load(&a->consumerIdle)) {
+        pthread_mutex_lock(&a->mutex);
+        pthread_cond_signal(&a->data);
+        pthread_mutex_unlock(&a->mutex);
+    }
+    return atomic_load(&a->status);
+}
+
+/* Wait until all queued commands have been executed and return the first
+   error of the driver thread (which is then forgotten). */
+static MpStatus
+syncQueue(AsyncDevice* a)
+{
+    if (a->running) {
+        waitForSpace(a, a->size);
+    }
+    return atomic_exchange(&a->status, MP_OK);
+}
+
+/* Queue a command with `nrows` rows of `rowSize` bytes (separated by
+   `stride` bytes) followed by `size2` bytes as payload. */
+static MpStatus
+queueCommand(AsyncDevice* a, const AsyncCommand* src,
+             const void* data1, size_t rowSize, size_t stride, MpInt nrows,
+             const void* data2, size_t size2)
+{
+    AsyncCommand* cmd = newCommand(a, src, nrows*rowSize + size2);
+    unsigned char* dst = (unsigned char*)ASYNC_PAYLOAD(cmd);
+    for (MpInt i = 0; i < nrows; ++i) {
+        memcpy(dst + i*rowSize, (const unsigned char*)data1 + i*stride,
+               rowSize);
+    }
+    if (size2 > 0) {
+        memcpy(dst + nrows*rowSize, data2, size2);
+    }
+    return pushCommand(a);
+}
+
+/*---------------------------------------------------------------------------*/
+/* METHODS */
+
+static MpStatus
+initializeAsyncDevice(MpDevice* dev)
+{
+    AsyncDevice* a = (AsyncDevice*)dev;
+    MpDevice* target = a->target;
+
+    /* Mirror the settings of the wrapped device. */
+    MpStatus status = MpSetNDCToDeviceTransform(dev, &target->ndcToDevice);
+    if (status != MP_OK) {
+        return status;
+    }
+    memcpy(dev->colormap, target->colormap,
+           target->colormapSize*sizeof(MpColor));
+    dev->colorIndex = target->pendingColorIndex;
+    dev->lineStyle = target->pendingLineStyle;
+    dev->lineWidth = target->pendingLineWidth;
+
+    /* Start the driver thread. */
+    int code = pthread_create(&a->thread, NULL, runDriverThread, a);
+    if (code != 0) {
+        return -(1 + code);
+    }
+    a->running = true;
+    return MP_OK;
+}
+
+static MpStatus
+finalizeAsyncDevice(MpDevice* dev)
+{
+    AsyncDevice* a = (AsyncDevice*)dev;
+    MpStatus status = MP_OK;
+    if (a->running) {
+        status = syncQueue(a);
+        pthread_mutex_lock(&a->mutex);
+        atomic_store(&a->quit, true);
+        pthread_cond_signal(&a->data);
+        pthread_mutex_unlock(&a->mutex);
+        pthread_join(a->thread, NULL);
+        a->running = false;
+    }
+    pthread_cond_destroy(&a->space);
+    pthread_cond_destroy(&a->data);
+    pthread_mutex_destroy(&a->mutex);
+    MpStatus code = MpCloseDevice(&a->target);
+    free((void*)a->ring);
+    a->ring = NULL;
+    return (status == MP_OK ? code : status);
+}
+
+static MpStatus
+flushAsyncDevice(MpDevice* dev)
+{
+    return syncQueue((AsyncDevice*)dev);
+}
+
+/* Copy the geometry of the wrapped device. */
+static void
+mirrorGeometry(MpDevice* dev, const MpDevice* target)
+{
+    dev->pageWidth = target->pageWidth;
+    dev->pageHeight = target->pageHeight;
+    dev->horizontalResolution = target->horizontalResolution;
+    dev->verticalResolution = target->verticalResolution;
+    dev->horizontalSamples = target->horizontalSamples;
+    dev->verticalSamples = target->verticalSamples;
+}
+
+/* Settings which change the geometry are done synchronously. */
+static MpStatus
+setAsyncPageSize(MpDevice* dev, MpReal w, MpReal h)
+{
+    AsyncDevice* a = (AsyncDevice*)dev;
+    MpStatus status = syncQueue(a);
+    if (status == MP_OK) {
+        status = MpSetPageSize(a->target, w, h);
+    }
+    if (status == MP_OK) {
+        mirrorGeometry(dev, a->target);
+        status = MpSetNDCToDeviceTransform(dev, &a->target->ndcToDevice);
+    }
+    return status;
+}
+
+static MpStatus
+setAsyncResolution(MpDevice* dev, MpReal xpmm, MpReal ypmm)
+{
+    AsyncDevice* a = (AsyncDevice*)dev;
+    MpStatus status = syncQueue(a);
+    if (status == MP_OK) {
+        status = MpSetResolution(a->target, xpmm, ypmm);
+    }
+    if (status == MP_OK) {
+        mirrorGeometry(dev, a->target);
+        status = MpSetNDCToDeviceTransform(dev, &a->target->ndcToDevice);
+    }
+    return status;
+}
+
+#define QUEUE_SIMPLE_COMMAND(KIND, ...)                                 \
+    do {                                                                \
+        AsyncCommand cmd = {.kind = KIND, __VA_ARGS__};                 \
+        return queueCommand((AsyncDevice*)dev, &cmd, NULL, 0, 0, 0,     \
+                            NULL, 0);                                   \
+    } while (0)
+
+static MpStatus
+startAsyncBuffering(MpDevice* dev)
+{
+    QUEUE_SIMPLE_COMMAND(ASYNC_START_BUFFERING);
+}
+
+static MpStatus
+stopAsyncBuffering(MpDevice* dev)
+{
+    QUEUE_SIMPLE_COMMAND(ASYNC_STOP_BUFFERING);
+}
+
+static MpStatus
+beginAsyncPage(MpDevice* dev)
+{
+    QUEUE_SIMPLE_COMMAND(ASYNC_BEGIN_PAGE);
+}
+
+static MpStatus
+endAsyncPage(MpDevice* dev)
+{
+    QUEUE_SIMPLE_COMMAND(ASYNC_END_PAGE);
+}
+
+static MpStatus
+setAsyncColorIndex(MpDevice* dev, MpColorIndex ci)
+{
+    dev->colorIndex = ci;
+    QUEUE_SIMPLE_COMMAND(ASYNC_SET_COLOR_INDEX, .n1 = ci);
+}
+
+static MpStatus
+setAsyncColor(MpDevice* dev, MpColorIndex ci,
+              MpReal rd, MpReal gr, MpReal bl)
+{
+    MpEncodeColor(&dev->colormap[ci], rd, gr, bl);
+    QUEUE_SIMPLE_COMMAND(ASYNC_SET_COLOR, .n1 = ci, .r = rd, .g = gr, .b = bl);
+}
+
+static MpStatus
+setAsyncLineStyle(MpDevice* dev, MpLineStyle ls)
+{
+    dev->lineStyle = ls;
+    QUEUE_SIMPLE_COMMAND(ASYNC_SET_LINE_STYLE, .n1 = ls);
+}
+
+static MpStatus
+setAsyncLineWidth(MpDevice* dev, MpReal lw)
+{
+    dev->lineWidth = lw;
+    QUEUE_SIMPLE_COMMAND(ASYNC_SET_LINE_WIDTH, .r = lw);
+}
+
+static MpStatus
+drawAsyncPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    QUEUE_SIMPLE_COMMAND(ASYNC_DRAW_POINT, .x0 = x, .y0 = y);
+}
+
+static MpStatus
+drawAsyncRectangle(MpDevice* dev,
+                   MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    QUEUE_SIMPLE_COMMAND(ASYNC_DRAW_RECTANGLE,
+                         .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1);
+}
+
+/* Commands too large for the ring buffer are executed by the caller's thread
+   once the queue is empty. */
+#define DRAW_ASYNC_POINTS(KIND, METHOD)                                 \
+    do {                                                                \
+        AsyncDevice* a = (AsyncDevice*)dev;                             \
+        if (! CAN_BE_QUEUED(a, 2*n*sizeof(MpPoint))) {                  \
+            MpStatus status = syncQueue(a);                             \
+            if (status == MP_OK) {                                      \
+                status = MpApplySettings(a->target);                    \
+            }                                                           \
+            return (status != MP_OK ? status :                          \
+                    a->target->METHOD(a->target, x, y, n));             \
+        }                                                               \
+        AsyncCommand cmd = {.kind = KIND, .n1 = n};                     \
+        return queueCommand(a, &cmd, x, n*sizeof(MpPoint), 0, 1,        \
+                            y, n*sizeof(MpPoint));                      \
+    } while (0)
+
+static MpStatus
+drawAsyncPoints(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    DRAW_ASYNC_POINTS(ASYNC_DRAW_POINTS, drawPoints);
+}
+
+static MpStatus
+drawAsyncPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    DRAW_ASYNC_POINTS(ASYNC_DRAW_POLYLINE, drawPolyline);
+}
+
+static MpStatus
+drawAsyncPolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    DRAW_ASYNC_POINTS(ASYNC_DRAW_POLYGON, drawPolygon);
+}
+
+#define DRAW_ASYNC_CELLS(KIND, CELL, METHOD)                            \
+    do {                                                                \
+        AsyncDevice* a = (AsyncDevice*)dev;                             \
+        if (! CAN_BE_QUEUED(a, n1*n2*sizeof(CELL))) {                   \
+            MpStatus status = syncQueue(a);                             \
+            if (status == MP_OK) {                                      \
+                status = MpApplySettings(a->target);                    \
+            }                                                           \
+            return (status != MP_OK ? status :                          \
+                    a->target->METHOD(a->target, z, n1, n2, stride,     \
+                                      x0, y0, x1, y1));                 \
+        }                                                               \
+        AsyncCommand cmd = {.kind = KIND, .n1 = n1, .n2 = n2,           \
+                            .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1};    \
+        return queueCommand(a, &cmd, z, n1*sizeof(CELL),                \
+                            stride*sizeof(CELL), n2, NULL, 0);          \
+    } while (0)
+
+static MpStatus
+drawAsyncCells(MpDevice* dev,
+               const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
+               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    DRAW_ASYNC_CELLS(ASYNC_DRAW_CELLS, MpColorIndex, drawCells);
+}
+
+static MpStatus
+drawAsyncCells8(MpDevice* dev,
+                const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+                MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    DRAW_ASYNC_CELLS(ASYNC_DRAW_CELLS8, uint8_t, drawCells8);
+}
+
+static MpStatus
+drawAsyncCells16(MpDevice* dev,
+                 const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+                 MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    DRAW_ASYNC_CELLS(ASYNC_DRAW_CELLS16, uint16_t, drawCells16);
+}
+
+/*---------------------------------------------------------------------------*/
+/* PUBLIC FUNCTIONS */
+
+MpStatus
+MpOpenAsyncDevice(MpDevice** devptr, MpDevice* target, size_t size)
+{
+    if (devptr == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *devptr = NULL;
+    if (target == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+
+    /* The size of the ring is a power of 2. */
+    if (size == 0) {
+        size = ASYNC_DEFAULT_SIZE;
+    }
+    size_t ringSize = ASYNC_MINIMAL_SIZE;
+    while (ringSize < size) {
+        ringSize *= 2;
+    }
+
+    /* Allocate structure and instanciate methods. */
+    MpDevice* dev = MpAllocateDevice(sizeof(AsyncDevice));
+    if (dev == NULL) {
+        return MP_NO_MEMORY;
+    }
+    AsyncDevice* a = (AsyncDevice*)dev;
+    a->ring = (unsigned char*)malloc(ringSize);
+    if (a->ring == NULL) {
+        free((void*)dev);
+        return MP_NO_MEMORY;
+    }
+    a->size = ringSize;
+    atomic_init(&a->head, 0);
+    atomic_init(&a->tail, 0);
+    atomic_init(&a->status, MP_OK);
+    atomic_init(&a->quit, false);
+    atomic_init(&a->consumerIdle, false);
+    atomic_init(&a->producerBlocked, false);
+    pthread_mutex_init(&a->mutex, NULL);
+    pthread_cond_init(&a->data, NULL);
+    pthread_cond_init(&a->space, NULL);
+    a->target = target;
+    dev->driver = target->driver;
+    dev->initialize = initializeAsyncDevice;
+    dev->finalize = finalizeAsyncDevice;
+    dev->setPageSize = setAsyncPageSize;
+    dev->setResolution = setAsyncResolution;
+    dev->startBuffering = startAsyncBuffering;
+    dev->stopBuffering = stopAsyncBuffering;
+    dev->flush = flushAsyncDevice;
+    dev->beginPage = beginAsyncPage;
+    dev->endPage = endAsyncPage;
+    dev->setColorIndex = setAsyncColorIndex;
+    dev->setColor = setAsyncColor;
+    dev->setLineStyle = setAsyncLineStyle;
+    dev->setLineWidth = setAsyncLineWidth;
+    dev->drawPoint = drawAsyncPoint;
+    dev->drawPoints = drawAsyncPoints;
+    dev->drawRectangle = drawAsyncRectangle;
+    dev->drawPolyline = drawAsyncPolyline;
+    dev->drawPolygon = drawAsyncPolygon;
+    dev->drawCells = drawAsyncCells;
+    dev->drawCells8 = drawAsyncCells8;
+    dev->drawCells16 = drawAsyncCells16;
+    mirrorGeometry(dev, target);
+    dev->pageNumber = target->pageNumber;
+    dev->colormapSize1 = target->colormapSize1;
+    dev->colormapSize2 = target->colormapSize2;
+
+    /* Initialize the device as MpOpenDevice() does.  On failure, the wrapped
+       device must not be closed. */
+    MpStatus status = MpInitializeDevice(dev);
+    if (status != MP_OK) {
+        a->target = NULL;
+        MpCloseDevice(&dev);
+        return status;
+    }
+    *devptr = dev;
+    return MP_OK;
+}
@@ -0,0 +1,915 @@
+/*
+ * muDisplayList.c --
+ *
+ * Implementation of a display list driver for µPlot.  A display list device
+ * records the calls to its methods in a compact buffer of commands which can
+ * be replayed on any other device.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "muPlotPriv.h"
+
+/* Default size of the device (in samples) and resolution (in samples per
+   millimeter). */
+#define LIST_DEFAULT_WIDTH  1000
+#define LIST_DEFAULT_HEIGHT 1000
+#define LIST_RESOLUTION       10
+
+/* Sizes of the colormaps. */
+#define LIST_COLORMAP_SIZE_1  16
+#define LIST_COLORMAP_SIZE_2 240
+
+/* Minimal size of the blocks of the arena (in bytes). */
+#define LIST_BLOCK_SIZE (1 << 16)
+
+/* Maximum number of threads to draw pages. */
+#define LIST_MAX_THREADS 64
+
+#define LIST_MIN(a,b) ((a) <= (b) ? (a) : (b))
+#define LIST_MAX(a,b) ((a) >= (b) ? (a) : (b))
+#define LIST_ALIGN(n) (((n) + (size_t)7) & ~(size_t)7)
+#define LIST_HEADER_SIZE LIST_ALIGN(sizeof(ListCommand))
+#define LIST_PAYLOAD(cmd) ((void*)((char*)(cmd) + LIST_HEADER_SIZE))
+
+typedef enum {
+    LIST_START_BUFFERING = 0,
+    LIST_STOP_BUFFERING,
+    LIST_BEGIN_PAGE,
+    LIST_END_PAGE,
+    LIST_SET_COLOR_INDEX,
+    LIST_SET_COLOR,
+    LIST_SET_LINE_STYLE,
+    LIST_SET_LINE_WIDTH,
+    LIST_DRAW_POINT,
+    LIST_DRAW_POINTS,
+    LIST_DRAW_RECTANGLE,
+    LIST_DRAW_POLYLINE,
+    LIST_DRAW_POLYGON,
+    LIST_DRAW_CELLS,
+    LIST_DRAW_CELLS8,
+    LIST_DRAW_CELLS16,
+} ListCommandKind;
+
+/*
+ * Header of a recorded command, its payload follows.  The bounding box is
+ * only meaningful for drawing commands.
+ */
+typedef struct _ListCommand {
+    uint16_t kind; /* Kind of command */
+    MpPoint  xmin, ymin, xmax, ymax; /* Bounding box of drawn pixels */
+    uint32_t size; /* Size of command (header and payload) in bytes */
+} ListCommand;
+
+/* Payloads of commands. */
+typedef struct _ListColor {
+    MpColorIndex ci;
+    MpReal red, green, blue;
+} ListColor;
+
+typedef struct _ListRectangle {
+    MpPoint x0, y0, x1, y1;
+} ListRectangle;
+
+typedef struct _ListPoints {
+    MpInt n; /* Number of points, followed by abscissae and ordinates */
+} ListPoints;
+
+typedef struct _ListCells {
+    MpInt n1, n2; /* Number of cells, followed by the n1*n2 cells */
+    MpPoint x0, y0, x1, y1;
+} ListCells;
+
+/*
+ * The commands are stored in a linked list of large blocks of memory.  When
+ * the list is cleared, the blocks are kept for subsequent recordings.
+ */
+typedef struct _ListBlock ListBlock;
+struct _ListBlock {
+    ListBlock* next;
+    size_t     size; /* Number of bytes available for commands */
+    size_t    count; /* Number of used bytes */
+};
+
+#define LIST_BLOCK_DATA(blk) ((unsigned char*)(blk) + LIST_ALIGN(sizeof(ListBlock)))
+
+typedef struct _ListDevice {
+    MpDevice pub;
+
+    ListBlock*           first; /* First block of arena */
+    ListBlock*         current; /* Block where to store next command */
+    MpInt               ncmds; /* Number of recorded commands */
+
+    /* Settings of the device when recording started. */
+    MpColorIndex    colorIndex;
+    MpLineStyle      lineStyle;
+    MpReal           lineWidth;
+} ListDevice;
+
+/*---------------------------------------------------------------------------*/
+/* RECORDING */
+
+/* Allocate a new command with a payload of `size` bytes. */
+static ListCommand*
+newCommand(ListDevice* lst, ListCommandKind kind, size_t size)
+{
+    size = LIST_HEADER_SIZE + LIST_ALIGN(size);
+    if (size > UINT32_MAX) {
+        return NULL;
+    }
+    ListBlock* blk = lst->current;
+    if (blk == NULL || blk->count + size > blk->size) {
+        /* Use the next block if it is large enough, insert a new block
+           otherwise. */
+        ListBlock* next = (blk == NULL ? lst->first : blk->next);
+        if (next == NULL || next->size < size) {
+            size_t blkSize = LIST_MAX(size, LIST_BLOCK_SIZE);
+            ListBlock* tmp = (ListBlock*)malloc(LIST_ALIGN(sizeof(ListBlock))
+                                                + blkSize);
+            if (tmp == NULL) {
+                return NULL;
+            }
+            tmp->size = blkSize;
+            tmp->next = next;
+            if (blk == NULL) {
+                lst->first = tmp;
+            } else {
+                blk->next = tmp;
+            }
+            next = tmp;
+        }
+        next->count = 0;
+        lst->current = blk = next;
+    }
+    ListCommand* cmd = (ListCommand*)(LIST_BLOCK_DATA(blk) + blk->count);
+    blk->count += size;
+    ++lst->ncmds;
+    cmd->kind = kind;
+    cmd->size = size;
+    cmd->xmin = cmd->ymin = cmd->xmax = cmd->ymax = 0;
+    return cmd;
+}
+
+static MpStatus
+recordSimpleCommand(MpDevice* dev, ListCommandKind kind)
+{
+    return (newCommand((ListDevice*)dev, kind, 0) == NULL ?
+            MP_NO_MEMORY : MP_OK);
+}
+
+static void
+setBoundingBox(ListCommand* cmd, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    MpPoint xmin = x[0], xmax = x[0], ymin = y[0], ymax = y[0];
+    for (MpInt i = 1; i < n; ++i) {
+        xmin = LIST_MIN(xmin, x[i]);
+        xmax = LIST_MAX(xmax, x[i]);
+        ymin = LIST_MIN(ymin, y[i]);
+        ymax = LIST_MAX(ymax, y[i]);
+    }
+    cmd->xmin = xmin;
+    cmd->ymin = ymin;
+    cmd->xmax = xmax;
+    cmd->ymax = ymax;
+}
+
+static MpStatus
+recordPoints(MpDevice* dev, ListCommandKind kind,
+             const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    if (n < 1) {
+        return MP_OK;
+    }
+    ListCommand* cmd = newCommand((ListDevice*)dev, kind, sizeof(ListPoints) +
+                                  2*n*sizeof(MpPoint));
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    ListPoints* pts = (ListPoints*)LIST_PAYLOAD(cmd);
+    MpPoint* xp = (MpPoint*)(pts + 1);
+    pts->n = n;
+    memcpy(xp, x, n*sizeof(MpPoint));
+    memcpy(xp + n, y, n*sizeof(MpPoint));
+    setBoundingBox(cmd, x, y, n);
+    return MP_OK;
+}
+
+static MpStatus
+recordCells(MpDevice* dev, ListCommandKind kind, size_t elsize,
+            const void* z, MpInt n1, MpInt n2, MpInt stride,
+            MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    if (n1 < 1 || n2 < 1) {
+        return MP_OK;
+    }
+    ListCommand* cmd = newCommand((ListDevice*)dev, kind, sizeof(ListCells) +
+                                  n1*n2*elsize);
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    ListCells* cells = (ListCells*)LIST_PAYLOAD(cmd);
+    unsigned char* dst = (unsigned char*)(cells + 1);
+    cells->n1 = n1;
+    cells->n2 = n2;
+    cells->x0 = x0;
+    cells->y0 = y0;
+    cells->x1 = x1;
+    cells->y1 = y1;
+    for (MpInt i2 = 0; i2 < n2; ++i2) {
+        memcpy(dst + i2*n1*elsize, (const unsigned char*)z + i2*stride*elsize,
+               n1*elsize);
+    }
+    cmd->xmin = LIST_MIN(x0, x1);
+    cmd->ymin = LIST_MIN(y0, y1);
+    cmd->xmax = LIST_MAX(x0, x1);
+    cmd->ymax = LIST_MAX(y0, y1);
+    return MP_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/* METHODS */
+
+static MpStatus
+initializeListDevice(MpDevice* dev)
+{
+    ListDevice* lst = (ListDevice*)dev;
+    lst->colorIndex = dev->colorIndex;
+    lst->lineStyle = dev->lineStyle;
+    lst->lineWidth = dev->lineWidth;
+    return MP_OK;
+}
+
+static MpStatus
+finalizeListDevice(MpDevice* dev)
+{
+    ListDevice* lst = (ListDevice*)dev;
+    ListBlock* blk = lst->first;
+    while (blk != NULL) {
+        ListBlock* next = blk->next;
+        free((void*)blk);
+        blk = next;
+    }
+    lst->first = NULL;
+    lst->current = NULL;
+    lst->ncmds = 0;
+    return MP_OK;
+}
+
+static MpStatus
+startListBuffering(MpDevice* dev)
+{
+    return recordSimpleCommand(dev, LIST_START_BUFFERING);
+}
+
+static MpStatus
+stopListBuffering(MpDevice* dev)
+{
+    return recordSimpleCommand(dev, LIST_STOP_BUFFERING);
+}
+
+static MpStatus
+beginListPage(MpDevice* dev)
+{
+    return recordSimpleCommand(dev, LIST_BEGIN_PAGE);
+}
+
+static MpStatus
+endListPage(MpDevice* dev)
+{
+    return recordSimpleCommand(dev, LIST_END_PAGE);
+}
+
+static MpStatus
+setListColorIndex(MpDevice* dev, MpColorIndex ci)
+{
+    ListCommand* cmd = newCommand((ListDevice*)dev, LIST_SET_COLOR_INDEX,
+                                  sizeof(MpColorIndex));
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    *(MpColorIndex*)LIST_PAYLOAD(cmd) = ci;
+    dev->colorIndex = ci;
+    return MP_OK;
+}
+
+static MpStatus
+setListColor(MpDevice* dev, MpColorIndex ci,
+             MpReal rd, MpReal gr, MpReal bl)
+{
+    ListCommand* cmd = newCommand((ListDevice*)dev, LIST_SET_COLOR,
+                                  sizeof(ListColor));
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    ListColor* c = (ListColor*)LIST_PAYLOAD(cmd);
+    c->ci = ci;
+    c->red = rd;
+    c->green = gr;
+    c->blue = bl;
+    MpEncodeColor(&dev->colormap[ci], rd, gr, bl);
+    return MP_OK;
+}
+
+static MpStatus
+setListLineStyle(MpDevice* dev, MpLineStyle ls)
+{
+    ListCommand* cmd = newCommand((ListDevice*)dev, LIST_SET_LINE_STYLE,
+                                  sizeof(MpLineStyle));
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    *(MpLineStyle*)LIST_PAYLOAD(cmd) = ls;
+    dev->lineStyle = ls;
+    return MP_OK;
+}
+
+static MpStatus
+setListLineWidth(MpDevice* dev, MpReal lw)
+{
+    ListCommand* cmd = newCommand((ListDevice*)dev, LIST_SET_LINE_WIDTH,
+                                  sizeof(MpReal));
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    *(MpReal*)LIST_PAYLOAD(cmd) = lw;
+    dev->lineWidth = lw;
+    return MP_OK;
+}
+
+static MpStatus
+drawListPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    ListCommand* cmd = newCommand((ListDevice*)dev, LIST_DRAW_POINT, 0);
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    cmd->xmin = cmd->xmax = x;
+    cmd->ymin = cmd->ymax = y;
+    return MP_OK;
+}
+
+static MpStatus
+drawListPoints(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    return recordPoints(dev, LIST_DRAW_POINTS, x, y, n);
+}
+
+static MpStatus
+drawListRectangle(MpDevice* dev,
+                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    ListCommand* cmd = newCommand((ListDevice*)dev, LIST_DRAW_RECTANGLE,
+                                  sizeof(ListRectangle));
+    if (cmd == NULL) {
+        return MP_NO_MEMORY;
+    }
+    ListRectangle* r = (ListRectangle*)LIST_PAYLOAD(cmd);
+    r->x0 = x0;
+    r->y0 = y0;
+    r->x1 = x1;
+    r->y1 = y1;
+    cmd->xmin = LIST_MIN(x0, x1);
+    cmd->ymin = LIST_MIN(y0, y1);
+    cmd->xmax = LIST_MAX(x0, x1);
+    cmd->ymax = LIST_MAX(y0, y1);
+    return MP_OK;
+}
+
+static MpStatus
+drawListPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    return recordPoints(dev, LIST_DRAW_POLYLINE, x, y, n);
+}
+
+static MpStatus
+drawListPolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    return recordPoints(dev, LIST_DRAW_POLYGON, x, y, n);
+}
+
+static MpStatus
+drawListCells(MpDevice* dev,
+              const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
+              MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return recordCells(dev, LIST_DRAW_CELLS, sizeof(MpColorIndex),
+                       z, n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawListCells8(MpDevice* dev,
+               const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return recordCells(dev, LIST_DRAW_CELLS8, sizeof(uint8_t),
+                       z, n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawListCells16(MpDevice* dev,
+                const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+                MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return recordCells(dev, LIST_DRAW_CELLS16, sizeof(uint16_t),
+                       z, n1, n2, stride, x0, y0, x1, y1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* REPLAY */
+
+/* Context for replaying the commands on a target device. */
+typedef struct _ListReplay {
+    MpDevice*               dev; /* Target device */
+    MpBool             identity; /* Same device coordinates? */
+    MpCoordinateTransform     T; /* List to target device coordinates */
+} ListReplay;
+
+static MpPoint
+toPoint(double u)
+{
+    u = floor(u + 0.5);
+    return (MpPoint)(u < INT16_MIN ? INT16_MIN :
+                     (u > INT16_MAX ? INT16_MAX : u));
+}
+
+static void
+transformPoint(const ListReplay* ctx, MpPoint* xp, MpPoint* yp)
+{
+    const MpCoordinateTransform* T = &ctx->T;
+    double x = *xp, y = *yp;
+    *xp = toPoint(T->xx*x + T->xy*y + T->x);
+    *yp = toPoint(T->yx*x + T->yy*y + T->y);
+}
+
+/* Get the coordinates of a list of points in the target device, using the
+   scratch buffers of the target if the coordinates must be transformed. */
+static MpStatus
+transformPoints(const ListReplay* ctx, const ListPoints* pts,
+                const MpPoint** xptr, const MpPoint** yptr)
+{
+    const MpPoint* x = (const MpPoint*)(pts + 1);
+    const MpPoint* y = x + pts->n;
+    if (! ctx->identity) {
+        MpDevice* dev = ctx->dev;
+        MpStatus status = MpReserveScratch(dev, pts->n);
+        if (status != MP_OK) {
+            return status;
+        }
+        const MpCoordinateTransform* T = &ctx->T;
+        MpPoint* restrict xt = dev->xscratch;
+        MpPoint* restrict yt = dev->yscratch;
+        for (MpInt i = 0; i < pts->n; ++i) {
+            double u = x[i], v = y[i];
+            xt[i] = toPoint(T->xx*u + T->xy*v + T->x);
+            yt[i] = toPoint(T->yx*u + T->yy*v + T->y);
+        }
+        x = xt;
+        y = yt;
+    }
+    *xptr = x;
+    *yptr = y;
+    return MP_OK;
+}
+
+static MpStatus
+replayCommand(const ListReplay* ctx, const ListCommand* cmd)
+{
+    MpDevice* dev = ctx->dev;
+    const void* data = LIST_PAYLOAD(cmd);
+    switch (cmd->kind) {
+    case LIST_START_BUFFERING:
+        return MpStartBuffering(dev);
+    case LIST_STOP_BUFFERING:
+        return MpStopBuffering(dev);
+    case LIST_BEGIN_PAGE:
+        return MpBeginPage(dev);
+    case LIST_END_PAGE:
+        return MpEndPage(dev);
+    case LIST_SET_COLOR_INDEX:
+        return MpSetColorIndex(dev, *(const MpColorIndex*)data);
+    case LIST_SET_COLOR: {
+        const ListColor* c = (const ListColor*)data;
+        return MpSetColor(dev, c->ci, c->red, c->green, c->blue);
+    }
+    case LIST_SET_LINE_STYLE:
+        return MpSetLineStyle(dev, *(const MpLineStyle*)data);
+    case LIST_SET_LINE_WIDTH:
+        return MpSetLineWidth(dev, *(const MpReal*)data);
+    case LIST_DRAW_POINT: {
+        MpPoint x = cmd->xmin, y = cmd->ymin;
+        if (! ctx->identity) {
+            transformPoint(ctx, &x, &y);
+        }
+        return dev->drawPoint(dev, x, y);
+    }
+    case LIST_DRAW_RECTANGLE: {
+        ListRectangle r = *(const ListRectangle*)data;
+        if (! ctx->identity) {
+            transformPoint(ctx, &r.x0, &r.y0);
+            transformPoint(ctx, &r.x1, &r.y1);
+        }
+        return dev->drawRectangle(dev, r.x0, r.y0, r.x1, r.y1);
+    }
+    case LIST_DRAW_POINTS:
+    case LIST_DRAW_POLYLINE:
+    case LIST_DRAW_POLYGON: {
+        const ListPoints* pts = (const ListPoints*)data;
+        const MpPoint* x;
+        const MpPoint* y;
+        MpStatus status = transformPoints(ctx, pts, &x, &y);
+        if (status != MP_OK) {
+            return status;
+        }
+        return (cmd->kind == LIST_DRAW_POINTS ?
+                dev->drawPoints(dev, x, y, pts->n) :
+                cmd->kind == LIST_DRAW_POLYLINE ?
+                dev->drawPolyline(dev, x, y, pts->n) :
+                dev->drawPolygon(dev, x, y, pts->n));
+    }
+    case LIST_DRAW_CELLS:
+    case LIST_DRAW_CELLS8:
+    case LIST_DRAW_CELLS16: {
+        const ListCells* c = (const ListCells*)data;
+        const void* z = c + 1;
+        MpPoint x0 = c->x0, y0 = c->y0, x1 = c->x1, y1 = c->y1;
+        if (! ctx->identity) {
+            transformPoint(ctx, &x0, &y0);
+            transformPoint(ctx, &x1, &y1);
+        }
+        if (cmd->kind == LIST_DRAW_CELLS) {
+            return dev->drawCells(dev, (const MpColorIndex*)z, c->n1, c->n2,
+                                  c->n1, x0, y0, x1, y1);
+        }
+        if (cmd->kind == LIST_DRAW_CELLS8) {
+            return dev->drawCells8(dev, (const uint8_t*)z, c->n1, c->n2,
+                                   c->n1, x0, y0, x1, y1);
+        }
+        return dev->drawCells16(dev, (const uint16_t*)z, c->n1, c->n2,
+                                c->n1, x0, y0, x1, y1);
+    }
+    }
+    return MP_ASSERTION_FAILED;
+}
+
+static MpStatus
+replay(MpDevice* list, MpDevice* dev, const MpPoint* box)
+{
+    if (list == NULL || dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (list->initialize != initializeListDevice || list == dev) {
+        return MP_BAD_DEVICE;
+    }
+
+    /* The device coordinates of the list are converted to NDC and then to
+       the device coordinates of the target. */
+    ListDevice* lst = (ListDevice*)list;
+    ListReplay ctx;
+    MpCoordinateTransform R;
+    ctx.dev = dev;
+    MpStatus status = MpInverseAffineTransformDbl(&R, &list->ndcToDevice);
+    if (status == MP_OK) {
+        status = MpComposeAffineTransformsDbl(&ctx.T, &dev->ndcToDevice, &R);
+    }
+    if (status != MP_OK) {
+        return status;
+    }
+    ctx.identity = (list->ndcToDevice.xx == dev->ndcToDevice.xx &&
+                    list->ndcToDevice.xy == dev->ndcToDevice.xy &&
+                    list->ndcToDevice.x  == dev->ndcToDevice.x  &&
+                    list->ndcToDevice.yx == dev->ndcToDevice.yx &&
+                    list->ndcToDevice.yy == dev->ndcToDevice.yy &&
+                    list->ndcToDevice.y  == dev->ndcToDevice.y);
+
+    /* Restore the initial settings of the list and execute the commands.
+       Drawing commands outside the box (if any) are skipped. */
+    status = MpSetColorIndex(dev, lst->colorIndex);
+    if (status == MP_OK) {
+        status = MpSetLineStyle(dev, lst->lineStyle);
+    }
+    if (status == MP_OK) {
+        status = MpSetLineWidth(dev, lst->lineWidth);
+    }
+    for (const ListBlock* blk = lst->first;
+         blk != NULL && status == MP_OK; blk = blk->next) {
+        const unsigned char* data = LIST_BLOCK_DATA(blk);
+        for (size_t offset = 0; offset < blk->count && status == MP_OK; ) {
+            const ListCommand* cmd = (const ListCommand*)(data + offset);
+            offset += cmd->size;
+            if (box != NULL && cmd->kind >= LIST_DRAW_POINT &&
+                (cmd->xmax < box[0] || cmd->xmin > box[2] ||
+                 cmd->ymax < box[1] || cmd->ymin > box[3])) {
+                continue;
+            }
+            if (cmd->kind >= LIST_DRAW_POINT) {
+                status = MpApplySettings(dev);
+                if (status != MP_OK) {
+                    break;
+                }
+            }
+            status = replayCommand(&ctx, cmd);
+        }
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/* PUBLIC FUNCTIONS */
+
+MpStatus
+MpOpenDisplayListDevice(MpDevice** devptr, const char* ident, const char* arg)
+{
+    /* Note: Arguments have been checked but `arg` may be `NULL` or an empty
+       string.  The syntax of `arg` is `[WIDTHxHEIGHT]`. */
+    long width = LIST_DEFAULT_WIDTH, height = LIST_DEFAULT_HEIGHT;
+    if (arg != NULL && arg[0] != '\0') {
+        int len = 0;
+        if (sscanf(arg, "%ldx%ld%n", &width, &height, &len) != 2 ||
+            arg[len] != '\0') {
+            return MP_BAD_ARGUMENT;
+        }
+        if (width < 1 || width > 32767 || height < 1 || height > 32767) {
+            return MP_BAD_SIZE;
+        }
+    }
+
+    /* Allocate structure and instanciate methods. */
+    MpDevice* dev = MpAllocateDevice(sizeof(ListDevice));
+    *devptr = dev;
+    if (dev == NULL) {
+        return MP_NO_MEMORY;
+    }
+    dev->initialize = initializeListDevice;
+    dev->finalize = finalizeListDevice;
+    dev->startBuffering = startListBuffering;
+    dev->stopBuffering = stopListBuffering;
+    dev->beginPage = beginListPage;
+    dev->endPage = endListPage;
+    dev->setColorIndex = setListColorIndex;
+    dev->setColor = setListColor;
+    dev->setLineStyle = setListLineStyle;
+    dev->setLineWidth = setListLineWidth;
+    dev->drawPoint = drawListPoint;
+    dev->drawPoints = drawListPoints;
+    dev->drawRectangle = drawListRectangle;
+    dev->drawPolyline = drawListPolyline;
+    dev->drawPolygon = drawListPolygon;
+    dev->drawCells = drawListCells;
+    dev->drawCells8 = drawListCells8;
+    dev->drawCells16 = drawListCells16;
+
+    dev->horizontalResolution = LIST_RESOLUTION;
+    dev->verticalResolution = LIST_RESOLUTION;
+    dev->horizontalSamples = width;
+    dev->verticalSamples = height;
+    dev->colormapSize1 = LIST_COLORMAP_SIZE_1;
+    dev->colormapSize2 = LIST_COLORMAP_SIZE_2;
+    dev->colorIndex = MP_COLOR_FOREGROUND;
+    return MP_OK;
+}
+
+MpStatus
+MpReplay(MpDevice* list, MpDevice* dev)
+{
+    return replay(list, dev, NULL);
+}
+
+MpStatus
+MpReplayRegion(MpDevice* list, MpDevice* dev,
+               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    MpPoint box[4] = {LIST_MIN(x0, x1), LIST_MIN(y0, y1),
+                      LIST_MAX(x0, x1), LIST_MAX(y0, y1)};
+    return replay(list, dev, box);
+}
+
+MpStatus
+MpClearDisplayList(MpDevice* list)
+{
+    if (list == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (list->initialize != initializeListDevice) {
+        return MP_BAD_DEVICE;
+    }
+    ListDevice* lst = (ListDevice*)list;
+    for (ListBlock* blk = lst->first; blk != NULL; blk = blk->next) {
+        blk->count = 0;
+    }
+    lst->current = lst->first;
+    lst->ncmds = 0;
+    lst->colorIndex = list->colorIndex;
+    lst->lineStyle = list->lineStyle;
+    lst->lineWidth = list->lineWidth;
+    return MP_OK;
+}
+
+MpStatus
+MpGetDisplayListSize(MpDevice* list, MpInt* ncmds)
+{
+    if (list == NULL || ncmds == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (list->initialize != initializeListDevice) {
+        return MP_BAD_DEVICE;
+    }
+    *ncmds = ((ListDevice*)list)->ncmds;
+    return MP_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/* PAGE RECORDERS */
+
+/* Mirror the settings of the target device of a page recorder. */
+static MpStatus
+mirrorTarget(MpDevice* dev, MpDevice* target)
+{
+    MpStatus status = MpSetNDCToDeviceTransform(dev, &target->ndcToDevice);
+    if (status == MP_OK) {
+        status = MpSetCoordinateTransform(dev, &target->dataToNDC);
+    }
+    if (status == MP_OK) {
+        status = MpSetAxisScales(dev, &target->xscale, &target->yscale);
+    }
+    if (status != MP_OK) {
+        return status;
+    }
+    memcpy(dev->colormap, target->colormap,
+           target->colormapSize*sizeof(MpColor));
+    dev->decimate = target->decimate;
+    dev->simplify = target->simplify;
+    ListDevice* lst = (ListDevice*)dev;
+    dev->colorIndex = dev->pendingColorIndex = lst->colorIndex =
+        target->pendingColorIndex;
+    dev->lineStyle = dev->pendingLineStyle = lst->lineStyle =
+        target->pendingLineStyle;
+    dev->lineWidth = dev->pendingLineWidth = lst->lineWidth =
+        target->pendingLineWidth;
+    dev->pendingSettings = false;
+    return MP_OK;
+}
+
+MpStatus
+MpOpenPageRecorder(MpDevice** devptr, MpDevice* target)
+{
+    if (devptr == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *devptr = NULL;
+    if (target == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MpDevice* dev;
+    MpStatus status = MpOpenDisplayListDevice(&dev, NULL, NULL);
+    if (status != MP_OK) {
+        return status;
+    }
+    dev->driver = "list";
+    dev->pageWidth = target->pageWidth;
+    dev->pageHeight = target->pageHeight;
+    dev->horizontalResolution = target->horizontalResolution;
+    dev->verticalResolution = target->verticalResolution;
+    dev->horizontalSamples = target->horizontalSamples;
+    dev->verticalSamples = target->verticalSamples;
+    dev->colormapSize1 = target->colormapSize1;
+    dev->colormapSize2 = target->colormapSize2;
+    dev->colorIndex = target->pendingColorIndex;
+    status = MpInitializeDevice(dev);
+    if (status == MP_OK) {
+        status = mirrorTarget(dev, target);
+    }
+    if (status != MP_OK) {
+        MpCloseDevice(&dev);
+        return status;
+    }
+    *devptr = dev;
+    return MP_OK;
+}
+
+MpStatus
+MpMergePages(MpDevice* dev, MpDevice* const* pages, MpInt n)
+{
+    if (dev == NULL || (pages == NULL && n > 0)) {
+        return MP_BAD_ADDRESS;
+    }
+    if (n < 0) {
+        return MP_BAD_SIZE;
+    }
+    MpStatus status = MP_OK;
+    for (MpInt k = 0; k < n && status == MP_OK; ++k) {
+        status = MpBeginPage(dev);
+        if (status == MP_OK) {
+            status = MpReplay(pages[k], dev);
+        }
+        if (status == MP_OK) {
+            status = MpEndPage(dev);
+        }
+    }
+    return status;
+}
+
+typedef struct _PageTask {
+    pthread_t      thread;
+    MpPageDrawer*    draw;
+    void*             ctx;
+    MpDevice*         dev; /* Page recorder */
+    MpInt            page;
+    MpStatus       status;
+} PageTask;
+
+static void*
+runPageTask(void* arg)
+{
+    PageTask* task = (PageTask*)arg;
+    task->status = task->draw(task->ctx, task->dev, task->page);
+    return NULL;
+}
+
+MpStatus
+MpDrawPages(MpDevice* dev, MpInt npages, MpPageDrawer* draw, void* ctx,
+            MpInt nthreads)
+{
+    if (dev == NULL || draw == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (npages < 0) {
+        return MP_BAD_SIZE;
+    }
+    if (nthreads < 0) {
+        return MP_BAD_ARGUMENT;
+    }
+    if (nthreads == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (ncpus > 1 ? ncpus : 1);
+    }
+    if (nthreads > LIST_MAX_THREADS) {
+        nthreads = LIST_MAX_THREADS;
+    }
+
+    /* The recorders of the pages mirror a model which is never drawn so that
+       all pages start with the current settings of the target whatever the
+       pages merged before. */
+    MpDevice* model;
+    MpStatus status = MpOpenPageRecorder(&model, dev);
+    if (status != MP_OK) {
+        return status;
+    }
+    PageTask tasks[LIST_MAX_THREADS];
+    MpDevice* recs[LIST_MAX_THREADS];
+    for (MpInt first = 1; first <= npages && status == MP_OK;
+         first += nthreads) {
+        MpInt n = LIST_MIN(nthreads, npages + 1 - first);
+        for (MpInt k = 0; k < n; ++k) {
+            recs[k] = NULL;
+        }
+        for (MpInt k = 0; k < n && status == MP_OK; ++k) {
+            tasks[k].draw = draw;
+            tasks[k].ctx = ctx;
+            tasks[k].page = first + k;
+            tasks[k].status = MP_OK;
+            status = MpOpenPageRecorder(&recs[k], model);
+            tasks[k].dev = recs[k];
+        }
+        if (status == MP_OK) {
+            /* The first page is drawn by the caller.  Pages which cannot be
+               given to a new thread are also drawn by the caller. */
+            MpInt started = 1;
+            while (started < n &&
+                   pthread_create(&tasks[started].thread, NULL,
+                                  runPageTask, &tasks[started]) == 0) {
+                ++started;
+            }
+            for (MpInt k = started; k < n; ++k) {
+                runPageTask(&tasks[k]);
+            }
+            runPageTask(&tasks[0]);
+            for (MpInt k = 1; k < started; ++k) {
+                pthread_join(tasks[k].thread, NULL);
+            }
+            MpInt m = 0;
+            while (m < n && tasks[m].status == MP_OK) {
+                ++m;
+            }
+            status = MpMergePages(dev, recs, m);
+            if (status == MP_OK && m < n) {
+                status = tasks[m].status;
+            }
+        }
+        for (MpInt k = 0; k < n; ++k) {
+            MpCloseDevice(&recs[k]);
+        }
+    }
+    MpCloseDevice(&model);
+    return status;
+}
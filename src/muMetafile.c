@@ -0,0 +1,1149 @@
+/*
+ * muMetafile.c --
+ *
+ * Implementation of a binary metafile driver for µPlot.  A metafile device
+ * writes the calls to its methods as records in a file.  The file ends with
+ * an index of the pages so that, once mapped in memory, any page can be
+ * replayed on any other device without decoding the pages before it.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "muPlotPriv.h"
+
+/* Default size of the device (in samples) and resolution (in samples per
+   millimeter). */
+#define META_DEFAULT_WIDTH  1000
+#define META_DEFAULT_HEIGHT 1000
+#define META_RESOLUTION       10
+
+/* Sizes of the colormaps. */
+#define META_COLORMAP_SIZE_1  16
+#define META_COLORMAP_SIZE_2 240
+
+/*
+ * Layout of a metafile, all numbers are little-endian:
+ *
+ * - a header of META_HEADER_SIZE bytes, see writeHeader();
+ *
+ * - the records, each record has a header of META_RECORD_SIZE bytes (the kind
+ *   of record on 16 bits, 16 bits of padding and the size of the payload on 32
+ *   bits) followed by the payload padded to a multiple of 8 bytes;
+ *
+ * - the index with an entry of META_ENTRY_SIZE bytes per page, see
+ *   writeIndex();
+ *
+ * - a trailer of META_TRAILER_SIZE bytes with the offset of the index, the
+ *   number of pages, the version and META_INDEX_MAGIC.
+ *
+ * The points of polylines, polygons and sets of points are encoded as the
+ * differences of coordinates between successive points (the first one with
+ * respect to (0,0)) stored as zigzag variable length integers: small steps
+ * take a single byte.  The cells are stored as they are, on a little-endian
+ * machine the 8-bit and 16-bit cells are directly drawn from the mapped file.
+ */
+#define META_MAGIC         "muPlotMF"
+#define META_INDEX_MAGIC   "muPlotIX"
+#define META_VERSION        1
+#define META_HEADER_SIZE  128
+#define META_RECORD_SIZE    8
+#define META_ENTRY_SIZE    32
+#define META_TRAILER_SIZE  24
+#define META_POINTS_SIZE   12 /* Size of payload header for points */
+#define META_CELLS_SIZE    16 /* Size of payload header for cells */
+
+#define META_MIN(a,b) ((a) <= (b) ? (a) : (b))
+#define META_MAX(a,b) ((a) >= (b) ? (a) : (b))
+#define META_ALIGN(n) (((n) + (size_t)7) & ~(size_t)7)
+
+typedef enum {
+    META_START_BUFFERING = 0,
+    META_STOP_BUFFERING,
+    META_BEGIN_PAGE,
+    META_END_PAGE,
+    META_SET_COLOR_INDEX,
+    META_SET_COLOR,
+    META_SET_LINE_STYLE,
+    META_SET_LINE_WIDTH,
+    META_DRAW_POINT,
+    META_DRAW_POINTS,
+    META_DRAW_RECTANGLE,
+    META_DRAW_POLYLINE,
+    META_DRAW_POLYGON,
+    META_DRAW_CELLS,
+    META_DRAW_CELLS8,
+    META_DRAW_CELLS16,
+} MetaRecordKind;
+
+/*---------------------------------------------------------------------------*/
+/* ENCODING */
+
+static inline void
+put16(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static inline void
+put32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static inline void
+put64(unsigned char* p, uint64_t v)
+{
+    put32(p, (uint32_t)v);
+    put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline void
+putFlt(unsigned char* p, float v)
+{
+    uint32_t u;
+    memcpy(&u, &v, sizeof(u));
+    put32(p, u);
+}
+
+static inline void
+putDbl(unsigned char* p, double v)
+{
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    put64(p, u);
+}
+
+static inline uint32_t
+get16(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static inline uint32_t
+get32(const unsigned char* p)
+{
+    return ((uint32_t)p[0]         | ((uint32_t)p[1] <<  8) |
+            ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static inline uint64_t
+get64(const unsigned char* p)
+{
+    return (uint64_t)get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+static inline float
+getFlt(const unsigned char* p)
+{
+    uint32_t u = get32(p);
+    float v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+static inline double
+getDbl(const unsigned char* p)
+{
+    uint64_t u = get64(p);
+    double v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+static inline MpBool
+isLittleEndian(void)
+{
+    const uint16_t u = 1;
+    return *(const unsigned char*)&u == 1;
+}
+
+/* Store a zigzag variable length integer, at most 3 bytes for the
+   differences of 16-bit coordinates. */
+static inline unsigned char*
+putVarint(unsigned char* p, int32_t d)
+{
+    uint32_t v = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+/* Retrieve a zigzag variable length integer, `NULL` is returned if it is
+   truncated or too long. */
+static inline const unsigned char*
+getVarint(const unsigned char* p, const unsigned char* end, int32_t* d)
+{
+    uint32_t v = 0;
+    for (int s = 0; p < end && s < 32; s += 7) {
+        uint32_t b = *p++;
+        v |= (b & 0x7f) << s;
+        if ((b & 0x80) == 0) {
+            *d = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* RECORDING */
+
+/* Entry of the index of pages. */
+typedef struct _MetaPage {
+    uint64_t          begin; /* Offset of first record of the page */
+    uint64_t            end; /* Offset after last record of the page */
+    MpInt            number; /* Page number */
+    MpColorIndex colorIndex; /* Settings at the beginning of the page */
+    MpLineStyle   lineStyle;
+    MpReal        lineWidth;
+} MetaPage;
+
+typedef struct _MetaDevice {
+    MpDevice pub;
+
+    FILE*                file; /* Output file */
+    MpWriter              out; /* Buffered writer for the output file */
+    uint64_t           offset; /* Offset of next record in the file */
+    unsigned char*     buffer; /* Buffer to encode the payloads */
+    size_t         bufferSize; /* Number of bytes in buffer */
+    MetaPage*           pages; /* Index of pages */
+    MpInt              npages; /* Number of pages */
+    MpInt            maxPages; /* Number of allocated entries for pages */
+    MpBool             inPage; /* Last page not yet ended? */
+    uint8_t*    changedColors; /* Which colors have been set? */
+} MetaDevice;
+
+/* Get the address of a buffer of at least `size` bytes for a payload. */
+static unsigned char*
+reservePayload(MetaDevice* m, size_t size)
+{
+    if (size > m->bufferSize) {
+        size_t newSize = META_MAX(size, 2*m->bufferSize);
+        unsigned char* buf = realloc(m->buffer, newSize);
+        if (buf == NULL) {
+            return NULL;
+        }
+        m->buffer = buf;
+        m->bufferSize = newSize;
+    }
+    return m->buffer;
+}
+
+/* Write the header of a record whose payload has `size` bytes.  The payload
+   is then written by the caller and completed by endRecord(). */
+static MpStatus
+beginRecord(MetaDevice* m, MetaRecordKind kind, size_t size)
+{
+    if (size > UINT32_MAX - 8) {
+        return MP_BAD_SIZE;
+    }
+    unsigned char hdr[META_RECORD_SIZE];
+    put16(hdr, kind);
+    put16(hdr + 2, 0);
+    put32(hdr + 4, (uint32_t)size);
+    return MpWriteBytes(&m->out, hdr, META_RECORD_SIZE);
+}
+
+static MpStatus
+endRecord(MetaDevice* m, size_t size)
+{
+    static const unsigned char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t pad = META_ALIGN(size) - size;
+    MpStatus status = (pad > 0 ? MpWriteBytes(&m->out, zeros, pad) :
+                       m->out.status);
+    if (status == MP_OK) {
+        m->offset += META_RECORD_SIZE + META_ALIGN(size);
+    }
+    return status;
+}
+
+/* Write a record whose payload is stored in `data`. */
+static MpStatus
+writeRecord(MetaDevice* m, MetaRecordKind kind,
+            const unsigned char* data, size_t size)
+{
+    MpStatus status = beginRecord(m, kind, size);
+    if (status == MP_OK && size > 0) {
+        status = MpWriteBytes(&m->out, data, size);
+    }
+    return (status == MP_OK ? endRecord(m, size) : status);
+}
+
+static MpStatus
+recordInteger(MetaDevice* m, MetaRecordKind kind, MpInt val)
+{
+    unsigned char data[4];
+    put32(data, (uint32_t)(int32_t)val);
+    return writeRecord(m, kind, data, 4);
+}
+
+static MpStatus
+recordColor(MetaDevice* m, MpColorIndex ci)
+{
+    const MpColor* c = &m->pub.colormap[ci];
+    unsigned char data[16];
+    put32(data, (uint32_t)ci);
+    putFlt(data +  4, c->red);
+    putFlt(data +  8, c->green);
+    putFlt(data + 12, c->blue);
+    return writeRecord(m, META_SET_COLOR, data, 16);
+}
+
+static MpStatus
+recordPoints(MpDevice* dev, MetaRecordKind kind,
+             const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    if (n < 1) {
+        return MP_OK;
+    }
+    MetaDevice* m = (MetaDevice*)dev;
+    unsigned char* data = reservePayload(m, META_POINTS_SIZE + 6*(size_t)n);
+    if (data == NULL) {
+        return MP_NO_MEMORY;
+    }
+    unsigned char* p = data + META_POINTS_SIZE;
+    MpPoint xmin = x[0], xmax = x[0], ymin = y[0], ymax = y[0];
+    int32_t xp = 0, yp = 0;
+    for (MpInt i = 0; i < n; ++i) {
+        p = putVarint(p, (int32_t)x[i] - xp);
+        p = putVarint(p, (int32_t)y[i] - yp);
+        xp = x[i];
+        yp = y[i];
+        xmin = META_MIN(xmin, x[i]);
+        xmax = META_MAX(xmax, x[i]);
+        ymin = META_MIN(ymin, y[i]);
+        ymax = META_MAX(ymax, y[i]);
+    }
+    put32(data, (uint32_t)n);
+    put16(data +  4, (uint16_t)xmin);
+    put16(data +  6, (uint16_t)ymin);
+    put16(data +  8, (uint16_t)xmax);
+    put16(data + 10, (uint16_t)ymax);
+    return writeRecord(m, kind, data, p - data);
+}
+
+/* Write the rows of cells directly from the caller's array when their
+   representation in the file is the same as in memory. */
+static MpStatus
+recordCells(MpDevice* dev, MetaRecordKind kind, size_t elsize,
+            const void* z, MpInt n1, MpInt n2, MpInt stride,
+            MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    if (n1 < 1 || n2 < 1) {
+        return MP_OK;
+    }
+    MetaDevice* m = (MetaDevice*)dev;
+    size_t fsize = (kind == META_DRAW_CELLS ? 4 : elsize);
+    size_t size = META_CELLS_SIZE + (size_t)n1*(size_t)n2*fsize;
+    unsigned char hdr[META_CELLS_SIZE];
+    put32(hdr, (uint32_t)n1);
+    put32(hdr +  4, (uint32_t)n2);
+    put16(hdr +  8, (uint16_t)x0);
+    put16(hdr + 10, (uint16_t)y0);
+    put16(hdr + 12, (uint16_t)x1);
+    put16(hdr + 14, (uint16_t)y1);
+    MpStatus status = beginRecord(m, kind, size);
+    if (status == MP_OK) {
+        status = MpWriteBytes(&m->out, hdr, META_CELLS_SIZE);
+    }
+    MpBool raw = (elsize == 1 || (elsize == fsize && isLittleEndian()));
+    unsigned char* row = (raw ? NULL : reservePayload(m, n1*fsize));
+    if (status == MP_OK && ! raw && row == NULL) {
+        status = MP_NO_MEMORY;
+    }
+    for (MpInt i2 = 0; i2 < n2 && status == MP_OK; ++i2) {
+        const unsigned char* src = (const unsigned char*)z + i2*stride*elsize;
+        if (raw) {
+            status = MpWriteBytes(&m->out, src, n1*elsize);
+            continue;
+        }
+        for (MpInt i1 = 0; i1 < n1; ++i1) {
+            if (kind == META_DRAW_CELLS) {
+                put32(row + 4*i1,
+                      (uint32_t)(int32_t)((const MpColorIndex*)src)[i1]);
+            } else {
+                put16(row + 2*i1, ((const uint16_t*)src)[i1]);
+            }
+        }
+        status = MpWriteBytes(&m->out, row, n1*fsize);
+    }
+    return (status == MP_OK ? endRecord(m, size) : status);
+}
+
+static MpStatus
+writeHeader(MetaDevice* m)
+{
+    const MpDevice* dev = &m->pub;
+    const MpCoordinateTransform* B = &dev->ndcToDevice;
+    unsigned char hdr[META_HEADER_SIZE];
+    memset(hdr, 0, META_HEADER_SIZE);
+    memcpy(hdr, META_MAGIC, 8);
+    put32(hdr +  8, META_VERSION);
+    put32(hdr + 12, META_HEADER_SIZE);
+    put32(hdr + 16, (uint32_t)dev->horizontalSamples);
+    put32(hdr + 20, (uint32_t)dev->verticalSamples);
+    put32(hdr + 24, (uint32_t)dev->colormapSize1);
+    put32(hdr + 28, (uint32_t)dev->colormapSize2);
+    put32(hdr + 32, (uint32_t)dev->colorIndex);
+    put32(hdr + 36, (uint32_t)dev->lineStyle);
+    putFlt(hdr + 40, dev->lineWidth);
+    putDbl(hdr + 48, dev->horizontalResolution);
+    putDbl(hdr + 56, dev->verticalResolution);
+    putDbl(hdr + 64, B->xx);
+    putDbl(hdr + 72, B->xy);
+    putDbl(hdr + 80, B->x);
+    putDbl(hdr + 88, B->yx);
+    putDbl(hdr + 96, B->yy);
+    putDbl(hdr + 104, B->y);
+    m->offset = META_HEADER_SIZE;
+    return MpWriteBytes(&m->out, hdr, META_HEADER_SIZE);
+}
+
+static MpStatus
+writeIndex(MetaDevice* m)
+{
+    MpStatus status = MP_OK;
+    unsigned char buf[META_ENTRY_SIZE];
+    for (MpInt k = 0; k < m->npages && status == MP_OK; ++k) {
+        const MetaPage* page = &m->pages[k];
+        put64(buf, page->begin);
+        put64(buf + 8, page->end);
+        put32(buf + 16, (uint32_t)page->number);
+        put32(buf + 20, (uint32_t)page->colorIndex);
+        put32(buf + 24, (uint32_t)page->lineStyle);
+        putFlt(buf + 28, page->lineWidth);
+        status = MpWriteBytes(&m->out, buf, META_ENTRY_SIZE);
+    }
+    if (status == MP_OK) {
+        put64(buf, m->offset);
+        put32(buf + 8, (uint32_t)m->npages);
+        put32(buf + 12, META_VERSION);
+        memcpy(buf + 16, META_INDEX_MAGIC, 8);
+        status = MpWriteBytes(&m->out, buf, META_TRAILER_SIZE);
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/* METHODS */
+
+static MpStatus
+initializeMetaDevice(MpDevice* dev)
+{
+    MetaDevice* m = (MetaDevice*)dev;
+    m->changedColors = (uint8_t*)calloc(dev->colormapSize, sizeof(uint8_t));
+    if (m->changedColors == NULL) {
+        return MP_NO_MEMORY;
+    }
+    return writeHeader(m);
+}
+
+static MpStatus
+finalizeMetaDevice(MpDevice* dev)
+{
+    MetaDevice* m = (MetaDevice*)dev;
+    MpStatus status = MP_OK;
+    if (m->file != NULL) {
+        if (m->inPage) {
+            m->pages[m->npages - 1].end = m->offset;
+            m->inPage = false;
+        }
+        status = writeIndex(m);
+        MpStatus code = MpFinalizeWriter(&m->out);
+        if (status == MP_OK) {
+            status = code;
+        }
+        if (fclose(m->file) != 0 && status == MP_OK) {
+            status = MpSystemError();
+        }
+        m->file = NULL;
+    }
+    free((void*)m->buffer);
+    free((void*)m->pages);
+    free((void*)m->changedColors);
+    m->buffer = NULL;
+    m->pages = NULL;
+    m->changedColors = NULL;
+    return status;
+}
+
+static MpStatus
+startMetaBuffering(MpDevice* dev)
+{
+    return writeRecord((MetaDevice*)dev, META_START_BUFFERING, NULL, 0);
+}
+
+static MpStatus
+stopMetaBuffering(MpDevice* dev)
+{
+    return writeRecord((MetaDevice*)dev, META_STOP_BUFFERING, NULL, 0);
+}
+
+static MpStatus
+flushMetaDevice(MpDevice* dev)
+{
+    return MpFlushWriter(&((MetaDevice*)dev)->out);
+}
+
+/*
+ * A new page is added to the index with the current settings.  The colors
+ * changed so far are recorded at the beginning of the page so that the page
+ * can be replayed alone.
+ */
+static MpStatus
+beginMetaPage(MpDevice* dev)
+{
+    MetaDevice* m = (MetaDevice*)dev;
+    if (m->inPage) {
+        m->pages[m->npages - 1].end = m->offset;
+        m->inPage = false;
+    }
+    if (m->npages >= m->maxPages) {
+        MpInt n = META_MAX(16, 2*m->maxPages);
+        MetaPage* pages = realloc(m->pages, n*sizeof(MetaPage));
+        if (pages == NULL) {
+            return MP_NO_MEMORY;
+        }
+        m->pages = pages;
+        m->maxPages = n;
+    }
+    MetaPage* page = &m->pages[m->npages];
+    page->begin = m->offset;
+    page->end = m->offset;
+    page->number = dev->pageNumber + 1;
+    page->colorIndex = dev->colorIndex;
+    page->lineStyle = dev->lineStyle;
+    page->lineWidth = dev->lineWidth;
+    MpStatus status = writeRecord(m, META_BEGIN_PAGE, NULL, 0);
+    for (MpColorIndex ci = 0; ci < dev->colormapSize && status == MP_OK; ++ci) {
+        if (m->changedColors[ci]) {
+            status = recordColor(m, ci);
+        }
+    }
+    if (status == MP_OK) {
+        ++m->npages;
+        m->inPage = true;
+    }
+    return status;
+}
+
+static MpStatus
+endMetaPage(MpDevice* dev)
+{
+    MetaDevice* m = (MetaDevice*)dev;
+    MpStatus status = writeRecord(m, META_END_PAGE, NULL, 0);
+    if (status == MP_OK && m->inPage) {
+        m->pages[m->npages - 1].end = m->offset;
+        m->inPage = false;
+    }
+    return (status == MP_OK ? MpFlushWriter(&m->out) : status);
+}
+
+static MpStatus
+setMetaColorIndex(MpDevice* dev, MpColorIndex ci)
+{
+    MpStatus status = recordInteger((MetaDevice*)dev, META_SET_COLOR_INDEX, ci);
+    if (status == MP_OK) {
+        dev->colorIndex = ci;
+    }
+    return status;
+}
+
+static MpStatus
+setMetaColor(MpDevice* dev, MpColorIndex ci,
+             MpReal rd, MpReal gr, MpReal bl)
+{
+    MetaDevice* m = (MetaDevice*)dev;
+    MpEncodeColor(&dev->colormap[ci], rd, gr, bl);
+    m->changedColors[ci] = 1;
+    return recordColor(m, ci);
+}
+
+static MpStatus
+setMetaLineStyle(MpDevice* dev, MpLineStyle ls)
+{
+    MpStatus status = recordInteger((MetaDevice*)dev, META_SET_LINE_STYLE, ls);
+    if (status == MP_OK) {
+        dev->lineStyle = ls;
+    }
+    return status;
+}
+
+static MpStatus
+setMetaLineWidth(MpDevice* dev, MpReal lw)
+{
+    unsigned char data[4];
+    putFlt(data, lw);
+    MpStatus status = writeRecord((MetaDevice*)dev, META_SET_LINE_WIDTH,
+                                  data, 4);
+    if (status == MP_OK) {
+        dev->lineWidth = lw;
+    }
+    return status;
+}
+
+static MpStatus
+drawMetaPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    unsigned char data[4];
+    put16(data, (uint16_t)x);
+    put16(data + 2, (uint16_t)y);
+    return writeRecord((MetaDevice*)dev, META_DRAW_POINT, data, 4);
+}
+
+static MpStatus
+drawMetaPoints(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    return recordPoints(dev, META_DRAW_POINTS, x, y, n);
+}
+
+static MpStatus
+drawMetaRectangle(MpDevice* dev,
+                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    unsigned char data[8];
+    put16(data, (uint16_t)x0);
+    put16(data + 2, (uint16_t)y0);
+    put16(data + 4, (uint16_t)x1);
+    put16(data + 6, (uint16_t)y1);
+    return writeRecord((MetaDevice*)dev, META_DRAW_RECTANGLE, data, 8);
+}
+
+static MpStatus
+drawMetaPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    return recordPoints(dev, META_DRAW_POLYLINE, x, y, n);
+}
+
+static MpStatus
+drawMetaPolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    return recordPoints(dev, META_DRAW_POLYGON, x, y, n);
+}
+
+static MpStatus
+drawMetaCells(MpDevice* dev,
+              const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
+              MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return recordCells(dev, META_DRAW_CELLS, sizeof(MpColorIndex),
+                       z, n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawMetaCells8(MpDevice* dev,
+               const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return recordCells(dev, META_DRAW_CELLS8, sizeof(uint8_t),
+                       z, n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawMetaCells16(MpDevice* dev,
+                const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+                MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return recordCells(dev, META_DRAW_CELLS16, sizeof(uint16_t),
+                       z, n1, n2, stride, x0, y0, x1, y1);
+}
+
+/*---------------------------------------------------------------------------*/
+/* REPLAY */
+
+struct _MpMetafile {
+    const unsigned char*    data; /* Mapped file */
+    size_t                  size; /* Size of file in bytes */
+    uint64_t          recordsEnd; /* Offset after the last record */
+    const unsigned char*   index; /* Index of pages */
+    MpInt                 npages; /* Number of pages */
+    MpColorIndex      colorIndex; /* Initial settings */
+    MpLineStyle        lineStyle;
+    MpReal             lineWidth;
+    MpCoordinateTransform ndcToDevice; /* NDC to device transform */
+};
+
+/* Context for replaying the records on a target device. */
+typedef struct _MetaReplay {
+    MpDevice*               dev; /* Target device */
+    MpBool             identity; /* Same device coordinates? */
+    MpCoordinateTransform     T; /* Metafile to target device coordinates */
+} MetaReplay;
+
+static MpPoint
+toPoint(double u)
+{
+    u = floor(u + 0.5);
+    return (MpPoint)(u < INT16_MIN ? INT16_MIN :
+                     (u > INT16_MAX ? INT16_MAX : u));
+}
+
+static void
+transformPoint(const MetaReplay* ctx, MpPoint* xp, MpPoint* yp)
+{
+    if (! ctx->identity) {
+        const MpCoordinateTransform* T = &ctx->T;
+        double x = *xp, y = *yp;
+        *xp = toPoint(T->xx*x + T->xy*y + T->x);
+        *yp = toPoint(T->yx*x + T->yy*y + T->y);
+    }
+}
+
+/* Decode points in the scratch buffers of the target device, their
+   coordinates are transformed on the fly if needed. */
+static MpStatus
+decodePoints(const MetaReplay* ctx, const unsigned char* data, size_t size,
+             MpInt* nptr)
+{
+    if (size < META_POINTS_SIZE) {
+        return MP_BAD_SIZE;
+    }
+    MpInt n = get32(data);
+    if (2*(size_t)n > size - META_POINTS_SIZE) {
+        return MP_BAD_SIZE;
+    }
+    MpDevice* dev = ctx->dev;
+    MpStatus status = MpReserveScratch(dev, n);
+    if (status != MP_OK) {
+        return status;
+    }
+    const unsigned char* p = data + META_POINTS_SIZE;
+    const unsigned char* end = data + size;
+    MpPoint* restrict xs = dev->xscratch;
+    MpPoint* restrict ys = dev->yscratch;
+    int32_t x = 0, y = 0;
+    for (MpInt i = 0; i < n; ++i) {
+        int32_t dx, dy;
+        p = getVarint(p, end, &dx);
+        p = (p == NULL ? NULL : getVarint(p, end, &dy));
+        if (p == NULL) {
+            return MP_BAD_SIZE;
+        }
+        x += dx;
+        y += dy;
+        if (x < INT16_MIN || x > INT16_MAX || y < INT16_MIN || y > INT16_MAX) {
+            return MP_OUT_OF_RANGE;
+        }
+        xs[i] = (MpPoint)x;
+        ys[i] = (MpPoint)y;
+        transformPoint(ctx, &xs[i], &ys[i]);
+    }
+    *nptr = n;
+    return MP_OK;
+}
+
+static MpStatus
+replayCells(const MetaReplay* ctx, MetaRecordKind kind,
+            const unsigned char* data, size_t size)
+{
+    if (size < META_CELLS_SIZE) {
+        return MP_BAD_SIZE;
+    }
+    MpDevice* dev = ctx->dev;
+    MpInt n1 = get32(data), n2 = get32(data + 4);
+    MpPoint x0 = (int16_t)get16(data +  8), y0 = (int16_t)get16(data + 10);
+    MpPoint x1 = (int16_t)get16(data + 12), y1 = (int16_t)get16(data + 14);
+    size_t fsize = (kind == META_DRAW_CELLS ? 4 : kind == META_DRAW_CELLS16 ?
+                    2 : 1);
+    size_t n = (size_t)n1*(size_t)n2;
+    if (n1 < 1 || n2 < 1 || n/(size_t)n1 != (size_t)n2 ||
+        n > (size - META_CELLS_SIZE)/fsize) {
+        return MP_BAD_SIZE;
+    }
+    transformPoint(ctx, &x0, &y0);
+    transformPoint(ctx, &x1, &y1);
+    const unsigned char* z = data + META_CELLS_SIZE;
+    if (kind == META_DRAW_CELLS8) {
+        return dev->drawCells8(dev, z, n1, n2, n1, x0, y0, x1, y1);
+    }
+    if (kind == META_DRAW_CELLS16 && isLittleEndian()) {
+        /* Records are aligned on 8 bytes in the file. */
+        return dev->drawCells16(dev, (const uint16_t*)z, n1, n2, n1,
+                                x0, y0, x1, y1);
+    }
+    size_t elsize = (kind == META_DRAW_CELLS ? sizeof(MpColorIndex) :
+                     sizeof(uint16_t));
+    MpStatus status = MpReserveWorkspace(dev, n*elsize);
+    if (status != MP_OK) {
+        return status;
+    }
+    if (kind == META_DRAW_CELLS) {
+        MpColorIndex* cells = (MpColorIndex*)dev->workspace;
+        for (size_t i = 0; i < n; ++i) {
+            cells[i] = (int32_t)get32(z + 4*i);
+        }
+        return dev->drawCells(dev, cells, n1, n2, n1, x0, y0, x1, y1);
+    }
+    uint16_t* cells = (uint16_t*)dev->workspace;
+    for (size_t i = 0; i < n; ++i) {
+        cells[i] = get16(z + 2*i);
+    }
+    return dev->drawCells16(dev, cells, n1, n2, n1, x0, y0, x1, y1);
+}
+
+static MpStatus
+replayRecord(const MetaReplay* ctx, MetaRecordKind kind,
+             const unsigned char* data, size_t size)
+{
+    MpDevice* dev = ctx->dev;
+    switch (kind) {
+    case META_START_BUFFERING:
+        return MpStartBuffering(dev);
+    case META_STOP_BUFFERING:
+        return MpStopBuffering(dev);
+    case META_BEGIN_PAGE:
+        return MpBeginPage(dev);
+    case META_END_PAGE:
+        return MpEndPage(dev);
+    case META_SET_COLOR_INDEX:
+    case META_SET_LINE_STYLE:
+        if (size < 4) {
+            return MP_BAD_SIZE;
+        }
+        return (kind == META_SET_COLOR_INDEX ?
+                MpSetColorIndex(dev, (int32_t)get32(data)) :
+                MpSetLineStyle(dev, (MpLineStyle)(int32_t)get32(data)));
+    case META_SET_COLOR:
+        if (size < 16) {
+            return MP_BAD_SIZE;
+        }
+        return MpSetColor(dev, (int32_t)get32(data), getFlt(data + 4),
+                          getFlt(data + 8), getFlt(data + 12));
+    case META_SET_LINE_WIDTH:
+        if (size < 4) {
+            return MP_BAD_SIZE;
+        }
+        return MpSetLineWidth(dev, getFlt(data));
+    case META_DRAW_POINT: {
+        if (size < 4) {
+            return MP_BAD_SIZE;
+        }
+        MpPoint x = (int16_t)get16(data), y = (int16_t)get16(data + 2);
+        transformPoint(ctx, &x, &y);
+        return dev->drawPoint(dev, x, y);
+    }
+    case META_DRAW_RECTANGLE: {
+        if (size < 8) {
+            return MP_BAD_SIZE;
+        }
+        MpPoint x0 = (int16_t)get16(data),     y0 = (int16_t)get16(data + 2);
+        MpPoint x1 = (int16_t)get16(data + 4), y1 = (int16_t)get16(data + 6);
+        transformPoint(ctx, &x0, &y0);
+        transformPoint(ctx, &x1, &y1);
+        return dev->drawRectangle(dev, x0, y0, x1, y1);
+    }
+    case META_DRAW_POINTS:
+    case META_DRAW_POLYLINE:
+    case META_DRAW_POLYGON: {
+        MpInt n;
+        MpStatus status = decodePoints(ctx, data, size, &n);
+        if (status != MP_OK) {
+            return status;
+        }
+        return (kind == META_DRAW_POINTS ?
+                dev->drawPoints(dev, dev->xscratch, dev->yscratch, n) :
+                kind == META_DRAW_POLYLINE ?
+                dev->drawPolyline(dev, dev->xscratch, dev->yscratch, n) :
+                dev->drawPolygon(dev, dev->xscratch, dev->yscratch, n));
+    }
+    case META_DRAW_CELLS:
+    case META_DRAW_CELLS8:
+    case META_DRAW_CELLS16:
+        return replayCells(ctx, kind, data, size);
+    }
+    return MP_BAD_ARGUMENT;
+}
+
+/* Replay the records in the range `[begin,end)` of the file with the given
+   initial settings. */
+static MpStatus
+replay(const MpMetafile* mf, MpDevice* dev, uint64_t begin, uint64_t end,
+       MpColorIndex ci, MpLineStyle ls, MpReal lw)
+{
+    /* The device coordinates of the metafile are converted to NDC and then
+       to the device coordinates of the target. */
+    MetaReplay ctx;
+    MpCoordinateTransform R;
+    ctx.dev = dev;
+    MpStatus status = MpInverseAffineTransformDbl(&R, &mf->ndcToDevice);
+    if (status == MP_OK) {
+        status = MpComposeAffineTransformsDbl(&ctx.T, &dev->ndcToDevice, &R);
+    }
+    if (status != MP_OK) {
+        return status;
+    }
+    const MpCoordinateTransform* B = &mf->ndcToDevice;
+    ctx.identity = (B->xx == dev->ndcToDevice.xx &&
+                    B->xy == dev->ndcToDevice.xy &&
+                    B->x  == dev->ndcToDevice.x  &&
+                    B->yx == dev->ndcToDevice.yx &&
+                    B->yy == dev->ndcToDevice.yy &&
+                    B->y  == dev->ndcToDevice.y);
+
+    status = MpSetColorIndex(dev, ci);
+    if (status == MP_OK) {
+        status = MpSetLineStyle(dev, ls);
+    }
+    if (status == MP_OK) {
+        status = MpSetLineWidth(dev, lw);
+    }
+    for (uint64_t offset = begin; offset < end && status == MP_OK; ) {
+        if (end - offset < META_RECORD_SIZE) {
+            return MP_BAD_SIZE;
+        }
+        const unsigned char* rec = mf->data + offset;
+        MetaRecordKind kind = (MetaRecordKind)get16(rec);
+        size_t size = get32(rec + 4);
+        if (META_ALIGN(size) > end - offset - META_RECORD_SIZE) {
+            return MP_BAD_SIZE;
+        }
+        offset += META_RECORD_SIZE + META_ALIGN(size);
+        if (kind >= META_DRAW_POINT) {
+            status = MpApplySettings(dev);
+            if (status != MP_OK) {
+                break;
+            }
+        }
+        status = replayRecord(&ctx, kind, rec + META_RECORD_SIZE, size);
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/* PUBLIC FUNCTIONS */
+
+MpStatus
+MpOpenMetafileDevice(MpDevice** devptr, const char* ident, const char* arg)
+{
+    /* Note: Arguments have been checked but `arg` may be `NULL` or an empty
+       string.  The syntax of `arg` is `[WIDTHxHEIGHT:]FILENAME`. */
+    long width = META_DEFAULT_WIDTH, height = META_DEFAULT_HEIGHT;
+    const char* name = arg;
+    if (arg != NULL) {
+        int len = 0;
+        if (sscanf(arg, "%ldx%ld%n", &width, &height, &len) == 2 &&
+            arg[len] == ':') {
+            if (width < 1 || width > 32767 || height < 1 || height > 32767) {
+                return MP_BAD_SIZE;
+            }
+            name = arg + len + 1;
+        } else {
+            width = META_DEFAULT_WIDTH;
+            height = META_DEFAULT_HEIGHT;
+        }
+    }
+    if (name == NULL || name[0] == '\0') {
+        return MP_BAD_FILENAME;
+    }
+
+    /* Allocate structure and instanciate methods. */
+    MpDevice* dev = MpAllocateDevice(sizeof(MetaDevice));
+    *devptr = dev;
+    if (dev == NULL) {
+        return MP_NO_MEMORY;
+    }
+    dev->initialize = initializeMetaDevice;
+    dev->finalize = finalizeMetaDevice;
+    dev->startBuffering = startMetaBuffering;
+    dev->stopBuffering = stopMetaBuffering;
+    dev->flush = flushMetaDevice;
+    dev->beginPage = beginMetaPage;
+    dev->endPage = endMetaPage;
+    dev->setColorIndex = setMetaColorIndex;
+    dev->setColor = setMetaColor;
+    dev->setLineStyle = setMetaLineStyle;
+    dev->setLineWidth = setMetaLineWidth;
+    dev->drawPoint = drawMetaPoint;
+    dev->drawPoints = drawMetaPoints;
+    dev->drawRectangle = drawMetaRectangle;
+    dev->drawPolyline = drawMetaPolyline;
+    dev->drawPolygon = drawMetaPolygon;
+    dev->drawCells = drawMetaCells;
+    dev->drawCells8 = drawMetaCells8;
+    dev->drawCells16 = drawMetaCells16;
+
+    /* Open output file, the records are flushed at the end of each page. */
+    MetaDevice* m = (MetaDevice*)dev;
+    m->file = fopen(name, "wb");
+    if (m->file == NULL) {
+        MpStatus status = MpSystemError();
+        free((void*)dev);
+        *devptr = NULL;
+        return status;
+    }
+    MpStatus status = MpInitializeWriter(&m->out, m->file, 0);
+    m->out.device = dev;
+    if (status != MP_OK) {
+        fclose(m->file);
+        free((void*)dev);
+        *devptr = NULL;
+        return status;
+    }
+    m->out.buffering = true;
+
+    dev->horizontalResolution = META_RESOLUTION;
+    dev->verticalResolution = META_RESOLUTION;
+    dev->horizontalSamples = width;
+    dev->verticalSamples = height;
+    dev->colormapSize1 = META_COLORMAP_SIZE_1;
+    dev->colormapSize2 = META_COLORMAP_SIZE_2;
+    dev->colorIndex = MP_COLOR_FOREGROUND;
+    return MP_OK;
+}
+
+MpStatus
+MpOpenMetafile(MpMetafile** mfptr, const char* filename)
+{
+    if (mfptr == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *mfptr = NULL;
+    if (filename == NULL || filename[0] == '\0') {
+        return MP_BAD_FILENAME;
+    }
+    MpMetafile* mf = (MpMetafile*)calloc(1, sizeof(MpMetafile));
+    if (mf == NULL) {
+        return MP_NO_MEMORY;
+    }
+
+    /* Map the file in memory, the mapping remains valid after closing the
+       file descriptor. */
+    MpStatus status = MP_OK;
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        status = MpSystemError();
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            status = MpSystemError();
+        } else if (st.st_size < META_HEADER_SIZE + META_TRAILER_SIZE) {
+            status = MP_BAD_SIZE;
+        } else {
+            void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                status = MpSystemError();
+            } else {
+                mf->data = (const unsigned char*)addr;
+                mf->size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    /* Check the header and the trailer. */
+    if (status == MP_OK) {
+        const unsigned char* hdr = mf->data;
+        const unsigned char* trl = mf->data + mf->size - META_TRAILER_SIZE;
+        uint64_t nbytes = mf->size - META_TRAILER_SIZE;
+        if (memcmp(hdr, META_MAGIC, 8) != 0 ||
+            get32(hdr + 8) != META_VERSION ||
+            get32(hdr + 12) != META_HEADER_SIZE ||
+            memcmp(trl + 16, META_INDEX_MAGIC, 8) != 0) {
+            status = MP_BAD_ARGUMENT;
+        } else {
+            mf->recordsEnd = get64(trl);
+            mf->npages = get32(trl + 8);
+            if (mf->recordsEnd < META_HEADER_SIZE ||
+                mf->recordsEnd > nbytes ||
+                (nbytes - mf->recordsEnd)/META_ENTRY_SIZE != mf->npages ||
+                (nbytes - mf->recordsEnd)%META_ENTRY_SIZE != 0) {
+                status = MP_BAD_SIZE;
+            }
+        }
+    }
+    if (status == MP_OK) {
+        const unsigned char* hdr = mf->data;
+        mf->index = mf->data + mf->recordsEnd;
+        mf->colorIndex = (int32_t)get32(hdr + 32);
+        mf->lineStyle = (MpLineStyle)(int32_t)get32(hdr + 36);
+        mf->lineWidth = getFlt(hdr + 40);
+        mf->ndcToDevice.xx = getDbl(hdr + 64);
+        mf->ndcToDevice.xy = getDbl(hdr + 72);
+        mf->ndcToDevice.x  = getDbl(hdr + 80);
+        mf->ndcToDevice.yx = getDbl(hdr + 88);
+        mf->ndcToDevice.yy = getDbl(hdr + 96);
+        mf->ndcToDevice.y  = getDbl(hdr + 104);
+        *mfptr = mf;
+        return MP_OK;
+    }
+    MpCloseMetafile(&mf);
+    return status;
+}
+
+MpStatus
+MpCloseMetafile(MpMetafile** mfptr)
+{
+    if (mfptr == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MpMetafile* mf = *mfptr;
+    MpStatus status = MP_OK;
+    if (mf != NULL) {
+        if (mf->data != NULL && munmap((void*)mf->data, mf->size) != 0) {
+            status = MpSystemError();
+        }
+        free((void*)mf);
+        *mfptr = NULL;
+    }
+    return status;
+}
+
+MpStatus
+MpGetMetafilePages(const MpMetafile* mf, MpInt* npages)
+{
+    if (mf == NULL || npages == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *npages = mf->npages;
+    return MP_OK;
+}
+
+MpStatus
+MpReplayMetafile(const MpMetafile* mf, MpDevice* dev)
+{
+    if (mf == NULL || dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    return replay(mf, dev, META_HEADER_SIZE, mf->recordsEnd,
+                  mf->colorIndex, mf->lineStyle, mf->lineWidth);
+}
+
+MpStatus
+MpReplayMetafilePage(const MpMetafile* mf, MpInt page, MpDevice* dev)
+{
+    if (mf == NULL || dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (page < 1 || page > mf->npages) {
+        return MP_OUT_OF_RANGE;
+    }
+    const unsigned char* entry = mf->index + (page - 1)*META_ENTRY_SIZE;
+    uint64_t begin = get64(entry), end = get64(entry + 8);
+    if (get32(entry + 16) != (uint32_t)page || begin < META_HEADER_SIZE ||
+        begin > end || end > mf->recordsEnd) {
+        return MP_BAD_SIZE;
+    }
+    return replay(mf, dev, begin, end, (int32_t)get32(entry + 20),
+                  (MpLineStyle)(int32_t)get32(entry + 24),
+                  getFlt(entry + 28));
+}
@@ -0,0 +1,895 @@
+/*
+ * muPDFDriver.c --
+ *
+ * Implementation of the PDF driver for µPlot.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <zlib.h>
+#include "muPlotPriv.h"
+
+#define MILLIMETERS_PER_INCH 25.4
+#define POINTS_PER_INCH      72
+#define MP_A4_PAPER_WIDTH     210
+#define MP_A4_PAPER_HEIGHT    297
+
+/* Number of device samples per millimeter. */
+#define PDF_SAMPLES_PER_MILLIMETER 10
+
+#define PDF_COLORMAP_SIZE_1  16
+#define PDF_COLORMAP_SIZE_2 240
+
+/* Value of the colors set in the content stream which is no color. */
+#define PDF_NO_COLOR 0xffffffff
+
+/*
+ * Object numbers of the document catalog, of the root of the page tree and
+ * of the resources shared by all pages.  These objects are written with the
+ * cross-reference table when the document is finished; the objects of the
+ * pages and of the images are written as they are completed.
+ */
+#define PDF_CATALOG_OBJECT   1
+#define PDF_PAGES_OBJECT     2
+#define PDF_RESOURCES_OBJECT 3
+
+/*
+ * Graphics state of the lines.  All the pages share the same graphics state
+ * objects, one for each combination of line style and width that is used.
+ */
+typedef struct _PdfLineState PdfLineState;
+struct _PdfLineState {
+    MpLineStyle   style;
+    MpInt     thickness; /* Line width in samples */
+    MpInt        object; /* Object number */
+};
+
+typedef struct _PdfDevice PdfDevice;
+
+struct _PdfDevice {
+    MpDevice pub;
+
+    FILE*                 file; /* Output file */
+    MpWriter               out; /* Buffered output to `file` */
+    MpWriter           content; /* Content stream of the current page, in
+                                   memory until the page ends */
+    size_t*            offsets; /* Offsets of the objects in the file */
+    MpInt      numberOfObjects; /* Number of objects so far */
+    MpInt          offsetsSize; /* Number of allocated offsets */
+    MpInt*               pages; /* Object numbers of the pages */
+    MpInt        numberOfPages; /* Number of pages written so far */
+    MpInt            pagesSize; /* Number of allocated pages */
+    MpInt*              images; /* Object numbers of the images */
+    MpInt       numberOfImages; /* Number of images written so far */
+    MpInt           imagesSize; /* Number of allocated images */
+    PdfLineState*       states; /* Graphics states of the lines */
+    MpInt       numberOfStates; /* Number of graphics states */
+    MpInt           statesSize; /* Number of allocated graphics states */
+    uint32_t       strokeColor; /* Stroking color of the content stream */
+    uint32_t         fillColor; /* Filling color of the content stream */
+    MpInt            lineState; /* Index of the graphics state of the content
+                                   stream, -1 if none */
+    MpStroker          stroker; /* To compute the dash patterns */
+};
+
+static unsigned
+colorant(MpReal val)
+{
+    return (val <= (MpReal)0 ? (unsigned)0 :
+            (val >= (MpReal)1 ? (unsigned)255 :
+             (MP_IS_SINGLE_PRECISION(val) ?
+              (unsigned)roundf((float)val*(float)255) :
+              (unsigned)round((double)val*(double)255))));
+}
+
+/* Encode a color as `0xRRGGBB`. */
+static uint32_t
+encodePdfColor(const MpColor* c)
+{
+    return ((colorant(c->red) << 16) | (colorant(c->green) << 8) |
+            colorant(c->blue));
+}
+
+/*
+ * Make room for `n` elements of `elsize` bytes in the array at `*ptr` with
+ * `*size` allocated elements.
+ */
+static MpStatus
+growArray(void** ptr, MpInt* size, MpInt n, size_t elsize)
+{
+    if (n <= *size) {
+        return MP_OK;
+    }
+    MpInt newSize = (*size < 16 ? 16 : 2*(*size));
+    if (newSize < n) {
+        newSize = n;
+    }
+    void* newPtr = realloc(*ptr, newSize*elsize);
+    if (newPtr == NULL) {
+        return MP_NO_MEMORY;
+    }
+    *ptr = newPtr;
+    *size = newSize;
+    return MP_OK;
+}
+
+/* Offset in the file of the next byte to write. */
+#define POSITION(pdf) ((pdf)->out.written + (pdf)->out.count)
+
+/* Allocate the number of a new object, 0 on error. */
+static MpInt
+newObject(PdfDevice* pdf)
+{
+    if (growArray((void**)&pdf->offsets, &pdf->offsetsSize,
+                  pdf->numberOfObjects + 2, sizeof(size_t)) != MP_OK) {
+        return 0;
+    }
+    MpInt num = ++pdf->numberOfObjects;
+    pdf->offsets[num] = 0;
+    return num;
+}
+
+/* Write the beginning of object `num` and record its offset. */
+static MpStatus
+beginObject(PdfDevice* pdf, MpInt num)
+{
+    pdf->offsets[num] = POSITION(pdf);
+    return MpWriteFormatted(&pdf->out, "%ld 0 obj\n", (long)num);
+}
+
+/*
+ * Write the beginning of the stream object `num` with the entries `dict` of
+ * its dictionary.  The length of the stream is the object `num + 1` which is
+ * written by endStream().
+ */
+static MpStatus
+beginStream(PdfDevice* pdf, MpInt num, const char* dict)
+{
+    beginObject(pdf, num);
+    return MpWriteFormatted(&pdf->out,
+                            "<<%s/Length %ld 0 R/Filter/FlateDecode>>\n"
+                            "stream\n", dict, (long)(num + 1));
+}
+
+static MpStatus
+endStream(PdfDevice* pdf, MpInt num, size_t start)
+{
+    size_t length = POSITION(pdf) - start;
+    MpWriteString(&pdf->out, "\nendstream\nendobj\n");
+    beginObject(pdf, num + 1);
+    return MpWriteFormatted(&pdf->out, "%lu\nendobj\n",
+                            (unsigned long)length);
+}
+
+/*
+ * Compress `n` bytes at `data` and write the result to the output file.
+ * Argument `flush` is `Z_NO_FLUSH` if more data follow, `Z_FINISH`
+ * otherwise.
+ */
+static MpStatus
+deflateBytes(z_stream* z, MpWriter* out, const void* data, size_t n,
+             int flush)
+{
+    unsigned char chunk[1 << 14];
+    z->next_in = (Bytef*)data;
+    z->avail_in = n;
+    while (out->status == MP_OK) {
+        z->next_out = chunk;
+        z->avail_out = sizeof(chunk);
+        int code = deflate(z, flush);
+        if (code == Z_STREAM_ERROR) {
+            return MP_ASSERTION_FAILED;
+        }
+        MpWriteBytes(out, chunk, sizeof(chunk) - z->avail_out);
+        if (code == Z_STREAM_END ||
+            (flush == Z_NO_FLUSH && z->avail_in == 0 && z->avail_out > 0)) {
+            break;
+        }
+    }
+    return out->status;
+}
+
+/* Reset the settings of the content stream for a new page. */
+static void
+resetContent(PdfDevice* pdf)
+{
+    pdf->content.count = 0;
+    pdf->strokeColor = PDF_NO_COLOR;
+    pdf->fillColor = PDF_NO_COLOR;
+    pdf->lineState = -1;
+}
+
+/*
+ * Write the current page: its compressed content stream, preceded by the
+ * transform from device samples to PDF units, and the page object.  The
+ * output is flushed unless buffering.
+ */
+static MpStatus
+writePdfPage(PdfDevice* pdf)
+{
+    MpDevice* dev = &pdf->pub;
+    MpInt num = newObject(pdf);
+    MpInt len = newObject(pdf);
+    MpInt page = newObject(pdf);
+    if (num == 0 || len == 0 || page == 0 ||
+        growArray((void**)&pdf->pages, &pdf->pagesSize,
+                  pdf->numberOfPages + 1, sizeof(MpInt)) != MP_OK) {
+        return MP_NO_MEMORY;
+    }
+    MpStatus status = pdf->content.status;
+    if (status != MP_OK) {
+        return status;
+    }
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit(&z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return MP_NO_MEMORY;
+    }
+    char prefix[64];
+    int n = snprintf(prefix, sizeof(prefix), "%.6g 0 0 %.6g 0 0 cm\n",
+                     POINTS_PER_INCH/(MILLIMETERS_PER_INCH*
+                                      dev->horizontalResolution),
+                     POINTS_PER_INCH/(MILLIMETERS_PER_INCH*
+                                      dev->verticalResolution));
+    beginStream(pdf, num, "");
+    size_t start = POSITION(pdf);
+    status = deflateBytes(&z, &pdf->out, prefix, n, Z_NO_FLUSH);
+    if (status == MP_OK) {
+        status = deflateBytes(&z, &pdf->out, pdf->content.buffer,
+                              pdf->content.count, Z_FINISH);
+    }
+    deflateEnd(&z);
+    if (status != MP_OK) {
+        return status;
+    }
+    endStream(pdf, num, start);
+    beginObject(pdf, page);
+    double scale = POINTS_PER_INCH/MILLIMETERS_PER_INCH;
+    MpWriteFormatted(&pdf->out, "<</Type/Page/Parent %d 0 R/Resources %d 0 R"
+                     "/MediaBox[0 0 %.2f %.2f]/Contents %ld 0 R>>\nendobj\n",
+                     PDF_PAGES_OBJECT, PDF_RESOURCES_OBJECT,
+                     scale*dev->pageWidth, scale*dev->pageHeight, (long)num);
+    pdf->pages[pdf->numberOfPages++] = page;
+    resetContent(pdf);
+    return MpSyncWriter(&pdf->out);
+}
+
+/*
+ * Finish the document: write the pending page if any (or an empty page if
+ * there are no pages), the shared objects, the cross-reference table and the
+ * trailer.
+ */
+static MpStatus
+writePdfTrailer(PdfDevice* pdf)
+{
+    MpStatus status = MP_OK;
+    if (pdf->content.count > 0 || pdf->numberOfPages == 0) {
+        status = writePdfPage(pdf);
+        if (status != MP_OK) {
+            return status;
+        }
+    }
+    MpWriter* out = &pdf->out;
+
+    /* Graphics states of the lines. */
+    for (MpInt k = 0; k < pdf->numberOfStates; ++k) {
+        const PdfLineState* s = &pdf->states[k];
+        MpSetStrokerStyle(&pdf->stroker, s->style, s->thickness);
+        beginObject(pdf, s->object);
+        MpWriteFormatted(out, "<</Type/ExtGState/LW %ld/LC 2/D[[",
+                         (long)pdf->stroker.thickness);
+        for (MpInt i = 0; i < pdf->stroker.count; ++i) {
+            MpWriteFormatted(out, (i > 0 ? " %g" : "%g"),
+                             pdf->stroker.dashes[i]/256.0);
+        }
+        MpWriteString(out, "]0]>>\nendobj\n");
+    }
+
+    /* Resources shared by all pages. */
+    beginObject(pdf, PDF_RESOURCES_OBJECT);
+    MpWriteString(out, "<</ProcSet[/PDF/ImageC]");
+    if (pdf->numberOfStates > 0) {
+        MpWriteString(out, "/ExtGState<<");
+        for (MpInt k = 0; k < pdf->numberOfStates; ++k) {
+            MpWriteFormatted(out, "/G%ld %ld 0 R", (long)k,
+                             (long)pdf->states[k].object);
+        }
+        MpWriteString(out, ">>");
+    }
+    if (pdf->numberOfImages > 0) {
+        MpWriteString(out, "/XObject<<");
+        for (MpInt k = 0; k < pdf->numberOfImages; ++k) {
+            MpWriteFormatted(out, "/I%ld %ld 0 R", (long)k,
+                             (long)pdf->images[k]);
+        }
+        MpWriteString(out, ">>");
+    }
+    MpWriteString(out, ">>\nendobj\n");
+
+    /* Page tree and catalog. */
+    beginObject(pdf, PDF_PAGES_OBJECT);
+    MpWriteString(out, "<</Type/Pages/Kids[");
+    for (MpInt k = 0; k < pdf->numberOfPages; ++k) {
+        MpWriteFormatted(out, (k > 0 ? " %ld 0 R" : "%ld 0 R"),
+                         (long)pdf->pages[k]);
+    }
+    MpWriteFormatted(out, "]/Count %ld>>\nendobj\n",
+                     (long)pdf->numberOfPages);
+    beginObject(pdf, PDF_CATALOG_OBJECT);
+    MpWriteFormatted(out, "<</Type/Catalog/Pages %d 0 R>>\nendobj\n",
+                     PDF_PAGES_OBJECT);
+
+    /* Cross-reference table, each entry has exactly 20 bytes. */
+    size_t xref = POSITION(pdf);
+    MpWriteFormatted(out, "xref\n0 %ld\n0000000000 65535 f \n",
+                     (long)(pdf->numberOfObjects + 1));
+    for (MpInt num = 1; num <= pdf->numberOfObjects; ++num) {
+        MpWriteFormatted(out, "%010lu 00000 n \n",
+                         (unsigned long)pdf->offsets[num]);
+    }
+    MpWriteFormatted(out, "trailer\n<</Size %ld/Root %d 0 R>>\n"
+                     "startxref\n%lu\n%%%%EOF\n",
+                     (long)(pdf->numberOfObjects + 1), PDF_CATALOG_OBJECT,
+                     (unsigned long)xref);
+    return MpFlushWriter(out);
+}
+
+/*
+ * Start a new document for the current output file.  The first objects are
+ * reserved for the catalog, the page tree and the shared resources.
+ */
+static MpStatus
+startPdfDocument(PdfDevice* pdf)
+{
+    pdf->numberOfObjects = 0;
+    pdf->numberOfPages = 0;
+    pdf->numberOfImages = 0;
+    pdf->numberOfStates = 0;
+    resetContent(pdf);
+    if (newObject(pdf) != PDF_CATALOG_OBJECT ||
+        newObject(pdf) != PDF_PAGES_OBJECT ||
+        newObject(pdf) != PDF_RESOURCES_OBJECT) {
+        return MP_NO_MEMORY;
+    }
+    return MpWriteString(&pdf->out, "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+}
+
+static MpStatus
+initializePdfDevice(MpDevice* dev)
+{
+    /* PDF coordinate system has its origin at the lower left corner. */
+    MpCoordinateTransform B = {dev->horizontalSamples - 1, 0, 0,
+                               0, dev->verticalSamples - 1, 0};
+    MpStatus status = MpSetNDCToDeviceTransform(dev, &B);
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Graphics are drawn on white paper. */
+    status = MpDefineStandardColors(dev, false);
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Initialize CMAP2 with a ramp of grays. */
+    if (dev->colormapSize2 > 1) {
+        MpReal a = (MpReal)1/(MpReal)(dev->colormapSize2 - 1);
+        for (MpInt i = 0; i < dev->colormapSize2; ++i) {
+            MpReal g = a*i;
+            MpEncodeColor(&dev->colormap[dev->colormapSize1 + i], g,g,g);
+        }
+    }
+
+    /* Redundant vertices are not worth writing. */
+    dev->simplify = true;
+
+    /* The colors of the content streams and of the images are written from
+       the encoded colors. */
+    return MpSetColorEncoder(dev, encodePdfColor);
+}
+
+/*
+ * Close the current output file after finishing its document.
+ */
+static MpStatus
+closePdfFile(PdfDevice* pdf)
+{
+    MpStatus status = writePdfTrailer(pdf);
+    MpStatus code = MpResetWriter(&pdf->out, NULL);
+    if (status == MP_OK) {
+        status = code;
+    }
+    if (pdf->file != NULL) {
+        if (fclose(pdf->file) != 0 && status == MP_OK) {
+            status = MpSystemError();
+        }
+        pdf->file = NULL;
+    }
+    return status;
+}
+
+static MpStatus
+finalizePdfDevice(MpDevice* dev)
+{
+    PdfDevice* pdf = (PdfDevice*)dev;
+    MpStatus status = closePdfFile(pdf);
+    MpFinalizeWriter(&pdf->content);
+    MpFinalizeWriter(&pdf->out);
+    free((void*)pdf->offsets);
+    free((void*)pdf->pages);
+    free((void*)pdf->images);
+    free((void*)pdf->states);
+    pdf->offsets = NULL;
+    pdf->pages = NULL;
+    pdf->images = NULL;
+    pdf->states = NULL;
+    return status;
+}
+
+/*
+ * Write the decimal representation of a colorant (with at most 3 digits
+ * after the decimal point as PDF color levels are in the range [0,1]) at
+ * `dst` and return the address after the last written character.
+ */
+static char*
+formatLevel(char* dst, unsigned c)
+{
+    unsigned m = (c*1000 + 127)/255;
+    if (m == 0 || m >= 1000) {
+        *dst++ = (m == 0 ? '0' : '1');
+        return dst;
+    }
+    *dst++ = '.';
+    for (unsigned d = 100; m > 0; d /= 10) {
+        *dst++ = (char)('0' + m/d);
+        m %= d;
+    }
+    return dst;
+}
+
+/* Emit the color operator `op` in the content stream for `color`. */
+static void
+setContentColor(PdfDevice* pdf, uint32_t color, const char* op)
+{
+    char* p = MpReserveWriter(&pdf->content, 3*5 + 4);
+    if (p != NULL) {
+        p = formatLevel(p, (color >> 16) & 0xff);
+        *p++ = ' ';
+        p = formatLevel(p, (color >> 8) & 0xff);
+        *p++ = ' ';
+        p = formatLevel(p, color & 0xff);
+        *p++ = ' ';
+        *p++ = op[0];
+        *p++ = op[1];
+        *p++ = '\n';
+        pdf->content.count = p - pdf->content.buffer;
+    }
+}
+
+/* Current color of the device. */
+#define CURRENT_COLOR(pdf) \
+    ((pdf)->pub.encodedColors[(pdf)->pub.colorIndex])
+
+/* Make sure the content stream fills with the current color. */
+static void
+prepareFill(PdfDevice* pdf)
+{
+    uint32_t color = CURRENT_COLOR(pdf);
+    if (color != pdf->fillColor) {
+        setContentColor(pdf, color, "rg");
+        pdf->fillColor = color;
+    }
+}
+
+/*
+ * Make sure the content stream strokes with the current color, line style
+ * and line width.
+ */
+static MpStatus
+prepareStroke(PdfDevice* pdf)
+{
+    uint32_t color = CURRENT_COLOR(pdf);
+    if (color != pdf->strokeColor) {
+        setContentColor(pdf, color, "RG");
+        pdf->strokeColor = color;
+    }
+    MpDevice* dev = &pdf->pub;
+    MpStatus status = MpSetStrokerStyle(&pdf->stroker, dev->lineStyle,
+                                        dev->lineWidth);
+    if (status != MP_OK) {
+        return status;
+    }
+    MpInt t = pdf->stroker.thickness, k = pdf->lineState;
+    if (k >= 0 && pdf->states[k].style == dev->lineStyle &&
+        pdf->states[k].thickness == t) {
+        return MP_OK;
+    }
+    for (k = 0; k < pdf->numberOfStates; ++k) {
+        if (pdf->states[k].style == dev->lineStyle &&
+            pdf->states[k].thickness == t) {
+            break;
+        }
+    }
+    if (k == pdf->numberOfStates) {
+        if (growArray((void**)&pdf->states, &pdf->statesSize, k + 1,
+                      sizeof(PdfLineState)) != MP_OK) {
+            return MP_NO_MEMORY;
+        }
+        MpInt num = newObject(pdf);
+        if (num == 0) {
+            return MP_NO_MEMORY;
+        }
+        pdf->states[k].style = dev->lineStyle;
+        pdf->states[k].thickness = t;
+        pdf->states[k].object = num;
+        ++pdf->numberOfStates;
+    }
+    pdf->lineState = k;
+    return MpWriteFormatted(&pdf->content, "/G%ld gs\n", (long)k);
+}
+
+/*
+ * Write the path of `n` vertices followed by the painting operator `op` in
+ * the content stream.
+ */
+static MpStatus
+writePath(PdfDevice* pdf, const MpPoint* x, const MpPoint* y, MpInt n,
+          const char* op)
+{
+    MpWriter* out = &pdf->content;
+    for (MpInt i = 0; i < n; ++i) {
+        /* 2×6 characters for the coordinates, a space, the operator and a
+           newline. */
+        char* p = MpReserveWriter(out, 2*6 + 4);
+        if (p == NULL) {
+            break;
+        }
+        p = MpFormatInteger(p, x[i]);
+        *p++ = ' ';
+        p = MpFormatInteger(p, y[i]);
+        *p++ = ' ';
+        *p++ = (i == 0 ? 'm' : 'l');
+        *p++ = '\n';
+        out->count = p - out->buffer;
+    }
+    return MpWriteString(out, op);
+}
+
+/* Write the rectangle of corners `(x0,y0)`, `(x1,y1)` in the content
+   stream. */
+static void
+writeRectangle(PdfDevice* pdf, MpInt x0, MpInt y0, MpInt x1, MpInt y1)
+{
+    MpWriter* out = &pdf->content;
+    char* p = MpReserveWriter(out, 4*7 + 4);
+    if (p != NULL) {
+        p = MpFormatInteger(p, x0);
+        *p++ = ' ';
+        p = MpFormatInteger(p, y0);
+        *p++ = ' ';
+        p = MpFormatInteger(p, x1 - x0);
+        *p++ = ' ';
+        p = MpFormatInteger(p, y1 - y0);
+        memcpy(p, " re\n", 4);
+        out->count = p + 4 - out->buffer;
+    }
+}
+
+static MpStatus
+drawPdfPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    if (n < 2) {
+        return MP_OK;
+    }
+    PdfDevice* pdf = (PdfDevice*)dev;
+    MpStatus status = prepareStroke(pdf);
+    if (status != MP_OK) {
+        return status;
+    }
+    return writePath(pdf, x, y, n, "S\n");
+}
+
+static MpStatus
+drawPdfPolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    if (n < 2) {
+        return MP_OK;
+    }
+    PdfDevice* pdf = (PdfDevice*)dev;
+    prepareFill(pdf);
+    return writePath(pdf, x, y, n, "f\n");
+}
+
+static MpStatus
+drawPdfRectangle(MpDevice* dev, MpPoint x0, MpPoint y0,
+                 MpPoint x1, MpPoint y1)
+{
+    PdfDevice* pdf = (PdfDevice*)dev;
+    prepareFill(pdf);
+    writeRectangle(pdf, x0, y0, x1, y1);
+    return MpWriteString(&pdf->content, "f\n");
+}
+
+/*
+ * A point is a square of one sample, all the points are filled by a single
+ * painting operator.
+ */
+static MpStatus
+drawPdfPoints(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    if (n < 1) {
+        return MP_OK;
+    }
+    PdfDevice* pdf = (PdfDevice*)dev;
+    prepareFill(pdf);
+    for (MpInt i = 0; i < n; ++i) {
+        writeRectangle(pdf, x[i], y[i], x[i] + 1, y[i] + 1);
+    }
+    return MpWriteString(&pdf->content, "f\n");
+}
+
+static MpStatus
+drawPdfPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    return drawPdfPoints(dev, &x, &y, 1);
+}
+
+/*
+ * Cells are drawn as an image object written at once in the output file and
+ * painted by the content stream.  Each cell is a pixel of the image.  The
+ * index of the cell at offset `k` is given by the macro `GET_INDEX`.
+ */
+#define GET_INDEX(z,nbytes,k)                                   \
+    ((nbytes) == 1 ? (MpColorIndex)((const uint8_t*)(z))[k] :   \
+     (nbytes) == 2 ? (MpColorIndex)((const uint16_t*)(z))[k] :  \
+     ((const MpColorIndex*)(z))[k])
+
+static MpStatus
+drawPdfCellsImage(PdfDevice* pdf, const void* z, int nbytes,
+                  MpInt n1, MpInt n2, MpInt stride,
+                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    if (n1 < 1 || n2 < 1 || x0 == x1 || y0 == y1) {
+        return MP_OK;
+    }
+
+    /* Check the cells before writing anything. */
+    MpColorIndex ncolors = pdf->pub.colormapSize;
+    for (MpInt i2 = 0; i2 < n2; ++i2) {
+        for (MpInt i1 = 0; i1 < n1; ++i1) {
+            MpColorIndex ci = GET_INDEX(z, nbytes, i1 + i2*stride);
+            if (ci < 0 || ci >= ncolors) {
+                return MP_OUT_OF_RANGE;
+            }
+        }
+    }
+    MpInt num = newObject(pdf);
+    if (num == 0 || newObject(pdf) == 0 ||
+        growArray((void**)&pdf->images, &pdf->imagesSize,
+                  pdf->numberOfImages + 1, sizeof(MpInt)) != MP_OK) {
+        return MP_NO_MEMORY;
+    }
+    unsigned char* row = (unsigned char*)malloc(3*n1);
+    if (row == NULL) {
+        return MP_NO_MEMORY;
+    }
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        free((void*)row);
+        return MP_NO_MEMORY;
+    }
+
+    /* Write the image, the first row of the image is the one at `y0`. */
+    char dict[128]; /* fixed text and two 20-digit longs */
+    snprintf(dict, sizeof(dict), "/Type/XObject/Subtype/Image/Width %ld"
+             "/Height %ld/ColorSpace/DeviceRGB/BitsPerComponent 8",
+             (long)n1, (long)n2);
+    beginStream(pdf, num, dict);
+    size_t start = POSITION(pdf);
+    MpStatus status = MP_OK;
+    const uint32_t* colors = pdf->pub.encodedColors;
+    for (MpInt i2 = 0; i2 < n2 && status == MP_OK; ++i2) {
+        for (MpInt i1 = 0; i1 < n1; ++i1) {
+            uint32_t color = colors[GET_INDEX(z, nbytes, i1 + i2*stride)];
+            row[3*i1]     = (unsigned char)(color >> 16);
+            row[3*i1 + 1] = (unsigned char)(color >> 8);
+            row[3*i1 + 2] = (unsigned char)color;
+        }
+        status = deflateBytes(&zs, &pdf->out, row, 3*n1,
+                              (i2 < n2 - 1 ? Z_NO_FLUSH : Z_FINISH));
+    }
+    deflateEnd(&zs);
+    free((void*)row);
+    if (status != MP_OK) {
+        /* The output file is no longer consistent. */
+        if (pdf->out.status == MP_OK) {
+            pdf->out.status = status;
+        }
+        return status;
+    }
+    endStream(pdf, num, start);
+    MpInt k = pdf->numberOfImages++;
+    pdf->images[k] = num;
+
+    /* Paint the image, the unit square of the image is mapped to the
+       rectangle of the cells. */
+    return MpWriteFormatted(&pdf->content, "q %d 0 0 %d %d %d cm /I%ld Do Q\n",
+                            (int)x1 - (int)x0, (int)y0 - (int)y1,
+                            (int)x0, (int)y1, (long)k);
+}
+
+static MpStatus
+drawPdfCells(MpDevice* dev,
+             const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
+             MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return drawPdfCellsImage((PdfDevice*)dev, z, sizeof(z[0]),
+                             n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawPdfCells8(MpDevice* dev,
+              const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+              MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return drawPdfCellsImage((PdfDevice*)dev, z, sizeof(z[0]),
+                             n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawPdfCells16(MpDevice* dev,
+               const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return drawPdfCellsImage((PdfDevice*)dev, z, sizeof(z[0]),
+                             n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+startPdfBuffering(MpDevice* dev)
+{
+    PdfDevice* pdf = (PdfDevice*)dev;
+    pdf->out.buffering = true;
+    return MP_OK;
+}
+
+static MpStatus
+stopPdfBuffering(MpDevice* dev)
+{
+    PdfDevice* pdf = (PdfDevice*)dev;
+    pdf->out.buffering = false;
+    return MpFlushWriter(&pdf->out);
+}
+
+static MpStatus
+beginPdfPage(MpDevice* dev)
+{
+    /* Graphics drawn before the page begins are discarded. */
+    resetContent((PdfDevice*)dev);
+    return MP_OK;
+}
+
+static MpStatus
+endPdfPage(MpDevice* dev)
+{
+    return writePdfPage((PdfDevice*)dev);
+}
+
+/*
+ * Set the initial settings of a new PDF device.
+ */
+static void
+setPdfDefaults(PdfDevice* pdf)
+{
+    MpDevice* dev = &pdf->pub;
+    dev->pageWidth = MP_A4_PAPER_WIDTH;
+    dev->pageHeight = MP_A4_PAPER_HEIGHT;
+    dev->horizontalResolution = PDF_SAMPLES_PER_MILLIMETER;
+    dev->verticalResolution = PDF_SAMPLES_PER_MILLIMETER;
+    dev->horizontalSamples = round(dev->pageWidth*dev->horizontalResolution);
+    dev->verticalSamples = round(dev->pageHeight*dev->verticalResolution);
+    dev->colormapSize1 = PDF_COLORMAP_SIZE_1;
+    dev->colormapSize2 = PDF_COLORMAP_SIZE_2;
+    dev->colorIndex = MP_COLOR_FOREGROUND;
+    dev->lineStyle = MP_SOLID_LINE;
+    dev->lineWidth = 1;
+}
+
+/*
+ * Finish the document in the current file and start a new document in the
+ * file `arg`, the buffers of the device are kept.
+ */
+static MpStatus
+reopenPdfDevice(MpDevice* dev, const char* arg, MpBool reset)
+{
+    if (arg == NULL || arg[0] == '\0') {
+        return MP_BAD_FILENAME;
+    }
+    PdfDevice* pdf = (PdfDevice*)dev;
+    MpStatus status = closePdfFile(pdf);
+    if (status != MP_OK) {
+        return status;
+    }
+    pdf->file = fopen(arg, "wb");
+    if (pdf->file == NULL) {
+        return MpSystemError();
+    }
+    MpResetWriter(&pdf->out, pdf->file);
+    status = MpResetWriter(&pdf->content, NULL);
+    if (status != MP_OK) {
+        return status;
+    }
+    if (reset) {
+        setPdfDefaults(pdf);
+    }
+    return startPdfDocument(pdf);
+}
+
+MpStatus
+MpOpenPDFDevice(MpDevice** devptr, const char* ident, const char* arg)
+{
+    /* Note: Arguments have been checked but `arg` may be `NULL` or an empty
+       string. */
+    if (arg == NULL || arg[0] == '\0') {
+        return MP_BAD_FILENAME;
+    }
+
+    /* Allocate structure and instanciate methods. */
+    MpDevice* dev = MpAllocateDevice(sizeof(PdfDevice));
+    *devptr = dev;
+    if (dev == NULL) {
+        return MP_NO_MEMORY;
+    }
+    dev->initialize = initializePdfDevice;
+    dev->finalize = finalizePdfDevice;
+    dev->reopen = reopenPdfDevice;
+    dev->startBuffering = startPdfBuffering;
+    dev->stopBuffering = stopPdfBuffering;
+    dev->beginPage = beginPdfPage;
+    dev->endPage = endPdfPage;
+    dev->drawPoint = drawPdfPoint;
+    dev->drawPoints = drawPdfPoints;
+    dev->drawRectangle = drawPdfRectangle;
+    dev->drawPolyline = drawPdfPolyline;
+    dev->drawPolygon = drawPdfPolygon;
+    dev->drawCells = drawPdfCells;
+    dev->drawCells8 = drawPdfCells8;
+    dev->drawCells16 = drawPdfCells16;
+
+    /* Open output file. */
+    PdfDevice* pdf = (PdfDevice*)dev;
+    pdf->file = fopen(arg, "wb");
+    if (pdf->file == NULL) {
+        free((void*)dev);
+        return MpSystemError();
+    }
+    MpStatus status = MpInitializeWriter(&pdf->out, pdf->file, 0);
+    pdf->out.device = dev;
+    if (status == MP_OK) {
+        status = MpInitializeWriter(&pdf->content, NULL, 4096);
+    }
+    if (status == MP_OK) {
+        status = startPdfDocument(pdf);
+    }
+    if (status != MP_OK) {
+        MpFinalizeWriter(&pdf->content);
+        MpFinalizeWriter(&pdf->out);
+        fclose(pdf->file);
+        free((void*)pdf->offsets);
+        free((void*)dev);
+        return status;
+    }
+
+    setPdfDefaults(pdf);
+    return MP_OK;
+}
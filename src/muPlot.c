@@ -16,15 +16,14 @@
 #include <stdlib.h>
 #include <math.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#ifdef MP_ENABLE_STATS
+#  include <time.h>
+#endif
 
 #include "muPlotPriv.h"
-
-typedef struct _MpDriver MpDriver;
-struct _MpDriver {
-    MpStatus (*open)(MpDevice** dev, const char* ident, const char* arg);
-    MpDriver* next;
-    const char ident[1]; /* Driver identifier. */
-};
+#include "muPlotXForms.h"
 
 MpStatus
 MpSystemError()
@@ -48,8 +47,149 @@ MpGetReason(MpStatus status)
     }
 }
 
-/* Chained list of installed drivers. */
-static MpDriver* firstDriver = NULL;
+/*
+ * The registry of installed drivers is an immutable snapshot published
+ * through an atomic pointer.  Lookups (MpOpenDevice() and MpListDrivers())
+ * take no lock: they just load the current snapshot.  Installing or
+ * uninstalling a driver, which is rare, builds a new snapshot under a mutex
+ * and publishes it.  Since a reader may still be using a previous snapshot,
+ * retired snapshots are chained to the current one and only freed by
+ * MpUninstallAllDrivers().  Drivers are hashed by their identifiers (FNV-1a)
+ * into a power of 2 number of buckets.
+ */
+typedef MpStatus MpOpenMethod(MpDevice** dev, const char* ident,
+                              const char* arg);
+
+typedef struct _MpDriver MpDriver;
+struct _MpDriver {
+    MpOpenMethod* open;
+    const char*  ident; /* Driver identifier (stored in the snapshot). */
+    MpInt         next; /* Next driver in the same bucket, -1 if none. */
+    uint32_t      hash; /* Hash code of the identifier. */
+};
+
+typedef struct _MpRegistry MpRegistry;
+struct _MpRegistry {
+    MpRegistry* retired; /* Previous snapshot. */
+    MpDriver*   drivers; /* Drivers, most recently installed first. */
+    MpInt*      buckets; /* Index of first driver in each bucket, -1 if
+                            none. */
+    MpInt         count; /* Number of drivers. */
+    MpInt          mask; /* Number of buckets minus one. */
+};
+
+static _Atomic(MpRegistry*) registry = NULL;
+static pthread_mutex_t registryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t
+hashIdentifier(const char* ident)
+{
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* s = (const unsigned char*)ident; *s; ++s) {
+        hash = (hash ^ *s)*16777619u;
+    }
+    return hash;
+}
+
+static MpInt
+findDriver(const MpRegistry* reg, const char* ident, uint32_t hash)
+{
+    if (reg != NULL) {
+        for (MpInt i = reg->buckets[hash & reg->mask]; i >= 0;
+             i = reg->drivers[i].next) {
+            const MpDriver* drv = &reg->drivers[i];
+            if (drv->hash == hash && strcmp(drv->ident, ident) == 0) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+/* Publish a new snapshot where the driver `ident` has method `open` or is
+   removed if `open` is `NULL`. */
+static MpStatus
+updateRegistry(const char* ident, MpOpenMethod* open)
+{
+    MpStatus status = MP_OK;
+    uint32_t hash = hashIdentifier(ident);
+    pthread_mutex_lock(&registryMutex);
+    MpRegistry* old = atomic_load_explicit(&registry, memory_order_relaxed);
+    MpInt found = findDriver(old, ident, hash);
+    if (found < 0 && open == NULL) {
+        status = MP_NOT_FOUND;
+        goto done;
+    }
+
+    /* Compute the size of the new snapshot. */
+    MpInt oldcnt = (old == NULL ? 0 : old->count);
+    MpInt cnt = 0;
+    size_t len = 0;
+    if (found < 0) {
+        cnt += 1;
+        len += strlen(ident) + 1;
+    }
+    for (MpInt i = 0; i < oldcnt; ++i) {
+        if (i != found || open != NULL) {
+            cnt += 1;
+            len += strlen(old->drivers[i].ident) + 1;
+        }
+    }
+    MpInt nbuckets = 8;
+    while (nbuckets < 2*cnt) {
+        nbuckets *= 2;
+    }
+    size_t siz = (sizeof(MpRegistry) + cnt*sizeof(MpDriver) +
+                  nbuckets*sizeof(MpInt) + len);
+    MpRegistry* reg = (MpRegistry*)malloc(siz);
+    if (reg == NULL) {
+        status = MP_NO_MEMORY;
+        goto done;
+    }
+    reg->retired = old;
+    reg->drivers = (MpDriver*)(reg + 1);
+    reg->buckets = (MpInt*)(reg->drivers + cnt);
+    reg->count = cnt;
+    reg->mask = nbuckets - 1;
+    for (MpInt j = 0; j < nbuckets; ++j) {
+        reg->buckets[j] = -1;
+    }
+
+    /* Fill the new snapshot, a new driver is inserted first. */
+    char* str = (char*)(reg->buckets + nbuckets);
+    MpInt j = 0;
+    for (MpInt i = (found < 0 ? -1 : 0); i < oldcnt; ++i) {
+        const char* src;
+        MpOpenMethod* method;
+        uint32_t code;
+        if (i < 0 || i == found) {
+            if (open == NULL) {
+                continue;
+            }
+            src = ident;
+            method = open;
+            code = hash;
+        } else {
+            src = old->drivers[i].ident;
+            method = old->drivers[i].open;
+            code = old->drivers[i].hash;
+        }
+        MpDriver* drv = &reg->drivers[j];
+        len = strlen(src);
+        memcpy(str, src, len + 1);
+        drv->open = method;
+        drv->ident = str;
+        drv->hash = code;
+        drv->next = reg->buckets[code & reg->mask];
+        reg->buckets[code & reg->mask] = j;
+        str += len + 1;
+        j += 1;
+    }
+    atomic_store_explicit(&registry, reg, memory_order_release);
+ done:
+    pthread_mutex_unlock(&registryMutex);
+    return status;
+}
 
 MpStatus
 MpInstallDriver(const char* ident,
@@ -65,27 +205,8 @@ MpInstallDriver(const char* ident,
         return MP_BAD_METHOD;
     }
 
-    /* Replace existing driver if found. */
-    for (MpDriver* drv = firstDriver; drv != NULL; drv = drv->next) {
-        if (strcmp(drv->ident, ident) == 0) {
-            drv->open = open;
-            return MP_OK;
-        }
-    }
-
-    /* Insert a new driver in the list. */
-    size_t len = strlen(ident);
-    size_t siz = MP_OFFSET_OF(MpDriver, ident) + len + 1;
-    MpDriver* drv = (MpDriver*)malloc(siz);
-    if (drv == NULL) {
-        return MP_NO_MEMORY;
-    }
-    memset((void*)drv, 0, siz);
-    drv->open = open;
-    drv->next = firstDriver;
-    memcpy((void*)&drv->ident[0], ident, len);
-    firstDriver = drv;
-    return MP_OK;
+    /* Replace existing driver if found, insert a new one otherwise. */
+    return updateRegistry(ident, open);
 }
 
 MpStatus
@@ -97,28 +218,21 @@ MpUninstallDriver(const char* ident)
     }
 
     /* Uninstall existing driver if found. */
-    MpDriver* prev = NULL;
-    for (MpDriver* drv = firstDriver; drv != NULL; drv = drv->next) {
-        if (strcmp(drv->ident, ident) == 0) {
-            if (prev == NULL) {
-                firstDriver = drv->next;
-            } else {
-                prev->next = drv->next;
-            }
-            free((void*)drv);
-            return MP_OK;
-        }
-        prev = drv;
-    }
-    return MP_NOT_FOUND;
+    return updateRegistry(ident, NULL);
 }
 
 MpStatus
 MpUninstallAllDrivers(void)
 {
-    while (firstDriver != NULL) {
-        MpUninstallDriver(firstDriver->ident);
-    }
+    pthread_mutex_lock(&registryMutex);
+    MpRegistry* reg = atomic_exchange_explicit(&registry, NULL,
+                                               memory_order_acq_rel);
+    while (reg != NULL) {
+        MpRegistry* prev = reg->retired;
+        free((void*)reg);
+        reg = prev;
+    }
+    pthread_mutex_unlock(&registryMutex);
     return MP_OK;
 }
 
@@ -137,11 +251,12 @@ MpListDrivers(MpInt* argc, char*** argv)
     if (argc == NULL || argv == NULL) {
         return MP_BAD_ADDRESS;
     }
-    MpInt cnt = 0;
+    const MpRegistry* reg = atomic_load_explicit(&registry,
+                                                 memory_order_acquire);
+    MpInt cnt = (reg == NULL ? 0 : reg->count);
     size_t len = 0;
-    for (MpDriver* drv = firstDriver; drv != NULL; drv = drv->next) {
-        cnt += 1;
-        len += strlen(drv->ident) + 1;
+    for (MpInt i = 0; i < cnt; ++i) {
+        len += strlen(reg->drivers[i].ident) + 1;
     }
     size_t siz = (cnt + 1)*sizeof(char*) + len;
     void* buf = malloc(siz);
@@ -151,20 +266,12 @@ MpListDrivers(MpInt* argc, char*** argv)
     memset(buf, 0, siz);
     char** lst = (char**)buf;
     char* str = ((char*)buf) + (cnt + 1)*sizeof(char*);
-    MpInt idx = 0;
-    for (MpDriver* drv = firstDriver; drv != NULL; drv = drv->next) {
-        if (idx < cnt) {
-            len = strlen(drv->ident);
-            memcpy(str, drv->ident, len);
-            str[len] = '\0';
-            lst[idx] = str;
-            str += len + 1;
-            idx += 1;
-        }
-    }
-    if (idx != cnt) {
-        free(buf);
-        return MP_ASSERTION_FAILED;
+    for (MpInt i = 0; i < cnt; ++i) {
+        len = strlen(reg->drivers[i].ident);
+        memcpy(str, reg->drivers[i].ident, len);
+        str[len] = '\0';
+        lst[i] = str;
+        str += len + 1;
     }
     lst[cnt] = NULL;
     *argc = cnt;
@@ -268,6 +375,12 @@ cannotSetResolution(MpDevice* dev, MpReal xpmm, MpReal ypmm)
     return MP_NOT_PERMITTED;
 }
 
+static MpStatus
+cannotReopen(MpDevice* dev, const char* arg, MpBool reset)
+{
+    return MP_NOT_IMPLEMENTED;
+}
+
 static MpStatus
 defaultSetColorIndex(MpDevice* dev, MpColorIndex ci)
 {
@@ -322,10 +435,12 @@ MpCheckMethods(MpDevice* dev)
 #define SUBSTITUTE_METHOD(M,A) if (M == NULL) M = A
     SUBSTITUTE_METHOD(dev->initialize,       doNothing);
     SUBSTITUTE_METHOD(dev->finalize,         doNothing);
+    SUBSTITUTE_METHOD(dev->reopen,           cannotReopen);
     SUBSTITUTE_METHOD(dev->setPageSize,      cannotSetPageSize);
     SUBSTITUTE_METHOD(dev->setResolution,    cannotSetResolution);
     SUBSTITUTE_METHOD(dev->startBuffering,   doNothing);
     SUBSTITUTE_METHOD(dev->stopBuffering,    doNothing);
+    SUBSTITUTE_METHOD(dev->flush,            doNothing);
     SUBSTITUTE_METHOD(dev->beginPage,        doNothing);
     SUBSTITUTE_METHOD(dev->endPage,          doNothing);
     SUBSTITUTE_METHOD(dev->setColormapSizes, defaultSetColormapSizes);
@@ -333,16 +448,21 @@ MpCheckMethods(MpDevice* dev)
     SUBSTITUTE_METHOD(dev->setColor,         defaultSetColor);
     SUBSTITUTE_METHOD(dev->setLineWidth,     defaultSetLineWidth);
     SUBSTITUTE_METHOD(dev->setLineStyle,     defaultSetLineStyle);
+    SUBSTITUTE_METHOD(dev->drawPoints,       MpDrawPointsHelper);
     SUBSTITUTE_METHOD(dev->drawCells,        MpDrawCellsHelper);
+    SUBSTITUTE_METHOD(dev->drawCells8,       MpDrawCellsHelper8);
+    SUBSTITUTE_METHOD(dev->drawCells16,      MpDrawCellsHelper16);
 #undef SUBSTITUTE_METHOD
 
     /* Make sure that all methods are defined. */
     if (dev->initialize       == NULL ||
         dev->finalize         == NULL ||
+        dev->reopen           == NULL ||
         dev->setPageSize      == NULL ||
         dev->setResolution    == NULL ||
         dev->startBuffering   == NULL ||
         dev->stopBuffering    == NULL ||
+        dev->flush            == NULL ||
         dev->beginPage        == NULL ||
         dev->endPage          == NULL ||
         dev->setColormapSizes == NULL ||
@@ -351,10 +471,13 @@ MpCheckMethods(MpDevice* dev)
         dev->setLineStyle     == NULL ||
         dev->setLineWidth     == NULL ||
         dev->drawPoint        == NULL ||
+        dev->drawPoints       == NULL ||
         dev->drawRectangle    == NULL ||
         dev->drawPolyline     == NULL ||
         dev->drawPolygon      == NULL ||
-        dev->drawCells        == NULL) {
+        dev->drawCells        == NULL ||
+        dev->drawCells8       == NULL ||
+        dev->drawCells16      == NULL) {
         return MP_BAD_METHOD;
     }
     return MP_OK;
@@ -380,8 +503,318 @@ MpCheckColors(MpDevice* dev)
     return MP_OK;
 }
 
+/* Check whether the linear part of a coordinate transform is all zeros (which
+   indicates an uninitialized transform). */
+#define IS_UNSET_TRANSFORM(A) ((A).xx == 0 && (A).xy == 0 && \
+                               (A).yx == 0 && (A).yy == 0)
+
+static MpStatus
+setDefaultTransforms(MpDevice* dev)
+{
+    /* Data to NDC transform defaults to the identity. */
+    if (IS_UNSET_TRANSFORM(dev->dataToNDC)) {
+        MpCoordinateTransform A = {1, 0, 0, 0, 1, 0};
+        dev->dataToNDC = A;
+    }
+
+    /* NDC to device transform maps the unit square to the page. */
+    if (IS_UNSET_TRANSFORM(dev->ndcToDevice)) {
+        double w = dev->horizontalSamples - 1;
+        double h = dev->verticalSamples - 1;
+        MpCoordinateTransform B = {w, 0, 0, 0, h, 0};
+        if (dev->horizontalResolution < 0) {
+            B.xx = -w;
+            B.x = w;
+        }
+        if (dev->verticalResolution < 0) {
+            B.yy = -h;
+            B.y = h;
+        }
+        dev->ndcToDevice = B;
+    }
+    dev->dataToDeviceIsDirty = true;
+    return MP_OK;
+}
+
+const char*
+MpGetMethodName(MpMethod method)
+{
+    switch (method) {
+#define _MP_METHOD(a,b) case a: return #b;
+        _MP_METHOD_LIST
+#undef _MP_METHOD
+    default: return "unknown";
+    }
+}
+
+#ifdef MP_ENABLE_STATS
+
+/* Wall clock time in seconds. */
+static inline double
+elapsedTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1E-9*(double)ts.tv_nsec;
+}
+
+/*
+ * Wrappers of the driver methods.  Each wrapper calls the saved method of the
+ * driver and updates the counters of the method.  Methods called by other
+ * methods (e.g., drawPoint() by MpDrawPointsHelper()) are counted too and
+ * their time is included in the time of the caller.
+ */
+#define CALL_DRIVER(ID, METHOD, ARGS, NVERTS)                           \
+    do {                                                                \
+        struct _MpStatsRecorder* rec = dev->stats;                      \
+        double t0 = elapsedTime();                                      \
+        MpStatus status = rec->driver.METHOD ARGS;                      \
+        rec->counters.seconds[ID] += elapsedTime() - t0;                \
+        rec->counters.calls[ID] += 1;                                   \
+        rec->counters.emittedVertices += (NVERTS);                      \
+        return status;                                                  \
+    } while (false)
+
+static MpStatus
+statsFinalize(MpDevice* dev)
+{
+    CALL_DRIVER(MP_METHOD_FINALIZE, finalize, (dev), 0);
+}
+
+static MpStatus
+statsReopen(MpDevice* dev, const char* arg, MpBool reset)
+{
+    CALL_DRIVER(MP_METHOD_REOPEN, reopen, (dev, arg, reset), 0);
+}
+
+static MpStatus
+statsSetPageSize(MpDevice* dev, MpReal w, MpReal h)
+{
+    CALL_DRIVER(MP_METHOD_SET_PAGE_SIZE, setPageSize, (dev, w, h), 0);
+}
+
+static MpStatus
+statsSetResolution(MpDevice* dev, MpReal xpmm, MpReal ypmm)
+{
+    CALL_DRIVER(MP_METHOD_SET_RESOLUTION, setResolution,
+                (dev, xpmm, ypmm), 0);
+}
+
+static MpStatus
+statsStartBuffering(MpDevice* dev)
+{
+    CALL_DRIVER(MP_METHOD_START_BUFFERING, startBuffering, (dev), 0);
+}
+
+static MpStatus
+statsStopBuffering(MpDevice* dev)
+{
+    CALL_DRIVER(MP_METHOD_STOP_BUFFERING, stopBuffering, (dev), 0);
+}
+
 static MpStatus
-intializeDevice(MpDevice* dev)
+statsFlush(MpDevice* dev)
+{
+    CALL_DRIVER(MP_METHOD_FLUSH, flush, (dev), 0);
+}
+
+static MpStatus
+statsBeginPage(MpDevice* dev)
+{
+    CALL_DRIVER(MP_METHOD_BEGIN_PAGE, beginPage, (dev), 0);
+}
+
+static MpStatus
+statsEndPage(MpDevice* dev)
+{
+    CALL_DRIVER(MP_METHOD_END_PAGE, endPage, (dev), 0);
+}
+
+static MpStatus
+statsSetColormapSizes(MpDevice* dev, MpInt n1, MpInt n2)
+{
+    CALL_DRIVER(MP_METHOD_SET_COLORMAP_SIZES, setColormapSizes,
+                (dev, n1, n2), 0);
+}
+
+static MpStatus
+statsSetColorIndex(MpDevice* dev, MpColorIndex ci)
+{
+    CALL_DRIVER(MP_METHOD_SET_COLOR_INDEX, setColorIndex, (dev, ci), 0);
+}
+
+static MpStatus
+statsSetColor(MpDevice* dev, MpColorIndex ci,
+              MpReal rd, MpReal gr, MpReal bl)
+{
+    CALL_DRIVER(MP_METHOD_SET_COLOR, setColor, (dev, ci, rd, gr, bl), 0);
+}
+
+static MpStatus
+statsSetLineStyle(MpDevice* dev, MpLineStyle ls)
+{
+    CALL_DRIVER(MP_METHOD_SET_LINE_STYLE, setLineStyle, (dev, ls), 0);
+}
+
+static MpStatus
+statsSetLineWidth(MpDevice* dev, MpReal lw)
+{
+    CALL_DRIVER(MP_METHOD_SET_LINE_WIDTH, setLineWidth, (dev, lw), 0);
+}
+
+static MpStatus
+statsDrawPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    /* Vertices are counted by drawPoints(). */
+    CALL_DRIVER(MP_METHOD_DRAW_POINT, drawPoint, (dev, x, y), 0);
+}
+
+static MpStatus
+statsDrawPoints(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    CALL_DRIVER(MP_METHOD_DRAW_POINTS, drawPoints, (dev, x, y, n), n);
+}
+
+static MpStatus
+statsDrawRectangle(MpDevice* dev,
+                   MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    CALL_DRIVER(MP_METHOD_DRAW_RECTANGLE, drawRectangle,
+                (dev, x0, y0, x1, y1), 0);
+}
+
+static MpStatus
+statsDrawPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    CALL_DRIVER(MP_METHOD_DRAW_POLYLINE, drawPolyline, (dev, x, y, n), n);
+}
+
+static MpStatus
+statsDrawPolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    CALL_DRIVER(MP_METHOD_DRAW_POLYGON, drawPolygon, (dev, x, y, n), n);
+}
+
+static MpStatus
+statsDrawCells(MpDevice* dev,
+               const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
+               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    CALL_DRIVER(MP_METHOD_DRAW_CELLS, drawCells,
+                (dev, z, n1, n2, stride, x0, y0, x1, y1), 0);
+}
+
+static MpStatus
+statsDrawCells8(MpDevice* dev,
+                const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+                MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    CALL_DRIVER(MP_METHOD_DRAW_CELLS8, drawCells8,
+                (dev, z, n1, n2, stride, x0, y0, x1, y1), 0);
+}
+
+static MpStatus
+statsDrawCells16(MpDevice* dev,
+                 const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+                 MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    CALL_DRIVER(MP_METHOD_DRAW_CELLS16, drawCells16,
+                (dev, z, n1, n2, stride, x0, y0, x1, y1), 0);
+}
+
+#undef CALL_DRIVER
+
+/* Allocate the recorder of performance counters of a device (whose methods
+   have been checked) and interpose the wrappers. */
+static MpStatus
+installStatsRecorder(MpDevice* dev)
+{
+    if (dev->stats != NULL) {
+        /* Already installed (the device is initialized again). */
+        return MP_OK;
+    }
+    struct _MpStatsRecorder* rec = calloc(1, sizeof(*rec));
+    if (rec == NULL) {
+        return MP_NO_MEMORY;
+    }
+    rec->driver = *dev;
+    dev->stats = rec;
+    dev->finalize         = statsFinalize;
+    dev->reopen           = statsReopen;
+    dev->setPageSize      = statsSetPageSize;
+    dev->setResolution    = statsSetResolution;
+    dev->startBuffering   = statsStartBuffering;
+    dev->stopBuffering    = statsStopBuffering;
+    dev->flush            = statsFlush;
+    dev->beginPage        = statsBeginPage;
+    dev->endPage          = statsEndPage;
+    dev->setColormapSizes = statsSetColormapSizes;
+    dev->setColorIndex    = statsSetColorIndex;
+    dev->setColor         = statsSetColor;
+    dev->setLineStyle     = statsSetLineStyle;
+    dev->setLineWidth     = statsSetLineWidth;
+    dev->drawPoint        = statsDrawPoint;
+    dev->drawPoints       = statsDrawPoints;
+    dev->drawRectangle    = statsDrawRectangle;
+    dev->drawPolyline     = statsDrawPolyline;
+    dev->drawPolygon      = statsDrawPolygon;
+    dev->drawCells        = statsDrawCells;
+    dev->drawCells8       = statsDrawCells8;
+    dev->drawCells16      = statsDrawCells16;
+    return MP_OK;
+}
+
+/* Call the `initialize()` method of a device which is not interposed. */
+static MpStatus
+initializeDriver(MpDevice* dev)
+{
+    double t0 = elapsedTime();
+    MpStatus status = dev->initialize(dev);
+    dev->stats->counters.seconds[MP_METHOD_INITIALIZE] += elapsedTime() - t0;
+    dev->stats->counters.calls[MP_METHOD_INITIALIZE] += 1;
+    return status;
+}
+
+#endif /* MP_ENABLE_STATS */
+
+MpStatus
+MpGetDeviceStats(MpDevice* dev, MpDeviceStats* stats)
+{
+    if (dev == NULL || stats == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+#ifdef MP_ENABLE_STATS
+    if (dev->stats == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return MP_BAD_DEVICE;
+    }
+    *stats = dev->stats->counters;
+    return MP_OK;
+#else
+    memset(stats, 0, sizeof(*stats));
+    return MP_NOT_IMPLEMENTED;
+#endif
+}
+
+MpStatus
+MpResetDeviceStats(MpDevice* dev)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+#ifdef MP_ENABLE_STATS
+    if (dev->stats == NULL) {
+        return MP_BAD_DEVICE;
+    }
+    memset(&dev->stats->counters, 0, sizeof(dev->stats->counters));
+    return MP_OK;
+#else
+    return MP_NOT_IMPLEMENTED;
+#endif
+}
+
+MpStatus
+MpInitializeDevice(MpDevice* dev)
 {
     MpStatus status = MP_OK;
     if (dev == NULL) {
@@ -393,9 +826,17 @@ intializeDevice(MpDevice* dev)
     if (status == MP_OK) {
         status = MpCheckMethods(dev);
     }
+#ifdef MP_ENABLE_STATS
+    if (status == MP_OK) {
+        status = installStatsRecorder(dev);
+    }
+#endif
     if (status == MP_OK) {
         status = MpCheckColors(dev);
     }
+    if (status == MP_OK) {
+        status = setDefaultTransforms(dev);
+    }
     if (status == MP_OK) {
         status = MpDefineStandardColors(dev, true);
         if (status != MP_OK && dev->colormapSize1 >= 2) {
@@ -406,7 +847,17 @@ intializeDevice(MpDevice* dev)
         }
     }
     if (status == MP_OK) {
+#ifdef MP_ENABLE_STATS
+        status = initializeDriver(dev);
+#else
         status = dev->initialize(dev);
+#endif
+    }
+    if (status == MP_OK) {
+        dev->pendingColorIndex = dev->colorIndex;
+        dev->pendingLineStyle = dev->lineStyle;
+        dev->pendingLineWidth = dev->lineWidth;
+        dev->pendingSettings = false;
     }
     return status;
 }
@@ -425,15 +876,15 @@ MpOpenDevice(MpDevice** devptr, const char* ident, const char* arg)
 
     /* Find driver. */
     MpStatus status = MP_NOT_FOUND;
-    for (MpDriver* drv = firstDriver; drv != NULL; drv = drv->next) {
-        if (strcmp(drv->ident, ident) == 0) {
-            status = drv->open(devptr, ident, arg);
-            break;
-        }
+    const MpRegistry* reg = atomic_load_explicit(&registry,
+                                                 memory_order_acquire);
+    MpInt idx = findDriver(reg, ident, hashIdentifier(ident));
+    if (idx >= 0) {
+        status = reg->drivers[idx].open(devptr, ident, arg);
     }
     if (status == MP_OK) {
         /* Fix/check settings. */
-        status = intializeDevice(*devptr);
+        status = MpInitializeDevice(*devptr);
         if (status != MP_OK) {
             MpCloseDevice(devptr);
         }
@@ -453,6 +904,35 @@ finalizeDevice(MpDevice* dev)
             dev->colormap = NULL;
             dev->colormapSize = 0;
         }
+        if (dev->xscratch != NULL) {
+            free((void*)dev->xscratch);
+            dev->xscratch = NULL;
+        }
+        if (dev->yscratch != NULL) {
+            free((void*)dev->yscratch);
+            dev->yscratch = NULL;
+        }
+        dev->scratchSize = 0;
+        if (dev->workspace != NULL) {
+            free(dev->workspace);
+            dev->workspace = NULL;
+        }
+        dev->workspaceSize = 0;
+        if (dev->stream != NULL) {
+            free((void*)dev->stream);
+            dev->stream = NULL;
+        }
+        MpFreeTextCache(dev);
+        if (dev->stats != NULL) {
+            free((void*)dev->stats);
+            dev->stats = NULL;
+        }
+        if (dev->encodedColors != NULL) {
+            free((void*)dev->encodedColors);
+            dev->encodedColors = NULL;
+        }
+        dev->encodedColorsSize = 0;
+        dev->colorEncoder = NULL;
         free((void*)dev);
     }
     return status;
@@ -469,6 +949,33 @@ MpCloseDevice(MpDevice** devptr)
     return status;
 }
 
+MpStatus
+MpReopenDevice(MpDevice* dev, const char* arg, MpBool reset)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MpDropPolyline(dev);
+    MpStatus status = dev->reopen(dev, arg, reset);
+    if (status == MP_OK) {
+        dev->groupLevel = 0;
+        dev->pageNumber = 0;
+        if (reset) {
+            /* Initialize the device again like a new one: the transforms
+               are unset to be recomputed and the allocated colormap, encoded
+               colors and scratch buffers are kept. */
+            memset(&dev->dataToNDC, 0, sizeof(dev->dataToNDC));
+            memset(&dev->ndcToDevice, 0, sizeof(dev->ndcToDevice));
+            dev->colormapSize = 0;
+            dev->decimate = false;
+            dev->simplify = false;
+            MpSetAxisScales(dev, NULL, NULL);
+            status = MpInitializeDevice(dev);
+        }
+    }
+    return status;
+}
+
 MpStatus
 MpSetPageSize(MpDevice* dev, MpReal width, MpReal height)
 {
@@ -532,55 +1039,285 @@ MpGetNumberOfSamples(MpDevice* dev, MpPoint* width, MpPoint* height)
     return MP_OK;
 }
 
+/* Check whether all coefficients of a coordinate transform are finite. */
+#define IS_FINITE_TRANSFORM(A) (MP_IS_FINITE((A)->xx) && \
+                                MP_IS_FINITE((A)->xy) && \
+                                MP_IS_FINITE((A)->x)  && \
+                                MP_IS_FINITE((A)->yx) && \
+                                MP_IS_FINITE((A)->yy) && \
+                                MP_IS_FINITE((A)->y))
+
+/* Check whether two coordinate transforms are identical. */
+#define SAME_TRANSFORMS(A, B) ((A)->xx == (B)->xx && (A)->xy == (B)->xy && \
+                               (A)->x  == (B)->x  && (A)->yx == (B)->yx && \
+                               (A)->yy == (B)->yy && (A)->y  == (B)->y)
+
 MpStatus
-MpDrawCellsHelper(MpDevice* dev, const MpColorIndex* z,
-                  MpInt n1, MpInt n2, MpInt stride,
-                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+MpStartBuffering(MpDevice* dev)
 {
-    MpStatus status = MP_OK;
-    MpColorIndex ci0, cip, ci;
-
-    /* Early return if nothing to do. */
-    if (n1 < 1 || n2 < 1) {
-        return status;
-    }
-
-    /* Save initial color index. */
-    status = MpGetColorIndex(dev, &ci0);
-    if (status != MP_OK) {
-        return status;
-    }
-
-    /* Draw all cells. */
-    float dx = (float)(x1 - x0)/n1;
-    float dy = (float)(y1 - y0)/n2;
-    cip = -1;
-    for (MpInt i2 = 0; i2 < n2; ++i2) {
-        const MpColorIndex* c =  z + i2*stride;
-        MpPoint cy0 = y0 + (MpPoint)roundf(i2*dy); /* FIXME: replace by integer code */
-        MpPoint cy1 = cy0 + dy;
-        for (MpInt i1 = 0; i1 < n1; ++i1) {
-            /* Set color index if it has changed. */
-            ci = c[i1];
-            if (ci != cip) {
-                status = dev->setColorIndex(dev, c[i1]);
-                if (status != MP_OK) {
-                    return status;
-                }
-                cip = ci;
-            }
-            /* Draw rectangle. */
-            MpPoint cx0 = x0 + i1*dx;
-            MpPoint cx1 = cx0 + dx;
-            status = dev->drawRectangle(dev, cx0, cy0, cx1, cy1);
-            if (status != MP_OK) {
-                return status;
-            }
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    return dev->startBuffering(dev);
+}
+
+MpStatus
+MpStopBuffering(MpDevice* dev)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    return dev->stopBuffering(dev);
+}
+
+MpStatus
+MpFlush(MpDevice* dev)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    return dev->flush(dev);
+}
+
+MpStatus
+MpBeginPage(MpDevice* dev)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    MpStatus status = dev->beginPage(dev);
+    if (status == MP_OK) {
+        ++dev->pageNumber;
+    }
+    return status;
+}
+
+MpStatus
+MpEndPage(MpDevice* dev)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    return dev->endPage(dev);
+}
+
+MpStatus
+MpSetCoordinateTransform(MpDevice* dev, const MpCoordinateTransform* A)
+{
+    if (dev == NULL || A == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (SAME_TRANSFORMS(A, &dev->dataToNDC)) {
+        return MP_OK;
+    }
+    if (! IS_FINITE_TRANSFORM(A)) {
+        return MP_BAD_ARGUMENT;
+    }
+    dev->dataToNDC = *A;
+    dev->dataToDeviceIsDirty = true;
+    return MP_OK;
+}
+
+MpStatus
+MpGetCoordinateTransform(MpDevice* dev, MpCoordinateTransform* A)
+{
+    if (dev == NULL || A == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *A = dev->dataToNDC;
+    return MP_OK;
+}
+
+MpStatus
+MpSetAxisScales(MpDevice* dev, const MpAxisScale* xs, const MpAxisScale* ys)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    const MpAxisScale linear = {MP_LINEAR_SCALING, 0};
+    if (xs == NULL) {
+        xs = &linear;
+    }
+    if (ys == NULL) {
+        ys = &linear;
+    }
+    if (MpCheckAxisScale(xs) != MP_OK || MpCheckAxisScale(ys) != MP_OK) {
+        return MP_BAD_ARGUMENT;
+    }
+    dev->xscale = *xs;
+    dev->yscale = *ys;
+    dev->scaledAxes = (xs->scaling != MP_LINEAR_SCALING ||
+                       ys->scaling != MP_LINEAR_SCALING);
+    return MP_OK;
+}
+
+MpStatus
+MpGetAxisScales(MpDevice* dev, MpAxisScale* xs, MpAxisScale* ys)
+{
+    if (dev == NULL || xs == NULL || ys == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *xs = dev->xscale;
+    *ys = dev->yscale;
+    return MP_OK;
+}
+
+MpStatus
+MpSetNDCToDeviceTransform(MpDevice* dev, const MpCoordinateTransform* B)
+{
+    if (dev == NULL || B == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (SAME_TRANSFORMS(B, &dev->ndcToDevice)) {
+        return MP_OK;
+    }
+    if (! IS_FINITE_TRANSFORM(B)) {
+        return MP_BAD_ARGUMENT;
+    }
+    dev->ndcToDevice = *B;
+    dev->dataToDeviceIsDirty = true;
+    return MP_OK;
+}
+
+const MpCoordinateTransform*
+MpGetDataToDeviceTransform(MpDevice* dev)
+{
+    if (dev->dataToDeviceIsDirty) {
+        const MpCoordinateTransform* C = &dev->dataToDevice;
+        MpAffineTransformFlt* F = &dev->dataToDeviceFlt;
+        MpComposeAffineTransformsDbl(&dev->dataToDevice,
+                                     &dev->ndcToDevice, &dev->dataToNDC);
+        F->xx = (float)C->xx;
+        F->xy = (float)C->xy;
+        F->x  = (float)C->x;
+        F->yx = (float)C->yx;
+        F->yy = (float)C->yy;
+        F->y  = (float)C->y;
+        dev->dataToDeviceKind = MpClassifyAffineTransformDbl(C);
+        dev->dataToDeviceIsDirty = false;
+    }
+    return &dev->dataToDevice;
+}
+
+const MpAffineTransformFlt*
+MpGetDataToDeviceTransformFlt(MpDevice* dev)
+{
+    MpGetDataToDeviceTransform(dev);
+    return &dev->dataToDeviceFlt;
+}
+
+MpStatus
+MpReserveScratch(MpDevice* dev, MpInt n)
+{
+    if (n > dev->scratchSize) {
+        size_t size = n*sizeof(MpPoint);
+        MpPoint* xbuf = (MpPoint*)realloc((void*)dev->xscratch, size);
+        if (xbuf == NULL) {
+            return MP_NO_MEMORY;
         }
+        dev->xscratch = xbuf;
+        MpPoint* ybuf = (MpPoint*)realloc((void*)dev->yscratch, size);
+        if (ybuf == NULL) {
+            return MP_NO_MEMORY;
+        }
+        dev->yscratch = ybuf;
+        dev->scratchSize = n;
     }
+    return MP_OK;
+}
 
-    /* Restore initial color index. */
-    return MpSetColorIndex(dev, ci0);
+MpStatus
+MpReserveWorkspace(MpDevice* dev, size_t size)
+{
+    if (size > dev->workspaceSize) {
+        void* buf = realloc(dev->workspace, size);
+        if (buf == NULL) {
+            return MP_NO_MEMORY;
+        }
+        dev->workspace = buf;
+        dev->workspaceSize = size;
+    }
+    return MP_OK;
+}
+
+MpStatus
+MpSetColorEncoder(MpDevice* dev, MpColorEncoder* encoder)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    dev->colorEncoder = encoder;
+    if (encoder == NULL) {
+        free((void*)dev->encodedColors);
+        dev->encodedColors = NULL;
+        dev->encodedColorsSize = 0;
+        return MP_OK;
+    }
+    return MpRefreshEncodedColors(dev, 0, dev->colormapSize);
+}
+
+MpStatus
+MpRefreshEncodedColors(MpDevice* dev, MpColorIndex first, MpInt count)
+{
+    if (first < 0 || count < 0 || first + count > dev->colormapSize) {
+        return MP_OUT_OF_RANGE;
+    }
+    if (dev->colorEncoder == NULL) {
+        return MP_OK;
+    }
+    if (dev->colormapSize > dev->encodedColorsSize) {
+        uint32_t* buf = realloc(dev->encodedColors,
+                                dev->colormapSize*sizeof(uint32_t));
+        if (buf == NULL) {
+            return MP_NO_MEMORY;
+        }
+        dev->encodedColors = buf;
+        dev->encodedColorsSize = dev->colormapSize;
+    }
+    for (MpColorIndex ci = first; ci < first + count; ++ci) {
+        dev->encodedColors[ci] = dev->colorEncoder(&dev->colormap[ci]);
+    }
+    return MP_OK;
+}
+
+MpStatus
+MpSetPolylineDecimation(MpDevice* dev, MpBool flag)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    dev->decimate = flag;
+    return MP_OK;
+}
+
+MpStatus
+MpGetPolylineDecimation(MpDevice* dev, MpBool* flag)
+{
+    if (dev == NULL || flag == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *flag = dev->decimate;
+    return MP_OK;
+}
+
+MpStatus
+MpSetVertexSimplification(MpDevice* dev, MpBool flag)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    dev->simplify = flag;
+    return MP_OK;
+}
+
+MpStatus
+MpGetVertexSimplification(MpDevice* dev, MpBool* flag)
+{
+    if (dev == NULL || flag == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    *flag = dev->simplify;
+    return MP_OK;
 }
 
 MpStatus
@@ -589,13 +1326,16 @@ MpSetColorIndex(MpDevice* dev, MpColorIndex ci)
     if (dev == NULL) {
         return MP_BAD_ADDRESS;
     }
-    if (ci == dev->colorIndex) {
+    if (ci == dev->pendingColorIndex) {
+        MP_COUNT(dev, suppressedSettings, 1);
         return MP_OK;
     }
     if (ci < 0 || ci >= dev->colormapSize) {
         return MP_OUT_OF_RANGE;
     }
-    return dev->setColorIndex(dev, ci); // FXIME: check that dev->colorIndex = ci
+    dev->pendingColorIndex = ci;
+    dev->pendingSettings = true;
+    return MP_OK;
 }
 
 MpStatus
@@ -604,7 +1344,7 @@ MpGetColorIndex(MpDevice* dev, MpColorIndex* ci)
     if (dev == NULL || ci == NULL) {
         return MP_BAD_ADDRESS;
     }
-    *ci = dev->colorIndex;
+    *ci = dev->pendingColorIndex;
     return MP_OK;
 }
 
@@ -642,7 +1382,11 @@ MpSetColor(MpDevice* dev, MpColorIndex ci, MpReal rd, MpReal gr, MpReal bl)
         dev->colormap[ci].blue  == bl) {
         return MP_OK;
     }
-    return dev->setColor(dev, ci, rd, gr, bl);
+    MpStatus status = dev->setColor(dev, ci, rd, gr, bl);
+    if (status == MP_OK && dev->colorEncoder != NULL) {
+        dev->encodedColors[ci] = dev->colorEncoder(&dev->colormap[ci]);
+    }
+    return status;
 
  badValue:
     return MP_BAD_SETTINGS;
@@ -670,13 +1414,16 @@ MpSetLineStyle(MpDevice* dev, MpLineStyle ls)
     if (dev == NULL) {
         return MP_BAD_ADDRESS;
     }
-    if (ls == dev->lineStyle) {
+    if (ls == dev->pendingLineStyle) {
+        MP_COUNT(dev, suppressedSettings, 1);
         return MP_OK;
     }
     if (ls < 0 || ls > MP_DASH_TRIPLE_DOTTED_LINE) {
         return MP_OUT_OF_RANGE;
     }
-    return dev->setLineStyle(dev, ls);
+    dev->pendingLineStyle = ls;
+    dev->pendingSettings = true;
+    return MP_OK;
 }
 
 MpStatus
@@ -685,7 +1432,7 @@ MpGetLineStyle(MpDevice* dev, MpLineStyle* ls)
     if (dev == NULL || ls == NULL) {
         return MP_BAD_ADDRESS;
     }
-    *ls = dev->lineStyle;
+    *ls = dev->pendingLineStyle;
     return MP_OK;
 }
 
@@ -697,13 +1444,40 @@ MpSetLineWidth(MpDevice* dev, MpReal lw)
     if (dev == NULL) {
         return MP_BAD_ADDRESS;
     }
-    if (lw == dev->lineWidth) {
+    if (lw == dev->pendingLineWidth) {
+        MP_COUNT(dev, suppressedSettings, 1);
         return MP_OK;
     }
     if (MP_IS_NAN(lw) || lw < 0 || lw > MAX_LINE_WIDTH) {
         return MP_BAD_SETTINGS;
     }
-    return dev->setLineWidth(dev, lw);
+    dev->pendingLineWidth = lw;
+    dev->pendingSettings = true;
+    return MP_OK;
+}
+
+MpStatus
+MpApplyPendingSettings(MpDevice* dev)
+{
+    /* The color index is checked again because the colormap may have been
+       resized since it was set. */
+    MpStatus status = MP_OK;
+    if (dev->pendingColorIndex != dev->colorIndex) {
+        if (dev->pendingColorIndex >= dev->colormapSize) {
+            return MP_OUT_OF_RANGE;
+        }
+        status = dev->setColorIndex(dev, dev->pendingColorIndex);
+    }
+    if (status == MP_OK && dev->pendingLineStyle != dev->lineStyle) {
+        status = dev->setLineStyle(dev, dev->pendingLineStyle);
+    }
+    if (status == MP_OK && dev->pendingLineWidth != dev->lineWidth) {
+        status = dev->setLineWidth(dev, dev->pendingLineWidth);
+    }
+    if (status == MP_OK) {
+        dev->pendingSettings = false;
+    }
+    return status;
 }
 
 MpStatus
@@ -712,7 +1486,7 @@ MpGetLineWidth(MpDevice* dev, MpReal* lw)
     if (dev == NULL || lw == NULL) {
         return MP_BAD_ADDRESS;
     }
-    *lw = dev->lineWidth;
+    *lw = dev->pendingLineWidth;
     return MP_OK;
 }
 
@@ -751,6 +1525,11 @@ MpDefineStandardColors(MpDevice* dev, MpBool dark)
         SET_STANDARD_COLOR(WHITE,      1,  1,  1);
         SET_STANDARD_COLOR(BLACK,      1,  1,  1);
 #undef SET_STANDARD_COLOR
+        MpStatus code = MpRefreshEncodedColors(
+            dev, 0, (dev->colormapSize1 < 10 ? dev->colormapSize1 : 10));
+        if (code != MP_OK) {
+            status = code;
+        }
     }
     return status;
 }
@@ -791,5 +1570,17 @@ MpSetColormapSizes(MpDevice* dev, MpInt n1, MpInt n2)
     if (n1 < 2 || n2 < 0) {
          return MP_BAD_SIZE;
     }
-    return dev->setColormapSizes(dev, n1, n2);
+
+    /* The colormap may have been partially resized even though the driver
+       reports an error, the colors which are new are encoded anyway. */
+    MpColorIndex size = dev->colormapSize;
+    MpStatus status = dev->setColormapSizes(dev, n1, n2);
+    if (dev->colormapSize > size) {
+        MpStatus code = MpRefreshEncodedColors(dev, size,
+                                               dev->colormapSize - size);
+        if (status == MP_OK) {
+            status = code;
+        }
+    }
+    return status;
 }
@@ -302,8 +302,131 @@ extern MpStatus MpInvertMappingFlt(MpMappingFlt* dst,
 extern MpStatus MpInvertMappingDbl(MpMappingDbl* dst,
                                    const MpMappingDbl* src);
 
-#define _MP_IS_EMPTY_BOX(E,B) (E(B,xmin) > E(box,xmax) || \
-                               E(B,ymin) > E(box,ymax))
+/**
+ * Apply a coordinate mapping to arrays of coordinates.
+ *
+ * This function applies the mapping `A` to the `n` points whose coordinates
+ * are `(xin[i],yin[i])` and stores the result in `(xout[i],yout[i])` for `i =
+ * 0, ..., n-1`.  The operation can be done in-place, that is `xout` and `yout`
+ * can be respectively the same as `xin` and `yin`; otherwise, output and input
+ * arrays must not overlap.
+ *
+ * @param A      The coordinate mapping.
+ * @param xout   The array to store the mapped abscissae.
+ * @param yout   The array to store the mapped ordinates.
+ * @param xin    The abscissae of the points to map.
+ * @param yin    The ordinates of the points to map.
+ * @param n      The number of points.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpApplyMappingFlt(const MpMappingFlt* A,
+                                  float* xout, float* yout,
+                                  const float* xin, const float* yin,
+                                  MpInt n);
+
+/**
+ * Apply a coordinate mapping to arrays of coordinates.
+ *
+ * This function is identical to MpApplyMappingFlt() but for double precision
+ * coordinates.
+ */
+extern MpStatus MpApplyMappingDbl(const MpMappingDbl* A,
+                                  double* xout, double* yout,
+                                  const double* xin, const double* yin,
+                                  MpInt n);
+
+/*
+ * Scaling functions for mapping values to colormap indices (see
+ * MpValueMapping) and for the axes (see MpAxisScale).
+ */
+typedef enum {
+    MP_LINEAR_SCALING = 0,
+    MP_LOG_SCALING    = 1, /* logarithmic scaling */
+    MP_ASINH_SCALING  = 2, /* asinh((v - vmin)/softening) */
+    MP_SYMLOG_SCALING = 3, /* symmetric logarithmic scaling (only for axes) */
+} MpScaling;
+
+/**
+ * @struct MpAxisScale
+ *
+ * A nonlinear scale of the coordinates along an axis.  A coordinate `v` is
+ * scaled as follows according to the value of `scaling`:
+ *
+ * - `MP_LINEAR_SCALING`: `v` (`param` is not used);
+ * - `MP_LOG_SCALING`: `log10(v)`, NaN for `v ≤ 0` (`param` is not used);
+ * - `MP_SYMLOG_SCALING`: `sign(v)*log10(1 + |v|/param)` which is nearly
+ *   linear for `|v| ≪ param` and logarithmic for `|v| ≫ param`;
+ * - `MP_ASINH_SCALING`: `asinh(v/param)`.
+ *
+ * For the symlog and asinh scalings, `param` must be finite and strictly
+ * positive.  All the scalings are increasing functions.
+ */
+typedef struct _MpAxisScale {
+    MpScaling scaling;
+    double      param;
+} MpAxisScale;
+
+/**
+ * Check an axis scale.
+ *
+ * @return A standard status: `MP_OK` if the scale is valid, `MP_BAD_ARGUMENT`
+ *         otherwise.
+ */
+extern MpStatus MpCheckAxisScale(const MpAxisScale* s);
+
+/**
+ * Scale a single coordinate.
+ *
+ * @param s      The axis scale (assumed valid).
+ * @param v      The coordinate.
+ *
+ * @return The scaled coordinate.
+ */
+extern double MpScaleCoordinate(const MpAxisScale* s, double v);
+
+/**
+ * Unscale a single coordinate.
+ *
+ * This function is the inverse of MpScaleCoordinate(), for example to
+ * compute the values of the ticks of an axis.
+ *
+ * @param s      The axis scale (assumed valid).
+ * @param u      The scaled coordinate.
+ *
+ * @return The coordinate.
+ */
+extern double MpUnscaleCoordinate(const MpAxisScale* s, double u);
+
+/**
+ * Scale arrays of coordinates.
+ *
+ * This function applies the axis scale `s` to the `n` coordinates `src[i]`
+ * and stores the result in `dst[i]` for `i = 0, ..., n-1`.  The operation
+ * can be done in-place.  The loops have no branches and are vectorized by the
+ * compiler (the transcendental functions require a vector math library).
+ *
+ * @param s      The axis scale.
+ * @param dst    The array to store the scaled coordinates.
+ * @param src    The coordinates to scale.
+ * @param n      The number of coordinates.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpApplyAxisScaleFlt(const MpAxisScale* s,
+                                    float* dst, const float* src, MpInt n);
+
+/**
+ * Scale arrays of coordinates.
+ *
+ * This function is identical to MpApplyAxisScaleFlt() but for double
+ * precision coordinates.
+ */
+extern MpStatus MpApplyAxisScaleDbl(const MpAxisScale* s,
+                                    double* dst, const double* src, MpInt n);
+
+#define _MP_IS_EMPTY_BOX(E,B) (E(B,xmin) > E(B,xmax) || \
+                               E(B,ymin) > E(B,ymax))
 
 #define MP_IS_EMPTY_BOX(B)     _MP_IS_EMPTY_BOX(MP_GET_FIELD,B)
 #define MP_IS_EMPTY_BOX_PTR(B) _MP_IS_EMPTY_BOX(MP_GET_FIELD_PTR,B)
@@ -445,6 +568,198 @@ extern MpInt
 MpClipPolylineDbl(double* xc, double* yc, const MpBoxDbl* box,
                   const double* x, const double* y, MpInt n);
 
+/**
+ * Clip a polygon within a box.
+ *
+ * The polygon is clipped by the Sutherland-Hodgman algorithm, first against
+ * the vertical edges of the box and then against the horizontal ones.  Each
+ * pass at most doubles the number of vertices, so there must be at least `4n`
+ * values in `xc` and `yc` which are also used as workspace.  The clipping
+ * bits of the vertices (see MP_CLIP_TBRL()) are computed first: a polygon
+ * whose vertices are all beyond the same edge of the box is rejected, a
+ * polygon whose vertices are all inside the box is copied and only the edges
+ * of the box crossed by the polygon are considered otherwise.  Parts of the
+ * polygon outside the box are replaced by the edges of the box, hence the
+ * result may have degenerated edges along the box edges but is filled the
+ * same.  All coordinates must be finite.
+ *
+ * @param xc     Array to store the abscissae of the clipped polygon.
+ * @param yc     Array to store the ordinates of the clipped polygon.
+ * @param box    The clipping box.
+ * @param x      Abscissae of the vertices of the polygon.
+ * @param y      Ordinates of the vertices of the polygon.
+ * @param n      Number of vertices of the polygon.
+ *
+ * @return The number of vertices of the clipped polygon, `0` if it is empty
+ * (fewer than 3 vertices).
+ */
+extern MpInt
+MpClipPolygonFlt(float* xc, float* yc, const MpBoxFlt* box,
+                 const float* x, const float* y, MpInt n);
+
+/**
+ * Clip a polygon within a box.
+ *
+ * This function is identical to MpClipPolygonFlt() but for double precision
+ * coordinates.
+ */
+extern MpInt
+MpClipPolygonDbl(double* xc, double* yc, const MpBoxDbl* box,
+                 const double* x, const double* y, MpInt n);
+
+/*
+ * Coordinate transform (must match opaque definition in <muPlotXForms.h>).
+ */
+typedef struct _MpAffineTransformDbl MpCoordinateTransform;
+
+/**
+ * @def MP_DEFAULT_CHUNK_SIZE
+ *
+ * Default number of segments per chunk for MpInitializeChunkBoundsFlt() and
+ * MpInitializeChunkBoundsDbl().
+ */
+#define MP_DEFAULT_CHUNK_SIZE 1024
+
+/**
+ * Classes of chunks yielded by MpClassifyChunksFlt() and
+ * MpClassifyChunksDbl().
+ */
+#define MP_CHUNK_OUTSIDE    0 /* All the points are outside the box. */
+#define MP_CHUNK_INSIDE     1 /* All the points are inside the box. */
+#define MP_CHUNK_STRADDLING 2 /* The chunk may cross the box boundaries. */
+
+/**
+ * @struct MpChunkBoundsFlt
+ *
+ * A summary of the bounds of the points of a large polyline.  The `n` points
+ * are split in chunks of `chunkSize` segments, that is `chunkSize + 1` points,
+ * the last point of a chunk being the first one of the next chunk, so that
+ * all the segments of a chunk are inside its bounding box.  The bounding
+ * boxes of the chunks are stored in `boxes[0:chunks-1]` and are followed by
+ * the boxes of the upper levels of a hierarchy where each box covers those of
+ * 16 consecutive boxes of the level below, up to a single box covering all
+ * the points.  This lets a clipping box accept or reject many chunks at once.
+ * The structure is initialized by MpInitializeChunkBoundsFlt() and must be
+ * finalized by MpFinalizeChunkBoundsFlt().  It remains valid as long as the
+ * coordinates of the points are unchanged.
+ */
+typedef struct _MpChunkBoundsFlt {
+    MpInt         count; /* Number of points */
+    MpInt     chunkSize; /* Number of segments per chunk */
+    MpInt        chunks; /* Number of chunks */
+    MpInt        levels; /* Number of levels in the hierarchy */
+    MpBoxFlt*     boxes; /* Bounding boxes of all levels */
+} MpChunkBoundsFlt;
+
+/**
+ * @struct MpChunkBoundsDbl
+ *
+ * This structure is identical to MpChunkBoundsFlt but for double precision
+ * coordinates.
+ */
+typedef struct _MpChunkBoundsDbl {
+    MpInt         count; /* Number of points */
+    MpInt     chunkSize; /* Number of segments per chunk */
+    MpInt        chunks; /* Number of chunks */
+    MpInt        levels; /* Number of levels in the hierarchy */
+    MpBoxDbl*     boxes; /* Bounding boxes of all levels */
+} MpChunkBoundsDbl;
+
+/**
+ * Compute the bounds of chunks of points.
+ *
+ * The bounds are computed once in a single vectorized pass over the points.
+ * NaN coordinates are ignored, a chunk whose points all have a NaN coordinate
+ * is always outside.
+ *
+ * @param cb     The structure to initialize.
+ * @param x      Abscissae of the points.
+ * @param y      Ordinates of the points.
+ * @param n      Number of points.
+ * @param size   Number of segments per chunk, `MP_DEFAULT_CHUNK_SIZE` if
+ *               not strictly positive.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus
+MpInitializeChunkBoundsFlt(MpChunkBoundsFlt* cb, const float* x,
+                           const float* y, MpInt n, MpInt size);
+
+/**
+ * Compute the bounds of chunks of points.
+ *
+ * This function is identical to MpInitializeChunkBoundsFlt() but for double
+ * precision coordinates.
+ */
+extern MpStatus
+MpInitializeChunkBoundsDbl(MpChunkBoundsDbl* cb, const double* x,
+                           const double* y, MpInt n, MpInt size);
+
+/**
+ * Free the resources of a chunk bounds structure.  It can safely be called
+ * more than once.
+ */
+extern void MpFinalizeChunkBoundsFlt(MpChunkBoundsFlt* cb);
+extern void MpFinalizeChunkBoundsDbl(MpChunkBoundsDbl* cb);
+
+/**
+ * Classify chunks of points against a box.
+ *
+ * This function sets `code[k]` to `MP_CHUNK_OUTSIDE`, `MP_CHUNK_INSIDE` or
+ * `MP_CHUNK_STRADDLING` for each chunk `k` depending on the position of its
+ * bounding box relative to the box `box`.  The hierarchy of boxes is
+ * descended from the top and whole nodes that are inside or outside are
+ * classified at once, so the cost is at most proportional to the number of
+ * chunks.  If `C` is not `NULL`, the bounding boxes are transformed by `C`
+ * (using interval arithmetic, so that the result is conservative) before
+ * being compared to `box`.
+ *
+ * @param code   Array of `cb->chunks` values to store the classes.
+ * @param cb     The bounds of the chunks.
+ * @param C      Coordinate transform, `NULL` for the identity.
+ * @param box    The box in the coordinates of `C`.
+ *
+ * @return The number of chunks which are not outside the box.
+ */
+extern MpInt
+MpClassifyChunksFlt(uint8_t* code, const MpChunkBoundsFlt* cb,
+                    const MpCoordinateTransform* C,
+                    const MpBoxFlt* box);
+
+extern MpInt
+MpClassifyChunksDbl(uint8_t* code, const MpChunkBoundsDbl* cb,
+                    const MpCoordinateTransform* C,
+                    const MpBoxDbl* box);
+
+/**
+ * Clip an indexed polyline within a box.
+ *
+ * This function yields the same segments as MpClipPolylineFlt() but uses the
+ * bounds of chunks of the polyline to skip the chunks outside the box and
+ * copy the chunks inside the box without clipping.  Only the segments of the
+ * straddling chunks are clipped.
+ *
+ * @param xc     Array to store the abscissae of the segments to draw.
+ * @param yc     Array to store the ordinates of the segments to draw.
+ * @param box    The clipping box.
+ * @param x      Abscissae of the points defining the polyline.
+ * @param y      Ordinates of the points defining the polyline.
+ * @param n      Number of points in the polyline, must be `cb->count`.
+ * @param cb     The bounds of the chunks of the polyline.
+ * @param code   Workspace of `cb->chunks` bytes.
+ *
+ * @return The number of segments to draw.
+ */
+extern MpInt
+MpClipIndexedPolylineFlt(float* xc, float* yc, const MpBoxFlt* box,
+                         const float* x, const float* y, MpInt n,
+                         const MpChunkBoundsFlt* cb, uint8_t* code);
+
+extern MpInt
+MpClipIndexedPolylineDbl(double* xc, double* yc, const MpBoxDbl* box,
+                         const double* x, const double* y, MpInt n,
+                         const MpChunkBoundsDbl* cb, uint8_t* code);
+
 extern MpStatus
 MpDrawClippedSegmentFlt(void* ctx,
                         MpStatus (*move)(void* ctx, float x, float y),
@@ -582,12 +897,17 @@ extern int MpClipNextDbl(MpClipStateDbl* w, double x, double y);
  * - if `X > XMAX`, bit `0010` is set;
  * - if `Y < YMIN`, bit `0100` is set;
  * - if `Y > YMAX`, bit `1000` is set.
+ *
+ * As the limits are sorted, at most one of the two bits for a given axis can
+ * be set, the bits are thus combined without branching which lets the compiler
+ * vectorize loops computing the bits of many points.  Each argument is
+ * evaluated twice at most.
  */
 #define MP_CLIP_TBRL(X, Y, XMIN, XMAX, YMIN, YMAX)      \
-    (((X) < (XMIN) ? 1 :                                \
-      ((X) > (XMAX) ? 2 : 0)) |                         \
-     ((Y) < (YMIN) ? 4 :                                \
-      ((Y) > (YMAX) ? 8 : 0)))
+    (((unsigned)((X) < (XMIN))     ) |                  \
+     ((unsigned)((X) > (XMAX)) << 1) |                  \
+     ((unsigned)((Y) < (YMIN)) << 2) |                  \
+     ((unsigned)((Y) > (YMAX)) << 3))
 
 /**
  * @def MP_CLIP_INTERSECT(T,REJECT,X1C,Y1C,DX,DY,X1,Y1,X2,Y2,
@@ -656,7 +976,7 @@ extern int MpClipNextDbl(MpClipStateDbl* w, double x, double y);
             _y1 = (Y2) + (_x1 - (X2))*((DY)/(DX));                      \
         }                                                               \
         /* Last move has left the point inside the window? */           \
-        if (_y1 > (YMIN) || _y1 > (YMAX)) {                             \
+        if (_y1 < (YMIN) || _y1 > (YMAX)) {                             \
             REJECT;                                                     \
         }                                                               \
         X1C = _x1;                                                      \
@@ -679,11 +999,11 @@ extern int MpClipNextDbl(MpClipStateDbl* w, double x, double y);
             E(W,ymin) = E(B,ymax);                      \
             E(W,ymax) = E(B,ymin);                      \
         }                                               \
-        E(w,c2) = MP_CLIP_TBRL(X, Y,                    \
-                               E(w,xmin), E(w,xmax),    \
-                               E(w,ymin), E(w,ymax));   \
-        E(w,x2) = (X);                                  \
-        E(w,y2) = (Y);                                  \
+        E(W,c2) = MP_CLIP_TBRL(X, Y,                    \
+                               E(W,xmin), E(W,xmax),    \
+                               E(W,ymin), E(W,ymax));   \
+        E(W,x2) = (X);                                  \
+        E(W,y2) = (Y);                                  \
     } while (0)
 
 #define MP_INITIALIZE_CLIP(W,X,Y,B) \
@@ -693,11 +1013,11 @@ extern int MpClipNextDbl(MpClipStateDbl* w, double x, double y);
 
 #define _MP_RESTART_CLIP(E,W,X,Y)                       \
     do {                                                \
-        E(w,c2) = MP_CLIP_TBRL(X, Y,                    \
-                               E(w,xmin), E(w,xmax),    \
-                               E(w,ymin), E(w,ymax));   \
-        E(w,x2) = (X);                                  \
-        E(w,y2) = (Y);                                  \
+        E(W,c2) = MP_CLIP_TBRL(X, Y,                    \
+                               E(W,xmin), E(W,xmax),    \
+                               E(W,ymin), E(W,ymax));   \
+        E(W,x2) = (X);                                  \
+        E(W,y2) = (Y);                                  \
     } while (0)
 
 #define MP_RESTART_CLIP(W,X,Y) \
@@ -752,16 +1072,20 @@ typedef enum {
  */
 typedef struct _MpDevice MpDevice;
 
-/*
- * Coordinate transform (must match opaque definition in <muPlotXForms.h>).
- */
-typedef struct _MpAffineTransformDbl MpCoordinateTransform;
-
 /**
  * Install a graphic driver.
  *
  * Call this routine to install a graphic driver.  Installed drivers may be
  * uninstalled by calling MpUninstallDriver() or MpUninstallAllDrivers().
+ * Installing a driver with the same identifier as an installed one replaces
+ * the latter.
+ *
+ * The registry of drivers may be safely used by concurrent threads: looking
+ * up drivers in MpOpenDevice() or MpListDrivers() takes no lock, while
+ * installing or uninstalling drivers, which is expected to be rare,
+ * publishes a new copy of the registry.  Distinct devices share no mutable
+ * state, hence different threads may draw on different devices without any
+ * synchronization.
  *
  * @param ident  The identifier of the graphic driver.
 
@@ -777,150 +1101,1304 @@ extern MpStatus MpInstallDriver(const char* ident,
                                                  const char* ident,
                                                  const char* arg));
 
+/**
+ * Uninstall a graphic driver.
+ *
+ * @param ident  The identifier of the graphic driver.
+ *
+ * @return A standard status: `MP_OK` on success, `MP_NOT_FOUND` if no such
+ *         driver is installed, another error code on failure.
+ */
 extern MpStatus MpUninstallDriver(const char* ident);
+
+/**
+ * Uninstall all graphic drivers.
+ *
+ * This function also frees all the copies of the registry of drivers kept
+ * since they may be in use by concurrent readers.  It must therefore not be
+ * called while other threads may be opening devices or listing drivers.
+ *
+ * @return A standard status.
+ */
 extern MpStatus MpUninstallAllDrivers(void);
+
 extern MpStatus MpListDrivers(MpInt* argc, char*** argv);
 extern MpStatus MpFreeDriverList(char** argv);
 
-extern MpStatus MpCheckPageSettings(MpDevice* dev);
-extern MpStatus MpCheckMethods(MpDevice* dev);
-extern MpDevice* MpAllocateDevice(size_t size);
+/**
+ * Open a device of the XFig driver.
+ *
+ * This function is the method to install the XFig driver with
+ * MpInstallDriver().  The argument of MpOpenDevice() is the name of the
+ * output file.
+ */
+extern MpStatus MpOpenXFigDevice(MpDevice** devptr, const char* ident,
+                                 const char* arg);
 
 /**
- * Open a new graphic device.
+ * Open a device of the PDF driver.
  *
- * Call this routine to open a new graphic device.  The caller is responsible
- * of eventually calling MpCloseDevice() to close the graphic device and free
- * all associated ressources.
+ * This function is the method to install the PDF driver with
+ * MpInstallDriver().  The argument of MpOpenDevice() is the name of the
+ * output file.  Each page is written, with a compressed content stream, when
+ * it ends; the document is finished when the device is closed or reopened.
+ * Graphics drawn after the last ended page make a final page.
+ */
+extern MpStatus MpOpenPDFDevice(MpDevice** devptr, const char* ident,
+                                const char* arg);
+
+/**
+ * Open a device of the raster driver.
+ *
+ * This function is the method to install the raster driver with
+ * MpInstallDriver().  Graphics are drawn in memory in a buffer of RGBA
+ * pixels.  The argument of MpOpenDevice() has the form
+ * `[WIDTHxHEIGHT][:FILENAME]` to specify the size of the raster in pixels
+ * (640×480 by default) and the name of the file where to save the image when
+ * a page ends or when the device is closed (as a PNG image if the name ends
+ * with `.png`, as a PPM image otherwise).  Without a file name, the image is
+ * only available via MpGetRasterPixels().
+ */
+extern MpStatus MpOpenRasterDevice(MpDevice** devptr, const char* ident,
+                                   const char* arg);
+
+/**
+ * Get the pixels of a raster device.
  *
- * @param devptr    The address to store the new device structure.
- * @param ident     The identifier of the graphic device.
- * @param arg       Supplied argument like the filename.
+ * The pixels are stored row by row, the first row being at the top of the
+ * image.  The value of a pixel is `R | G<<8 | B<<16 | A<<24` with `R`, `G`,
+ * `B` and `A` the red, green, blue and alpha levels in the range [0,255].
+ *
+ * @param dev     The graphic device (must belong to the raster driver).
+ * @param pixels  The address to store the address of the pixels.
+ * @param width   The address to store the number of pixels per row.
+ * @param height  The address to store the number of rows.
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpOpenDevice(MpDevice** devptr, const char* ident, const char* arg);
+extern MpStatus MpGetRasterPixels(MpDevice* dev, const uint32_t** pixels,
+                                  MpInt* width, MpInt* height);
 
 /**
- * Close graphic device.
+ * Set the number of threads used by a raster device.
  *
- * Call this routine to close a graphic device.  This releases all associated
- * ressources.  As a consequence, the device can no longer be used.
+ * With more than one thread, graphic primitives are not drawn immediately by
+ * a raster device: they are recorded and binned into tiles of the raster.
+ * The tiles are rendered in parallel when the page ends, when buffering is
+ * stopped, when a color of the colormap is changed, when too many primitives
+ * have been recorded or when MpGetRasterPixels() is called.  The resulting
+ * pixels are the same as with a single thread.  The threads are internal to
+ * the driver, the caller's thread is one of them.
  *
- * @param devptr    The graphic device.
+ * @param dev       The graphic device (must belong to the raster driver).
+ * @param nthreads  The number of threads, 1 to draw the primitives
+ *                  immediately, 0 to use as many threads as there are
+ *                  processors.
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpCloseDevice(MpDevice** devptr);
+extern MpStatus MpSetRasterThreads(MpDevice* dev, MpInt nthreads);
 
 /**
- * Set page size.
+ * Open a display list device.
+ *
+ * This function is the method to install the display list driver with
+ * MpInstallDriver().  A display list device records all the graphics drawn
+ * on it (including the changes of settings and the pages) in a compact
+ * buffer which can be replayed any number of times on other devices by
+ * MpReplay() or MpReplayRegion().  The argument of MpOpenDevice() has the
+ * form `[WIDTHxHEIGHT]` to specify the size of the device in samples
+ * (1000×1000 by default).
+ */
+extern MpStatus MpOpenDisplayListDevice(MpDevice** devptr, const char* ident,
+                                        const char* arg);
+
+/**
+ * Replay a display list on a device.
  *
- * @param dev     The graphic device.
- * @param width   The page width in millimeters.
- * @param height  The page height in millimeters.
+ * This function draws on device `dev` all the graphics recorded by the
+ * display list device `list`.  The settings of `dev` are first set to the
+ * ones of `list` when recording started.  The device coordinates of the list
+ * are mapped to the ones of `dev` so that the NDC are preserved.
+ *
+ * @param list    The display list device.
+ * @param dev     The target device (must be different from `list`).
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpSetPageSize(MpDevice* dev, MpReal width, MpReal height);
+extern MpStatus MpReplay(MpDevice* list, MpDevice* dev);
 
 /**
- * Get page size.
+ * Replay a region of a display list on a device.
  *
- * @param dev     The graphic device.
- * @param width   The address to store the page width in millimeters.
- * @param height  The address to store the page height in millimeters.
+ * This function is the same as MpReplay() except that the primitives whose
+ * bounding boxes do not intersect the rectangle of corners `(x0,y0)` and
+ * `(x1,y1)` (in the device coordinates of the list) are skipped.  This is
+ * intended for redrawing a damaged region of the target device; changes of
+ * settings are always replayed.
+ */
+extern MpStatus MpReplayRegion(MpDevice* list, MpDevice* dev,
+                               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+
+/**
+ * Clear a display list.
+ *
+ * This function forgets all the graphics recorded by a display list device.
+ * The memory is kept for subsequent recordings.  The current settings of the
+ * device become its initial settings for MpReplay().
+ *
+ * @param list    The display list device.
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpGetPageSize(MpDevice* dev, MpReal* width, MpReal* height);
+extern MpStatus MpClearDisplayList(MpDevice* list);
 
 /**
- * Set device resolution.
+ * Get the number of commands recorded by a display list device.
  *
- * @param dev    The graphic device.
- * @param xpmm   The number of horizontal samples per millimeter.
- * @param ypmm   The number of vertical samples per millimeter.
+ * @param list    The display list device.
+ * @param ncmds   The address to store the number of commands.
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpSetResolution(MpDevice* dev, MpReal xpmm, MpReal ypmm);
+extern MpStatus MpGetDisplayListSize(MpDevice* list, MpInt* ncmds);
 
 /**
- * Get device resolution.
+ * Open a page recorder.
  *
- * @param dev    The graphic device.
- * @param xpmm   The address to store the number of horizontal samples per
- *               millimeter.
- * @param ypmm   The address to store number of vertical samples per
- *               millimeter.
+ * A page recorder is a display list device which mirrors the geometry, the
+ * colormap, the coordinate transforms, the axis scales and the current
+ * settings of a target device.  It records the graphics of one page
+ * independently of the target, which is not used until the pages are merged
+ * by MpMergePages().  Different page recorders can be opened, filled and
+ * closed by different threads at the same time.  MpBeginPage() and
+ * MpEndPage() must not be called on a page recorder.
+ *
+ * @param devptr  The address to store the new device.
+ * @param target  The device where the page will be merged.
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpGetResolution(MpDevice* dev, MpReal* xpmm, MpReal* ypmm);
+extern MpStatus MpOpenPageRecorder(MpDevice** devptr, MpDevice* target);
 
 /**
- * Get the number of samples in a page.
+ * Merge recorded pages into a device.
  *
- * @param dev     The graphic device.
- * @param width   The address to store the number of horizontal samples.
- * @param height  The address to store number of vertical samples.
+ * This function writes the pages recorded by `n` page recorders to device
+ * `dev` in the order of the array: for each recorder, a page is begun, the
+ * recorder is replayed and the page is ended.
+ *
+ * @param dev     The target device.
+ * @param pages   The page recorders.
+ * @param n       The number of page recorders.
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpGetNumberOfSamples(MpDevice* dev, MpPoint* width, MpPoint* height);
-
-extern MpStatus MpDrawCellsHelper(MpDevice* dev, const MpColorIndex* z,
-                                  MpInt n1, MpInt n2, MpInt stride,
-                                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpMergePages(MpDevice* dev, MpDevice* const* pages, MpInt n);
 
-extern MpStatus MpSetColorIndex(MpDevice* dev, MpColorIndex ci);
-extern MpStatus MpGetColorIndex(MpDevice* dev, MpColorIndex* ci);
+/**
+ * Function to draw a page.
+ *
+ * @param ctx     The context given to MpDrawPages().
+ * @param dev     The page recorder where to draw the page.
+ * @param page    The page number (starting at 1).
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+typedef MpStatus MpPageDrawer(void* ctx, MpDevice* dev, MpInt page);
 
-extern MpStatus MpSetColor(MpDevice* dev, MpColorIndex ci,
-                           MpReal rd, MpReal gr, MpReal bl);
-extern MpStatus MpGetColor(MpDevice* dev, MpColorIndex ci,
-                           MpReal* rd, MpReal* gr, MpReal* bl);
+/**
+ * Draw pages in parallel.
+ *
+ * This function calls `draw(ctx, rec, page)` for `page = 1, ..., npages` in
+ * up to `nthreads` threads (the caller's thread is one of them), each page
+ * being drawn on its own page recorder of device `dev`, and merges the pages
+ * into `dev` in page order.  The pages are processed by batches of
+ * `nthreads` pages so that at most `nthreads` pages are recorded at the same
+ * time.  All pages start with the settings that `dev` has when this function
+ * is called, hence the output does not depend on the number of threads.
+ * Processing stops at the first page that cannot be drawn, the pages before
+ * it are merged.
+ *
+ * @param dev       The target device.
+ * @param npages    The number of pages.
+ * @param draw      The function to draw a page, it must not use `dev`.
+ * @param ctx       The context for `draw`.
+ * @param nthreads  The number of threads, 0 to use as many threads as there
+ *                  are processors.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawPages(MpDevice* dev, MpInt npages, MpPageDrawer* draw,
+                            void* ctx, MpInt nthreads);
 
-extern MpStatus MpSetLineStyle(MpDevice* dev, MpLineStyle ls);
-extern MpStatus MpGetLineStyle(MpDevice* dev, MpLineStyle* ls);
+/**
+ * Open a metafile device.
+ *
+ * This function is the method to install the metafile driver with
+ * MpInstallDriver().  A metafile device writes all the graphics drawn on it
+ * (including the changes of settings and the pages) as compact binary
+ * records in a file which ends with an index of the pages.  The file can be
+ * read back by MpOpenMetafile() to replay the graphics on other devices.  The
+ * argument of MpOpenDevice() has the form `[WIDTHxHEIGHT:]FILENAME` to
+ * specify the name of the file and the size of the device in samples
+ * (1000×1000 by default).  The records are written to the file at the end of
+ * each page, by MpFlush() and when the device is closed; the file is only
+ * readable once the device has been closed.
+ */
+extern MpStatus MpOpenMetafileDevice(MpDevice** devptr, const char* ident,
+                                     const char* arg);
 
-extern MpStatus MpSetLineWidth(MpDevice* dev, MpReal lw);
-extern MpStatus MpGetLineWidth(MpDevice* dev, MpReal* lw);
+/*
+ * Opaque structure for a metafile mapped in memory.
+ */
+typedef struct _MpMetafile MpMetafile;
 
 /**
- * Define standard colors.
+ * Open a metafile for reading.
  *
- * This function defines the 10 standard colors in the primary colormap of a
- * given device.  This function should only be called at initialization time.
+ * The file is mapped in memory, nothing is decoded until something is
+ * replayed.
  *
- * @param dev     The graphic device.
- * @param dark    True to define a dark (i.e., black) background.
+ * @param mfptr     The address to store the metafile (set to `NULL` on
+ *                  error).
+ * @param filename  The name of the file written by a metafile device.
  *
- * @return A standard status: `MP_OK` on success, an error code on failure
- * (e.g., `MP_BAD_ADDRESS` is the colormap is not allocated or `MP_BAD_SIZE` is
- * the size of the primary colormap is insufficient.
+ * @return A standard status: `MP_OK` on success, an error code on failure.
  */
-extern MpStatus MpDefineStandardColors(MpDevice* dev, MpBool dark);
-
-extern void MpEncodeColor(MpColor* dst, MpReal rd, MpReal gr, MpReal bl);
+extern MpStatus MpOpenMetafile(MpMetafile** mfptr, const char* filename);
 
 /**
- * Set the number of colors.
- *
- * This function attempts to change the number of colors in the primary and/or
- * secondary colormaps.
- *
- * Unsuccessful operation does not mean that nothing has been done: in case of
- * error, the user may call MpGetColormapSizes() to figure out the actual
- * number of colors that have been allocated.
+ * Close a metafile.
  *
- * @param dev     The graphic device.
+ * @param mfptr   The address of the metafile, set to `NULL` on return.
  *
- * @param n1      The number of colors for the primary colormap (for most
- *                devices this cannot be changed).
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpCloseMetafile(MpMetafile** mfptr);
+
+/**
+ * Get the number of pages of a metafile.
  *
- * @param n2      The number of colors for the secondary colormap.
+ * @param mf      The metafile.
+ * @param npages  The address to store the number of pages.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetMetafilePages(const MpMetafile* mf, MpInt* npages);
+
+/**
+ * Replay a metafile on a device.
+ *
+ * This function draws on device `dev` all the graphics recorded in a
+ * metafile, starting with the settings of the metafile device when it was
+ * opened.  As for MpReplay(), the NDC are preserved.
+ *
+ * @param mf      The metafile.
+ * @param dev     The target device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpReplayMetafile(const MpMetafile* mf, MpDevice* dev);
+
+/**
+ * Replay a page of a metafile on a device.
+ *
+ * This function draws on device `dev` the graphics of a given page of a
+ * metafile.  The pages are located with the index of the metafile, so the
+ * previous pages are not decoded.  The settings at the beginning of the page
+ * and the colors changed before are restored first.
+ *
+ * @param mf      The metafile.
+ * @param page    The page number (starting at 1).
+ * @param dev     The target device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpReplayMetafilePage(const MpMetafile* mf, MpInt page,
+                                     MpDevice* dev);
+
+/**
+ * Open an asynchronous device.
+ *
+ * This function wraps an open device `dev` into a new device whose methods
+ * queue the graphics (with a copy of their coordinates) in a lock-free ring
+ * buffer.  The queued graphics are processed by the methods of `dev` in a
+ * dedicated thread, so that the caller does not wait for the output.  If the
+ * ring buffer is full, the caller waits until there is enough space.  Call
+ * MpFlush() to wait until all graphics have been processed, errors in the
+ * driver thread are reported by the next calls.
+ *
+ * On success, `dev` belongs to the new device and is closed with it; `dev`
+ * must not be used directly except after calling MpFlush() and before
+ * drawing anything else.  On failure, `dev` is left unchanged.
+ *
+ * @param devptr  The address to store the new device.
+ * @param dev     The device to wrap.
+ * @param size    The size of the ring buffer in bytes (0 for a default size
+ *                of 4 MiB).
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpOpenAsyncDevice(MpDevice** devptr, MpDevice* dev,
+                                  size_t size);
+
+extern MpStatus MpCheckPageSettings(MpDevice* dev);
+extern MpStatus MpCheckMethods(MpDevice* dev);
+extern MpDevice* MpAllocateDevice(size_t size);
+
+/**
+ * Initialize a new graphic device.
+ *
+ * This function is called by MpOpenDevice() to check and fix the settings of
+ * a device freshly opened by a driver and to call its `initialize()` method.
+ * It is only needed by code opening devices by other means.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpInitializeDevice(MpDevice* dev);
+
+/**
+ * Open a new graphic device.
+ *
+ * Call this routine to open a new graphic device.  The caller is responsible
+ * of eventually calling MpCloseDevice() to close the graphic device and free
+ * all associated ressources.
+ *
+ * @param devptr    The address to store the new device structure.
+ * @param ident     The identifier of the graphic device.
+ * @param arg       Supplied argument like the filename.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpOpenDevice(MpDevice** devptr, const char* ident, const char* arg);
+
+/**
+ * Close graphic device.
+ *
+ * Call this routine to close a graphic device.  This releases all associated
+ * ressources.  As a consequence, the device can no longer be used.
+ *
+ * @param devptr    The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpCloseDevice(MpDevice** devptr);
+
+/**
+ * Reopen a graphic device on a new output.
+ *
+ * Call this routine to finish the current output of a graphic device, as
+ * MpCloseDevice() would do, and start a new output given by `arg`, as
+ * MpOpenDevice() would do with the same driver, while keeping the device
+ * structure and its allocated resources (colormap, encoded colors, scratch
+ * buffers and workspace).  This avoids the setup costs when producing many
+ * figures in a row.  The page number and group level are reset.  If `reset`
+ * is false, all other settings (colormap, color index, line style and width,
+ * coordinate transform, etc.) are kept; otherwise, the device is set as if it
+ * has just been open.  Any polyline being drawn by pieces is dropped.
+ *
+ * If this function fails, the device can only be closed.
+ *
+ * @param dev       The graphic device.
+ * @param arg       Supplied argument like the filename.
+ * @param reset     Whether to reset the settings.
+ *
+ * @return A standard status: `MP_OK` on success, `MP_NOT_IMPLEMENTED` if
+ *         the driver of the device does not support this operation, an
+ *         error code on failure.
+ */
+extern MpStatus MpReopenDevice(MpDevice* dev, const char* arg, MpBool reset);
+
+/**
+ * Set page size.
+ *
+ * @param dev     The graphic device.
+ * @param width   The page width in millimeters.
+ * @param height  The page height in millimeters.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetPageSize(MpDevice* dev, MpReal width, MpReal height);
+
+/**
+ * Get page size.
+ *
+ * @param dev     The graphic device.
+ * @param width   The address to store the page width in millimeters.
+ * @param height  The address to store the page height in millimeters.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetPageSize(MpDevice* dev, MpReal* width, MpReal* height);
+
+/**
+ * Set device resolution.
+ *
+ * @param dev    The graphic device.
+ * @param xpmm   The number of horizontal samples per millimeter.
+ * @param ypmm   The number of vertical samples per millimeter.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetResolution(MpDevice* dev, MpReal xpmm, MpReal ypmm);
+
+/**
+ * Get device resolution.
+ *
+ * @param dev    The graphic device.
+ * @param xpmm   The address to store the number of horizontal samples per
+ *               millimeter.
+ * @param ypmm   The address to store number of vertical samples per
+ *               millimeter.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetResolution(MpDevice* dev, MpReal* xpmm, MpReal* ypmm);
+
+/**
+ * Get the number of samples in a page.
+ *
+ * @param dev     The graphic device.
+ * @param width   The address to store the number of horizontal samples.
+ * @param height  The address to store number of vertical samples.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetNumberOfSamples(MpDevice* dev, MpPoint* width, MpPoint* height);
+
+/**
+ * Start buffering graphical output.
+ *
+ * Buffering may speed-up drawing operations or make sure that a graphic is
+ * complete before showing it.  The effects depend on the driver.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpStartBuffering(MpDevice* dev);
+
+/**
+ * Stop buffering graphical output.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpStopBuffering(MpDevice* dev);
+
+/**
+ * Wait until a device has processed all graphics.
+ *
+ * Some devices (like the ones opened by MpOpenAsyncDevice()) process the
+ * graphics asynchronously.  This function is a synchronization point: on
+ * return, all graphics drawn so far have been processed.  For other devices,
+ * this function does nothing.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ *         (for asynchronous devices, the first error that occurred since the
+ *         last call).
+ */
+extern MpStatus MpFlush(MpDevice* dev);
+
+/**
+ * Begin a new page of graphics.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpBeginPage(MpDevice* dev);
+
+/**
+ * End the current page of graphics.
+ *
+ * Some drivers (e.g., XFig) only write a page when it is ended (or when the
+ * device is closed) and may not accept further drawing.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpEndPage(MpDevice* dev);
+
+/**
+ * Set the data to NDC coordinate transform.
+ *
+ * This function sets the coordinate transform `A` which converts user-defined
+ * (data) coordinates into normalized device coordinates (NDC).  The
+ * transform from user-defined coordinates to device coordinates is then `C =
+ * B⋅A` with `B` the NDC to device transform maintained by the driver.  `C` is
+ * only recomputed when needed, that is when `A` or `B` have changed.
+ *
+ * @param dev     The graphic device.
+ * @param A       The data to NDC coordinate transform.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetCoordinateTransform(MpDevice* dev,
+                                         const MpCoordinateTransform* A);
+
+/**
+ * Get the data to NDC coordinate transform.
+ *
+ * @param dev     The graphic device.
+ * @param A       The address to store the data to NDC coordinate transform.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetCoordinateTransform(MpDevice* dev,
+                                         MpCoordinateTransform* A);
+
+/**
+ * Set the axis scales.
+ *
+ * The axis scales are applied to the user-defined coordinates of the
+ * polylines, polygons and points before the data to NDC coordinate transform
+ * (see MpSetCoordinateTransform()), so that logarithmic axes do not require
+ * scaling the data beforehand.  The scaling is done by blocks of vertices
+ * in the same pass as the transform, clipping and rounding.  Points whose
+ * scaled coordinates are not finite (e.g. non-positive values on a
+ * logarithmic axis) are skipped and break polylines.
+ *
+ * @param dev     The graphic device.
+ * @param xs      The scale of the abscissae, `NULL` for a linear scale.
+ * @param ys      The scale of the ordinates, `NULL` for a linear scale.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetAxisScales(MpDevice* dev, const MpAxisScale* xs,
+                                const MpAxisScale* ys);
+
+/**
+ * Get the axis scales.
+ *
+ * @param dev     The graphic device.
+ * @param xs      The address to store the scale of the abscissae.
+ * @param ys      The address to store the scale of the ordinates.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetAxisScales(MpDevice* dev, MpAxisScale* xs,
+                                MpAxisScale* ys);
+
+/**
+ * Set the NDC to device coordinate transform.
+ *
+ * This function is intended for drivers to set the coordinate transform `B`
+ * which converts normalized device coordinates (NDC) into device coordinates.
+ * By default, the NDC `(0,0)` and `(1,1)` are respectively mapped to the
+ * device coordinates `(0,0)` and `(W-1,H-1)` with `W` and `H` the number of
+ * horizontal and vertical samples (an axis is flipped if the corresponding
+ * resolution is negative).  The driver shall call this function whenever the
+ * page size or the resolution of the device changes.
+ *
+ * @param dev     The graphic device.
+ * @param B       The NDC to device coordinate transform.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetNDCToDeviceTransform(MpDevice* dev,
+                                          const MpCoordinateTransform* B);
+
+/**
+ * Draw a polyline.
+ *
+ * This function draws a polyline with the current settings of the device.
+ * The coordinates of the vertices are converted into device coordinates by
+ * the data to device coordinate transform, clipped against the limits of the
+ * device and rounded to the nearest device sample in a single pass, the
+ * resulting pieces are drawn by the driver.  Memory needed for the conversion
+ * is owned by the device and reused from call to call.  Non-finite
+ * coordinates break the polyline.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawPolylineFlt(MpDevice* dev,
+                                  const float* x, const float* y, MpInt n);
+
+/**
+ * Draw a polyline.
+ *
+ * This function is identical to MpDrawPolylineFlt() but for double precision
+ * coordinates.
+ */
+extern MpStatus MpDrawPolylineDbl(MpDevice* dev,
+                                  const double* x, const double* y, MpInt n);
+
+/**
+ * Draw an indexed polyline.
+ *
+ * This function draws the same polyline as MpDrawPolylineFlt() but uses the
+ * bounds of chunks of the polyline, computed once by
+ * MpInitializeChunkBoundsFlt(), to skip the chunks which are outside the
+ * device whatever the current coordinate transform.  This is much faster for
+ * large datasets when only a small part is visible (e.g., when zooming or
+ * panning).
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices, must be `cb->count`.
+ * @param cb      The bounds of the chunks of the polyline.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawIndexedPolylineFlt(MpDevice* dev,
+                                         const float* x, const float* y,
+                                         MpInt n, const MpChunkBoundsFlt* cb);
+
+/**
+ * Draw an indexed polyline.
+ *
+ * This function is identical to MpDrawIndexedPolylineFlt() but for double
+ * precision coordinates.
+ */
+extern MpStatus MpDrawIndexedPolylineDbl(MpDevice* dev,
+                                         const double* x, const double* y,
+                                         MpInt n, const MpChunkBoundsDbl* cb);
+
+/**
+ * Begin a polyline drawn by pieces.
+ *
+ * This function starts a polyline whose vertices are provided by successive
+ * calls to MpAppendPolylineFlt() or MpAppendPolylineDbl() until
+ * MpEndPolyline() is called.  This is useful to draw data as it is acquired.
+ * Each call transforms, clips and rounds the appended vertices and sends the
+ * completed pieces to the driver, so the memory needed does not depend on the
+ * number of vertices.  The result is the same as drawing all the vertices with
+ * a single call to MpDrawPolylineFlt() or MpDrawPolylineDbl() providing the
+ * settings of the device are not changed before MpEndPolyline() is called.
+ * Other graphics can be drawn in the meantime.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ * (e.g., `MP_NOT_PERMITTED` if a polyline has already begun).
+ */
+extern MpStatus MpBeginPolyline(MpDevice* dev);
+
+/**
+ * Append vertices to a polyline drawn by pieces.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ * (e.g., `MP_NOT_PERMITTED` if no polyline has begun).
+ *
+ * @see MpBeginPolyline().
+ */
+extern MpStatus MpAppendPolylineFlt(MpDevice* dev,
+                                    const float* x, const float* y, MpInt n);
+
+/**
+ * Append vertices to a polyline drawn by pieces.
+ *
+ * This function is identical to MpAppendPolylineFlt() but for double
+ * precision coordinates.
+ */
+extern MpStatus MpAppendPolylineDbl(MpDevice* dev,
+                                    const double* x, const double* y, MpInt n);
+
+/**
+ * End a polyline drawn by pieces.
+ *
+ * This function sends the last piece of the polyline started by
+ * MpBeginPolyline() to the driver.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ * (e.g., `MP_NOT_PERMITTED` if no polyline has begun).
+ */
+extern MpStatus MpEndPolyline(MpDevice* dev);
+
+/**
+ * Draw a polygon.
+ *
+ * This function draws a closed (filled) polygon with the current settings of
+ * the device.  The coordinates of the vertices are converted into device
+ * coordinates by the data to device coordinate transform, the polygon is
+ * clipped against the limits of the device by MpClipPolygonDbl() and the
+ * coordinates are rounded to the nearest device sample before being drawn by
+ * the driver.  Vertices with non-finite coordinates are skipped.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawPolygonFlt(MpDevice* dev,
+                                 const float* x, const float* y, MpInt n);
+
+/**
+ * Draw a polygon.
+ *
+ * This function is identical to MpDrawPolygonFlt() but for double precision
+ * coordinates.
+ */
+extern MpStatus MpDrawPolygonDbl(MpDevice* dev,
+                                 const double* x, const double* y, MpInt n);
+
+/**
+ * Draw points.
+ *
+ * This function draws points (e.g., the markers of a scatter plot) with the
+ * current settings of the device.  The coordinates of the points are
+ * converted into device coordinates by the data to device coordinate
+ * transform and rounded to the nearest device sample, points outside the
+ * device or with non-finite coordinates are discarded.  The remaining points
+ * are sent to the driver by large batches.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the points.
+ * @param y       The ordinates of the points.
+ * @param n       The number of points.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawPointsFlt(MpDevice* dev,
+                                const float* x, const float* y, MpInt n);
+
+/**
+ * Draw points.
+ *
+ * This function is identical to MpDrawPointsFlt() but for double precision
+ * coordinates.
+ */
+extern MpStatus MpDrawPointsDbl(MpDevice* dev,
+                                const double* x, const double* y, MpInt n);
+
+/**
+ * Enable or disable decimation of polylines.
+ *
+ * When decimation is enabled, the vertices of the polylines drawn by
+ * MpDrawPolylineFlt() or MpDrawPolylineDbl() are decimated by
+ * MpDecimatePolyline() after being converted into device coordinates.  This
+ * saves a lot of work in the driver when many consecutive vertices fall in the
+ * same device column (e.g., a long time series) while yielding the same
+ * graphic.  Decimation is disabled by default.
+ *
+ * @param dev     The graphic device.
+ * @param flag    Whether to decimate polylines.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetPolylineDecimation(MpDevice* dev, MpBool flag);
+
+/**
+ * Query whether polylines are decimated.
+ *
+ * @param dev     The graphic device.
+ * @param flag    The address to store whether polylines are decimated.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetPolylineDecimation(MpDevice* dev, MpBool* flag);
+
+/**
+ * Structure to store the state of a polyline decimator.
+ *
+ * A decimator collects consecutive vertices of a polyline having the same
+ * abscissa (that is, in device coordinates, belonging to the same column) and
+ * only keeps the first, the lowest, the highest and the last one (in their
+ * order of occurrence) which is sufficient to draw the same polyline.  The
+ * members of this structure are private.
+ */
+typedef struct _MpDecimator {
+    MpInt count; /* Number of vertices in the current column. */
+    MpBool minFirst; /* Lowest vertex occurs before highest one? */
+    MpPoint x; /* Abscissa of the current column. */
+    MpPoint yfirst, ymin, ymax, ylast; /* Ordinates in the current column. */
+} MpDecimator;
+
+/**
+ * Initialize a polyline decimator.
+ *
+ * @param d       The address of the decimator.
+ */
+extern void MpInitializeDecimator(MpDecimator* d);
+
+/**
+ * Decimate a piece of polyline.
+ *
+ * This function feeds `n` vertices to the polyline decimator `d` and stores
+ * in `xout` and `yout` the vertices which have been decided.  The vertices of
+ * the last column are pending until a vertex in another column is fed or
+ * until MpFlushDecimator() is called, hence a polyline may be decimated by
+ * pieces.
+ *
+ * The output arrays must have at least `n + 3` elements.  If the decimator
+ * has just been initialized, the output arrays can have `n` elements and can
+ * be the same as the input arrays and, after MpFlushDecimator(), the whole
+ * decimated polyline fits in the input arrays.
+ *
+ * @param d       The address of the decimator.
+ * @param xout    The address to store the abscissae of the decided vertices.
+ * @param yout    The address to store the ordinates of the decided vertices.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return The number of decided vertices.
+ */
+extern MpInt MpDecimatePolyline(MpDecimator* d,
+                                MpPoint* xout, MpPoint* yout,
+                                const MpPoint* x, const MpPoint* y, MpInt n);
+
+/**
+ * Flush the pending vertices of a polyline decimator.
+ *
+ * This function stores the pending vertices of the decimator `d` in `xout`
+ * and `yout` (at most 4 of them) and re-initializes the decimator.
+ *
+ * @param d       The address of the decimator.
+ * @param xout    The address to store the abscissae of the pending vertices.
+ * @param yout    The address to store the ordinates of the pending vertices.
+ *
+ * @return The number of pending vertices.
+ */
+extern MpInt MpFlushDecimator(MpDecimator* d, MpPoint* xout, MpPoint* yout);
+
+/**
+ * Simplify a polyline in device coordinates.
+ *
+ * This function removes, in-place, the repeated vertices of a polyline and
+ * merges consecutive segments which are exactly collinear and have the same
+ * direction.  The simplified polyline has the same graphic as the original
+ * one.
+ *
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return The number of remaining vertices.
+ */
+extern MpInt MpSimplifyPolyline(MpPoint* x, MpPoint* y, MpInt n);
+
+/**
+ * Simplify a polygon in device coordinates.
+ *
+ * This function is similar to MpSimplifyPolyline() but for a closed polygon:
+ * the edge joining the last vertex to the first one is also considered.
+ *
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return The number of remaining vertices.
+ */
+extern MpInt MpSimplifyPolygon(MpPoint* x, MpPoint* y, MpInt n);
+
+/**
+ * Enable or disable simplification of polylines and polygons.
+ *
+ * When simplification is enabled, polylines and polygons are simplified by
+ * MpSimplifyPolyline() or MpSimplifyPolygon() after being converted into
+ * device coordinates and before being drawn by the driver.  Simplification is
+ * disabled by default.
+ *
+ * @param dev     The graphic device.
+ * @param flag    Whether to simplify polylines and polygons.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetVertexSimplification(MpDevice* dev, MpBool flag);
+
+/**
+ * Query whether polylines and polygons are simplified.
+ *
+ * @param dev     The graphic device.
+ * @param flag    The address to store whether polylines and polygons are
+ *                simplified.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpGetVertexSimplification(MpDevice* dev, MpBool* flag);
+
+/**
+ * Draw a polyline in device coordinates.
+ *
+ * This function draws a polyline whose vertices are given in device
+ * coordinates with the current settings of the device.  The vertices are
+ * decimated and/or simplified according to the settings of the device before
+ * being sent to the driver.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawDevicePolyline(MpDevice* dev,
+                                     const MpPoint* x, const MpPoint* y,
+                                     MpInt n);
+
+/**
+ * Draw a polygon in device coordinates.
+ *
+ * This function draws a closed polygon whose vertices are given in device
+ * coordinates with the current settings of the device.  The vertices are
+ * simplified according to the settings of the device before being sent to
+ * the driver.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawDevicePolygon(MpDevice* dev,
+                                    const MpPoint* x, const MpPoint* y,
+                                    MpInt n);
+
+/**
+ * Draw points in device coordinates.
+ *
+ * This function draws points whose coordinates are given in device
+ * coordinates with the current settings of the device.  All the points are
+ * sent to the driver in a single call.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissae of the points.
+ * @param y       The ordinates of the points.
+ * @param n       The number of points.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawDevicePoints(MpDevice* dev,
+                                   const MpPoint* x, const MpPoint* y,
+                                   MpInt n);
+
+/*
+ * Text is drawn with the strokes of the Hershey simplex Roman font which is
+ * compiled in the library.  Strings are encoded in UTF-8, the ASCII and the
+ * Latin-1 characters are available (accented letters are composed), other
+ * characters are drawn as a question mark.  The laid out strings are cached
+ * by the device so that strings drawn again (like the labels of the ticks of
+ * axes on every page) are not laid out again.
+ */
+
+/**
+ * Draw a text string.
+ *
+ * This function draws a text string with the current settings of the device.
+ * The strokes of the glyphs are sent to the driver as polylines.
+ *
+ * @param dev     The graphic device.
+ * @param x       The abscissa of the anchor point in data coordinates.
+ * @param y       The ordinate of the anchor point in data coordinates.
+ * @param text    The string (UTF-8 encoded).
+ * @param size    The height of capital letters in millimeters.
+ * @param angle   The angle of the baseline in degrees (counterclockwise on
+ *                the page).
+ * @param just    The horizontal justification: the anchor point is on the
+ *                baseline at the fraction `just` of the width of the string
+ *                (0 for left-justified text, 0.5 for centered text and 1
+ *                for right-justified text).
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpDrawText(MpDevice* dev, double x, double y,
+                           const char* text, double size, double angle,
+                           double just);
+
+/**
+ * Measure a text string.
+ *
+ * @param text    The string (UTF-8 encoded).
+ * @param size    The height of capital letters in millimeters.
+ * @param width   The address to store the width of the string in
+ *                millimeters.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpMeasureText(const char* text, double size, double* width);
+
+/**
+ * Draw colored cells.
+ *
+ * This function draws a rectangular array of colored cells.  The cells have
+ * `n1` columns and `n2` rows and fill the rectangle of corners `(x0,y0)` and
+ * `(x1,y1)` in device coordinates (the latter corner being excluded).  The
+ * colormap index of the cell at column `i1` and row `i2` (both starting at 0)
+ * is `z[i1 + i2*stride]`.  The edges of the cells are computed with exact
+ * integer arithmetic.  The driver may draw the cells as an image or as
+ * rectangles, consecutive cells of a row with the same color being merged.
+ *
+ * @param dev     The graphic device.
+ * @param z       The colormap indices of the cells.
+ * @param n1      The number of columns.
+ * @param n2      The number of rows.
+ * @param stride  The number of elements between successive rows of `z`
+ *                (at least `n1`).
+ * @param x0      The abscissa of the first corner.
+ * @param y0      The ordinate of the first corner.
+ * @param x1      The abscissa of the second corner.
+ * @param y1      The ordinate of the second corner.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ *         (`MP_OUT_OF_RANGE` if an index is invalid).
+ */
+extern MpStatus MpDrawCells(MpDevice* dev, const MpColorIndex* z,
+                            MpInt n1, MpInt n2, MpInt stride,
+                            MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+
+/**
+ * Draw colored cells with compact indices.
+ *
+ * These functions are identical to MpDrawCells() but for colormap indices
+ * stored as 8-bit or 16-bit unsigned integers.  This saves memory and
+ * bandwidth for large arrays of cells.
+ */
+extern MpStatus MpDrawCells8(MpDevice* dev, const uint8_t* z,
+                             MpInt n1, MpInt n2, MpInt stride,
+                             MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpDrawCells16(MpDevice* dev, const uint16_t* z,
+                              MpInt n1, MpInt n2, MpInt stride,
+                              MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+
+/*
+ * Mapping of values to colormap indices.  The scaled values of `vmin` and
+ * `vmax` are mapped to the indices `cmin` and `cmax`, the scaled values in
+ * between being evenly split among the colors; values outside this range are
+ * clamped and NaN values are mapped to `cbad`.  Having `vmax < vmin` reverses
+ * the order of the colors.
+ */
+typedef struct _MpValueMapping {
+    MpScaling scaling;
+    double vmin;          /* value mapped to the first color */
+    double vmax;          /* value mapped to the last color */
+    double softening;     /* softening of the asinh scaling (> 0) */
+    MpColorIndex cmin;    /* first color index */
+    MpColorIndex cmax;    /* last color index */
+    MpColorIndex cbad;    /* color index for NaN values */
+} MpValueMapping;
+
+/**
+ * Initialize a mapping of values to colormap indices.
+ *
+ * This function initializes a mapping of values to the secondary colormap of
+ * a device, that is to the indices `colormapSize1` to `colormapSize - 1`.
+ * NaN values are mapped to the background color and the softening of the
+ * asinh scaling is a tenth of `|vmax - vmin|`.  The members of the mapping may
+ * be changed afterwards.
+ *
+ * @param map     The mapping to initialize.
+ * @param dev     The graphic device.
+ * @param scaling The scaling function.
+ * @param vmin    The value mapped to the first color.
+ * @param vmax    The value mapped to the last color.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ *         (`MP_BAD_SETTINGS` if the device has no secondary colormap).
+ */
+extern MpStatus MpInitializeValueMapping(MpValueMapping* map, MpDevice* dev,
+                                         MpScaling scaling,
+                                         double vmin, double vmax);
+
+/**
+ * Map values to compact colormap indices.
+ *
+ * These functions map a rectangular array of values to colormap indices
+ * stored as 8-bit or 16-bit unsigned integers.  The value at column `i1` and
+ * row `i2` is `src[i1 + i2*srcStride]`, its index is stored in
+ * `dst[i1 + i2*dstStride]`.  Floating-point values are mapped by loops that
+ * the compiler can vectorize, 8-bit and 16-bit integer values are mapped by
+ * a lookup table.  Large arrays are split in bands of rows mapped by several
+ * threads.
+ *
+ * @param dst       The destination array of indices.
+ * @param dstStride The number of elements between successive rows of `dst`.
+ * @param src       The source array of values.
+ * @param srcStride The number of elements between successive rows of `src`.
+ * @param n1        The number of columns.
+ * @param n2        The number of rows.
+ * @param map       The mapping of values.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ *         (`MP_OUT_OF_RANGE` if an index of the mapping does not fit in the
+ *         destination type, `MP_BAD_ARGUMENT` if the bounds or the scaling of
+ *         the mapping are invalid).
+ */
+extern MpStatus MpMapValuesFlt8(uint8_t* dst, MpInt dstStride,
+                                const float* src, MpInt srcStride,
+                                MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesFlt16(uint16_t* dst, MpInt dstStride,
+                                 const float* src, MpInt srcStride,
+                                 MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesDbl8(uint8_t* dst, MpInt dstStride,
+                                const double* src, MpInt srcStride,
+                                MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesDbl16(uint16_t* dst, MpInt dstStride,
+                                 const double* src, MpInt srcStride,
+                                 MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesU88(uint8_t* dst, MpInt dstStride,
+                               const uint8_t* src, MpInt srcStride,
+                               MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesU816(uint16_t* dst, MpInt dstStride,
+                                const uint8_t* src, MpInt srcStride,
+                                MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesU168(uint8_t* dst, MpInt dstStride,
+                                const uint16_t* src, MpInt srcStride,
+                                MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesU1616(uint16_t* dst, MpInt dstStride,
+                                 const uint16_t* src, MpInt srcStride,
+                                 MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesI328(uint8_t* dst, MpInt dstStride,
+                                const int32_t* src, MpInt srcStride,
+                                MpInt n1, MpInt n2, const MpValueMapping* map);
+extern MpStatus MpMapValuesI3216(uint16_t* dst, MpInt dstStride,
+                                 const int32_t* src, MpInt srcStride,
+                                 MpInt n1, MpInt n2, const MpValueMapping* map);
+
+/**
+ * Draw an image.
+ *
+ * These functions map the values of an image to colormap indices and draw
+ * them as cells (see MpDrawCells()).  The indices are stored in the workspace
+ * of the device as 8-bit integers if they are all less than 256 and as 16-bit
+ * integers otherwise.
+ *
+ * @param dev     The graphic device.
+ * @param z       The values of the image.
+ * @param n1      The number of columns.
+ * @param n2      The number of rows.
+ * @param stride  The number of elements between successive rows of `z`
+ *                (at least `n1`).
+ * @param map     The mapping of values to colormap indices.
+ * @param x0      The abscissa of the first corner.
+ * @param y0      The ordinate of the first corner.
+ * @param x1      The abscissa of the second corner.
+ * @param y1      The ordinate of the second corner.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ *         (`MP_OUT_OF_RANGE` if an index of the mapping is not in the
+ *         colormap of the device).
+ */
+extern MpStatus MpDrawImageFlt(MpDevice* dev, const float* z,
+                               MpInt n1, MpInt n2, MpInt stride,
+                               const MpValueMapping* map,
+                               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpDrawImageDbl(MpDevice* dev, const double* z,
+                               MpInt n1, MpInt n2, MpInt stride,
+                               const MpValueMapping* map,
+                               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpDrawImageU8(MpDevice* dev, const uint8_t* z,
+                              MpInt n1, MpInt n2, MpInt stride,
+                              const MpValueMapping* map,
+                              MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpDrawImageU16(MpDevice* dev, const uint16_t* z,
+                               MpInt n1, MpInt n2, MpInt stride,
+                               const MpValueMapping* map,
+                               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpDrawImageI32(MpDevice* dev, const int32_t* z,
+                               MpInt n1, MpInt n2, MpInt stride,
+                               const MpValueMapping* map,
+                               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+
+/**
+ * Draw colored cells with rectangles.
+ *
+ * These functions implement the `drawCells()`, `drawCells8()` and
+ * `drawCells16()` methods of drivers which do not provide their own: each
+ * run of consecutive cells of a row having the same color is drawn by a
+ * single call to the `drawRectangle()` method and the color index is only
+ * changed when needed.  The color index set by the user is restored by the
+ * next drawing operation.
+ */
+extern MpStatus MpDrawCellsHelper(MpDevice* dev, const MpColorIndex* z,
+                                  MpInt n1, MpInt n2, MpInt stride,
+                                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpDrawCellsHelper8(MpDevice* dev, const uint8_t* z,
+                                   MpInt n1, MpInt n2, MpInt stride,
+                                   MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+extern MpStatus MpDrawCellsHelper16(MpDevice* dev, const uint16_t* z,
+                                    MpInt n1, MpInt n2, MpInt stride,
+                                    MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+
+/**
+ * Draw points one by one.
+ *
+ * This function implements the `drawPoints()` method of drivers which do not
+ * provide their own: the `drawPoint()` method is called for each point.
+ */
+extern MpStatus MpDrawPointsHelper(MpDevice* dev,
+                                   const MpPoint* x, const MpPoint* y,
+                                   MpInt n);
+
+/*
+ * The color index, line style and line width set by MpSetColorIndex(),
+ * MpSetLineStyle() and MpSetLineWidth() are only notified to the driver when
+ * something is drawn and if they differ from the settings of the driver.
+ * Hence, errors reported by the driver for these settings are returned by the
+ * next drawing function.  The MpGet...() functions yield the last settings
+ * set by the user.
+ */
+extern MpStatus MpSetColorIndex(MpDevice* dev, MpColorIndex ci);
+extern MpStatus MpGetColorIndex(MpDevice* dev, MpColorIndex* ci);
+
+extern MpStatus MpSetColor(MpDevice* dev, MpColorIndex ci,
+                           MpReal rd, MpReal gr, MpReal bl);
+extern MpStatus MpGetColor(MpDevice* dev, MpColorIndex ci,
+                           MpReal* rd, MpReal* gr, MpReal* bl);
+
+extern MpStatus MpSetLineStyle(MpDevice* dev, MpLineStyle ls);
+extern MpStatus MpGetLineStyle(MpDevice* dev, MpLineStyle* ls);
+
+extern MpStatus MpSetLineWidth(MpDevice* dev, MpReal lw);
+extern MpStatus MpGetLineWidth(MpDevice* dev, MpReal* lw);
+
+/**
+ * Define standard colors.
+ *
+ * This function defines the 10 standard colors in the primary colormap of a
+ * given device.  This function should only be called at initialization time.
+ *
+ * @param dev     The graphic device.
+ * @param dark    True to define a dark (i.e., black) background.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure
+ * (e.g., `MP_BAD_ADDRESS` is the colormap is not allocated or `MP_BAD_SIZE` is
+ * the size of the primary colormap is insufficient.
+ */
+extern MpStatus MpDefineStandardColors(MpDevice* dev, MpBool dark);
+
+extern void MpEncodeColor(MpColor* dst, MpReal rd, MpReal gr, MpReal bl);
+
+/**
+ * Set the number of colors.
+ *
+ * This function attempts to change the number of colors in the primary and/or
+ * secondary colormaps.
+ *
+ * Unsuccessful operation does not mean that nothing has been done: in case of
+ * error, the user may call MpGetColormapSizes() to figure out the actual
+ * number of colors that have been allocated.
+ *
+ * @param dev     The graphic device.
+ *
+ * @param n1      The number of colors for the primary colormap (for most
+ *                devices this cannot be changed).
+ *
+ * @param n2      The number of colors for the secondary colormap.
  *
  * @return A standard status: `MP_OK` on success, an error code on failure.
  */
@@ -928,6 +2406,105 @@ extern MpStatus MpSetColormapSizes(MpDevice* dev, MpInt n1, MpInt n2);
 
 extern MpStatus MpGetColormapSizes(MpDevice* dev, MpInt* n1, MpInt* n2);
 
+/*---------------------------------------------------------------------------*/
+/* PERFORMANCE COUNTERS */
+
+/* List of the methods of a device with their symbolic names.  The macro
+   `_MP_METHOD(a,b)` shall be defined appropriately before using this list. */
+#define _MP_METHOD_LIST                                         \
+    _MP_METHOD(MP_METHOD_INITIALIZE,        initialize)         \
+    _MP_METHOD(MP_METHOD_FINALIZE,          finalize)           \
+    _MP_METHOD(MP_METHOD_REOPEN,            reopen)             \
+    _MP_METHOD(MP_METHOD_SET_PAGE_SIZE,     setPageSize)        \
+    _MP_METHOD(MP_METHOD_SET_RESOLUTION,    setResolution)      \
+    _MP_METHOD(MP_METHOD_START_BUFFERING,   startBuffering)     \
+    _MP_METHOD(MP_METHOD_STOP_BUFFERING,    stopBuffering)      \
+    _MP_METHOD(MP_METHOD_FLUSH,             flush)              \
+    _MP_METHOD(MP_METHOD_BEGIN_PAGE,        beginPage)          \
+    _MP_METHOD(MP_METHOD_END_PAGE,          endPage)            \
+    _MP_METHOD(MP_METHOD_SET_COLORMAP_SIZES, setColormapSizes)  \
+    _MP_METHOD(MP_METHOD_SET_COLOR_INDEX,   setColorIndex)      \
+    _MP_METHOD(MP_METHOD_SET_COLOR,         setColor)           \
+    _MP_METHOD(MP_METHOD_SET_LINE_STYLE,    setLineStyle)       \
+    _MP_METHOD(MP_METHOD_SET_LINE_WIDTH,    setLineWidth)       \
+    _MP_METHOD(MP_METHOD_DRAW_POINT,        drawPoint)          \
+    _MP_METHOD(MP_METHOD_DRAW_POINTS,       drawPoints)         \
+    _MP_METHOD(MP_METHOD_DRAW_RECTANGLE,    drawRectangle)      \
+    _MP_METHOD(MP_METHOD_DRAW_POLYLINE,     drawPolyline)       \
+    _MP_METHOD(MP_METHOD_DRAW_POLYGON,      drawPolygon)        \
+    _MP_METHOD(MP_METHOD_DRAW_CELLS,        drawCells)          \
+    _MP_METHOD(MP_METHOD_DRAW_CELLS8,       drawCells8)         \
+    _MP_METHOD(MP_METHOD_DRAW_CELLS16,      drawCells16)
+
+typedef enum {
+#define _MP_METHOD(a,b) a,
+    _MP_METHOD_LIST
+#undef _MP_METHOD
+    MP_METHOD_COUNT /* Number of methods */
+} MpMethod;
+
+/**
+ * Structure to store the performance counters of a device.
+ *
+ * The counters are only maintained if µPlot has been compiled with the macro
+ * `MP_ENABLE_STATS` defined (e.g., with `-DMP_ENABLE_STATS` in the compiler
+ * flags); otherwise, the instrumentation compiles to nothing and
+ * MpGetDeviceStats() returns `MP_NOT_IMPLEMENTED`.
+ *
+ * Vertices are counted as submitted to the high-level drawing functions and
+ * as emitted to the driver after clipping, decimation and simplification.
+ * Settings are counted as suppressed when the color index, line style or line
+ * width are set to their current value, so that the driver is not called.  Bytes are counted when
+ * the buffered output of a driver is written to its file.  Times are wall
+ * clock times in seconds spent in the methods of the driver.
+ */
+typedef struct _MpDeviceStats {
+    uint64_t calls[MP_METHOD_COUNT]; /* Number of calls of each method */
+    double seconds[MP_METHOD_COUNT]; /* Time spent in each method */
+    uint64_t     submittedVertices; /* Vertices given to drawing functions */
+    uint64_t       emittedVertices; /* Vertices sent to the driver */
+    uint64_t    suppressedSettings; /* Changes of settings not sent to the
+                                       driver */
+    uint64_t          bytesWritten; /* Bytes written to the output file */
+} MpDeviceStats;
+
+/**
+ * Get the performance counters of a device.
+ *
+ * The counters are collected since the device has been open or since the last
+ * call to MpResetDeviceStats().  They are not synchronized: for an
+ * asynchronous device, query the target device after MpFlush().
+ *
+ * @param dev     The graphic device.
+ * @param stats   The address to store the counters.
+ *
+ * @return A standard status: `MP_OK` on success, `MP_NOT_IMPLEMENTED` if
+ *         µPlot has been compiled without performance counters, an error
+ *         code on failure.
+ */
+extern MpStatus MpGetDeviceStats(MpDevice* dev, MpDeviceStats* stats);
+
+/**
+ * Reset the performance counters of a device.
+ *
+ * @param dev     The graphic device.
+ *
+ * @return A standard status: `MP_OK` on success, `MP_NOT_IMPLEMENTED` if
+ *         µPlot has been compiled without performance counters, an error
+ *         code on failure.
+ */
+extern MpStatus MpResetDeviceStats(MpDevice* dev);
+
+/**
+ * Get the name of a device method.
+ *
+ * @param method  The method identifier.
+ *
+ * @return The name of the member of the device structure (e.g.,
+ *         `"drawPolyline"`), `"unknown"` for an invalid identifier.
+ */
+extern const char* MpGetMethodName(MpMethod method);
+
 _MP_END_DECLS
 
 #endif /* _MUPLOT_H_ */
@@ -15,11 +15,17 @@
 #ifndef _MUPLOT_PRIVATE_H_
 #define _MUPLOT_PRIVATE_H_ 1
 
+#include <stdio.h>
 #include <muPlot.h>
 #include <muPlotXForms.h>
 
 _MP_BEGIN_DECLS
 
+/*
+ * Encoder of colors, see MpSetColorEncoder().
+ */
+typedef uint32_t MpColorEncoder(const MpColor* color);
+
 struct _MpDevice {
     /* The following members are set once and must never be changed. */
     const char* driver; /* Driver name */
@@ -44,12 +50,47 @@ struct _MpDevice {
     MpLineStyle           lineStyle;
     MpReal                lineWidth;
     MpCoordinateTransform dataToNDC; /* data to NDC coordinate transform */
+    MpCoordinateTransform ndcToDevice; /* NDC to device coordinate transform,
+                                          only change it by calling
+                                          MpSetNDCToDeviceTransform() */
     MpColorIndex      colormapSize1; /* Number of colors in the primary colormap */
     MpColorIndex      colormapSize2; /* Number of colors in the secondary colormap */
     MpColorIndex       colormapSize; /* Total number of colors in color table */
     MpColor*               colormap; /* Colormap (freed automatically on close
                                         if non-NULL */
+    uint32_t*         encodedColors; /* Colormap encoded by the driver encoder
+                                        (see MpSetColorEncoder()) or NULL */
 
+    /* The following members are private to the high-level interface. */
+    MpCoordinateTransform dataToDevice; /* data to device coordinate transform,
+                                           that is `ndcToDevice⋅dataToNDC` */
+    MpBool       dataToDeviceIsDirty; /* `dataToDevice` must be recomputed */
+    MpTransformKind dataToDeviceKind; /* kind of `dataToDevice` */
+    MpAffineTransformFlt dataToDeviceFlt; /* single precision copy of
+                                             `dataToDevice` */
+    MpInt                scratchSize; /* Number of points in scratch buffers */
+    MpPoint*                xscratch; /* Scratch buffer for abscissae */
+    MpPoint*                yscratch; /* Scratch buffer for ordinates */
+    size_t             workspaceSize; /* Number of bytes in workspace */
+    void*                  workspace; /* Workspace for coordinates */
+    MpBool                  decimate; /* Decimate polylines? */
+    MpBool                  simplify; /* Simplify polylines and polygons? */
+    MpColorIndex   pendingColorIndex; /* Color index set by the user */
+    MpLineStyle     pendingLineStyle; /* Line style set by the user */
+    MpReal          pendingLineWidth; /* Line width set by the user */
+    MpBool           pendingSettings; /* Settings not yet notified to the
+                                         driver? */
+    struct _MpPolylineStream* stream; /* Polyline drawn by pieces (see
+                                         MpBeginPolyline()) */
+    MpColorEncoder*     colorEncoder; /* Encoder of colors or NULL */
+    MpColorIndex   encodedColorsSize; /* Number of allocated encoded colors */
+    MpAxisScale               xscale; /* Scale of the abscissae */
+    MpAxisScale               yscale; /* Scale of the ordinates */
+    MpBool                scaledAxes; /* Any nonlinear axis scale? */
+    struct _MpTextCache*   textCache; /* Laid out strings (see
+                                         MpDrawText()) */
+    struct _MpStatsRecorder*   stats; /* Performance counters or NULL (see
+                                         MpGetDeviceStats()) */
 
     /* Methods can assume checked arguments.
      *
@@ -58,7 +99,8 @@ struct _MpDevice {
      * - initialize() is called after the device has been open by the driver
      *   and the device structure allocated (with its colormap).  This method
      *   is the oportunity for the device to set initial settings (like the
-     *   colors, etc.).  This method is never called again.
+     *   colors, etc.).  This method is only called again by MpReopenDevice()
+     *   when settings are reset.
      */
     MpStatus (*initialize)(MpDevice* dev);
     /*
@@ -68,6 +110,17 @@ struct _MpDevice {
      *   of this method).  This method is never called again.
      */
     MpStatus (*finalize)(MpDevice* dev);
+    /*
+     * - reopen() is called by MpReopenDevice() to finish the current output,
+     *   as finalize() would do but without freeing the device, and to start a
+     *   new output specified by `arg` (as for the driver open method).  If
+     *   `reset` is true, the driver shall restore the public members that it
+     *   set when opening the device (page settings, colormap sizes not
+     *   exceeding the allocated ones, color index, line style and width, etc.)
+     *   and its private settings, the device is then initialized again like a
+     *   new one.  If this method fails, the device can only be closed.
+     */
+    MpStatus (*reopen)(MpDevice* dev, const char* arg, MpBool reset);
     /*
      * - setPageSize() is called to set the page size in millimeters.
      */
@@ -87,6 +140,12 @@ struct _MpDevice {
      * - stopBuffering() is called to stop buffering graphical output.
      */
     MpStatus (*stopBuffering)(MpDevice* dev);
+    /*
+     * - flush() is called to make sure that all graphics drawn so far have
+     *   been processed by the driver (for instance, the ones queued for
+     *   another thread).
+     */
+    MpStatus (*flush)(MpDevice* dev);
     /*
      * - beginPage() is called to begin a new page of graphics.
      */
@@ -121,6 +180,13 @@ struct _MpDevice {
      * - drawPoint() is called to draw a point using the current settings.
      */
     MpStatus (*drawPoint)(MpDevice* dev, MpPoint x, MpPoint y);
+    /*
+     * - drawPoints() is called to draw several points using the current
+     *   settings.  If not provided by the driver, MpDrawPointsHelper() is
+     *   used which calls drawPoint() for each point.
+     */
+    MpStatus (*drawPoints)(MpDevice* dev,
+                           const MpPoint* x, const MpPoint* y, MpInt n);
     /*
      * - drawRectangle() is called to draw a (filled) rectangle using the
      *   current settings.
@@ -146,8 +212,502 @@ struct _MpDevice {
     MpStatus (*drawCells)(MpDevice* dev,
                           const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
                           MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+    /*
+     * - drawCells8() and drawCells16() are the same as drawCells() but for
+     *   color indices stored as 8-bit and 16-bit unsigned integers.
+     *
+     * The cells have `n1` columns and `n2` rows, the index of the cell at
+     * column `i1` and row `i2` is `z[i1 + i2*stride]`, and they fill the
+     * rectangle of corners `(x0,y0)` and `(x1,y1)` (the latter excluded).
+     * Color indices are not checked by the high-level interface.
+     */
+    MpStatus (*drawCells8)(MpDevice* dev,
+                           const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+                           MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+    MpStatus (*drawCells16)(MpDevice* dev,
+                            const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+                            MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1);
+};
+
+/*
+ * Structure to record the performance counters of a device.  When µPlot is
+ * compiled with `MP_ENABLE_STATS` defined, MpInitializeDevice() allocates a
+ * recorder, saves the methods of the driver in the copy `driver` of the
+ * device structure and replaces them by wrappers which update the counters
+ * and call the saved methods.  The `initialize()` method, which drivers use
+ * to identify their devices, is not replaced.
+ */
+struct _MpStatsRecorder {
+    MpDeviceStats counters; /* Performance counters */
+    MpDevice        driver; /* Copy of the device with the driver methods */
+};
+
+/**
+ * Increment a performance counter of a device.
+ *
+ * This macro does nothing unless µPlot is compiled with `MP_ENABLE_STATS`
+ * defined.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ * @param member  The member of `MpDeviceStats` to increment.
+ * @param n       The increment.
+ */
+#ifdef MP_ENABLE_STATS
+#  define MP_COUNT(dev, member, n)                              \
+    do {                                                        \
+        if ((dev)->stats != NULL) {                             \
+            (dev)->stats->counters.member += (n);               \
+        }                                                       \
+    } while (false)
+#else
+#  define MP_COUNT(dev, member, n) do {} while (false)
+#endif
+
+/**
+ * Get the data to device coordinate transform.
+ *
+ * This function yields the coordinate transform `C = B⋅A` from user-defined
+ * coordinates to device coordinates where `A` is the data to NDC transform
+ * set by MpSetCoordinateTransform() and `B` is the NDC to device transform set
+ * by the driver.  The composition is cached and only recomputed when `A` or
+ * `B` have changed.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ *
+ * @return The address of the cached transform.
+ */
+extern const MpCoordinateTransform* MpGetDataToDeviceTransform(MpDevice* dev);
+
+/**
+ * Get the data to device coordinate transform in single precision.
+ *
+ * This function is the same as MpGetDataToDeviceTransform() but yields a
+ * single precision copy of the transform, for drivers and kernels which
+ * compute in single precision.  The copy is cached with the transform.
+ *
+ * The kind of the transform (see @ref MpTransformKind) is cached as well in
+ * the member `dataToDeviceKind` of the device, which is valid after calling
+ * MpGetDataToDeviceTransform() or MpGetDataToDeviceTransformFlt().
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ *
+ * @return The address of the cached transform.
+ */
+extern const MpAffineTransformFlt*
+MpGetDataToDeviceTransformFlt(MpDevice* dev);
+
+/**
+ * Reserve scratch memory.
+ *
+ * This function makes sure that the scratch buffers `dev->xscratch` and
+ * `dev->yscratch` have at least `n` elements.  These buffers are owned by the
+ * device and are freed when the device is closed.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ * @param n       The minimal number of elements.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpReserveScratch(MpDevice* dev, MpInt n);
+
+/**
+ * Reserve workspace memory.
+ *
+ * This function makes sure that the workspace `dev->workspace` has at least
+ * `size` bytes.  The workspace is suitably aligned for any type, it is owned
+ * by the device and is freed when the device is closed.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ * @param size    The minimal number of bytes.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpReserveWorkspace(MpDevice* dev, size_t size);
+
+/**
+ * Register an encoder of colors.
+ *
+ * A driver calls this function to have the colors of the colormap of a device
+ * converted into its own representation (for example packed RGBA pixels) and
+ * stored in the cache `dev->encodedColors`, so that drawing only requires a
+ * table lookup.  All the colors are encoded by this function, afterwards
+ * MpSetColor(), MpSetColormapSizes() and MpDefineStandardColors() only
+ * re-encode the colors that they change.  Drivers which modify the colormap
+ * directly (instead of being called by these functions) must call
+ * MpRefreshEncodedColors().  The cache is freed when the device is closed.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ * @param encoder The encoder of colors, `NULL` to drop the cache.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetColorEncoder(MpDevice* dev, MpColorEncoder* encoder);
+
+/**
+ * Re-encode colors.
+ *
+ * This function updates the encoded colors of `count` entries of the
+ * colormap starting at index `first`.  It does nothing if the device has no
+ * encoder of colors.  The `setColor()` method of a driver may call it when it
+ * needs the encoded color before returning, otherwise there is no needs to.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ * @param first   The first color index.
+ * @param count   The number of colors.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpRefreshEncodedColors(MpDevice* dev, MpColorIndex first,
+                                       MpInt count);
+
+/**
+ * Drop the polyline being drawn by pieces.
+ *
+ * This function forgets the polyline begun by MpBeginPolyline(), if any,
+ * without drawing its last piece.  The memory used by the stream is kept for
+ * the next polyline.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ */
+extern void MpDropPolyline(MpDevice* dev);
+
+/**
+ * Get the number of boxes summarizing the bounds of chunks of points.
+ *
+ * @param chunks  The number of chunks.
+ *
+ * @return The number of boxes of all the levels of the hierarchy built by
+ *         MpInitializeChunkBoundsFlt() or MpInitializeChunkBoundsDbl() for
+ *         @a chunks chunks.
+ */
+extern MpInt MpCountChunkBoxes(MpInt chunks);
+
+/**
+ * Free the strings laid out by MpDrawText().
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ */
+extern void MpFreeTextCache(MpDevice* dev);
+
+/* Helper for MpApplySettings(). */
+extern MpStatus MpApplyPendingSettings(MpDevice* dev);
+
+/**
+ * Notify the driver of the pending settings.
+ *
+ * The color index, line style and line width set by the user are only
+ * notified to the driver right before something is drawn, and only if they
+ * differ from the current settings of the driver.  This function must be
+ * called before calling the drawing methods of a device (the high-level
+ * drawing functions do it).  It is cheap when there are no pending settings.
+ *
+ * @param dev     The graphic device (must not be `NULL`).
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+static inline MpStatus
+MpApplySettings(MpDevice* dev)
+{
+    return (dev->pendingSettings ? MpApplyPendingSettings(dev) : MP_OK);
+}
+
+/**
+ * Structure to compute the edges of the cells along a dimension.
+ *
+ * The edge `i` (for `i = 0, ..., n`) of `n` cells between device coordinates
+ * `a` and `b` is `a + floor(i*(b - a)/n)`.  Edges are computed incrementally
+ * by MpStepCellEdge() with exact integer arithmetic.  The members of this
+ * structure are private.
+ */
+typedef struct _MpCellEdges {
+    MpInt e; /* Current edge. */
+    MpInt q; /* Quotient of the step. */
+    MpInt r; /* Remainder of the step (in the range [0,n-1]). */
+    MpInt n; /* Number of cells. */
+    MpInt acc; /* Accumulated remainder. */
+} MpCellEdges;
+
+/**
+ * Initialize the computation of cell edges.
+ *
+ * @param s       The address of the structure to initialize.
+ * @param a       The first edge.
+ * @param b       The last edge.
+ * @param n       The number of cells (must be at least 1).
+ */
+extern void MpInitializeCellEdges(MpCellEdges* s, MpPoint a, MpPoint b,
+                                  MpInt n);
+
+/**
+ * Compute the next cell edge.
+ *
+ * @param s       The address of the structure initialized by
+ *                MpInitializeCellEdges().
+ *
+ * @return The next edge.
+ */
+static inline MpPoint
+MpStepCellEdge(MpCellEdges* s)
+{
+    s->e += s->q;
+    s->acc += s->r;
+    if (s->acc >= s->n) {
+        s->acc -= s->n;
+        s->e += 1;
+    }
+    return (MpPoint)s->e;
+}
+
+/*---------------------------------------------------------------------------*/
+/* BUFFERED OUTPUT */
+
+/**
+ * Structure to store a buffered writer.
+ *
+ * A buffered writer collects the output of a driver in a large buffer which is
+ * written to a file by blocks.  Numbers are converted to text without the
+ * overheads of the formatted output of the standard C library.  The first
+ * write error is remembered and returned by all subsequent operations.
+ *
+ * When `buffering` is false (the default), MpSyncWriter() flushes the buffer;
+ * otherwise, the buffer is only flushed when it is full or by calling
+ * MpFlushWriter().  Drivers are expected to call MpSyncWriter() after each
+ * graphic object and to toggle `buffering` in their `startBuffering()` and
+ * `stopBuffering()` methods.
+ *
+ * A writer without a file is a memory writer: its buffer grows as needed
+ * and is never flushed, the collected bytes are `buffer[0:count-1]`.
+ *
+ * For maximum speed, a driver may directly store bytes in the buffer: call
+ * MpReserveWriter() to make sure `n` bytes are available, store at most `n`
+ * bytes starting at the returned address `p` and set `count` to the offset of
+ * the end of the written bytes (that is, `count = q - buffer` with `q` the
+ * address after the last written byte).
+ *
+ * A driver may set `device` to its device after initializing the writer to
+ * have the written bytes accounted in the performance counters.  The offset
+ * of the next byte in the file is `written + count`, for file formats which
+ * refer to the positions of their parts (e.g., PDF).
+ */
+typedef struct _MpWriter MpWriter;
+struct _MpWriter {
+    FILE*           file; /* Output file */
+    char*         buffer; /* Output buffer */
+    size_t          size; /* Size of buffer in bytes */
+    size_t         count; /* Number of pending bytes in buffer */
+    MpBool     buffering; /* Only flush when buffer is full? */
+    MpStatus      status; /* Status of first failure */
+    MpDevice*     device; /* Device credited with the bytes written to the
+                             file (see MpGetDeviceStats()) or NULL */
+    size_t       written; /* Number of bytes written to the file so far */
+};
+
+/**
+ * Initialize a buffered writer.
+ *
+ * @param w       The buffered writer.
+ * @param file    The output file (not closed by MpFinalizeWriter()), `NULL`
+ *                for a memory writer.
+ * @param size    The size of the buffer in bytes (0 for a default size, at
+ *                least 64 bytes are allocated).
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpInitializeWriter(MpWriter* w, FILE* file, size_t size);
+
+/**
+ * Finalize a buffered writer.
+ *
+ * This function flushes the pending bytes of a buffered writer and frees its
+ * buffer.  It can safely be called more than once.
+ *
+ * @param w       The buffered writer.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpFinalizeWriter(MpWriter* w);
+
+/**
+ * Reuse a buffered writer for another file.
+ *
+ * This function flushes the pending bytes of a buffered writer to its current
+ * file and starts writing to `file` with the same buffer.  The status of the
+ * writer is cleared and buffering is turned off.
+ *
+ * @param w       The buffered writer.
+ * @param file    The new output file (`NULL` for a memory writer).
+ *
+ * @return The status of the output to the previous file.
+ */
+extern MpStatus MpResetWriter(MpWriter* w, FILE* file);
+
+/**
+ * Write the pending bytes of a buffered writer to its file.
+ *
+ * @param w       The buffered writer.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpFlushWriter(MpWriter* w);
+
+/**
+ * Flush a buffered writer unless it is buffering.
+ *
+ * @param w       The buffered writer.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSyncWriter(MpWriter* w);
+
+/**
+ * Reserve bytes in the buffer of a writer.
+ *
+ * @param w       The buffered writer.
+ * @param n       The number of bytes (at most 64).
+ *
+ * @return The address where to store at least `n` bytes, `NULL` on error.
+ */
+extern char* MpReserveWriter(MpWriter* w, size_t n);
+
+/**
+ * Write bytes, a null terminated string, the decimal representation of an
+ * integer or formatted text (as with `printf`) with a buffered writer.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpWriteBytes(MpWriter* w, const void* ptr, size_t n);
+extern MpStatus MpWriteString(MpWriter* w, const char* str);
+extern MpStatus MpWriteInteger(MpWriter* w, long val);
+extern MpStatus MpWriteFormatted(MpWriter* w, const char* format, ...);
+
+/**
+ * Convert an integer into decimal text.
+ *
+ * This function writes the decimal representation of `val` at `dst` (at most
+ * 20 characters are written, no final null is written).
+ *
+ * @param dst     The destination.
+ * @param val     The value.
+ *
+ * @return The address after the last written character.
+ */
+extern char* MpFormatInteger(char* dst, long val);
+
+/*---------------------------------------------------------------------------*/
+/* LINE STROKING */
+
+/* Maximum number of dashes and gaps in a dash pattern. */
+#define MP_MAX_DASHES 8
+
+/**
+ * Structure to store a line stroker.
+ *
+ * A line stroker is a software implementation of line styles and line widths
+ * for drivers which have no native support for them (e.g., pixel based
+ * drivers).  A stroker converts polylines with integer device coordinates
+ * into filled axis-aligned rectangles: dashes are split at integer positions
+ * along the segments, each dash is walked by a thick Bresenham algorithm
+ * which merges the samples of consecutive steps along the major axis into a
+ * single rectangle, and joins and caps of wide lines are squares.
+ *
+ * The line width is expressed in device samples (rounded to the nearest
+ * integer, at least 1).  The dash pattern of the line style is computed once
+ * for all by MpSetStrokerStyle() with lengths proportional to the line width
+ * and stored in units of 1/256 of sample, so that no floating-point
+ * operations are needed along the segments but one square root per segment.
+ *
+ * The dash phase carries across calls: a polyline starting at the last vertex
+ * of the previous one (as the pieces of a long polyline sent by chunks to the
+ * driver) continues its dash pattern.  A stroker is a plain structure which
+ * can be copied to replay the stroking of a polyline from a given phase (for
+ * instance in tiled rendering).
+ */
+typedef struct _MpStroker MpStroker;
+struct _MpStroker {
+    MpLineStyle            style; /* Line style */
+    MpInt              thickness; /* Line width in samples */
+    MpInt                  count; /* Number of dashes and gaps, 0 for solid
+                                     lines */
+    int64_t dashes[MP_MAX_DASHES]; /* Lengths of dashes and gaps (in 1/256
+                                      of sample) */
+    MpInt                  index; /* Current dash (even) or gap (odd) */
+    int64_t            remaining; /* Remaining length of current dash or
+                                     gap */
+    MpBool                 moved; /* Last vertex is known? */
+    MpPoint         xlast, ylast; /* Last vertex */
 };
 
+/**
+ * Callback to fill rectangles produced by a line stroker.
+ *
+ * The rectangle is made of columns `xmin` to `xmax` and rows `ymin` to `ymax`
+ * (all inclusive), it may extend beyond the limits of the device.
+ */
+typedef void MpStrokeFiller(void* ctx, MpInt xmin, MpInt ymin,
+                            MpInt xmax, MpInt ymax);
+
+/**
+ * Set the line style and width of a line stroker.
+ *
+ * The dash pattern is only recomputed if the style or the rounded width
+ * change.  The phase of the dash pattern is reset.
+ *
+ * @param s       The line stroker.
+ * @param ls      The line style.
+ * @param lw      The line width in device samples.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus MpSetStrokerStyle(MpStroker* s, MpLineStyle ls, MpReal lw);
+
+/**
+ * Reset the phase of a line stroker.
+ *
+ * After calling this function, the next polyline starts a new dash pattern.
+ * Drivers should call this function when a new page begins.
+ *
+ * @param s       The line stroker.
+ */
+extern void MpResetStroker(MpStroker* s);
+
+/**
+ * Start stroking a polyline.
+ *
+ * This function resets the phase of the dash pattern unless `(x0,y0)` is the
+ * last vertex of the previously stroked polyline.
+ *
+ * @param s       The line stroker.
+ * @param x0      The abscissa of the first vertex.
+ * @param y0      The ordinate of the first vertex.
+ */
+extern void MpBeginStroke(MpStroker* s, MpPoint x0, MpPoint y0);
+
+/**
+ * Stroke a polyline.
+ *
+ * This function strokes the segments of a polyline from the current phase of
+ * the dash pattern and remembers its last vertex.  MpBeginStroke() should be
+ * called first.
+ *
+ * @param s       The line stroker.
+ * @param x       The abscissae of the vertices.
+ * @param y       The ordinates of the vertices.
+ * @param n       The number of vertices.
+ * @param fill    The callback called for each rectangle, `NULL` to only
+ *                advance the phase of the dash pattern.
+ * @param ctx     The context for the callback.
+ */
+extern void MpStrokePolyline(MpStroker* s,
+                             const MpPoint* x, const MpPoint* y, MpInt n,
+                             MpStrokeFiller* fill, void* ctx);
+
+/**
+ * Check whether a line stroker draws thin solid lines.
+ *
+ * Drivers may draw thin solid lines by cheaper means.
+ */
+#define MP_IS_THIN_SOLID_STROKER(s) ((s)->count == 0 && (s)->thickness <= 1)
+
 /*
   calll `dev->select(dev)` when device becomes active
   setPageSize may be NULL
@@ -160,7 +720,8 @@ struct _MpDevice {
   2. device drawing routines all take integer coordinates, of type say MpPoint, and high level takes
   care of converting.
 
-  drawCells can be set to MpDrawCells to call drawRectangle for each cell. */
+  drawCells can be set to MpDrawCellsHelper to call drawRectangle for each run
+  of cells. */
 
 _MP_END_DECLS
 
@@ -103,6 +103,9 @@ _MP_BEGIN_DECLS
  *
  * - Call MpInterceptAffineTransformFlt() or MpInterceptAffineTransformFlt() to
  *   compute the intercept of an affine transform.
+ *
+ * - Call MpApplyAffineTransformFlt(), MpApplyAffineTransformDbl() or one of
+ *   their variants to apply an affine transform to arrays of coordinates.
  */
 typedef struct _MpAffineTransformFlt {
     float xx, xy, x;
@@ -120,6 +123,52 @@ typedef struct _MpAffineTransformDbl {
     double yx, yy, y;
 } MpAffineTransformDbl;
 
+/**
+ * Kinds of affine transforms.
+ *
+ * Affine transforms are classified from the simplest to the most general so
+ * that code can select once a specialized path for a given transform.  The
+ * kinds are ordered: a transform of a given kind is also of any following
+ * kind.  A *diagonal* transform implements a scaling of each axis and a
+ * translation but no shear nor rotation (i.e. `A.xy = A.yx = 0`).
+ */
+typedef enum {
+    MP_IDENTITY_TRANSFORM    = 0, /* Identity */
+    MP_TRANSLATION_TRANSFORM = 1, /* Pure translation */
+    MP_DIAGONAL_TRANSFORM    = 2, /* Axis-aligned scaling and translation */
+    MP_GENERAL_TRANSFORM     = 3, /* Any other affine transform */
+} MpTransformKind;
+
+/**
+ * Classify an affine transform.
+ *
+ * @param A       The affine transform.
+ *
+ * @return The simplest kind of transform implemented by `A`.
+ */
+extern MpTransformKind
+MpClassifyAffineTransformFlt(const MpAffineTransformFlt* A);
+
+/**
+ * Classify an affine transform.
+ *
+ * This is the same as @ref MpClassifyAffineTransformFlt but with double
+ * precision floating-point coefficients.
+ */
+extern MpTransformKind
+MpClassifyAffineTransformDbl(const MpAffineTransformDbl* A);
+
+/*
+ * The following macro yields the kind of the affine transform `A`.  Argument
+ * `E` is a macro such that `E(A,M)` yields the member `M` of `A`.  Usually,
+ * `E` is `MP_GET_FIELD` or `MP_GET_FIELD_PTR`.
+ */
+#define MP_XFORM_CLASSIFY(E,A)                                          \
+    ((E(A,xy) != 0 || E(A,yx) != 0) ? MP_GENERAL_TRANSFORM     :        \
+     (E(A,xx) != 1 || E(A,yy) != 1) ? MP_DIAGONAL_TRANSFORM    :        \
+     (E(A,x)  != 0 || E(A,y)  != 0) ? MP_TRANSLATION_TRANSFORM :        \
+     MP_IDENTITY_TRANSFORM)
+
 
 /*
  * The following macros yield the abscissa `X` or the ordinate `Y` resulting
@@ -130,6 +179,124 @@ typedef struct _MpAffineTransformDbl {
 #define MP_XFORM_APPLY_X(E,A,X,Y)  (E(A,xx)*(X) + E(A,xy)*(Y) + E(A,x))
 #define MP_XFORM_APPLY_Y(E,A,X,Y)  (E(A,yx)*(X) + E(A,yy)*(Y) + E(A,y))
 
+/*--------------------------------------------------------------------------*/
+/* Apply affine transforms to arrays of coordinates. */
+
+/**
+ * Apply affine transform to arrays of coordinates.
+ *
+ * This function applies the affine transform `A` to the `n` points whose
+ * coordinates are `(xin[i],yin[i])` and stores the result in
+ * `(xout[i],yout[i])` for `i = 0, ..., n-1`.  The kind of `A` (see
+ * @ref MpTransformKind) is determined once and a specialized code is used for
+ * the identity, pure translations and transforms with no shear nor rotation.
+ *
+ * The operation can be done in-place, that is `xout` and `yout` can be
+ * respectively the same as `xin` and `yin`; otherwise, output and input arrays
+ * must not overlap.
+ *
+ * @param A      The affine transform.
+ * @param xout   The array to store the transformed abscissae.
+ * @param yout   The array to store the transformed ordinates.
+ * @param xin    The abscissae of the points to transform.
+ * @param yin    The ordinates of the points to transform.
+ * @param n      The number of points.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus
+MpApplyAffineTransformFlt(const MpAffineTransformFlt* A,
+                          float* xout, float* yout,
+                          const float* xin, const float* yin, MpInt n);
+
+/**
+ * Apply affine transform to arrays of coordinates.
+ *
+ * This is the same as @ref MpApplyAffineTransformFlt but with double
+ * precision floating-point coefficients and coordinates.
+ */
+extern MpStatus
+MpApplyAffineTransformDbl(const MpAffineTransformDbl* A,
+                          double* xout, double* yout,
+                          const double* xin, const double* yin, MpInt n);
+
+/**
+ * Apply affine transform to arrays of coordinates in-place.
+ *
+ * This function replaces the coordinates `(x[i],y[i])` of the `n` points by
+ * the result of applying the affine transform `A` to them.  This is the same
+ * as calling @ref MpApplyAffineTransformFlt with `xout = xin = x` and `yout =
+ * yin = y`.
+ */
+extern MpStatus
+MpApplyAffineTransformInPlaceFlt(const MpAffineTransformFlt* A,
+                                 float* x, float* y, MpInt n);
+
+/**
+ * Apply affine transform to arrays of coordinates in-place.
+ *
+ * This is the same as @ref MpApplyAffineTransformInPlaceFlt but with double
+ * precision floating-point coefficients and coordinates.
+ */
+extern MpStatus
+MpApplyAffineTransformInPlaceDbl(const MpAffineTransformDbl* A,
+                                 double* x, double* y, MpInt n);
+
+/**
+ * Apply affine transform to strided arrays of coordinates.
+ *
+ * This function is similar to @ref MpApplyAffineTransformFlt except that the
+ * coordinates of the `i`-th input point are `(xin[i*inc],yin[i*inc])` and
+ * that the result is stored in `(xout[i*outc],yout[i*outc])`.  For instance,
+ * to transform interleaved coordinates stored in an array `xy` of `2*n`
+ * values:
+ *
+ * <pre>
+ * MpApplyAffineTransformStridedFlt(A, xy, xy+1, 2, xy, xy+1, 2, n);
+ * </pre>
+ *
+ * @param A      The affine transform.
+ * @param xout   The array to store the transformed abscissae.
+ * @param yout   The array to store the transformed ordinates.
+ * @param outc   The stride (in number of elements) of the outputs.
+ * @param xin    The abscissae of the points to transform.
+ * @param yin    The ordinates of the points to transform.
+ * @param inc    The stride (in number of elements) of the inputs.
+ * @param n      The number of points.
+ *
+ * @return A standard status: `MP_OK` on success, an error code on failure.
+ */
+extern MpStatus
+MpApplyAffineTransformStridedFlt(const MpAffineTransformFlt* A,
+                                 float* xout, float* yout, MpInt outc,
+                                 const float* xin, const float* yin, MpInt inc,
+                                 MpInt n);
+
+/**
+ * Apply affine transform to strided arrays of coordinates.
+ *
+ * This is the same as @ref MpApplyAffineTransformStridedFlt but with double
+ * precision floating-point coefficients and coordinates.
+ */
+extern MpStatus
+MpApplyAffineTransformStridedDbl(const MpAffineTransformDbl* A,
+                                 double* xout, double* yout, MpInt outc,
+                                 const double* xin, const double* yin, MpInt inc,
+                                 MpInt n);
+
+/**
+ * Apply affine transform to arrays of coordinates with mixed precision.
+ *
+ * This function is similar to @ref MpApplyAffineTransformDbl except that the
+ * transformed coordinates are stored as single precision floating-point
+ * values.  Computations are done in double precision.  Output and input
+ * arrays must not overlap.
+ */
+extern MpStatus
+MpApplyAffineTransformDblToFlt(const MpAffineTransformDbl* A,
+                               float* xout, float* yout,
+                               const double* xin, const double* yin, MpInt n);
+
 /*--------------------------------------------------------------------------*/
 /* Compose affine transforms. */
 
@@ -213,7 +380,7 @@ MpComposeAffineTransformsAltDbl(MpAffineTransformDbl A,
         E(DST,xy) = MP_XFORM_COMPOSE_XY(E,A,B); \
         E(DST,x ) = MP_XFORM_COMPOSE_X( E,A,B); \
         E(DST,yx) = MP_XFORM_COMPOSE_YX(E,A,B); \
-        E(DST,yy) = MP_XFORM_COMPOSE_YX(E,A,B); \
+        E(DST,yy) = MP_XFORM_COMPOSE_YY(E,A,B); \
         E(DST,y ) = MP_XFORM_COMPOSE_Y( E,A,B); \
     } while (0)
 
@@ -464,7 +631,7 @@ MpRightRotateAffineTransformDbl(MpAffineTransformDbl* dst,
 
 extern float MpDeterminantAffineTransformFlt(const MpAffineTransformFlt* A);
 
-extern double MpDeterminantAffineTransformDblt(const MpAffineTransformFlt* A);
+extern double MpDeterminantAffineTransformDbl(const MpAffineTransformDbl* A);
 
 /*
  * The following macro yields the determinant of the linear part of the affine
@@ -614,7 +781,7 @@ MpRightDivideAffineTransformsDbl(MpAffineTransformDbl* dst,
  */
 #define MP_XFORM_RIGHT_DIVIDE(T,E,DST,A,B)                      \
     do {                                                        \
-        T _delta = MP_XFORM_DETERMINANT(E,A);                   \
+        T _delta = MP_XFORM_DETERMINANT(E,B);                   \
         if (_delta == 0) {                                      \
             return MP_SINGULAR;                                 \
         }                                                       \
@@ -628,7 +795,7 @@ MpRightDivideAffineTransformsDbl(MpAffineTransformDbl* dst,
         E(DST,x ) = E(A,x) - (_Rxx*E(B,x) + _Rxy*E(B,y));       \
         E(DST,yx) = _Ryx;                                       \
         E(DST,yy) = _Ryy;                                       \
-        E(DST,y ) = E(A,y) - (_Ryx*E(B,y) + _Ryy*E(B,y));       \
+        E(DST,y ) = E(A,y) - (_Ryx*E(B,x) + _Ryy*E(B,y));       \
     } while (0)
 
 /*--------------------------------------------------------------------------*/
@@ -0,0 +1,1637 @@
+/*
+ * muRasterDriver.c --
+ *
+ * Implementation of an in-memory raster driver for µPlot.  Graphics are drawn
+ * in a buffer of RGBA pixels which may be saved as a PPM or PNG image.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <zlib.h>
+#include "muPlotPriv.h"
+
+/* Default size of the raster (in pixels). */
+#define RASTER_DEFAULT_WIDTH  640
+#define RASTER_DEFAULT_HEIGHT 480
+
+/* Sizes of the colormaps. */
+#define RASTER_COLORMAP_SIZE_1  16
+#define RASTER_COLORMAP_SIZE_2 240
+
+/* Pack a color in a pixel value: R | G<<8 | B<<16 | A<<24. */
+#define RASTER_PACK(r,g,b)                                      \
+    ((uint32_t)(r) | ((uint32_t)(g) << 8) |                     \
+     ((uint32_t)(b) << 16) | ((uint32_t)255 << 24))
+#define RASTER_RED(p)   ((unsigned char)((p)         & 0xff))
+#define RASTER_GREEN(p) ((unsigned char)(((p) >>  8) & 0xff))
+#define RASTER_BLUE(p)  ((unsigned char)(((p) >> 16) & 0xff))
+
+typedef enum {
+    RASTER_NO_OUTPUT = 0,
+    RASTER_PPM_OUTPUT,
+    RASTER_PNG_OUTPUT,
+} RasterOutput;
+
+/* Rectangular region of the raster (bounds are inclusive). */
+typedef struct _RasterBox {
+    MpInt xmin, ymin, xmax, ymax;
+} RasterBox;
+
+/* Edge of a polygon for scan conversion. */
+typedef struct _RasterEdge {
+    MpInt ymin, ymax; /* First and last+1 rows crossed by the edge */
+    double x; /* Abscissa of the intersection with current row */
+    double dxdy; /* Increment of abscissa per row */
+} RasterEdge;
+
+/*
+ * In tiled mode, drawing commands are recorded in an arena and the offsets of
+ * the commands overlapping a tile are stored, in order, in the bin of the
+ * tile.  The payload of a command follows its header in the arena.
+ */
+typedef enum {
+    RASTER_POINT = 0,
+    RASTER_POINTS,
+    RASTER_RECTANGLE,
+    RASTER_POLYLINE,
+    RASTER_STROKE,
+    RASTER_POLYGON,
+    RASTER_CELLS,
+    RASTER_CELLS8,
+    RASTER_CELLS16,
+} RasterCommandKind;
+
+typedef struct _RasterCommand {
+    RasterCommandKind kind;
+    uint32_t color; /* Packed color */
+    MpInt n; /* Number of points or of cells along 1st dimension */
+    MpInt m; /* Number of edges or of cells along 2nd dimension */
+    MpInt x0, y0, x1, y1; /* Point, rectangle or corners of cells */
+} RasterCommand;
+
+typedef struct _RasterBin {
+    size_t* offsets; /* Offsets of the commands in the arena */
+    MpInt     count; /* Number of commands */
+    MpInt      size; /* Number of allocated offsets */
+} RasterBin;
+
+/* Size of the tiles (in pixels) and maximum number of segments per chunk of
+   recorded polyline. */
+#define RASTER_TILE_SIZE  64
+#define RASTER_CHUNK_SIZE 64
+
+/* Maximum number of threads and maximum size of the recorded commands before
+   they are rendered. */
+#define RASTER_MAX_THREADS 256
+#define RASTER_MAX_PENDING (32 << 20)
+
+#define RASTER_MIN(a,b) ((a) <= (b) ? (a) : (b))
+#define RASTER_MAX(a,b) ((a) >= (b) ? (a) : (b))
+#define RASTER_ALIGN(n) (((n) + (size_t)7) & ~(size_t)7)
+#define RASTER_HEADER_SIZE RASTER_ALIGN(sizeof(RasterCommand))
+#define RASTER_PAYLOAD(cmd) ((void*)((char*)(cmd) + RASTER_HEADER_SIZE))
+
+typedef struct _RasterDevice RasterDevice;
+
+/* Rendering thread, worker 0 is the caller's thread. */
+typedef struct _RasterWorker {
+    RasterDevice*      device;
+    pthread_t          thread;
+    unsigned long  generation; /* Last rendering pass done by the worker */
+    MpInt            maxEdges; /* Number of allocated intersections */
+    double*                xs; /* Intersections of a row with polygon edges */
+} RasterWorker;
+
+struct _RasterDevice {
+    MpDevice pub;
+
+    MpInt          width; /* Number of columns */
+    MpInt         height; /* Number of rows */
+    RasterBox        box; /* The whole raster */
+    uint32_t*     pixels; /* Pixels, row by row, first row at the top */
+    uint32_t       color; /* Packed current color */
+    RasterOutput  output; /* Format of output file */
+    char*       fileName; /* Name of output file, NULL if none */
+    MpBool         dirty; /* Something drawn since page was last saved? */
+    MpInt       maxEdges; /* Number of allocated polygon edges */
+    RasterEdge*    edges; /* Polygon edges */
+    double*           xs; /* Intersections of a row with polygon edges */
+    MpStroker    stroker; /* Stroker for wide and dashed lines */
+
+    /* Tiled rendering (only used if `nthreads > 1`). */
+    MpInt           nthreads; /* Number of workers */
+    RasterWorker*    workers; /* Workers */
+    MpInt        tilesPerRow; /* Number of tiles along a row */
+    MpInt             ntiles; /* Number of tiles */
+    RasterBin*          bins; /* Recorded commands of each tile */
+    MpInt*        tileCounts; /* Number of points per tile (zero between
+                                 calls to recordPoints()) */
+    unsigned char*  commands; /* Arena of recorded commands */
+    size_t      commandsSize; /* Size of the arena */
+    size_t     commandsCount; /* Number of used bytes in the arena */
+    MpInt       pendingEdges; /* Maximum number of edges of recorded polygons */
+    atomic_long     nextTile; /* Next tile to render */
+    pthread_mutex_t    mutex; /* Lock for the following members */
+    pthread_cond_t     start; /* Signaled to start a rendering pass */
+    pthread_cond_t      done; /* Signaled when all workers are done */
+    unsigned long generation; /* Number of rendering passes */
+    MpInt               busy; /* Number of workers still rendering */
+    MpBool              quit; /* Workers must exit? */
+};
+
+static unsigned
+colorant(MpReal val)
+{
+    return (val <= (MpReal)0 ? (unsigned)0 :
+            (val >= (MpReal)1 ? (unsigned)255 :
+             (unsigned)round((double)val*(double)255)));
+}
+
+static uint32_t
+packColor(const MpColor* c)
+{
+    return RASTER_PACK(colorant(c->red), colorant(c->green),
+                       colorant(c->blue));
+}
+
+/*---------------------------------------------------------------------------*/
+/* PRIMITIVES */
+
+/* Fill pixels `x0` to `x1` (inclusive) of a row.  This loop is vectorized by
+   the compiler. */
+static inline void
+fillSpan(uint32_t* restrict row, MpInt x0, MpInt x1, uint32_t c)
+{
+    for (MpInt x = x0; x <= x1; ++x) {
+        row[x] = c;
+    }
+}
+
+static void
+clearRaster(RasterDevice* r)
+{
+    uint32_t c = r->pub.encodedColors[MP_COLOR_BACKGROUND];
+    MpInt n = r->width*r->height;
+    fillSpan(r->pixels, 0, n - 1, c);
+    r->dirty = false;
+}
+
+/*
+ * All primitives only draw the pixels inside the box `b` which is either the
+ * whole raster or a tile.  As a result, drawing a primitive tile by tile
+ * yields exactly the same pixels as drawing it in the whole raster.
+ */
+
+static inline void
+drawPixel(RasterDevice* r, const RasterBox* b, uint32_t c, MpInt x, MpInt y)
+{
+    if (x >= b->xmin && x <= b->xmax && y >= b->ymin && y <= b->ymax) {
+        r->pixels[y*r->width + x] = c;
+    }
+}
+
+/* Draw a line with Bresenham algorithm. */
+static void
+drawLine(RasterDevice* r, const RasterBox* b, uint32_t c,
+         MpInt x0, MpInt y0, MpInt x1, MpInt y1)
+{
+    /* The pixels of the line are in the bounding box of its end-points. */
+    if ((x0 < b->xmin && x1 < b->xmin) || (x0 > b->xmax && x1 > b->xmax) ||
+        (y0 < b->ymin && y1 < b->ymin) || (y0 > b->ymax && y1 > b->ymax)) {
+        return;
+    }
+    const MpInt w = r->width;
+    uint32_t* pixels = r->pixels;
+    MpInt dx = (x1 >= x0 ? x1 - x0 : x0 - x1), sx = (x0 < x1 ? 1 : -1);
+    MpInt dy = (y1 >= y0 ? y0 - y1 : y1 - y0), sy = (y0 < y1 ? 1 : -1);
+    MpInt err = dx + dy;
+    MpBool inside = (x0 >= b->xmin && x0 <= b->xmax &&
+                     y0 >= b->ymin && y0 <= b->ymax &&
+                     x1 >= b->xmin && x1 <= b->xmax &&
+                     y1 >= b->ymin && y1 <= b->ymax);
+    for (;;) {
+        if (inside || (x0 >= b->xmin && x0 <= b->xmax &&
+                       y0 >= b->ymin && y0 <= b->ymax)) {
+            pixels[y0*w + x0] = c;
+        }
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        MpInt e2 = 2*err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static void
+drawPolyline(RasterDevice* r, const RasterBox* b, uint32_t c,
+             const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    if (n == 1) {
+        drawPixel(r, b, c, x[0], y[0]);
+    }
+    for (MpInt i = 1; i < n; ++i) {
+        drawLine(r, b, c, x[i-1], y[i-1], x[i], y[i]);
+    }
+}
+
+/*
+ * Draw points by blocks.  The offsets of the pixels of the points inside the
+ * box are first computed by a loop without branches which is vectorized by
+ * the compiler (offsets of points outside the box are overwritten by the
+ * next ones), then the pixels are set.
+ */
+#define RASTER_POINTS_BLOCK 256
+static void
+drawPoints(RasterDevice* r, const RasterBox* b, uint32_t c,
+           const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    const MpInt xmin = b->xmin, xmax = b->xmax;
+    const MpInt ymin = b->ymin, ymax = b->ymax;
+    const MpInt w = r->width;
+    uint32_t* pixels = r->pixels;
+    uint32_t offsets[RASTER_POINTS_BLOCK];
+    for (MpInt i0 = 0; i0 < n; i0 += RASTER_POINTS_BLOCK) {
+        MpInt len = RASTER_MIN(RASTER_POINTS_BLOCK, n - i0);
+        const MpPoint* xb = x + i0;
+        const MpPoint* yb = y + i0;
+        MpInt m = 0;
+        for (MpInt k = 0; k < len; ++k) {
+            MpInt xk = xb[k], yk = yb[k];
+            offsets[m] = (uint32_t)(yk*w + xk);
+            m += ((xk >= xmin) & (xk <= xmax) & (yk >= ymin) & (yk <= ymax));
+        }
+        for (MpInt k = 0; k < m; ++k) {
+            pixels[offsets[k]] = c;
+        }
+    }
+}
+
+/* Fill rectangle of columns `x0` to `x1` and rows `y0` to `y1` (all
+   inclusive). */
+static void
+fillRectangle(RasterDevice* r, const RasterBox* b,
+              MpInt x0, MpInt y0, MpInt x1, MpInt y1, uint32_t c)
+{
+    if (x0 < b->xmin) x0 = b->xmin;
+    if (y0 < b->ymin) y0 = b->ymin;
+    if (x1 > b->xmax) x1 = b->xmax;
+    if (y1 > b->ymax) y1 = b->ymax;
+    for (MpInt y = y0; y <= y1; ++y) {
+        fillSpan(r->pixels + y*r->width, x0, x1, c);
+    }
+}
+
+/* Context of the stroker callback. */
+typedef struct _RasterFill {
+    RasterDevice*    r;
+    const RasterBox* b;
+    uint32_t         c;
+} RasterFill;
+
+static void
+fillStroke(void* ctx, MpInt x0, MpInt y0, MpInt x1, MpInt y1)
+{
+    const RasterFill* f = (const RasterFill*)ctx;
+    fillRectangle(f->r, f->b, x0, y0, x1, y1, f->c);
+}
+
+/* Draw a wide or dashed polyline with stroker `s` from its current phase. */
+static void
+drawStroke(RasterDevice* r, const RasterBox* b, uint32_t c, MpStroker* s,
+           const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    RasterFill f = {r, b, c};
+    MpStrokePolyline(s, x, y, n, fillStroke, &f);
+}
+
+static int
+compareEdges(const void* a, const void* b)
+{
+    MpInt ya = ((const RasterEdge*)a)->ymin;
+    MpInt yb = ((const RasterEdge*)b)->ymin;
+    return (ya < yb ? -1 : (ya > yb ? 1 : 0));
+}
+
+/* Build the list of non-horizontal edges of a polygon sorted by first row
+   and return their number.  An edge crosses rows `ymin` to `ymax - 1`. */
+static MpInt
+buildEdges(RasterEdge* edges, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    MpInt m = 0;
+    for (MpInt i = 0, j = n - 1; i < n; j = i++) {
+        MpInt ya = y[j], yb = y[i];
+        if (ya == yb) {
+            continue;
+        }
+        double xa = x[j], xb = x[i];
+        if (ya > yb) {
+            MpInt ty = ya; ya = yb; yb = ty;
+            double tx = xa; xa = xb; xb = tx;
+        }
+        edges[m].ymin = ya;
+        edges[m].ymax = yb;
+        edges[m].dxdy = (xb - xa)/(double)(yb - ya);
+        edges[m].x = xa;
+        ++m;
+    }
+    qsort(edges, m, sizeof(RasterEdge), compareEdges);
+    return m;
+}
+
+/* Fill the interior of a polygon by spans with the even-odd rule, pixel
+   centers being at integer coordinates.  Array `xs` must have at least `m`
+   elements. */
+static void
+fillEdges(RasterDevice* r, const RasterBox* b, uint32_t c,
+          const RasterEdge* edges, MpInt m, double* xs)
+{
+    /* Scan rows, edges `k0` to `k1 - 1` are the ones that may be active. */
+    MpInt ybeg = (m > 0 ? edges[0].ymin : 0), yend = 0;
+    for (MpInt k = 0; k < m; ++k) {
+        if (edges[k].ymax > yend) {
+            yend = edges[k].ymax;
+        }
+    }
+    if (ybeg < b->ymin) ybeg = b->ymin;
+    if (yend > b->ymax + 1) yend = b->ymax + 1;
+    MpInt k0 = 0, k1 = 0;
+    for (MpInt yr = ybeg; yr < yend; ++yr) {
+        while (k1 < m && edges[k1].ymin <= yr) {
+            ++k1;
+        }
+        while (k0 < k1 && edges[k0].ymax <= yr) {
+            ++k0;
+        }
+        /* Collect intersections and sort them by insertion. */
+        MpInt nx = 0;
+        for (MpInt k = k0; k < k1; ++k) {
+            const RasterEdge* e = &edges[k];
+            if (e->ymax <= yr) {
+                continue;
+            }
+            double xi = e->x + (yr - e->ymin)*e->dxdy;
+            MpInt l = nx++;
+            while (l > 0 && xs[l-1] > xi) {
+                xs[l] = xs[l-1];
+                --l;
+            }
+            xs[l] = xi;
+        }
+        uint32_t* row = r->pixels + yr*r->width;
+        for (MpInt l = 0; l + 1 < nx; l += 2) {
+            MpInt xa = (MpInt)ceil(xs[l]);
+            MpInt xb = (MpInt)floor(xs[l+1]);
+            if (xa < b->xmin) xa = b->xmin;
+            if (xb > b->xmax) xb = b->xmax;
+            if (xa <= xb) {
+                fillSpan(row, xa, xb, c);
+            }
+        }
+    }
+}
+
+/* Draw the outline of a polygon so that thin polygons are visible. */
+static void
+drawOutline(RasterDevice* r, const RasterBox* b, uint32_t c,
+            const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    for (MpInt i = 0, j = n - 1; i < n; j = i++) {
+        drawLine(r, b, c, x[j], y[j], x[i], y[i]);
+    }
+}
+
+/*
+ * Cells are directly written in the pixels.  The pixels of a row of cells
+ * are computed once and copied to the other rows of the raster covered by
+ * the same row of cells.  A function to check whether all cells are valid
+ * indices in the colormap is also defined.
+ */
+#define DEFINE_RASTER_CELLS(SFX, CELL)                                  \
+    static MpStatus                                                     \
+    fillCells##SFX(RasterDevice* r, const RasterBox* b,                 \
+                   const CELL* z, MpInt n1, MpInt n2, MpInt stride,     \
+                   MpInt x0, MpInt y0, MpInt x1, MpInt y1)              \
+    {                                                                   \
+        const uint32_t* palette = r->pub.encodedColors;                 \
+        MpColorIndex ncolors = r->pub.colormapSize;                     \
+        MpInt w = r->width;                                             \
+        MpCellEdges ex0, ey;                                            \
+        MpInitializeCellEdges(&ex0, x0, x1, n1);                        \
+        MpInitializeCellEdges(&ey, y0, y1, n2);                         \
+        MpInt ya = y0;                                                  \
+        for (MpInt i2 = 0; i2 < n2; ++i2) {                             \
+            MpInt yb = MpStepCellEdge(&ey);                             \
+            /* Rows covered by this row of cells. */                    \
+            MpInt ymin = (ya <= yb ? ya : yb + 1);                      \
+            MpInt ymax = (ya <= yb ? yb - 1 : ya);                      \
+            ya = yb;                                                    \
+            if (ymin < b->ymin) ymin = b->ymin;                         \
+            if (ymax > b->ymax) ymax = b->ymax;                         \
+            if (ymin > ymax) {                                          \
+                continue;                                               \
+            }                                                           \
+            const CELL* c = z + i2*stride;                              \
+            uint32_t* row = r->pixels + ymin*w;                         \
+            MpCellEdges ex = ex0;                                       \
+            MpInt xa = x0;                                              \
+            for (MpInt i1 = 0; i1 < n1; ++i1) {                         \
+                MpInt xb = MpStepCellEdge(&ex);                         \
+                MpInt xmin = (xa <= xb ? xa : xb + 1);                  \
+                MpInt xmax = (xa <= xb ? xb - 1 : xa);                  \
+                xa = xb;                                                \
+                if (xmin < b->xmin) xmin = b->xmin;                     \
+                if (xmax > b->xmax) xmax = b->xmax;                     \
+                if (xmin > xmax) {                                      \
+                    continue;                                           \
+                }                                                       \
+                MpColorIndex ci = c[i1];                                \
+                if (ci < 0 || ci >= ncolors) {                          \
+                    return MP_OUT_OF_RANGE;                             \
+                }                                                       \
+                fillSpan(row, xmin, xmax, palette[ci]);                 \
+            }                                                           \
+            MpInt xmin = (x0 <= x1 ? x0 : x1 + 1);                      \
+            MpInt xmax = (x0 <= x1 ? x1 - 1 : x0);                      \
+            if (xmin < b->xmin) xmin = b->xmin;                         \
+            if (xmax > b->xmax) xmax = b->xmax;                         \
+            for (MpInt y = ymin + 1; xmin <= xmax && y <= ymax; ++y) {  \
+                memcpy(r->pixels + y*w + xmin, row + xmin,              \
+                       (xmax + 1 - xmin)*sizeof(uint32_t));             \
+            }                                                           \
+        }                                                               \
+        return MP_OK;                                                   \
+    }                                                                   \
+                                                                        \
+    static MpBool                                                       \
+    checkCells##SFX(const CELL* z, MpInt n1, MpInt n2, MpInt stride,    \
+                    MpColorIndex ncolors)                               \
+    {                                                                   \
+        for (MpInt i2 = 0; i2 < n2; ++i2) {                             \
+            const CELL* c = z + i2*stride;                              \
+            for (MpInt i1 = 0; i1 < n1; ++i1) {                         \
+                MpColorIndex ci = c[i1];                                \
+                if (ci < 0 || ci >= ncolors) {                          \
+                    return false;                                       \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+        return true;                                                    \
+    }
+
+DEFINE_RASTER_CELLS(,   MpColorIndex)
+DEFINE_RASTER_CELLS(8,  uint8_t)
+DEFINE_RASTER_CELLS(16, uint16_t)
+
+/*---------------------------------------------------------------------------*/
+/* TILED RENDERING */
+
+/* Render a recorded command in box `b`. */
+static void
+renderCommand(RasterDevice* r, const RasterBox* b,
+              const RasterCommand* cmd, double* xs)
+{
+    const void* data = RASTER_PAYLOAD(cmd);
+    switch (cmd->kind) {
+    case RASTER_POINT:
+        drawPixel(r, b, cmd->color, cmd->x0, cmd->y0);
+        break;
+    case RASTER_POINTS: {
+        const MpPoint* x = (const MpPoint*)data;
+        drawPoints(r, b, cmd->color, x, x + cmd->n, cmd->n);
+        break;
+    }
+    case RASTER_RECTANGLE:
+        fillRectangle(r, b, cmd->x0, cmd->y0, cmd->x1, cmd->y1, cmd->color);
+        break;
+    case RASTER_POLYLINE: {
+        const MpPoint* x = (const MpPoint*)data;
+        drawPolyline(r, b, cmd->color, x, x + cmd->n, cmd->n);
+        break;
+    }
+    case RASTER_STROKE: {
+        /* The payload is the state of the stroker at the start of the chunk
+           followed by the vertices. */
+        MpStroker stroker = *(const MpStroker*)data;
+        const MpPoint* x = (const MpPoint*)((const char*)data +
+                                            RASTER_ALIGN(sizeof(MpStroker)));
+        drawStroke(r, b, cmd->color, &stroker, x, x + cmd->n, cmd->n);
+        break;
+    }
+    case RASTER_POLYGON: {
+        const RasterEdge* edges = (const RasterEdge*)data;
+        const MpPoint* x = (const MpPoint*)(edges + cmd->n);
+        fillEdges(r, b, cmd->color, edges, cmd->m, xs);
+        drawOutline(r, b, cmd->color, x, x + cmd->n, cmd->n);
+        break;
+    }
+    case RASTER_CELLS:
+        fillCells(r, b, (const MpColorIndex*)data, cmd->n, cmd->m, cmd->n,
+                  cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+        break;
+    case RASTER_CELLS8:
+        fillCells8(r, b, (const uint8_t*)data, cmd->n, cmd->m, cmd->n,
+                   cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+        break;
+    case RASTER_CELLS16:
+        fillCells16(r, b, (const uint16_t*)data, cmd->n, cmd->m, cmd->n,
+                    cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+        break;
+    }
+}
+
+/* Render tiles until there are no more tiles left.  Tiles are handed to the
+   workers by the shared counter so that idle workers take over the remaining
+   tiles. */
+static void
+renderTiles(RasterWorker* w)
+{
+    RasterDevice* r = w->device;
+    for (;;) {
+        MpInt t = atomic_fetch_add(&r->nextTile, 1);
+        if (t >= r->ntiles) {
+            break;
+        }
+        const RasterBin* bin = &r->bins[t];
+        if (bin->count < 1) {
+            continue;
+        }
+        RasterBox b;
+        b.xmin = (t%r->tilesPerRow)*RASTER_TILE_SIZE;
+        b.ymin = (t/r->tilesPerRow)*RASTER_TILE_SIZE;
+        b.xmax = RASTER_MIN(b.xmin + RASTER_TILE_SIZE, r->width) - 1;
+        b.ymax = RASTER_MIN(b.ymin + RASTER_TILE_SIZE, r->height) - 1;
+        for (MpInt k = 0; k < bin->count; ++k) {
+            renderCommand(r, &b, (const RasterCommand*)(
+                              r->commands + bin->offsets[k]), w->xs);
+        }
+    }
+}
+
+static void*
+runWorker(void* arg)
+{
+    RasterWorker* w = (RasterWorker*)arg;
+    RasterDevice* r = w->device;
+    pthread_mutex_lock(&r->mutex);
+    for (;;) {
+        while (!r->quit && r->generation == w->generation) {
+            pthread_cond_wait(&r->start, &r->mutex);
+        }
+        if (r->quit) {
+            break;
+        }
+        w->generation = r->generation;
+        pthread_mutex_unlock(&r->mutex);
+        renderTiles(w);
+        pthread_mutex_lock(&r->mutex);
+        if (--r->busy == 0) {
+            pthread_cond_signal(&r->done);
+        }
+    }
+    pthread_mutex_unlock(&r->mutex);
+    return NULL;
+}
+
+static void
+discardCommands(RasterDevice* r)
+{
+    for (MpInt t = 0; t < r->ntiles; ++t) {
+        r->bins[t].count = 0;
+    }
+    r->commandsCount = 0;
+    r->pendingEdges = 0;
+}
+
+/* Render all recorded commands, the caller's thread is one of the
+   workers. */
+static MpStatus
+flushRaster(RasterDevice* r)
+{
+    if (r->commandsCount == 0) {
+        return MP_OK;
+    }
+    for (MpInt i = 0; i < r->nthreads; ++i) {
+        RasterWorker* w = &r->workers[i];
+        if (w->maxEdges < r->pendingEdges) {
+            double* xs = (double*)realloc(w->xs,
+                                          r->pendingEdges*sizeof(double));
+            if (xs == NULL) {
+                discardCommands(r);
+                return MP_NO_MEMORY;
+            }
+            w->xs = xs;
+            w->maxEdges = r->pendingEdges;
+        }
+    }
+    atomic_store(&r->nextTile, 0);
+    pthread_mutex_lock(&r->mutex);
+    r->busy = r->nthreads - 1;
+    ++r->generation;
+    pthread_cond_broadcast(&r->start);
+    pthread_mutex_unlock(&r->mutex);
+    renderTiles(&r->workers[0]);
+    pthread_mutex_lock(&r->mutex);
+    while (r->busy > 0) {
+        pthread_cond_wait(&r->done, &r->mutex);
+    }
+    pthread_mutex_unlock(&r->mutex);
+    discardCommands(r);
+    return MP_OK;
+}
+
+static void
+stopWorkers(RasterDevice* r)
+{
+    if (r->workers == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&r->mutex);
+    r->quit = true;
+    pthread_cond_broadcast(&r->start);
+    pthread_mutex_unlock(&r->mutex);
+    for (MpInt i = 1; i < r->nthreads; ++i) {
+        pthread_join(r->workers[i].thread, NULL);
+    }
+    for (MpInt i = 0; i < r->nthreads; ++i) {
+        free((void*)r->workers[i].xs);
+    }
+    for (MpInt t = 0; t < r->ntiles; ++t) {
+        free((void*)r->bins[t].offsets);
+    }
+    pthread_cond_destroy(&r->done);
+    pthread_cond_destroy(&r->start);
+    pthread_mutex_destroy(&r->mutex);
+    free((void*)r->workers);
+    free((void*)r->bins);
+    free((void*)r->tileCounts);
+    free((void*)r->commands);
+    r->workers = NULL;
+    r->bins = NULL;
+    r->tileCounts = NULL;
+    r->commands = NULL;
+    r->commandsSize = 0;
+    r->commandsCount = 0;
+    r->pendingEdges = 0;
+    r->ntiles = 0;
+    r->nthreads = 0;
+}
+
+static MpStatus
+startWorkers(RasterDevice* r, MpInt nthreads)
+{
+    r->tilesPerRow = (r->width + RASTER_TILE_SIZE - 1)/RASTER_TILE_SIZE;
+    r->ntiles = r->tilesPerRow*(
+        (r->height + RASTER_TILE_SIZE - 1)/RASTER_TILE_SIZE);
+    r->workers = (RasterWorker*)calloc(nthreads, sizeof(RasterWorker));
+    r->bins = (RasterBin*)calloc(r->ntiles, sizeof(RasterBin));
+    r->tileCounts = (MpInt*)calloc(r->ntiles, sizeof(MpInt));
+    if (r->workers == NULL || r->bins == NULL || r->tileCounts == NULL) {
+        free((void*)r->workers);
+        free((void*)r->bins);
+        free((void*)r->tileCounts);
+        r->workers = NULL;
+        r->bins = NULL;
+        r->tileCounts = NULL;
+        r->ntiles = 0;
+        return MP_NO_MEMORY;
+    }
+    pthread_mutex_init(&r->mutex, NULL);
+    pthread_cond_init(&r->start, NULL);
+    pthread_cond_init(&r->done, NULL);
+    r->generation = 0;
+    r->busy = 0;
+    r->quit = false;
+    r->workers[0].device = r;
+    for (r->nthreads = 1; r->nthreads < nthreads; ++r->nthreads) {
+        RasterWorker* w = &r->workers[r->nthreads];
+        w->device = r;
+        int code = pthread_create(&w->thread, NULL, runWorker, w);
+        if (code != 0) {
+            stopWorkers(r);
+            return -(1 + code);
+        }
+    }
+    return MP_OK;
+}
+
+/* Record a new command.  The command is binned in the tiles overlapping the
+   box `b` which must be inside the raster.  On success, the header and the
+   payload of the command must be filled by the caller before any other
+   command is recorded. */
+static MpStatus
+pushCommand(RasterDevice* r, RasterCommandKind kind, const RasterBox* b,
+            size_t size, RasterCommand** cmdptr)
+{
+    size = RASTER_HEADER_SIZE + RASTER_ALIGN(size);
+    if (r->commandsCount > 0 &&
+        r->commandsCount + size > RASTER_MAX_PENDING) {
+        MpStatus status = flushRaster(r);
+        if (status != MP_OK) {
+            return status;
+        }
+    }
+    if (r->commandsCount + size > r->commandsSize) {
+        size_t newSize = RASTER_MAX(2*r->commandsSize, r->commandsCount + size);
+        newSize = RASTER_MAX(newSize, 1 << 16);
+        unsigned char* commands = (unsigned char*)realloc(r->commands,
+                                                          newSize);
+        if (commands == NULL) {
+            return MP_NO_MEMORY;
+        }
+        r->commands = commands;
+        r->commandsSize = newSize;
+    }
+
+    /* Reserve space in all bins before storing the offset of the command, so
+       that a failure leaves the bins unchanged. */
+    MpInt tx0 = b->xmin/RASTER_TILE_SIZE, tx1 = b->xmax/RASTER_TILE_SIZE;
+    MpInt ty0 = b->ymin/RASTER_TILE_SIZE, ty1 = b->ymax/RASTER_TILE_SIZE;
+    for (MpInt ty = ty0; ty <= ty1; ++ty) {
+        for (MpInt tx = tx0; tx <= tx1; ++tx) {
+            RasterBin* bin = &r->bins[ty*r->tilesPerRow + tx];
+            if (bin->count >= bin->size) {
+                MpInt newSize = RASTER_MAX(2*bin->size, 64);
+                size_t* offsets = (size_t*)realloc(bin->offsets,
+                                                   newSize*sizeof(size_t));
+                if (offsets == NULL) {
+                    return MP_NO_MEMORY;
+                }
+                bin->offsets = offsets;
+                bin->size = newSize;
+            }
+        }
+    }
+    size_t offset = r->commandsCount;
+    for (MpInt ty = ty0; ty <= ty1; ++ty) {
+        for (MpInt tx = tx0; tx <= tx1; ++tx) {
+            RasterBin* bin = &r->bins[ty*r->tilesPerRow + tx];
+            bin->offsets[bin->count++] = offset;
+        }
+    }
+    r->commandsCount += size;
+    RasterCommand* cmd = (RasterCommand*)(r->commands + offset);
+    cmd->kind = kind;
+    cmd->color = r->color;
+    r->dirty = true;
+    *cmdptr = cmd;
+    return MP_OK;
+}
+
+/* Clip box `b` to the raster, return whether the result is not empty. */
+static MpBool
+clipBox(const RasterDevice* r, RasterBox* b)
+{
+    b->xmin = RASTER_MAX(b->xmin, 0);
+    b->ymin = RASTER_MAX(b->ymin, 0);
+    b->xmax = RASTER_MIN(b->xmax, r->width - 1);
+    b->ymax = RASTER_MIN(b->ymax, r->height - 1);
+    return (b->xmin <= b->xmax && b->ymin <= b->ymax);
+}
+
+static void
+boundingBox(RasterBox* b, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    MpInt xmin = x[0], xmax = x[0], ymin = y[0], ymax = y[0];
+    for (MpInt i = 1; i < n; ++i) {
+        xmin = RASTER_MIN(xmin, x[i]);
+        xmax = RASTER_MAX(xmax, x[i]);
+        ymin = RASTER_MIN(ymin, y[i]);
+        ymax = RASTER_MAX(ymax, y[i]);
+    }
+    b->xmin = xmin;
+    b->ymin = ymin;
+    b->xmax = xmax;
+    b->ymax = ymax;
+}
+
+/* Record a polyline by chunks so that each chunk is only binned in the tiles
+   it overlaps. */
+static MpStatus
+recordPolyline(RasterDevice* r, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    for (MpInt i = 0; i < n; i += RASTER_CHUNK_SIZE) {
+        MpInt len = RASTER_MIN(RASTER_CHUNK_SIZE + 1, n - i);
+        if (i > 0 && len < 2) {
+            break;
+        }
+        RasterBox b;
+        boundingBox(&b, x + i, y + i, len);
+        if (!clipBox(r, &b)) {
+            continue;
+        }
+        RasterCommand* cmd;
+        MpStatus status = pushCommand(r, RASTER_POLYLINE, &b,
+                                      2*len*sizeof(MpPoint), &cmd);
+        if (status != MP_OK) {
+            return status;
+        }
+        MpPoint* xp = (MpPoint*)RASTER_PAYLOAD(cmd);
+        memcpy(xp, x + i, len*sizeof(MpPoint));
+        memcpy(xp + len, y + i, len*sizeof(MpPoint));
+        cmd->n = len;
+    }
+    return MP_OK;
+}
+
+/* Record a wide or dashed polyline by chunks.  Each chunk stores the state of
+   the stroker at its first vertex so that tiles replay the dash pattern from
+   the same phase, the boxes of the chunks are grown by the line width. */
+static MpStatus
+recordStroke(RasterDevice* r, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    MpStroker* s = &r->stroker;
+    const MpInt t = s->thickness;
+    const size_t offset = RASTER_ALIGN(sizeof(MpStroker));
+    MpBeginStroke(s, x[0], y[0]);
+    for (MpInt i = 0; i < n; i += RASTER_CHUNK_SIZE) {
+        MpInt len = RASTER_MIN(RASTER_CHUNK_SIZE + 1, n - i);
+        if (i > 0 && len < 2) {
+            break;
+        }
+        RasterBox b;
+        boundingBox(&b, x + i, y + i, len);
+        b.xmin -= t;
+        b.ymin -= t;
+        b.xmax += t;
+        b.ymax += t;
+        if (clipBox(r, &b)) {
+            RasterCommand* cmd;
+            MpStatus status = pushCommand(r, RASTER_STROKE, &b, offset +
+                                          2*len*sizeof(MpPoint), &cmd);
+            if (status != MP_OK) {
+                return status;
+            }
+            void* data = RASTER_PAYLOAD(cmd);
+            MpPoint* xp = (MpPoint*)((char*)data + offset);
+            memcpy(data, s, sizeof(MpStroker));
+            memcpy(xp, x + i, len*sizeof(MpPoint));
+            memcpy(xp + len, y + i, len*sizeof(MpPoint));
+            cmd->n = len;
+        }
+        MpStrokePolyline(s, x + i, y + i, len, NULL, NULL);
+    }
+    return MP_OK;
+}
+
+/*
+ * Record points by blocks.  The points of a block inside the raster are
+ * sorted by tiles (in the order of the first point of each tile) and a
+ * command is recorded for each tile with points.  Hence each point is only
+ * considered by the tile it belongs to.
+ */
+static MpStatus
+recordPoints(RasterDevice* r, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    MpPoint xb[RASTER_POINTS_BLOCK], yb[RASTER_POINTS_BLOCK];
+    MpPoint xs[RASTER_POINTS_BLOCK], ys[RASTER_POINTS_BLOCK];
+    MpInt tiles[RASTER_POINTS_BLOCK], touched[RASTER_POINTS_BLOCK];
+    MpInt* counts = r->tileCounts;
+    for (MpInt i0 = 0; i0 < n; i0 += RASTER_POINTS_BLOCK) {
+        /* Keep the points inside the raster and count the points per
+           tile. */
+        MpInt len = RASTER_MIN(RASTER_POINTS_BLOCK, n - i0);
+        MpInt m = 0, nt = 0;
+        for (MpInt k = 0; k < len; ++k) {
+            MpInt xk = x[i0 + k], yk = y[i0 + k];
+            if (xk >= 0 && xk < r->width && yk >= 0 && yk < r->height) {
+                MpInt t = (yk/RASTER_TILE_SIZE)*r->tilesPerRow +
+                    xk/RASTER_TILE_SIZE;
+                if (counts[t] == 0) {
+                    touched[nt++] = t;
+                }
+                ++counts[t];
+                xb[m] = xk;
+                yb[m] = yk;
+                tiles[m] = t;
+                ++m;
+            }
+        }
+
+        /* Sort the points by tiles, on return `counts[touched[j]]` is the
+           end of the points of the j-th tile. */
+        MpInt pos = 0;
+        for (MpInt j = 0; j < nt; ++j) {
+            MpInt c = counts[touched[j]];
+            counts[touched[j]] = pos;
+            pos += c;
+        }
+        for (MpInt k = 0; k < m; ++k) {
+            MpInt p = counts[tiles[k]]++;
+            xs[p] = xb[k];
+            ys[p] = yb[k];
+        }
+
+        /* Record a command per tile. */
+        MpStatus status = MP_OK;
+        for (MpInt j = 0, start = 0; j < nt; ++j) {
+            MpInt t = touched[j];
+            MpInt end = counts[t];
+            counts[t] = 0;
+            if (status != MP_OK) {
+                continue;
+            }
+            MpInt count = end - start;
+            RasterBox b;
+            boundingBox(&b, xs + start, ys + start, count);
+            RasterCommand* cmd;
+            status = pushCommand(r, RASTER_POINTS, &b,
+                                 2*count*sizeof(MpPoint), &cmd);
+            if (status == MP_OK) {
+                MpPoint* xp = (MpPoint*)RASTER_PAYLOAD(cmd);
+                memcpy(xp, xs + start, count*sizeof(MpPoint));
+                memcpy(xp + count, ys + start, count*sizeof(MpPoint));
+                cmd->n = count;
+            }
+            start = end;
+        }
+        if (status != MP_OK) {
+            return status;
+        }
+    }
+    return MP_OK;
+}
+
+static MpStatus
+recordPolygon(RasterDevice* r, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    RasterBox b;
+    boundingBox(&b, x, y, n);
+    if (!clipBox(r, &b)) {
+        return MP_OK;
+    }
+    RasterCommand* cmd;
+    MpStatus status = pushCommand(r, RASTER_POLYGON, &b,
+                                  n*sizeof(RasterEdge) + 2*n*sizeof(MpPoint),
+                                  &cmd);
+    if (status != MP_OK) {
+        return status;
+    }
+    RasterEdge* edges = (RasterEdge*)RASTER_PAYLOAD(cmd);
+    MpPoint* xp = (MpPoint*)(edges + n);
+    memcpy(xp, x, n*sizeof(MpPoint));
+    memcpy(xp + n, y, n*sizeof(MpPoint));
+    cmd->n = n;
+    cmd->m = buildEdges(edges, x, y, n);
+    r->pendingEdges = RASTER_MAX(r->pendingEdges, cmd->m);
+    return MP_OK;
+}
+
+static MpStatus
+recordCells(RasterDevice* r, RasterCommandKind kind, size_t elsize,
+            const void* z, MpInt n1, MpInt n2, MpInt stride,
+            MpInt x0, MpInt y0, MpInt x1, MpInt y1)
+{
+    RasterBox b = {(x0 <= x1 ? x0 : x1 + 1), (y0 <= y1 ? y0 : y1 + 1),
+                   (x0 <= x1 ? x1 - 1 : x0), (y0 <= y1 ? y1 - 1 : y0)};
+    if (n1 < 1 || n2 < 1 || !clipBox(r, &b)) {
+        return MP_OK;
+    }
+    RasterCommand* cmd;
+    MpStatus status = pushCommand(r, kind, &b, n1*n2*elsize, &cmd);
+    if (status != MP_OK) {
+        return status;
+    }
+    unsigned char* dst = (unsigned char*)RASTER_PAYLOAD(cmd);
+    for (MpInt i2 = 0; i2 < n2; ++i2) {
+        memcpy(dst + i2*n1*elsize, (const unsigned char*)z + i2*stride*elsize,
+               n1*elsize);
+    }
+    cmd->n = n1;
+    cmd->m = n2;
+    cmd->x0 = x0;
+    cmd->y0 = y0;
+    cmd->x1 = x1;
+    cmd->y1 = y1;
+    return MP_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/* OUTPUT */
+
+static void
+writeUInt32(MpWriter* out, uint32_t val)
+{
+    unsigned char buf[4] = {(unsigned char)(val >> 24),
+                            (unsigned char)(val >> 16),
+                            (unsigned char)(val >>  8),
+                            (unsigned char)(val      )};
+    MpWriteBytes(out, buf, 4);
+}
+
+static void
+writePNGChunk(MpWriter* out, const char* type,
+              const unsigned char* data, size_t len)
+{
+    writeUInt32(out, (uint32_t)len);
+    MpWriteBytes(out, type, 4);
+    uLong crc = crc32(0L, (const Bytef*)type, 4);
+    if (len > 0) {
+        MpWriteBytes(out, data, len);
+        crc = crc32(crc, (const Bytef*)data, (uInt)len);
+    }
+    writeUInt32(out, (uint32_t)crc);
+}
+
+/* Convert row `y` of pixels into RGB bytes. */
+static void
+packRow(const RasterDevice* r, MpInt y, unsigned char* dst)
+{
+    const uint32_t* row = r->pixels + y*r->width;
+    for (MpInt x = 0; x < r->width; ++x) {
+        uint32_t p = row[x];
+        dst[3*x]     = RASTER_RED(p);
+        dst[3*x + 1] = RASTER_GREEN(p);
+        dst[3*x + 2] = RASTER_BLUE(p);
+    }
+}
+
+static MpStatus
+writePPM(RasterDevice* r, MpWriter* out)
+{
+    MpWriteFormatted(out, "P6\n%ld %ld\n255\n", (long)r->width, (long)r->height);
+    unsigned char* row = (unsigned char*)malloc(3*r->width);
+    if (row == NULL) {
+        return MP_NO_MEMORY;
+    }
+    for (MpInt y = 0; y < r->height && out->status == MP_OK; ++y) {
+        packRow(r, y, row);
+        MpWriteBytes(out, row, 3*r->width);
+    }
+    free((void*)row);
+    return out->status;
+}
+
+static MpStatus
+writePNG(RasterDevice* r, MpWriter* out)
+{
+    /* Signature and header (8-bit RGB, no interlace). */
+    static const unsigned char signature[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    unsigned char header[13] = {
+        (unsigned char)(r->width >> 24), (unsigned char)(r->width >> 16),
+        (unsigned char)(r->width >> 8), (unsigned char)r->width,
+        (unsigned char)(r->height >> 24), (unsigned char)(r->height >> 16),
+        (unsigned char)(r->height >> 8), (unsigned char)r->height,
+        8, 2, 0, 0, 0};
+    MpWriteBytes(out, signature, sizeof(signature));
+    writePNGChunk(out, "IHDR", header, sizeof(header));
+
+    /* Compressed rows, each preceded by filter type 0, the compressed data
+       is written in IDAT chunks. */
+    MpStatus status = MP_OK;
+    size_t rowSize = 1 + 3*r->width, chunkSize = 1 << 16;
+    unsigned char* row = (unsigned char*)malloc(rowSize + chunkSize);
+    if (row == NULL) {
+        return MP_NO_MEMORY;
+    }
+    unsigned char* chunk = row + rowSize;
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit(&z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        free((void*)row);
+        return MP_NO_MEMORY;
+    }
+    z.next_out = chunk;
+    z.avail_out = chunkSize;
+    for (MpInt y = 0; y <= r->height && status == MP_OK; ++y) {
+        int flush = (y < r->height ? Z_NO_FLUSH : Z_FINISH);
+        if (y < r->height) {
+            row[0] = 0;
+            packRow(r, y, row + 1);
+            z.next_in = row;
+            z.avail_in = rowSize;
+        }
+        for (;;) {
+            int code = deflate(&z, flush);
+            if (code == Z_STREAM_ERROR) {
+                status = MP_ASSERTION_FAILED;
+                break;
+            }
+            if (z.avail_out == 0 || (code == Z_STREAM_END &&
+                                     z.avail_out < chunkSize)) {
+                writePNGChunk(out, "IDAT", chunk, chunkSize - z.avail_out);
+                z.next_out = chunk;
+                z.avail_out = chunkSize;
+            }
+            if (code == Z_STREAM_END ||
+                (flush == Z_NO_FLUSH && z.avail_in == 0 && z.avail_out > 0)) {
+                break;
+            }
+        }
+    }
+    deflateEnd(&z);
+    free((void*)row);
+    writePNGChunk(out, "IEND", NULL, 0);
+    return (status == MP_OK ? out->status : status);
+}
+
+static MpStatus
+saveRaster(RasterDevice* r)
+{
+    if (r->output == RASTER_NO_OUTPUT) {
+        r->dirty = false;
+        return MP_OK;
+    }
+    FILE* file = fopen(r->fileName, "wb");
+    if (file == NULL) {
+        return MpSystemError();
+    }
+    MpWriter out;
+    MpStatus status = MpInitializeWriter(&out, file, 0);
+    out.device = &r->pub;
+    if (status == MP_OK) {
+        status = (r->output == RASTER_PNG_OUTPUT ?
+                  writePNG(r, &out) : writePPM(r, &out));
+    }
+    if (MpFinalizeWriter(&out) != MP_OK && status == MP_OK) {
+        status = out.status;
+    }
+    if (fclose(file) != 0 && status == MP_OK) {
+        status = MpSystemError();
+    }
+    if (status == MP_OK) {
+        r->dirty = false;
+    }
+    return status;
+}
+
+/*---------------------------------------------------------------------------*/
+/* METHODS */
+
+static MpStatus
+initializeRasterDevice(MpDevice* dev)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+
+    /* The origin of the raster is at the upper left corner. */
+    MpCoordinateTransform B = {dev->horizontalSamples - 1, 0, 0,
+                               0, 1 - dev->verticalSamples,
+                               dev->verticalSamples - 1};
+    MpStatus status = MpSetNDCToDeviceTransform(dev, &B);
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Initialize CMAP2 with a ramp of grays. */
+    if (dev->colormapSize2 > 1) {
+        MpReal a = (MpReal)1/(MpReal)(dev->colormapSize2 - 1);
+        for (MpInt i = 0; i < dev->colormapSize2; ++i) {
+            MpReal g = a*i;
+            MpEncodeColor(&dev->colormap[dev->colormapSize1 + i], g,g,g);
+        }
+    }
+
+    /* Allocate pixels, the colors of the colormap are packed once for all in
+       the encoded colors of the device. */
+    r->width = dev->horizontalSamples;
+    r->height = dev->verticalSamples;
+    r->box.xmin = 0;
+    r->box.ymin = 0;
+    r->box.xmax = r->width - 1;
+    r->box.ymax = r->height - 1;
+    r->pixels = (uint32_t*)malloc(r->width*r->height*sizeof(uint32_t));
+    if (r->pixels == NULL) {
+        return MP_NO_MEMORY;
+    }
+    status = MpSetColorEncoder(dev, packColor);
+    if (status != MP_OK) {
+        return status;
+    }
+    r->color = dev->encodedColors[dev->colorIndex];
+    status = MpSetStrokerStyle(&r->stroker, dev->lineStyle, dev->lineWidth);
+    if (status != MP_OK) {
+        return status;
+    }
+    clearRaster(r);
+    return MP_OK;
+}
+
+static MpStatus
+finalizeRasterDevice(MpDevice* dev)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    MpStatus status = MP_OK;
+    if (r->nthreads > 1) {
+        status = flushRaster(r);
+        stopWorkers(r);
+    }
+    if (r->dirty && r->pixels != NULL) {
+        MpStatus code = saveRaster(r);
+        if (status == MP_OK) {
+            status = code;
+        }
+    }
+    free((void*)r->pixels);
+    free((void*)r->fileName);
+    free((void*)r->edges);
+    free((void*)r->xs);
+    r->pixels = NULL;
+    r->fileName = NULL;
+    r->edges = NULL;
+    r->xs = NULL;
+    return status;
+}
+
+static MpStatus
+stopRasterBuffering(MpDevice* dev)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    return (r->nthreads > 1 ? flushRaster(r) : MP_OK);
+}
+
+static MpStatus
+beginRasterPage(MpDevice* dev)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    if (r->nthreads > 1) {
+        discardCommands(r);
+    }
+    MpResetStroker(&r->stroker);
+    clearRaster(r);
+    return MP_OK;
+}
+
+static MpStatus
+endRasterPage(MpDevice* dev)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    if (r->nthreads > 1) {
+        MpStatus status = flushRaster(r);
+        if (status != MP_OK) {
+            return status;
+        }
+    }
+    return saveRaster(r);
+}
+
+static MpStatus
+setRasterColorIndex(MpDevice* dev, MpColorIndex ci)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    dev->colorIndex = ci;
+    r->color = dev->encodedColors[ci];
+    return MP_OK;
+}
+
+static MpStatus
+setRasterColor(MpDevice* dev, MpColorIndex ci,
+               MpReal rd, MpReal gr, MpReal bl)
+{
+    /* Recorded cells refer to the encoded colors, they must be rendered
+       before changing them. */
+    RasterDevice* r = (RasterDevice*)dev;
+    if (r->nthreads > 1) {
+        MpStatus status = flushRaster(r);
+        if (status != MP_OK) {
+            return status;
+        }
+    }
+    dev->colormap[ci].red   = rd;
+    dev->colormap[ci].green = gr;
+    dev->colormap[ci].blue  = bl;
+    MpStatus status = MpRefreshEncodedColors(dev, ci, 1);
+    if (status == MP_OK && ci == dev->colorIndex) {
+        r->color = dev->encodedColors[ci];
+    }
+    return status;
+}
+
+static MpStatus
+setRasterLineStyle(MpDevice* dev, MpLineStyle ls)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    MpStatus status = MpSetStrokerStyle(&r->stroker, ls, dev->lineWidth);
+    if (status == MP_OK) {
+        dev->lineStyle = ls;
+    }
+    return status;
+}
+
+static MpStatus
+setRasterLineWidth(MpDevice* dev, MpReal lw)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    MpStatus status = MpSetStrokerStyle(&r->stroker, dev->lineStyle, lw);
+    if (status == MP_OK) {
+        dev->lineWidth = lw;
+    }
+    return status;
+}
+
+static MpStatus
+drawRasterPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    if (x >= 0 && x < r->width && y >= 0 && y < r->height) {
+        if (r->nthreads > 1) {
+            RasterBox b = {x, y, x, y};
+            RasterCommand* cmd;
+            MpStatus status = pushCommand(r, RASTER_POINT, &b, 0, &cmd);
+            if (status != MP_OK) {
+                return status;
+            }
+            cmd->x0 = x;
+            cmd->y0 = y;
+            return MP_OK;
+        }
+        r->pixels[y*r->width + x] = r->color;
+        r->dirty = true;
+    }
+    return MP_OK;
+}
+
+static MpStatus
+drawRasterPoints(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    if (r->nthreads > 1) {
+        return recordPoints(r, x, y, n);
+    }
+    drawPoints(r, &r->box, r->color, x, y, n);
+    r->dirty = true;
+    return MP_OK;
+}
+
+static MpStatus
+drawRasterRectangle(MpDevice* dev,
+                    MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    /* The corner (x1,y1) is excluded. */
+    RasterDevice* r = (RasterDevice*)dev;
+    MpInt xmin = (x0 <= x1 ? x0 : x1 + 1), xmax = (x0 <= x1 ? x1 - 1 : x0);
+    MpInt ymin = (y0 <= y1 ? y0 : y1 + 1), ymax = (y0 <= y1 ? y1 - 1 : y0);
+    if (r->nthreads > 1) {
+        RasterBox b = {xmin, ymin, xmax, ymax};
+        if (!clipBox(r, &b)) {
+            return MP_OK;
+        }
+        RasterCommand* cmd;
+        MpStatus status = pushCommand(r, RASTER_RECTANGLE, &b, 0, &cmd);
+        if (status != MP_OK) {
+            return status;
+        }
+        cmd->x0 = b.xmin;
+        cmd->y0 = b.ymin;
+        cmd->x1 = b.xmax;
+        cmd->y1 = b.ymax;
+        return MP_OK;
+    }
+    fillRectangle(r, &r->box, xmin, ymin, xmax, ymax, r->color);
+    r->dirty = true;
+    return MP_OK;
+}
+
+static MpStatus
+drawRasterPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    if (n == 1) {
+        return drawRasterPoint(dev, x[0], y[0]);
+    }
+    if (! MP_IS_THIN_SOLID_STROKER(&r->stroker)) {
+        if (r->nthreads > 1) {
+            return recordStroke(r, x, y, n);
+        }
+        MpBeginStroke(&r->stroker, x[0], y[0]);
+        drawStroke(r, &r->box, r->color, &r->stroker, x, y, n);
+        r->dirty = true;
+        return MP_OK;
+    }
+    if (r->nthreads > 1) {
+        return recordPolyline(r, x, y, n);
+    }
+    drawPolyline(r, &r->box, r->color, x, y, n);
+    r->dirty = true;
+    return MP_OK;
+}
+
+static MpStatus
+drawRasterPolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    RasterDevice* r = (RasterDevice*)dev;
+    if (n < 3) {
+        return drawRasterPolyline(dev, x, y, n);
+    }
+    if (r->nthreads > 1) {
+        return recordPolygon(r, x, y, n);
+    }
+    if (n > r->maxEdges) {
+        RasterEdge* edges = (RasterEdge*)realloc(r->edges,
+                                                 n*sizeof(RasterEdge));
+        if (edges == NULL) {
+            return MP_NO_MEMORY;
+        }
+        r->edges = edges;
+        double* xs = (double*)realloc(r->xs, n*sizeof(double));
+        if (xs == NULL) {
+            return MP_NO_MEMORY;
+        }
+        r->xs = xs;
+        r->maxEdges = n;
+    }
+    MpInt m = buildEdges(r->edges, x, y, n);
+    fillEdges(r, &r->box, r->color, r->edges, m, r->xs);
+    drawOutline(r, &r->box, r->color, x, y, n);
+    r->dirty = true;
+    return MP_OK;
+}
+
+/* In tiled mode, cells with invalid indices are drawn immediately so that
+   the result and the returned status are the same as in serial mode. */
+#define DRAW_RASTER_CELLS(SFX, KIND, CELL)                              \
+    do {                                                                \
+        RasterDevice* r = (RasterDevice*)dev;                           \
+        if (r->nthreads > 1) {                                          \
+            if (checkCells##SFX(z, n1, n2, stride, dev->colormapSize)) { \
+                return recordCells(r, KIND, sizeof(CELL), z, n1, n2,    \
+                                   stride, x0, y0, x1, y1);             \
+            }                                                           \
+            MpStatus status = flushRaster(r);                           \
+            if (status != MP_OK) {                                      \
+                return status;                                          \
+            }                                                           \
+        }                                                               \
+        r->dirty = true;                                                \
+        return fillCells##SFX(r, &r->box, z, n1, n2, stride,            \
+                              x0, y0, x1, y1);                          \
+    } while (0)
+
+static MpStatus
+drawRasterCells(MpDevice* dev,
+                const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
+                MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    DRAW_RASTER_CELLS(, RASTER_CELLS, MpColorIndex);
+}
+
+static MpStatus
+drawRasterCells8(MpDevice* dev,
+                 const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+                 MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    DRAW_RASTER_CELLS(8, RASTER_CELLS8, uint8_t);
+}
+
+static MpStatus
+drawRasterCells16(MpDevice* dev,
+                  const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+                  MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    DRAW_RASTER_CELLS(16, RASTER_CELLS16, uint16_t);
+}
+
+/*---------------------------------------------------------------------------*/
+/* PUBLIC FUNCTIONS */
+
+MpStatus
+MpOpenRasterDevice(MpDevice** devptr, const char* ident, const char* arg)
+{
+    /* Note: Arguments have been checked but `arg` may be `NULL` or an empty
+       string.  The syntax of `arg` is `[WIDTHxHEIGHT][:FILENAME]`. */
+    long width = RASTER_DEFAULT_WIDTH, height = RASTER_DEFAULT_HEIGHT;
+    const char* name = NULL;
+    if (arg != NULL && arg[0] != '\0') {
+        int len = 0;
+        if (sscanf(arg, "%ldx%ld%n", &width, &height, &len) == 2 &&
+            (arg[len] == '\0' || arg[len] == ':')) {
+            if (width < 1 || width > 32767 || height < 1 || height > 32767) {
+                return MP_BAD_SIZE;
+            }
+            name = (arg[len] == ':' ? arg + len + 1 : NULL);
+        } else {
+            width = RASTER_DEFAULT_WIDTH;
+            height = RASTER_DEFAULT_HEIGHT;
+            name = (arg[0] == ':' ? arg + 1 : arg);
+        }
+        if (name != NULL && name[0] == '\0') {
+            return MP_BAD_FILENAME;
+        }
+    }
+
+    /* Allocate structure and instanciate methods. */
+    MpDevice* dev = MpAllocateDevice(sizeof(RasterDevice));
+    *devptr = dev;
+    if (dev == NULL) {
+        return MP_NO_MEMORY;
+    }
+    dev->initialize = initializeRasterDevice;
+    dev->finalize = finalizeRasterDevice;
+    dev->stopBuffering = stopRasterBuffering;
+    dev->beginPage = beginRasterPage;
+    dev->endPage = endRasterPage;
+    dev->setColorIndex = setRasterColorIndex;
+    dev->setColor = setRasterColor;
+    dev->setLineStyle = setRasterLineStyle;
+    dev->setLineWidth = setRasterLineWidth;
+    dev->drawPoint = drawRasterPoint;
+    dev->drawPoints = drawRasterPoints;
+    dev->drawRectangle = drawRasterRectangle;
+    dev->drawPolyline = drawRasterPolyline;
+    dev->drawPolygon = drawRasterPolygon;
+    dev->drawCells = drawRasterCells;
+    dev->drawCells8 = drawRasterCells8;
+    dev->drawCells16 = drawRasterCells16;
+
+    /* Output file. */
+    RasterDevice* r = (RasterDevice*)dev;
+    if (name != NULL) {
+        size_t len = strlen(name);
+        r->fileName = (char*)malloc(len + 1);
+        if (r->fileName == NULL) {
+            free((void*)dev);
+            return MP_NO_MEMORY;
+        }
+        strcpy(r->fileName, name);
+        r->output = (len > 4 && strcmp(name + len - 4, ".png") == 0 ?
+                     RASTER_PNG_OUTPUT : RASTER_PPM_OUTPUT);
+    }
+
+    /* One sample per millimeter. */
+    dev->horizontalResolution = 1;
+    dev->verticalResolution = 1;
+    dev->horizontalSamples = width;
+    dev->verticalSamples = height;
+    dev->colormapSize1 = RASTER_COLORMAP_SIZE_1;
+    dev->colormapSize2 = RASTER_COLORMAP_SIZE_2;
+    dev->colorIndex = MP_COLOR_FOREGROUND;
+    return MP_OK;
+}
+
+MpStatus
+MpGetRasterPixels(MpDevice* dev, const uint32_t** pixels,
+                  MpInt* width, MpInt* height)
+{
+    if (dev == NULL || pixels == NULL || width == NULL || height == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (dev->initialize != initializeRasterDevice) {
+        return MP_BAD_DEVICE;
+    }
+    RasterDevice* r = (RasterDevice*)dev;
+    if (r->nthreads > 1) {
+        MpStatus status = flushRaster(r);
+        if (status != MP_OK) {
+            return status;
+        }
+    }
+    *pixels = r->pixels;
+    *width = r->width;
+    *height = r->height;
+    return MP_OK;
+}
+
+MpStatus
+MpSetRasterThreads(MpDevice* dev, MpInt nthreads)
+{
+    if (dev == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (dev->initialize != initializeRasterDevice) {
+        return MP_BAD_DEVICE;
+    }
+    if (nthreads < 0) {
+        return MP_BAD_ARGUMENT;
+    }
+    if (nthreads == 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (ncpus > 1 ? ncpus : 1);
+    }
+    if (nthreads > RASTER_MAX_THREADS) {
+        nthreads = RASTER_MAX_THREADS;
+    }
+    RasterDevice* r = (RasterDevice*)dev;
+    MpStatus status = MP_OK;
+    if (r->nthreads > 1) {
+        if (r->nthreads == nthreads) {
+            return MP_OK;
+        }
+        status = flushRaster(r);
+        stopWorkers(r);
+    }
+    if (nthreads > 1) {
+        MpStatus code = startWorkers(r, nthreads);
+        if (status == MP_OK) {
+            status = code;
+        }
+    }
+    return status;
+}
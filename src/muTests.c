@@ -1,6 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <zlib.h>
 #include "muPlot.h"
+#include "muPlotPriv.h"
 
 static MpStatus
 openDummyDevice(MpDevice** dev, const char* ident, const char* arg)
@@ -21,6 +28,2044 @@ printDriverList(int cnt, char** lst)
     }
 }
 
+/* A device which records the vertices of the drawn polylines. */
+#define TEST_SIZE 100
+typedef struct {
+    MpDevice pub;
+    MpInt   npolys; /* number of polylines */
+    MpInt   npts; /* total number of vertices */
+    MpPoint x[TEST_SIZE], y[TEST_SIZE];
+    MpInt   nrects; /* number of rectangles */
+    MpPoint rects[TEST_SIZE][5]; /* rectangle corners and color */
+    uint32_t hash; /* hash of all the vertices of the polylines */
+} TestDevice;
+
+static MpStatus
+drawTestPoint(MpDevice* dev, MpPoint x, MpPoint y)
+{
+    /* Points are recorded as vertices not belonging to any polyline. */
+    TestDevice* tst = (TestDevice*)dev;
+    if (tst->npts < TEST_SIZE) {
+        tst->x[tst->npts] = x;
+        tst->y[tst->npts] = y;
+        ++tst->npts;
+    }
+    return MP_OK;
+}
+
+static MpStatus
+drawTestRectangle(MpDevice* dev, MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    TestDevice* tst = (TestDevice*)dev;
+    if (tst->nrects < TEST_SIZE) {
+        MpPoint* r = tst->rects[tst->nrects];
+        r[0] = x0;
+        r[1] = y0;
+        r[2] = x1;
+        r[3] = y1;
+        r[4] = dev->colorIndex;
+    }
+    ++tst->nrects;
+    return MP_OK;
+}
+
+static MpStatus
+drawTestPolyline(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    TestDevice* tst = (TestDevice*)dev;
+    tst->hash = tst->hash*31 + (uint32_t)n;
+    for (MpInt i = 0; i < n; ++i) {
+        tst->hash = (tst->hash*31 + (uint16_t)x[i])*31 + (uint16_t)y[i];
+    }
+    for (MpInt i = 0; i < n && tst->npts < TEST_SIZE; ++i) {
+        tst->x[tst->npts] = x[i];
+        tst->y[tst->npts] = y[i];
+        ++tst->npts;
+    }
+    ++tst->npolys;
+    return MP_OK;
+}
+
+static MpStatus
+openTestDevice(MpDevice** devptr, const char* ident, const char* arg)
+{
+    MpDevice* dev = MpAllocateDevice(sizeof(TestDevice));
+    *devptr = dev;
+    if (dev == NULL) {
+        return MP_NO_MEMORY;
+    }
+    dev->drawPoint = drawTestPoint;
+    dev->drawRectangle = drawTestRectangle;
+    dev->drawPolyline = drawTestPolyline;
+    dev->drawPolygon = drawTestPolyline;
+    dev->pageWidth = TEST_SIZE;
+    dev->pageHeight = TEST_SIZE;
+    dev->horizontalResolution = 1;
+    dev->verticalResolution = 1;
+    dev->colormapSize1 = 10;
+    dev->colormapSize2 = 0;
+    return MP_OK;
+}
+
+/* Encode colors as 0xRRGGBB. */
+static uint32_t
+encodeTestColor(const MpColor* c)
+{
+    return (((uint32_t)lround(255*c->red) << 16) |
+            ((uint32_t)lround(255*c->green) << 8) |
+            (uint32_t)lround(255*c->blue));
+}
+
+/* Check the recorded vertices. */
+static int
+checkTestDevice(MpDevice* dev, MpInt npolys, const MpPoint* xy, MpInt npts)
+{
+    TestDevice* tst = (TestDevice*)dev;
+    int nerrs = (tst->npolys != npolys || tst->npts != npts);
+    for (MpInt i = 0; nerrs == 0 && i < npts; ++i) {
+        nerrs += (tst->x[i] != xy[2*i] || tst->y[i] != xy[2*i+1]);
+    }
+    tst->npolys = 0;
+    tst->npts = 0;
+    return nerrs;
+}
+
+static int
+testDrawPolyline(void)
+{
+    MpDevice* dev;
+    MpStatus status = MpInstallDriver("test", openTestDevice);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&dev, "test", NULL);
+    }
+    printf("MpOpenDevice -> %d: %s\n", (int)status, MpGetReason(status));
+    if (status != MP_OK) {
+        return 1;
+    }
+
+    /* Make data coordinates the same as device coordinates. */
+    double a = 1.0/(TEST_SIZE - 1);
+    MpCoordinateTransform A = {a, 0, 0, 0, a, 0};
+    MpSetCoordinateTransform(dev, &A);
+
+    /* Polyline leaving the device, coming back and having a non-finite
+       vertex (coordinates in the device are in the range [0,99]). */
+    double x[] = {-10, 50,  50, 60, 70, 80, 0.0/0.0, 90, 95};
+    double y[] = { 50, 50, 150, 50, 50, 60,      10, 10, 20};
+    MpPoint xy[] = {0,50, 50,50, 50,99, 55,99, 60,50, 70,50, 80,60,
+                    90,10, 95,20};
+    status = MpDrawPolylineDbl(dev, x, y, 9);
+    int nerrs = (status != MP_OK) + checkTestDevice(dev, 3, xy, 9);
+    printf("MpDrawPolylineDbl -> %d error(s)\n", nerrs);
+
+    /* Same polyline drawn by pieces. */
+    int nbad = (MpAppendPolylineDbl(dev, x, y, 9) != MP_NOT_PERMITTED);
+    status = MpBeginPolyline(dev);
+    nbad += (status != MP_OK || MpBeginPolyline(dev) != MP_NOT_PERMITTED);
+    for (MpInt i = 0, m = 1; status == MP_OK && i < 9; i += m, m += 2) {
+        status = MpAppendPolylineDbl(dev, x + i, y + i, (i + m <= 9 ? m : 9 - i));
+    }
+    if (status == MP_OK) {
+        status = MpEndPolyline(dev);
+    }
+    nbad += (status != MP_OK) + checkTestDevice(dev, 3, xy, 9);
+
+    /* A long polyline drawn by pieces of various sizes yields the same
+       pieces as when drawn at once. */
+    TestDevice* tst = (TestDevice*)dev;
+    const MpInt nlong = 10000;
+    float* xl = (float*)malloc(2*nlong*sizeof(float));
+    float* yl = xl + nlong;
+    for (MpInt i = 0; i < nlong; ++i) {
+        xl[i] = 50 + 60*sin(i*0.01);
+        yl[i] = (i%3001 == 3000 ? 0.0/0.0 : 50 + 60*cos(i*0.013));
+    }
+    tst->hash = 0;
+    nbad += (MpDrawPolylineFlt(dev, xl, yl, nlong) != MP_OK);
+    uint32_t hash = tst->hash;
+    MpInt npolys = tst->npolys;
+    checkTestDevice(dev, 0, NULL, 0);
+    tst->hash = 0;
+    status = MpBeginPolyline(dev);
+    for (MpInt i = 0, m = 1; status == MP_OK && i < nlong; i += m, m += 97) {
+        status = MpAppendPolylineFlt(dev, xl + i, yl + i,
+                                     (i + m <= nlong ? m : nlong - i));
+    }
+    if (status == MP_OK) {
+        status = MpEndPolyline(dev);
+    }
+    nbad += (status != MP_OK || tst->hash != hash || tst->npolys != npolys ||
+             npolys < 3);
+    checkTestDevice(dev, 0, NULL, 0);
+    free((void*)xl);
+    printf("MpBeginPolyline/MpAppendPolyline/MpEndPolyline -> %d error(s)\n",
+           nbad);
+    nerrs += nbad;
+
+    /* Points inside the device are rounded and drawn one by one by the
+       default method. */
+    double xm[] = {1.2, -1, 50, 98.6, 0.0/0.0, 100};
+    double ym[] = {2.7, 50, 99.4, 0, 10, 10};
+    MpPoint xym[] = {1,3, 50,99, 99,0};
+    status = MpDrawPointsDbl(dev, xm, ym, 6);
+    nbad = (status != MP_OK) + checkTestDevice(dev, 0, xym, 3);
+    printf("MpDrawPointsDbl -> %d error(s)\n", nbad);
+    nerrs += nbad;
+
+    /* Polygon partially outside the device. */
+    double xq[] = {-10, 50, 50, -10}, yq[] = {-10, -10, 50, 50};
+    MpPoint xyq[] = {0,0, 50,0, 50,50, 0,50};
+    status = MpDrawPolygonDbl(dev, xq, yq, 4);
+    nbad = (status != MP_OK) + checkTestDevice(dev, 1, xyq, 4);
+    printf("MpDrawPolygonDbl -> %d error(s)\n", nbad);
+    nerrs += nbad;
+
+    /* Many vertices in few columns, with decimation. */
+    double xd[] = {10, 10.2, 9.9, 10.1, 10, 20, 20.1, 20.2, 30};
+    double yd[] = {50,   40,  70,   60, 55, 10,   30,   20, 40};
+    MpPoint xyd[] = {10,50, 10,40, 10,70, 10,55, 20,10, 20,30, 20,20, 30,40};
+    MpSetPolylineDecimation(dev, true);
+    status = MpDrawPolylineDbl(dev, xd, yd, 9);
+    nbad = (status != MP_OK) + checkTestDevice(dev, 1, xyd, 8);
+    printf("MpDrawPolylineDbl (decimated) -> %d error(s)\n", nbad);
+    nerrs += nbad;
+
+    /* Repeated and aligned vertices, with simplification. */
+    MpPoint xs[] = {0, 0, 5, 10, 10, 10, 5, 0, 0};
+    MpPoint ys[] = {5, 5, 5,  5,  0, 10, 5, 0, 5};
+    MpPoint xys[] = {0,5, 10,5, 10,0, 10,10, 0,0, 0,5};
+    MpPoint xyp[] = {0,5, 10,5, 10,0, 10,10, 0,0};
+    MpSetPolylineDecimation(dev, false);
+    MpSetVertexSimplification(dev, true);
+    status = MpDrawDevicePolyline(dev, xs, ys, 9);
+    nbad = (status != MP_OK) + checkTestDevice(dev, 1, xys, 6);
+    status = MpDrawDevicePolygon(dev, xs, ys, 9);
+    nbad += (status != MP_OK) + checkTestDevice(dev, 1, xyp, 5);
+    printf("MpDrawDevicePolyline/Polygon (simplified) -> %d error(s)\n", nbad);
+    nerrs += nbad;
+
+    /* Cells with runs of the same color, the first row has no height on the
+       device. */
+    uint8_t z[] = {2, 2, 3, 3, 3, 0,
+                   4, 4, 4, 4, 5, 0,
+                   6, 4, 4, 4, 4, 0};
+    MpPoint rects[][5] = {{10,20, 18,21, 4}, {18,20, 20,21, 5},
+                          {10,21, 12,22, 6}, {12,21, 20,22, 4}};
+    MpSetColorIndex(dev, MP_COLOR_FOREGROUND);
+    tst->nrects = 0;
+    status = MpDrawCells8(dev, z, 5, 3, 6, 10, 20, 20, 22);
+    MpColorIndex ci;
+    nbad = (status != MP_OK || tst->nrects != 4 ||
+                MpGetColorIndex(dev, &ci) != MP_OK ||
+                ci != MP_COLOR_FOREGROUND);
+    for (int i = 0; nbad == 0 && i < 4; ++i) {
+        nbad += memcmp(rects[i], tst->rects[i], sizeof(rects[i])) != 0;
+    }
+
+    /* The color index of the driver is only restored by the next drawing
+       operation. */
+    nbad += (dev->colorIndex != 4);
+    status = MpDrawDevicePolyline(dev, xs, ys, 2);
+    nbad += (status != MP_OK || dev->colorIndex != MP_COLOR_FOREGROUND);
+    printf("MpDrawCells8 -> %d error(s)\n", nbad);
+    nerrs += nbad;
+
+    /* Encoded colors are kept in sync with the colormap. */
+    const uint32_t* enc;
+    nbad = (MpSetColorEncoder(dev, encodeTestColor) != MP_OK);
+    enc = dev->encodedColors;
+    nbad += (enc == NULL || enc[MP_COLOR_RED] != 0xff0000 ||
+             enc[MP_COLOR_CYAN] != 0x00ffff);
+    nbad += (MpSetColor(dev, MP_COLOR_RED, 0, 0.5, 1) != MP_OK ||
+             enc[MP_COLOR_RED] != 0x0080ff);
+    nbad += (MpDefineStandardColors(dev, false) != MP_OK ||
+             enc[MP_COLOR_BACKGROUND] != 0xffffff ||
+             enc[MP_COLOR_RED] != 0xff0000);
+    printf("MpSetColorEncoder -> %d error(s)\n", nbad);
+    nerrs += nbad;
+
+    MpCloseDevice(&dev);
+    return nerrs;
+}
+
+#define NCLIP 1000
+
+static int
+testClipping(void)
+{
+    /* Compare clipping of polylines and segments by blocks with clipping
+       of individual segments.  Half of the points are outside the box. */
+    static double x[NCLIP], y[NCLIP], xc[NCLIP], yc[NCLIP];
+    static double xp[2*NCLIP], yp[2*NCLIP];
+    MpBoxDbl box = {-1, 1, 1, -1};
+    int nerrs = 0;
+    for (MpInt i = 0; i < NCLIP; ++i) {
+        x[i] = 2.1*sin(0.37*i);
+        y[i] = 1.5*cos(0.011*i);
+    }
+    MpInt np = MpClipPolylineDbl(xp, yp, &box, x, y, NCLIP);
+    MpInt j = 0;
+    for (MpInt i = 1; i < NCLIP; ++i) {
+        if (MpClipSegmentDbl(&xc[0], &yc[0], &xc[1], &yc[1], &box,
+                             x[i-1], y[i-1], x[i], y[i]) != 0) {
+            nerrs += (j >= np || xp[2*j] != xc[0] || yp[2*j] != yc[0] ||
+                      xp[2*j+1] != xc[1] || yp[2*j+1] != yc[1]);
+            ++j;
+        }
+    }
+    nerrs += (j != np);
+    j = 0;
+    for (MpInt i = 0; i < NCLIP/2; ++i) {
+        j += MpClipSegmentDbl(&xc[2*j], &yc[2*j], &xc[2*j+1], &yc[2*j+1],
+                              &box, x[2*i], y[2*i], x[2*i+1], y[2*i+1]) != 0;
+    }
+    MpInt ns = MpClipSegmentsDbl(x, y, &box, x, y, NCLIP/2); /* in-place */
+    nerrs += (ns != j);
+    for (MpInt i = 0; nerrs == 0 && i < 2*ns; ++i) {
+        nerrs += (x[i] != xc[i] || y[i] != yc[i]);
+    }
+    printf("MpClipPolylineDbl/MpClipSegmentsDbl -> %d error(s)\n", nerrs);
+
+    /* Clip polygons inside, outside, around and across the box, the areas
+       of the clipped polygons are known. */
+    static const struct {
+        MpInt n;
+        double x[4], y[4];
+        double area;
+    } polys[] = {{3, {-0.5, 0.5, 0}, {-0.5, -0.5, 0.5}, 0.5},
+                 {3, {1.5, 3, 2}, {-0.5, -0.5, 0.5}, 0},
+                 {4, {-2, 2, 2, -2}, {-2, -2, 2, 2}, 4},
+                 {3, {-3, 5, -3}, {-3, -3, 5}, 4},
+                 {4, {1.5, 0, -1.5, 0}, {0, 1.5, 0, -1.5}, 3.5},
+                 {3, {0, 3, 3}, {0, 0, 0.5}, 0.5/6}};
+    int nbad = 0;
+    for (int k = 0; k < sizeof(polys)/sizeof(polys[0]); ++k) {
+        MpInt n = polys[k].n;
+        MpInt m = MpClipPolygonDbl(xp, yp, &box, polys[k].x, polys[k].y, n);
+        double area = 0;
+        for (MpInt i = 0; i < m; ++i) {
+            MpInt i1 = (i + 1)%m;
+            area += (xp[i]*yp[i1] - xp[i1]*yp[i])/2;
+            nbad += (xp[i] < -1 || xp[i] > 1 || yp[i] < -1 || yp[i] > 1);
+        }
+        nbad += (m > 4*n || fabs(area - polys[k].area) > 1e-12);
+    }
+    MpInt m = MpClipPolygonDbl(xp, yp, &box, polys[0].x, polys[0].y, 3);
+    nbad += (m != 3 || memcmp(xp, polys[0].x, 3*sizeof(double)) != 0 ||
+             memcmp(yp, polys[0].y, 3*sizeof(double)) != 0);
+    printf("MpClipPolygonDbl -> %d error(s)\n", nbad);
+    nerrs += nbad;
+    return nerrs;
+}
+
+static int
+testWriter(void)
+{
+    /* Write integers and text with a small buffer to exercise flushing. */
+    static const char expected[] =
+        "0 -1 32767 -32768 1234567890 -987654321 abcdefghijklmnopqrstuvwxyz"
+        "0123456789 abcdefghijklmnopqrstuvwxyz0123456789 42.50\n";
+    char buf[sizeof(expected) + 10];
+    MpWriter w;
+    int nerrs = 0;
+    FILE* file = tmpfile();
+    if (file == NULL || MpInitializeWriter(&w, file, 1) != MP_OK) {
+        return 1;
+    }
+    long vals[] = {0, -1, 32767, -32768, 1234567890L, -987654321L};
+    for (int i = 0; i < sizeof(vals)/sizeof(vals[0]); ++i) {
+        MpWriteInteger(&w, vals[i]);
+        MpWriteBytes(&w, " ", 1);
+    }
+    MpWriteString(&w, "abcdefghijklmnopqrstuvwxyz0123456789");
+    MpWriteFormatted(&w, " %s", "abcdefghijklmnopqrstuvwxyz0123456789");
+    MpWriteFormatted(&w, " %.2f\n", 42.5);
+    nerrs += (MpFinalizeWriter(&w) != MP_OK);
+    rewind(file);
+    size_t len = fread(buf, 1, sizeof(buf), file);
+    nerrs += (len != sizeof(expected) - 1 || memcmp(buf, expected, len) != 0);
+    fclose(file);
+
+    /* Fill memory writers up to the end of their buffer with reserved
+       bytes, the reserved bytes must fit in the buffer which grows after. */
+    for (size_t size = 64; size < 96 && nerrs == 0; ++size) {
+        for (size_t n = 1; n <= 22 && nerrs == 0; ++n) {
+            nerrs += (MpInitializeWriter(&w, NULL, size) != MP_OK);
+            size_t m = w.size - n;
+            for (int pass = 0; pass < 3 && nerrs == 0; ++pass) {
+                char* p = MpReserveWriter(&w, m);
+                nerrs += (p == NULL || w.count + m > w.size);
+                if (p != NULL) {
+                    memset(p, 'a' + pass, m);
+                    w.count += m;
+                }
+                m = n;
+            }
+            nerrs += (w.count != size + n || w.status != MP_OK ||
+                      w.buffer[size - n - 1] != 'a' ||
+                      w.buffer[size - 1] != 'b' || w.buffer[size] != 'c');
+            nerrs += (MpFinalizeWriter(&w) != MP_OK);
+        }
+    }
+    printf("MpWriter -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+static int
+testRaster(void)
+{
+    MpDevice* dev;
+    MpStatus status = MpInstallDriver("raster", MpOpenRasterDevice);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&dev, "raster", "20x10");
+    }
+    if (status != MP_OK) {
+        printf("MpOpenDevice(\"raster\") -> %d: %s\n",
+               (int)status, MpGetReason(status));
+        return 1;
+    }
+    const uint32_t* pix;
+    MpInt w, h;
+    status = MpGetRasterPixels(dev, &pix, &w, &h);
+    int nerrs = (status != MP_OK || w != 20 || h != 10);
+    if (nerrs == 0) {
+        uint32_t bg = pix[0];
+
+        /* Rectangle and triangle (including its outline). */
+        MpSetColorIndex(dev, MP_COLOR_RED);
+        MpDrawDevicePolygon(dev, (MpPoint[]){10, 14, 14},
+                            (MpPoint[]){2, 2, 6}, 3);
+        MpSetColorIndex(dev, MP_COLOR_BLUE);
+        MpDrawCellsHelper(dev, (MpColorIndex[]){MP_COLOR_BLUE},
+                          1, 1, 1, 1, 1, 4, 3);
+        uint32_t red = pix[2*w + 10], blue = pix[1*w + 1];
+        nerrs += (red == bg || blue == bg || red == blue);
+        for (MpInt y = 0; y < h; ++y) {
+            for (MpInt x = 0; x < w; ++x) {
+                uint32_t expected = (x >= 1 && x < 4 && y >= 1 && y < 3 ? blue :
+                                     x >= 10 && x <= 14 && y >= 2 &&
+                                     x - y >= 8 ? red : bg);
+                nerrs += (pix[y*w + x] != expected);
+            }
+        }
+
+        /* Native cells with flipped rows (the first row of cells covers
+           rows 10 and 9 of the raster). */
+        uint16_t z[] = {MP_COLOR_RED, MP_COLOR_BLUE};
+        MpDrawCells16(dev, z, 1, 2, 1, 0, 10, 2, 6);
+        nerrs += (pix[6*w] != bg || pix[7*w + 1] != blue ||
+                  pix[8*w] != blue || pix[9*w + 1] != red || pix[9*w + 2] != bg);
+    }
+    MpCloseDevice(&dev);
+    printf("Raster driver -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Draw the same random graphics on a serial and a tiled raster device and
+   compare the pixels. */
+static int
+testTiledRaster(void)
+{
+    MpDevice* devs[2] = {NULL, NULL};
+    MpStatus status = MP_OK;
+    for (int k = 0; k < 2 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&devs[k], "raster", "300x200");
+    }
+    if (status == MP_OK) {
+        status = MpSetRasterThreads(devs[1], 4);
+    }
+    if (status != MP_OK) {
+        printf("Tiled raster -> %d: %s\n", (int)status, MpGetReason(status));
+        return 1;
+    }
+    int nerrs = 0;
+    for (int k = 0; k < 2; ++k) {
+        MpDevice* dev = devs[k];
+        MpPoint x[200], y[200];
+        uint8_t z[12];
+        srand(7);
+        for (int pass = 0; pass < 20; ++pass) {
+            MpSetColorIndex(dev, 1 + rand()%15);
+            MpInt n = 1 + rand()%200;
+            for (MpInt i = 0; i < n; ++i) {
+                x[i] = rand()%340 - 20;
+                y[i] = rand()%240 - 20;
+            }
+            nerrs += (MpDrawDevicePolyline(dev, x, y, n) != MP_OK);
+            nerrs += (MpDrawDevicePoints(dev, x, y, n) != MP_OK);
+            nerrs += (MpDrawDevicePolygon(dev, x, y, 3 + rand()%5) != MP_OK);
+            for (int i = 0; i < 12; ++i) {
+                z[i] = rand()%16;
+            }
+            nerrs += (MpDrawCells8(dev, z, 4, 3, 4, x[0], y[0],
+                                   x[1], y[1]) != MP_OK);
+            nerrs += (dev->drawRectangle(dev, x[2], y[2],
+                                         x[3], y[3]) != MP_OK);
+            if (pass%5 == 4) {
+                MpSetColor(dev, z[0], 0.1*(pass%10), 0.5, 0.2);
+            }
+        }
+        /* Invalid cells are drawn up to the first bad index. */
+        uint16_t zbad[4] = {2, 3, 1000, 4};
+        nerrs += (MpDrawCells16(dev, zbad, 2, 2, 2, 10, 10, 290, 190)
+                  != MP_OUT_OF_RANGE);
+    }
+    const uint32_t* pix[2];
+    MpInt w[2], h[2];
+    for (int k = 0; k < 2; ++k) {
+        nerrs += (MpGetRasterPixels(devs[k], &pix[k], &w[k], &h[k]) != MP_OK);
+    }
+    if (nerrs == 0) {
+        nerrs += (memcmp(pix[0], pix[1], w[0]*h[0]*sizeof(uint32_t)) != 0);
+    }
+    MpCloseDevice(&devs[0]);
+    MpCloseDevice(&devs[1]);
+    printf("Tiled raster -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Record graphics in a display list and replay them on a raster device (with
+   flipped rows) and compare with the same graphics drawn directly. */
+static int
+testDisplayList(void)
+{
+    MpDevice* lst = NULL;
+    MpDevice* devs[3] = {NULL, NULL, NULL};
+    MpStatus status = MpInstallDriver("list", MpOpenDisplayListDevice);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&lst, "list", "120x80");
+    }
+    for (int k = 0; k < 3 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&devs[k], "raster", "120x80");
+    }
+    if (status != MP_OK) {
+        printf("Display list -> %d: %s\n", (int)status, MpGetReason(status));
+        return 1;
+    }
+    int nerrs = 0;
+    const MpInt h = 80;
+    MpPoint x[30], y[30], yf[30];
+    uint8_t z[6] = {1, 2, 3, 4, 5, 6};
+    srand(11);
+    for (int pass = 0; pass < 10; ++pass) {
+        MpInt n = 2 + rand()%29;
+        for (MpInt i = 0; i < n; ++i) {
+            x[i] = rand()%140 - 10;
+            y[i] = rand()%100 - 10;
+            yf[i] = h - 1 - y[i];
+        }
+        for (int k = 0; k < 2; ++k) {
+            MpDevice* dev = (k == 0 ? lst : devs[0]);
+            const MpPoint* yk = (k == 0 ? y : yf);
+            nerrs += (MpSetColorIndex(dev, 2 + pass%10) != MP_OK);
+            nerrs += (MpDrawDevicePolyline(dev, x, yk, n) != MP_OK);
+            nerrs += (MpDrawDevicePolygon(dev, x + 1, yk + 1, 3) != MP_OK);
+            nerrs += (dev->drawPoint(dev, x[0], yk[0]) != MP_OK);
+            nerrs += (MpDrawCells8(dev, z, 3, 2, 3, x[2], yk[2],
+                                   x[3], yk[3]) != MP_OK);
+        }
+    }
+    MpInt ncmds;
+    nerrs += (MpGetDisplayListSize(lst, &ncmds) != MP_OK || ncmds != 50);
+    nerrs += (MpReplay(lst, devs[1]) != MP_OK);
+    nerrs += (MpReplay(lst, lst) != MP_BAD_DEVICE);
+    const uint32_t* pix[2];
+    MpInt w[2], hh[2];
+    for (int k = 0; k < 2; ++k) {
+        nerrs += (MpGetRasterPixels(devs[k], &pix[k], &w[k], &hh[k]) != MP_OK);
+    }
+    if (nerrs == 0) {
+        nerrs += (memcmp(pix[0], pix[1], w[0]*h*sizeof(uint32_t)) != 0);
+    }
+
+    /* Replaying a region where nothing was drawn only changes settings. */
+    MpClearDisplayList(lst);
+    MpDrawDevicePolyline(lst, (MpPoint[]){0, 10}, (MpPoint[]){0, 10}, 2);
+    MpSetColorIndex(lst, MP_COLOR_RED);
+    MpDrawDevicePolyline(lst, (MpPoint[]){50, 60}, (MpPoint[]){50, 70}, 2);
+    nerrs += (MpReplayRegion(lst, devs[2], 20, 20, 40, 79) != MP_OK);
+    MpColorIndex ci;
+    MpGetColorIndex(devs[2], &ci);
+    nerrs += (ci != MP_COLOR_RED);
+    nerrs += (MpGetRasterPixels(devs[2], &pix[0], &w[0], &hh[0]) != MP_OK);
+    for (MpInt i = 0; nerrs == 0 && i < w[0]*h; ++i) {
+        nerrs += (pix[0][i] != pix[0][0]);
+    }
+    nerrs += (MpReplayRegion(lst, devs[2], 20, 20, 55, 79) != MP_OK);
+    nerrs += (MpGetRasterPixels(devs[2], &pix[0], &w[0], &hh[0]) != MP_OK);
+    nerrs += (pix[0][(h - 1 - 60)*w[0] + 55] == pix[0][0]);
+    nerrs += (pix[0][(h - 1 - 5)*w[0] + 5] != pix[0][0]);
+
+    MpCloseDevice(&lst);
+    for (int k = 0; k < 3; ++k) {
+        MpCloseDevice(&devs[k]);
+    }
+    printf("Display list -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Draw the same graphics on a raster device and on an asynchronous device
+   wrapping another raster device (with a small ring buffer to exercise
+   wrapping and back-pressure) and compare the pixels. */
+static int
+testAsyncDevice(void)
+{
+    MpDevice* raster[2] = {NULL, NULL};
+    MpDevice* async = NULL;
+    MpStatus status = MP_OK;
+    for (int k = 0; k < 2 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&raster[k], "raster", "100x80");
+    }
+    if (status == MP_OK) {
+        status = MpOpenAsyncDevice(&async, raster[1], 1);
+    }
+    if (status != MP_OK) {
+        printf("Asynchronous device -> %d: %s\n",
+               (int)status, MpGetReason(status));
+        return 1;
+    }
+    int nerrs = 0;
+    MpPoint x[1000], y[1000];
+    uint16_t z[6] = {3, 4, 5, 6, 7, 8};
+    srand(5);
+    for (int pass = 0; pass < 200; ++pass) {
+        MpInt n = 2 + rand()%(pass == 100 ? 999 : 40);
+        for (MpInt i = 0; i < n; ++i) {
+            x[i] = rand()%120 - 10;
+            y[i] = rand()%100 - 10;
+        }
+        for (int k = 0; k < 2; ++k) {
+            MpDevice* dev = (k == 0 ? raster[0] : async);
+            nerrs += (MpSetColorIndex(dev, 1 + pass%15) != MP_OK);
+            nerrs += (MpDrawDevicePolyline(dev, x, y, n) != MP_OK);
+            nerrs += (MpDrawDevicePoints(dev, x, y, n) != MP_OK);
+            nerrs += (MpDrawDevicePolygon(dev, x, y, 3) != MP_OK);
+            nerrs += (MpDrawCells16(dev, z, 2, 3, 2, x[0], y[0],
+                                    x[1], y[1]) != MP_OK);
+        }
+    }
+    nerrs += (MpFlush(async) != MP_OK || MpFlush(raster[0]) != MP_OK);
+    const uint32_t* pix[2];
+    MpInt w[2], h[2];
+    for (int k = 0; k < 2; ++k) {
+        nerrs += (MpGetRasterPixels(raster[k], &pix[k], &w[k], &h[k]) != MP_OK);
+    }
+    if (nerrs == 0) {
+        nerrs += (memcmp(pix[0], pix[1], w[0]*h[0]*sizeof(uint32_t)) != 0);
+    }
+    MpCloseDevice(&raster[0]);
+    nerrs += (MpCloseDevice(&async) != MP_OK);
+    printf("Asynchronous device -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+#define NPTS 37
+
+static int
+testAffineTransforms(void)
+{
+    MpAffineTransformDbl As[2] = {
+        {2.0, 0.0, -1.0, 0.0, -3.0,  5.0}, /* no shear nor rotation */
+        {1.5, 0.3,  7.0, -.2,  0.7, -4.0}, /* general */
+    };
+    double x[NPTS], y[NPTS], xy[2*NPTS], xd[NPTS], yd[NPTS];
+    float xf[NPTS], yf[NPTS], xo[NPTS], yo[NPTS];
+    int nerrs = 0;
+    for (int i = 0; i < NPTS; ++i) {
+        x[i] = i - 11.25;
+        y[i] = 0.5*i*i - 3;
+        xy[2*i] = x[i];
+        xy[2*i+1] = y[i];
+    }
+    for (int k = 0; k < 2; ++k) {
+        const MpAffineTransformDbl* A = &As[k];
+        MpAffineTransformFlt B = {A->xx, A->xy, A->x, A->yx, A->yy, A->y};
+        MpApplyAffineTransformDbl(A, xd, yd, x, y, NPTS);
+        MpApplyAffineTransformDblToFlt(A, xf, yf, x, y, NPTS);
+        MpApplyAffineTransformStridedDbl(A, xy, xy+1, 2, xy, xy+1, 2, NPTS);
+        for (int i = 0; i < NPTS; ++i) {
+            double xp = MP_XFORM_APPLY_X(MP_GET_FIELD_PTR, A, x[i], y[i]);
+            double yp = MP_XFORM_APPLY_Y(MP_GET_FIELD_PTR, A, x[i], y[i]);
+            if (xd[i] != xp || yd[i] != yp ||
+                xf[i] != (float)xp || yf[i] != (float)yp ||
+                xy[2*i] != xp || xy[2*i+1] != yp) {
+                ++nerrs;
+            }
+            xf[i] = xo[i] = x[i];
+            yf[i] = yo[i] = y[i];
+        }
+        MpApplyAffineTransformFlt(&B, xo, yo, xf, yf, NPTS);
+        MpApplyAffineTransformInPlaceFlt(&B, xf, yf, NPTS);
+        for (int i = 0; i < NPTS; ++i) {
+            if (xf[i] != xo[i] || yf[i] != yo[i]) {
+                ++nerrs;
+            }
+            xy[2*i] = x[i];
+            xy[2*i+1] = y[i];
+        }
+    }
+    printf("MpApplyAffineTransform* -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Draw the graphics of a page of the metafile test, with flipped ordinates
+   if `h > 0`. */
+static int
+drawMetafilePage(MpDevice* dev, int page, MpInt h)
+{
+    MpPoint x[40], y[40];
+    uint8_t z8[6] = {1, 2, 3, 4, 5, 6};
+    uint16_t z16[4] = {20, 40, 60, 80};
+    MpColorIndex z[2] = {3, 250};
+    MpPoint dy = (h > 0 ? -4 : 4);
+    int nerrs = (MpBeginPage(dev) != MP_OK);
+    if (page == 1) {
+        nerrs += (MpSetColor(dev, 3, 0.2, 0.4, 0.6) != MP_OK);
+    }
+
+    /* Something is drawn with the settings left by the previous page, away
+       from the other graphics. */
+    x[0] = 2;
+    x[1] = 15;
+    y[0] = (h > 0 ? h - 1 - 5 : 5);
+    y[1] = (h > 0 ? h - 1 - 70 : 70);
+    nerrs += (MpDrawDevicePolyline(dev, x, y, 2) != MP_OK);
+    srand(100 + page);
+    for (int pass = 0; pass < 5; ++pass) {
+        MpInt n = 2 + rand()%39;
+        for (MpInt i = 0; i < n; ++i) {
+            x[i] = 30 + rand()%110;
+            y[i] = rand()%100 - 10;
+            if (h > 0) {
+                y[i] = h - 1 - y[i];
+            }
+        }
+        nerrs += (MpSetColorIndex(dev, 2 + (pass + 3*page)%10) != MP_OK);
+        nerrs += (MpSetLineWidth(dev, 1 + pass) != MP_OK);
+        nerrs += (MpDrawDevicePolyline(dev, x, y, n) != MP_OK);
+        nerrs += (MpDrawDevicePolygon(dev, x + 1, y + 1, 3) != MP_OK);
+        nerrs += (MpDrawDevicePoints(dev, x, y, n) != MP_OK);
+        nerrs += (MpDrawCells8(dev, z8, 3, 2, 3, x[0], y[0],
+                               x[0] + 6, y[0] + dy) != MP_OK);
+        nerrs += (MpDrawCells16(dev, z16, 2, 2, 2, x[1], y[1],
+                                x[1] - 4, y[1] - dy) != MP_OK);
+        nerrs += (MpDrawCells(dev, z, 1, 2, 1, x[1], y[0],
+                              x[1] + 3, y[0] - dy) != MP_OK);
+    }
+    nerrs += (MpEndPage(dev) != MP_OK);
+    return nerrs;
+}
+
+/* Read a whole file in a malloc'ed buffer and store its size in `*size`. */
+static char*
+readWholeFile(const char* name, size_t* size)
+{
+    *size = 0;
+    FILE* file = fopen(name, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    size_t len = 0, siz = 1024;
+    char* buf = (char*)malloc(siz);
+    while (buf != NULL) {
+        len += fread(buf + len, 1, siz - len, file);
+        if (len < siz) {
+            break;
+        }
+        siz *= 2;
+        char* tmp = (char*)realloc(buf, siz);
+        if (tmp == NULL) {
+            free((void*)buf);
+        }
+        buf = tmp;
+    }
+    fclose(file);
+    *size = len;
+    return buf;
+}
+
+static MpBool
+sameFiles(const char* a, const char* b)
+{
+    size_t na, nb;
+    char* bufa = readWholeFile(a, &na);
+    char* bufb = readWholeFile(b, &nb);
+    MpBool result = (bufa != NULL && bufb != NULL && na == nb &&
+                     memcmp(bufa, bufb, na) == 0);
+    free((void*)bufa);
+    free((void*)bufb);
+    return result;
+}
+
+/* Create `n` temporary files and store their names in `names`.  On error,
+   the files already created are removed and false is returned. */
+static MpBool
+makeTemporaryNames(char (*names)[24], int n)
+{
+    for (int k = 0; k < n; ++k) {
+        strcpy(names[k], "/tmp/muTestsXXXXXX");
+        int fd = mkstemp(names[k]);
+        if (fd == -1) {
+            printf("makeTemporaryNames -> cannot create temporary file\n");
+            while (--k >= 0) {
+                remove(names[k]);
+            }
+            return false;
+        }
+        close(fd);
+    }
+    return true;
+}
+
+/* Write pages in a metafile and replay them on raster devices to compare with
+   the same pages drawn directly. */
+static int
+testMetafile(void)
+{
+    char name[24];
+    if (! makeTemporaryNames(&name, 1)) {
+        return 1;
+    }
+    char arg[64];
+    sprintf(arg, "120x80:%s", name);
+    const MpInt h = 80;
+    MpDevice* meta = NULL;
+    MpDevice* devs[3] = {NULL, NULL, NULL};
+    MpStatus status = MpInstallDriver("metafile", MpOpenMetafileDevice);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&meta, "metafile", arg);
+    }
+    for (int k = 0; k < 3 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&devs[k], "raster", "120x80");
+    }
+    if (status != MP_OK) {
+        printf("Metafile -> %d: %s\n", (int)status, MpGetReason(status));
+        remove(name);
+        return 1;
+    }
+    int nerrs = 0;
+    for (int page = 1; page <= 3; ++page) {
+        nerrs += drawMetafilePage(meta, page, 0);
+        nerrs += drawMetafilePage(devs[0], page, h);
+    }
+    nerrs += (MpCloseDevice(&meta) != MP_OK);
+
+    /* The last page only depends on the color set in the first one and on
+       the settings at its beginning. */
+    MpMetafile* mf;
+    MpInt npages;
+    status = MpOpenMetafile(&mf, name);
+    nerrs += (status != MP_OK);
+    if (status == MP_OK) {
+        nerrs += (MpGetMetafilePages(mf, &npages) != MP_OK || npages != 3);
+        nerrs += (MpReplayMetafilePage(mf, 3, devs[1]) != MP_OK);
+        nerrs += (MpReplayMetafilePage(mf, 4, devs[1]) != MP_OUT_OF_RANGE);
+        nerrs += (MpReplayMetafile(mf, devs[2]) != MP_OK);
+        const uint32_t* pix[3];
+        MpInt w[3], hh[3];
+        for (int k = 0; k < 3; ++k) {
+            nerrs += (MpGetRasterPixels(devs[k], &pix[k],
+                                        &w[k], &hh[k]) != MP_OK);
+        }
+        if (nerrs == 0) {
+            nerrs += (memcmp(pix[0], pix[1], w[0]*h*sizeof(uint32_t)) != 0);
+            nerrs += (memcmp(pix[0], pix[2], w[0]*h*sizeof(uint32_t)) != 0);
+        }
+        nerrs += (MpCloseMetafile(&mf) != MP_OK || mf != NULL);
+    }
+    nerrs += (MpOpenMetafile(&mf, "/nonexistent/file") == MP_OK);
+    for (int k = 0; k < 3; ++k) {
+        MpCloseDevice(&devs[k]);
+    }
+    remove(name);
+    printf("Metafile -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Map values to colormap indices and compare the different kernels and the
+   drawing of images with the drawing of cells. */
+static int
+testImageMapping(void)
+{
+    MpValueMapping map = {MP_LINEAR_SCALING, 0, 10, 1, 10, 19, 0};
+    float vf[2][25];
+    uint8_t cf[2][30];
+    int nerrs = 0;
+    for (int i = 0; i < 25; ++i) {
+        vf[0][i] = 0.5f*(i - 2);
+        vf[1][i] = (i == 24 ? NAN : 0.5f*(i - 2));
+    }
+    nerrs += (MpMapValuesFlt8(cf[0], 30, vf[0], 25, 25, 2, &map) != MP_OK);
+    for (int i = 0; i < 25; ++i) {
+        int k = (i < 2 ? 0 : i > 20 ? 9 : (i - 2)/2);
+        nerrs += (cf[0][i] != 10 + k);
+        nerrs += (cf[1][i] != (i == 24 ? 0 : 10 + k));
+    }
+
+    /* Reversed colors. */
+    double vd[3] = {0, 5, 10};
+    uint16_t cd[3];
+    map.vmin = 10;
+    map.vmax = 0;
+    nerrs += (MpMapValuesDbl16(cd, 3, vd, 3, 3, 1, &map) != MP_OK);
+    nerrs += (cd[0] != 19 || cd[1] != 15 || cd[2] != 10);
+    nerrs += (MpMapValuesDbl8(NULL, 3, vd, 3, 3, 1, &map) != MP_BAD_ADDRESS);
+    nerrs += (MpMapValuesDbl8(cf[0], 2, vd, 3, 3, 1, &map) != MP_BAD_SIZE);
+    map.cmax = 300;
+    nerrs += (MpMapValuesDbl8(cf[0], 3, vd, 3, 3, 1, &map) != MP_OUT_OF_RANGE);
+    map.scaling = MP_LOG_SCALING;
+    map.vmax = -1;
+    nerrs += (MpMapValuesDbl16(cd, 3, vd, 3, 3, 1, &map) != MP_BAD_ARGUMENT);
+
+    /* Integers mapped by lookup tables (and by several threads for the large
+       image) or directly must match floating-point values. */
+    const MpInt sizes[2][2] = {{1000, 600}, {7, 5}};
+    for (int k = 0; k < 2; ++k) {
+        const MpInt n1 = sizes[k][0], n2 = sizes[k][1], n = n1*n2;
+        uint16_t* zi = malloc(n*sizeof(uint16_t));
+        int32_t* zl = malloc(n*sizeof(int32_t));
+        double* zd = malloc(n*sizeof(double));
+        uint16_t* c = malloc(3*n*sizeof(uint16_t));
+        if (zi == NULL || zl == NULL || zd == NULL || c == NULL) {
+            return nerrs + 1;
+        }
+        for (MpInt i = 0; i < n; ++i) {
+            zi[i] = (uint16_t)((i*7919)%65536);
+            zl[i] = (int32_t)zi[i] - 3000;
+            zd[i] = zi[i];
+        }
+        map = (MpValueMapping){MP_LOG_SCALING, 3, 60000, 1, 16, 1015, 1};
+        nerrs += (MpMapValuesU1616(c, n1, zi, n1, n1, n2, &map) != MP_OK);
+        nerrs += (MpMapValuesDbl16(c + n, n1, zd, n1, n1, n2, &map) != MP_OK);
+        nerrs += (memcmp(c, c + n, n*sizeof(uint16_t)) != 0);
+        map.scaling = MP_ASINH_SCALING;
+        map.softening = 100;
+        for (MpInt i = 0; i < n; ++i) {
+            zd[i] = zl[i];
+        }
+        nerrs += (MpMapValuesI3216(c, n1, zl, n1, n1, n2, &map) != MP_OK);
+        nerrs += (MpMapValuesDbl16(c + n, n1, zd, n1, n1, n2, &map) != MP_OK);
+        nerrs += (memcmp(c, c + n, n*sizeof(uint16_t)) != 0);
+        free(zi);
+        free(zl);
+        free(zd);
+        free(c);
+    }
+
+    /* Images are drawn as cells. */
+    MpDevice* devs[2] = {NULL, NULL};
+    MpStatus status = MP_OK;
+    for (int k = 0; k < 2 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&devs[k], "raster", "300x200");
+    }
+    if (status == MP_OK) {
+        status = MpInitializeValueMapping(&map, devs[0], MP_LINEAR_SCALING,
+                                          -1, 13);
+    }
+    nerrs += (status != MP_OK);
+    if (status == MP_OK) {
+        double z[4*3] = {-2, 0, 1, 2, 3, NAN, 5, 6, 7, 8, 9, 20};
+        uint16_t cz[4*3];
+        nerrs += (MpMapValuesDbl16(cz, 4, z, 4, 4, 3, &map) != MP_OK);
+        nerrs += (MpDrawImageDbl(devs[0], z, 4, 3, 4, &map,
+                                 10, 20, 290, 170) != MP_OK);
+        nerrs += (MpDrawCells16(devs[1], cz, 4, 3, 4,
+                                10, 20, 290, 170) != MP_OK);
+        map.cbad = devs[0]->colormapSize;
+        nerrs += (MpDrawImageDbl(devs[0], z, 4, 3, 4, &map,
+                                 10, 20, 290, 170) != MP_OUT_OF_RANGE);
+        const uint32_t* pix[2];
+        MpInt w[2], h[2];
+        for (int k = 0; k < 2; ++k) {
+            nerrs += (MpGetRasterPixels(devs[k], &pix[k],
+                                        &w[k], &h[k]) != MP_OK);
+        }
+        if (nerrs == 0) {
+            nerrs += (memcmp(pix[0], pix[1],
+                             w[0]*h[0]*sizeof(uint32_t)) != 0);
+        }
+    }
+    MpCloseDevice(&devs[0]);
+    MpCloseDevice(&devs[1]);
+    printf("MpMapValues*/MpDrawImage* -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Render a figure on a private raster device and return the hash of its
+   pixels. */
+static uint32_t
+renderFigure(void)
+{
+    MpDevice* dev;
+    if (MpOpenDevice(&dev, "raster", "120x80") != MP_OK) {
+        return 0;
+    }
+    uint32_t seed = 12345;
+    MpPoint x[50], y[50];
+    for (int pass = 0; pass < 10; ++pass) {
+        MpSetColorIndex(dev, 2 + pass%8);
+        for (int i = 0; i < 50; ++i) {
+            seed = seed*1103515245u + 12345u;
+            x[i] = (seed >> 8)%140 - 10;
+            seed = seed*1103515245u + 12345u;
+            y[i] = (seed >> 8)%100 - 10;
+        }
+        MpDrawDevicePolyline(dev, x, y, 50);
+        MpDrawDevicePolygon(dev, x, y, 5);
+    }
+    const uint32_t* pix;
+    MpInt w, h;
+    uint32_t hash = 0;
+    if (MpGetRasterPixels(dev, &pix, &w, &h) == MP_OK) {
+        hash = 2166136261u;
+        for (MpInt i = 0; i < w*h; ++i) {
+            hash = (hash ^ pix[i])*16777619u;
+        }
+    }
+    MpCloseDevice(&dev);
+    return hash;
+}
+
+typedef struct {
+    pthread_t thread;
+    uint32_t expected;
+    int nerrs;
+} FarmWorker;
+
+static void*
+runFarmWorker(void* arg)
+{
+    FarmWorker* worker = arg;
+    for (int iter = 0; iter < 40; ++iter) {
+        worker->nerrs += (renderFigure() != worker->expected);
+    }
+    return NULL;
+}
+
+/* Render figures on several threads while drivers are installed and
+   uninstalled. */
+static int
+testPlotFarm(void)
+{
+    FarmWorker workers[4];
+    uint32_t expected = renderFigure();
+    int nerrs = (expected == 0);
+    int started = 0;
+    for (int k = 0; k < 4; ++k) {
+        workers[k].expected = expected;
+        workers[k].nerrs = 0;
+        if (pthread_create(&workers[k].thread, NULL,
+                           runFarmWorker, &workers[k]) != 0) {
+            break;
+        }
+        ++started;
+    }
+    nerrs += (started != 4);
+    char ident[16];
+    for (int iter = 0; iter < 200; ++iter) {
+        sprintf(ident, "farm%d", iter%7);
+        nerrs += (MpInstallDriver(ident, openDummyDevice) != MP_OK);
+        nerrs += (MpInstallDriver("raster", MpOpenRasterDevice) != MP_OK);
+        if (iter%3 == 0) {
+            nerrs += (MpUninstallDriver(ident) != MP_OK);
+        }
+    }
+    for (int k = 0; k < started; ++k) {
+        pthread_join(workers[k].thread, NULL);
+        nerrs += workers[k].nerrs;
+    }
+    for (int k = 0; k < 7; ++k) {
+        sprintf(ident, "farm%d", k);
+        MpUninstallDriver(ident);
+    }
+    MpDevice* dev;
+    nerrs += (MpOpenDevice(&dev, "farm0", NULL) != MP_NOT_FOUND);
+    printf("Plot farm -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Read a big-endian 32-bit unsigned integer. */
+static uint32_t
+readUInt32(const unsigned char* p)
+{
+    return (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+            ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+}
+
+/* Save a small raster in a PNG file, check the structure of the file and
+   compare its inflated pixels with those of the raster. */
+static int
+testRasterPNG(void)
+{
+    char name[24], arg[40];
+    if (! makeTemporaryNames(&name, 1)) {
+        return 1;
+    }
+    sprintf(arg, "17x11:%s.png", name);
+    MpDevice* dev = NULL;
+    if (MpOpenDevice(&dev, "raster", arg) != MP_OK) {
+        printf("PNG output -> cannot open device\n");
+        return 1;
+    }
+    int nerrs = 0;
+    nerrs += (MpBeginPage(dev) != MP_OK);
+    MpSetColorIndex(dev, MP_COLOR_RED);
+    MpDrawDevicePolygon(dev, (MpPoint[]){2, 14, 8}, (MpPoint[]){1, 3, 10}, 3);
+    MpSetColorIndex(dev, MP_COLOR_CYAN);
+    MpDrawDevicePolyline(dev, (MpPoint[]){0, 16}, (MpPoint[]){10, 0}, 2);
+    nerrs += (MpEndPage(dev) != MP_OK);
+    const uint32_t* pix;
+    MpInt w, h;
+    nerrs += (MpGetRasterPixels(dev, &pix, &w, &h) != MP_OK ||
+              w != 17 || h != 11);
+
+    /* Check the signature, then the chunks and their CRC, collecting the
+       compressed data. */
+    size_t n;
+    unsigned char* buf = (unsigned char*)readWholeFile(arg + 6, &n);
+    unsigned char* data = (unsigned char*)malloc(n + 1);
+    size_t ndata = 0;
+    int nchunks = 0, iend = 0;
+    nerrs += (buf == NULL || data == NULL || n < 8 ||
+              memcmp(buf, "\x89PNG\r\n\x1a\n", 8) != 0);
+    for (size_t i = 8; nerrs == 0 && iend == 0 && i + 12 <= n; ++nchunks) {
+        size_t len = readUInt32(buf + i);
+        const unsigned char* type = buf + i + 4;
+        if (i + 12 + len > n) {
+            ++nerrs;
+            break;
+        }
+        nerrs += (readUInt32(type + 4 + len) !=
+                  (uint32_t)crc32(0L, type, 4 + len));
+        if (nchunks == 0) {
+            static const unsigned char ihdr[] = {
+                0, 0, 0, 17, 0, 0, 0, 11, 8, 2, 0, 0, 0};
+            nerrs += (len != 13 || memcmp(type, "IHDR", 4) != 0 ||
+                      memcmp(type + 4, ihdr, 13) != 0);
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            memcpy(data + ndata, type + 4, len);
+            ndata += len;
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            nerrs += (len != 0 || i + 12 != n);
+            iend = 1;
+        }
+        i += 12 + len;
+    }
+    nerrs += (iend == 0 || nchunks < 3);
+
+    /* Each row is filter type 0 followed by RGB bytes. */
+    unsigned char rows[11*(1 + 3*17)];
+    uLongf size = sizeof(rows);
+    if (nerrs == 0 &&
+        uncompress(rows, &size, data, ndata) == Z_OK && size == sizeof(rows)) {
+        for (MpInt y = 0; y < h; ++y) {
+            const unsigned char* row = rows + y*(1 + 3*w);
+            nerrs += (row[0] != 0);
+            for (MpInt x = 0; x < w; ++x) {
+                uint32_t p = pix[y*w + x];
+                nerrs += (row[1 + 3*x] != (p & 0xff) ||
+                          row[2 + 3*x] != ((p >> 8) & 0xff) ||
+                          row[3 + 3*x] != ((p >> 16) & 0xff));
+            }
+        }
+    } else {
+        ++nerrs;
+    }
+    free((void*)buf);
+    free((void*)data);
+    nerrs += (MpCloseDevice(&dev) != MP_OK);
+    remove(arg + 6);
+    remove(name);
+    printf("PNG output -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+static void
+drawReopenFigure(MpDevice* dev)
+{
+    MpDrawDevicePolyline(dev, (MpPoint[]){100, 2000, 3000, 500},
+                         (MpPoint[]){100, 1500, 200, 4000}, 4);
+    MpDrawDevicePolygon(dev, (MpPoint[]){400, 900, 900},
+                        (MpPoint[]){400, 400, 700}, 3);
+}
+
+/* Reuse an XFig device for several figures and compare them with the
+   figures of new devices. */
+static int
+testReopenDevice(void)
+{
+    char names[4][24];
+    if (! makeTemporaryNames(names, 4)) {
+        return 1;
+    }
+    int nerrs = 0;
+    MpDevice* dev = NULL;
+    MpStatus status = MpInstallDriver("xfig", MpOpenXFigDevice);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&dev, "xfig", names[0]);
+    }
+    if (status != MP_OK) {
+        printf("MpOpenDevice(\"xfig\") -> %d: %s\n",
+               (int)status, MpGetReason(status));
+        return 1;
+    }
+
+    /* Settings are kept. */
+    nerrs += (MpSetColor(dev, 50, 1, 0.5, 0) != MP_OK);
+    nerrs += (MpSetColorIndex(dev, 50) != MP_OK);
+    drawReopenFigure(dev);
+    nerrs += (MpReopenDevice(dev, names[1], false) != MP_OK);
+    drawReopenFigure(dev);
+
+    /* Settings are reset. */
+    nerrs += (MpReopenDevice(dev, names[2], true) != MP_OK);
+    MpColorIndex ci = -1;
+    MpGetColorIndex(dev, &ci);
+    nerrs += (ci != MP_COLOR_FOREGROUND);
+    drawReopenFigure(dev);
+    nerrs += (MpCloseDevice(&dev) != MP_OK);
+    if (MpOpenDevice(&dev, "xfig", names[3]) == MP_OK) {
+        drawReopenFigure(dev);
+    } else {
+        ++nerrs;
+    }
+    nerrs += (MpCloseDevice(&dev) != MP_OK);
+    nerrs += ! sameFiles(names[0], names[1]);
+    nerrs += ! sameFiles(names[2], names[3]);
+    nerrs += sameFiles(names[1], names[2]);
+    for (int k = 0; k < 4; ++k) {
+        remove(names[k]);
+    }
+
+    /* Drivers may not support reopening. */
+    if (MpOpenDevice(&dev, "raster", "10x10") == MP_OK) {
+        nerrs += (MpReopenDevice(dev, "10x10", false) != MP_NOT_IMPLEMENTED);
+    } else {
+        ++nerrs;
+    }
+    MpCloseDevice(&dev);
+    printf("MpReopenDevice -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Draw the same figure with a modified color on an XFig device and on an
+   asynchronous device wrapping another XFig device and compare the files. */
+static int
+testAsyncColors(void)
+{
+    char names[2][24];
+    if (! makeTemporaryNames(names, 2)) {
+        return 1;
+    }
+    int nerrs = 0;
+    for (int k = 0; k < 2; ++k) {
+        MpDevice* dev = NULL;
+        MpStatus status = MpOpenDevice(&dev, "xfig", names[k]);
+        if (status == MP_OK && k == 1) {
+            MpDevice* async = NULL;
+            status = MpOpenAsyncDevice(&async, dev, 2);
+            if (status == MP_OK) {
+                dev = async;
+            } else {
+                MpCloseDevice(&dev);
+            }
+        }
+        if (status != MP_OK) {
+            ++nerrs;
+            continue;
+        }
+        nerrs += (MpSetColor(dev, 50, 1, 0.5, 0) != MP_OK);
+        nerrs += (MpSetColorIndex(dev, 50) != MP_OK);
+        drawReopenFigure(dev);
+        nerrs += (MpCloseDevice(&dev) != MP_OK);
+    }
+    nerrs += ! sameFiles(names[0], names[1]);
+    for (int k = 0; k < 2; ++k) {
+        remove(names[k]);
+    }
+    printf("Asynchronous colors -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Check that only the user defined colors which are used are written in the
+   header of an XFig figure with their last definition and that colors can
+   no longer be changed once the page has been written. */
+static int
+testXFigColors(void)
+{
+    char name[24];
+    if (! makeTemporaryNames(&name, 1)) {
+        return 1;
+    }
+    MpDevice* dev = NULL;
+    if (MpOpenDevice(&dev, "xfig", name) != MP_OK) {
+        printf("XFig colors -> cannot open device\n");
+        return 1;
+    }
+    int nerrs = 0;
+    nerrs += (MpSetColor(dev, 50, 1, 0.5, 0) != MP_OK);
+    nerrs += (MpSetColor(dev, 60, 0, 0, 1) != MP_OK);
+    nerrs += (MpSetColor(dev, 70, 0.2, 0.2, 0.2) != MP_OK);
+    nerrs += (MpBeginPage(dev) != MP_OK);
+    nerrs += (MpSetColorIndex(dev, 50) != MP_OK);
+    drawReopenFigure(dev);
+    nerrs += (MpSetColorIndex(dev, 60) != MP_OK);
+    drawReopenFigure(dev);
+    nerrs += (MpSetColor(dev, 60, 0, 1, 0) != MP_OK);
+    nerrs += (MpEndPage(dev) != MP_OK);
+    nerrs += (MpSetColor(dev, 60, 1, 0, 1) != MP_READ_ONLY);
+    nerrs += (MpCloseDevice(&dev) != MP_OK);
+
+    /* Color objects are the lines starting with object type 0. */
+    size_t n;
+    char* buf = readWholeFile(name, &n);
+    int ncolors = 0;
+    for (char* p = buf; p != NULL && p < buf + n; ) {
+        char* q = memchr(p, '\n', buf + n - p);
+        q = (q == NULL ? buf + n : q + 1);
+        if (p[0] == '0' && p[1] == ' ') {
+            ++ncolors;
+            nerrs += (strncmp(p, "0 48 #ff8000\n", q - p) != 0 &&
+                      strncmp(p, "0 58 #00ff00\n", q - p) != 0);
+        }
+        p = q;
+    }
+    nerrs += (buf == NULL || ncolors != 2);
+    free((void*)buf);
+    remove(name);
+    printf("XFig colors -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Check the bounds of chunks of a random walk and compare clipping and
+   drawing with and without the bounds. */
+static int
+testChunkBounds(void)
+{
+    const MpInt n = 20000;
+    float* x = (float*)malloc(6*n*sizeof(float));
+    double* xd = (double*)malloc(2*n*sizeof(double));
+    if (x == NULL || xd == NULL) {
+        free((void*)x);
+        free((void*)xd);
+        return 1;
+    }
+    float* y = x + n;
+    float* xc = y + n;
+    float* yc = xc + 2*n;
+    double* yd = xd + n;
+    srand(11);
+    x[0] = y[0] = 0.5f;
+    for (MpInt i = 1; i < n; ++i) {
+        x[i] = x[i-1] + (float)(rand()%2001 - 1000)/1e5f;
+        y[i] = y[i-1] + (float)(rand()%2001 - 1000)/1e5f;
+    }
+    for (MpInt i = 0; i < n; ++i) {
+        xd[i] = x[i];
+        yd[i] = (i%997 == 5 ? NAN : y[i]);
+    }
+    int nerrs = 0;
+    MpChunkBoundsFlt cb;
+    MpChunkBoundsDbl cbd;
+    nerrs += (MpInitializeChunkBoundsFlt(&cb, x, y, n, 64) != MP_OK);
+    nerrs += (MpInitializeChunkBoundsDbl(&cbd, xd, yd, n, 0) != MP_OK);
+    nerrs += (cb.chunks != (n - 2)/64 + 1 || cb.levels != 4);
+    uint8_t code[(20000 - 2)/64 + 1];
+
+    /* Each chunk contains its points and the top box contains all. */
+    for (MpInt k = 0; k < cb.chunks && nerrs == 0; ++k) {
+        const MpBoxFlt* b = &cb.boxes[k];
+        for (MpInt i = k*64; i <= k*64 + 64 && i < n; ++i) {
+            nerrs += (x[i] < b->xmin || x[i] > b->xmax ||
+                      y[i] < b->ymin || y[i] > b->ymax);
+        }
+    }
+    MpInt nboxes = cb.chunks + 20 + 2 + 1;
+    const MpBoxFlt* top = &cb.boxes[nboxes - 1];
+    for (MpInt i = 0; i < n; ++i) {
+        nerrs += (x[i] < top->xmin || x[i] > top->xmax ||
+                  y[i] < top->ymin || y[i] > top->ymax);
+    }
+
+    /* Clipping yields the same segments. */
+    for (int pass = 0; pass < 20; ++pass) {
+        float w = 0.01f + (float)(rand()%100)/400.0f;
+        float x0 = top->xmin + (float)(rand()%100)/100.0f*(top->xmax - top->xmin);
+        float y0 = top->ymin + (float)(rand()%100)/100.0f*(top->ymax - top->ymin);
+        MpBoxFlt box = {x0 - w, x0 + w, y0 + w, y0 - w};
+        MpInt nc = MpClipPolylineFlt(xc, yc, &box, x, y, n);
+        float* xi = xc + 2*n - 2*nc;
+        MpInt ni = MpClipIndexedPolylineFlt(xi, yc + n, &box, x, y, n,
+                                            &cb, code);
+        nerrs += (ni != nc || memcmp(xc, xi, 2*nc*sizeof(float)) != 0);
+        MpBoxFlt big = {-10, 10, -10, 10};
+        nerrs += (MpClassifyChunksFlt(code, &cb, NULL, &big) != cb.chunks ||
+                  code[0] != MP_CHUNK_INSIDE);
+        MpBoxFlt far = {20, 30, 20, 30};
+        nerrs += (MpClassifyChunksFlt(code, &cb, NULL, &far) != 0);
+    }
+
+    /* Drawing yields the same pixels when zooming. */
+    MpDevice* devs[2] = {NULL, NULL};
+    MpStatus status = MP_OK;
+    for (int k = 0; k < 2 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&devs[k], "raster", "200x150");
+    }
+    for (int pass = 0; pass < 6 && status == MP_OK; ++pass) {
+        double z = (pass%3 == 0 ? 1 : 10*pass), xm = 0.5 + 0.02*pass;
+        MpCoordinateTransform A = {z, 0.1*(pass%2), 0.5 - z*xm,
+                                   0, z, 0.5 - z*0.5};
+        const uint32_t* pix[2];
+        MpInt w[2], h[2];
+        for (int k = 0; k < 2; ++k) {
+            MpDevice* dev = devs[k];
+            MpSetColorIndex(dev, MP_COLOR_BACKGROUND);
+            MpDrawDevicePolygon(dev, (MpPoint[]){0, 199, 199, 0},
+                                (MpPoint[]){0, 0, 149, 149}, 4);
+            MpSetColorIndex(dev, MP_COLOR_RED);
+            nerrs += (MpSetCoordinateTransform(dev, &A) != MP_OK);
+            if (pass < 3) {
+                status = (k == 0 ? MpDrawPolylineFlt(dev, x, y, n) :
+                          MpDrawIndexedPolylineFlt(dev, x, y, n, &cb));
+            } else {
+                status = (k == 0 ? MpDrawPolylineDbl(dev, xd, yd, n) :
+                          MpDrawIndexedPolylineDbl(dev, xd, yd, n, &cbd));
+            }
+            nerrs += (status != MP_OK);
+            nerrs += (MpGetRasterPixels(dev, &pix[k], &w[k], &h[k]) != MP_OK);
+        }
+        nerrs += memcmp(pix[0], pix[1], w[0]*h[0]*sizeof(uint32_t)) != 0;
+    }
+    nerrs += (status != MP_OK);
+    nerrs += (MpDrawIndexedPolylineFlt(devs[1], x, y, n - 1, &cb)
+              != MP_BAD_SIZE);
+    MpCloseDevice(&devs[0]);
+    MpCloseDevice(&devs[1]);
+    MpFinalizeChunkBoundsFlt(&cb);
+    MpFinalizeChunkBoundsDbl(&cbd);
+    free((void*)x);
+    free((void*)xd);
+    printf("MpChunkBounds* -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Check the axis scales and that drawing with nonlinear axes is the same as
+   drawing the scaled coordinates with linear axes. */
+static int
+testAxisScales(void)
+{
+    const MpInt n = 5000;
+    double* x = (double*)malloc(4*n*sizeof(double));
+    if (x == NULL) {
+        return 1;
+    }
+    double* y = x + n;
+    double* u = y + n;
+    double* v = u + n;
+    srand(23);
+    x[0] = 1.0;
+    y[0] = 0.0;
+    for (MpInt i = 1; i < n; ++i) {
+        x[i] = x[i-1]*(1 + (double)(rand()%2001 - 1000)/2e4);
+        y[i] = y[i-1] + (double)(rand()%2001 - 1000)/1e4;
+    }
+    x[n/3] = -1.0; /* no image on a logarithmic axis */
+    int nerrs = 0;
+
+    /* Batch kernels agree with the scalar functions and are inverted. */
+    MpAxisScale scales[4] = {{MP_LINEAR_SCALING, 0}, {MP_LOG_SCALING, 0},
+                             {MP_SYMLOG_SCALING, 0.5}, {MP_ASINH_SCALING, 2}};
+    for (int k = 0; k < 4; ++k) {
+        const MpAxisScale* s = &scales[k];
+        nerrs += (MpApplyAxisScaleDbl(s, u, y, n) != MP_OK);
+        for (MpInt i = 0; i < n; ++i) {
+            double a = MpScaleCoordinate(s, y[i]);
+            double t = fabs(y[i]) + 1;
+            if (s->scaling == MP_LOG_SCALING && y[i] <= 0) {
+                nerrs += ! isnan(u[i]);
+            } else {
+                nerrs += (fabs(u[i] - a) > 1e-14*t ||
+                          fabs(MpUnscaleCoordinate(s, a) - y[i]) > 1e-12*t);
+            }
+        }
+    }
+    float xf[3] = {-2.0f, 0.0f, 100.0f};
+    MpApplyAxisScaleFlt(&scales[1], xf, xf, 3);
+    nerrs += (! isnan(xf[0]) || ! isnan(xf[1]) || fabsf(xf[2] - 2.0f) > 1e-6f);
+    MpAxisScale bad = {MP_SYMLOG_SCALING, 0};
+    nerrs += (MpCheckAxisScale(&bad) != MP_BAD_ARGUMENT);
+
+    /* Compare drawing with nonlinear axes, with linear axes and scaled
+       coordinates, and with the bounds of chunks. */
+    MpChunkBoundsDbl cb;
+    nerrs += (MpInitializeChunkBoundsDbl(&cb, x, y, n, 32) != MP_OK);
+    MpDevice* devs[3] = {NULL, NULL, NULL};
+    MpStatus status = MP_OK;
+    for (int k = 0; k < 3 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&devs[k], "raster", "200x150");
+    }
+    nerrs += (status == MP_OK &&
+              MpSetAxisScales(devs[0], &scales[1], &bad) != MP_BAD_ARGUMENT);
+    for (int pass = 0; pass < 4 && status == MP_OK; ++pass) {
+        const MpAxisScale* xs = &scales[1];
+        const MpAxisScale* ys = &scales[pass];
+        MpApplyAxisScaleDbl(xs, u, x, n);
+        MpApplyAxisScaleDbl(ys, v, y, n);
+        double z = (pass < 2 ? 0.3 : 3.0);
+        MpCoordinateTransform A = {z, 0, 0.5, 0, z, 0.5};
+        const uint32_t* pix[3];
+        MpInt w[3], h[3];
+        for (int k = 0; k < 3; ++k) {
+            MpDevice* dev = devs[k];
+            MpSetColorIndex(dev, MP_COLOR_BACKGROUND);
+            MpDrawDevicePolygon(dev, (MpPoint[]){0, 199, 199, 0},
+                                (MpPoint[]){0, 0, 149, 149}, 4);
+            MpSetColorIndex(dev, MP_COLOR_RED);
+            nerrs += (MpSetCoordinateTransform(dev, &A) != MP_OK);
+            if (k == 1) {
+                nerrs += (MpSetAxisScales(dev, NULL, NULL) != MP_OK);
+                status = MpDrawPolylineDbl(dev, u, v, n);
+            } else {
+                nerrs += (MpSetAxisScales(dev, xs, ys) != MP_OK);
+                status = (k == 0 ? MpDrawPolylineDbl(dev, x, y, n) :
+                          MpDrawIndexedPolylineDbl(dev, x, y, n, &cb));
+            }
+            nerrs += (status != MP_OK);
+            nerrs += (MpGetRasterPixels(dev, &pix[k], &w[k], &h[k]) != MP_OK);
+        }
+        nerrs += memcmp(pix[0], pix[1], w[0]*h[0]*sizeof(uint32_t)) != 0;
+        nerrs += memcmp(pix[0], pix[2], w[0]*h[0]*sizeof(uint32_t)) != 0;
+    }
+    nerrs += (status != MP_OK);
+    MpAxisScale xs, ys;
+    MpGetAxisScales(devs[0], &xs, &ys);
+    nerrs += (xs.scaling != MP_LOG_SCALING || ys.scaling != MP_ASINH_SCALING);
+    for (int k = 0; k < 3; ++k) {
+        MpCloseDevice(&devs[k]);
+    }
+    MpFinalizeChunkBoundsDbl(&cb);
+    free((void*)x);
+    printf("MpAxisScale -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Stroker callback marking the samples of a small grid. */
+#define STROKE_WIDTH  120
+#define STROKE_HEIGHT  40
+static void
+markSamples(void* ctx, MpInt x0, MpInt y0, MpInt x1, MpInt y1)
+{
+    uint8_t* grid = (uint8_t*)ctx;
+    for (MpInt y = (y0 > 0 ? y0 : 0); y <= y1 && y < STROKE_HEIGHT; ++y) {
+        for (MpInt x = (x0 > 0 ? x0 : 0); x <= x1 && x < STROKE_WIDTH; ++x) {
+            grid[y*STROKE_WIDTH + x] = 1;
+        }
+    }
+}
+
+/* Check the dash patterns, the dash phase across polylines, the width of
+   lines and that wide dashed lines are rendered the same way in serial and in
+   tiled modes. */
+static int
+testStroker(void)
+{
+    int nerrs = 0;
+    static uint8_t g1[STROKE_WIDTH*STROKE_HEIGHT];
+    static uint8_t g2[STROKE_WIDTH*STROKE_HEIGHT];
+    MpStroker s;
+    memset(&s, 0, sizeof(s));
+    nerrs += (MpSetStrokerStyle(&s, (MpLineStyle)7, 1) != MP_OUT_OF_RANGE);
+    nerrs += (MpSetStrokerStyle(&s, MP_DASHED_LINE, -1) != MP_BAD_SETTINGS);
+
+    /* Thin dashes are 8 samples long with gaps of 5 samples. */
+    nerrs += (MpSetStrokerStyle(&s, MP_DASHED_LINE, 0) != MP_OK);
+    MpPoint x[3] = {0, 103, 103}, y[3] = {10, 10, 30};
+    MpBeginStroke(&s, x[0], y[0]);
+    MpStrokePolyline(&s, x, y, 2, markSamples, g1);
+    for (MpInt i = 0; i < STROKE_WIDTH; ++i) {
+        nerrs += (g1[10*STROKE_WIDTH + i] != (i <= 103 && i%13 <= 8));
+    }
+
+    /* The phase carries across polylines sharing a vertex and is reset
+       otherwise. */
+    nerrs += (MpSetStrokerStyle(&s, MP_DASH_DOTTED_LINE, 3) != MP_OK);
+    memset(g1, 0, sizeof(g1));
+    memset(g2, 0, sizeof(g2));
+    MpBeginStroke(&s, x[0], y[0]);
+    MpStrokePolyline(&s, x, y, 3, markSamples, g1);
+    MpResetStroker(&s);
+    MpBeginStroke(&s, x[0], y[0]);
+    MpStrokePolyline(&s, x, y, 2, markSamples, g2);
+    MpBeginStroke(&s, x[1], y[1]);
+    MpStrokePolyline(&s, x + 1, y + 1, 2, markSamples, g2);
+    nerrs += (memcmp(g1, g2, sizeof(g1)) != 0);
+    memset(g1, 0, sizeof(g1));
+    memset(g2, 0, sizeof(g2));
+    MpBeginStroke(&s, x[0], y[0]);
+    MpStrokePolyline(&s, x, y, 2, markSamples, g1);
+    MpBeginStroke(&s, x[0], y[0]);
+    MpStrokePolyline(&s, x, y, 2, markSamples, g2);
+    MpBeginStroke(&s, x[0], y[0]);
+    MpStrokePolyline(&s, x, y, 2, markSamples, g2);
+    nerrs += (memcmp(g1, g2, sizeof(g1)) != 0);
+
+    /* Solid wide lines have square caps. */
+    nerrs += (MpSetStrokerStyle(&s, MP_SOLID_LINE, 5) != MP_OK);
+    memset(g1, 0, sizeof(g1));
+    MpPoint xs[2] = {10, 60}, ys[2] = {20, 20};
+    MpBeginStroke(&s, xs[0], ys[0]);
+    MpStrokePolyline(&s, xs, ys, 2, markSamples, g1);
+    for (MpInt j = 0; j < STROKE_HEIGHT; ++j) {
+        for (MpInt i = 0; i < STROKE_WIDTH; ++i) {
+            nerrs += (g1[j*STROKE_WIDTH + i] !=
+                      (j >= 18 && j <= 22 && i >= 8 && i <= 62));
+        }
+    }
+
+    /* Serial and tiled rendering of a long polyline drawn by pieces. */
+    const MpInt n = 10000;
+    double* xd = (double*)malloc(2*n*sizeof(double));
+    if (xd == NULL) {
+        return nerrs + 1;
+    }
+    double* yd = xd + n;
+    srand(5);
+    xd[0] = 150;
+    yd[0] = 100;
+    for (MpInt i = 1; i < n; ++i) {
+        xd[i] = xd[i-1] + rand()%7 - 3;
+        yd[i] = yd[i-1] + rand()%7 - 3;
+    }
+    MpDevice* devs[3] = {NULL, NULL, NULL};
+    MpStatus status = MP_OK;
+    for (int k = 0; k < 3 && status == MP_OK; ++k) {
+        status = MpOpenDevice(&devs[k], "raster", "300x200");
+    }
+    if (status == MP_OK) {
+        status = MpSetRasterThreads(devs[1], 4);
+    }
+    const uint32_t* pix[3];
+    MpInt w[3], h[3];
+    for (int k = 0; k < 3 && status == MP_OK; ++k) {
+        MpDevice* dev = devs[k];
+        MpCoordinateTransform A = {1.0/299, 0, 0, 0, -1.0/199, 1};
+        nerrs += (MpSetCoordinateTransform(dev, &A) != MP_OK);
+        MpSetColorIndex(dev, MP_COLOR_RED);
+        if (k < 2) {
+            MpSetLineStyle(dev, MP_DASH_DOUBLE_DOTTED_LINE);
+            MpSetLineWidth(dev, 4);
+        }
+        status = MpDrawPolylineDbl(dev, xd, yd, n);
+        if (status == MP_OK) {
+            status = MpGetRasterPixels(dev, &pix[k], &w[k], &h[k]);
+        }
+    }
+    nerrs += (status != MP_OK);
+    if (status == MP_OK) {
+        nerrs += (memcmp(pix[0], pix[1], w[0]*h[0]*sizeof(uint32_t)) != 0);
+        nerrs += (memcmp(pix[0], pix[2], w[0]*h[0]*sizeof(uint32_t)) == 0);
+    }
+    for (int k = 0; k < 3; ++k) {
+        MpCloseDevice(&devs[k]);
+    }
+    free((void*)xd);
+    printf("MpStroker -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Check the layout of text strings and the clipping of their strokes. */
+static int
+testText(void)
+{
+    int nerrs = 0;
+    double w;
+    nerrs += (MpMeasureText("Hello", 21, &w) != MP_OK || w != 75);
+    nerrs += (MpMeasureText("\xc3\xa9\xc2\xb5", 42, &w) != MP_OK ||
+              w != 2*(18 + 19));
+    nerrs += (MpMeasureText("\xff\xc3", 21, &w) != MP_OK || w != 2*18);
+    nerrs += (MpMeasureText("e", 0, &w) != MP_BAD_ARGUMENT);
+
+    MpDevice* dev;
+    MpStatus status = MpOpenDevice(&dev, "test", NULL);
+    if (status != MP_OK) {
+        printf("MpOpenDevice -> %d: %s\n", (int)status, MpGetReason(status));
+        return 1;
+    }
+    TestDevice* tst = (TestDevice*)dev;
+    MpCoordinateTransform A = {0.01, 0, 0, 0, 0.01, 0};
+    nerrs += (MpSetCoordinateTransform(dev, &A) != MP_OK);
+
+    /* The strokes of "H" with 1 mm per data unit and 0.99 sample per mm. */
+    nerrs += (MpDrawText(dev, 10, 10, "H", 21, 0, 0) != MP_OK);
+    nerrs += checkTestDevice(dev, 3, (MpPoint[]){14,31, 14,10, 28,31, 28,10,
+                                                 14,21, 28,21}, 6);
+    nerrs += (MpDrawText(dev, 50, 50, "H", 21, 90, 0) != MP_OK);
+    nerrs += (tst->npolys != 3 || tst->x[0] != 29 || tst->y[0] != 53);
+    checkTestDevice(dev, 0, NULL, 0);
+    nerrs += (MpDrawText(dev, 50, 50, "H", 21, 0, 1) != MP_OK);
+    nerrs += (tst->npolys != 3 || tst->x[0] != 32);
+    checkTestDevice(dev, 0, NULL, 0);
+
+    /* Accents are composed, the cached layout yields the same strokes. */
+    uint32_t hash[2];
+    for (int k = 0; k < 2; ++k) {
+        tst->hash = 0;
+        nerrs += (MpDrawText(dev, 20, 30, "\xc3\x89t\xc3\xa9", 10, 30,
+                             0.5) != MP_OK);
+        nerrs += (tst->npolys != 4 + 1 + 2 + 1 + 1);
+        checkTestDevice(dev, 0, NULL, 0);
+        hash[k] = tst->hash;
+    }
+    nerrs += (hash[0] != hash[1]);
+
+    /* Strokes outside the device are clipped. */
+    nerrs += (MpDrawText(dev, -10, 10, "H", 21, 0, 0) != MP_OK);
+    nerrs += checkTestDevice(dev, 2, (MpPoint[]){8,31, 8,10, 0,21, 8,21}, 4);
+    nerrs += (MpDrawText(dev, 10, 10, NULL, 21, 0, 0) != MP_BAD_ADDRESS);
+    nerrs += (MpDrawText(dev, 10, 10, "H", NAN, 0, 0) != MP_BAD_ARGUMENT);
+    MpCloseDevice(&dev);
+    printf("MpDrawText -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+static int
+testDeviceStats(void)
+{
+    MpDevice* dev;
+    MpStatus status = MpOpenDevice(&dev, "test", NULL);
+    if (status != MP_OK) {
+        printf("MpOpenDevice -> %d: %s\n", (int)status, MpGetReason(status));
+        return 1;
+    }
+    int nerrs = 0;
+    MpDeviceStats stats;
+    nerrs += (MpGetDeviceStats(NULL, &stats) != MP_BAD_ADDRESS);
+    nerrs += (MpGetDeviceStats(dev, NULL) != MP_BAD_ADDRESS);
+    nerrs += (strcmp(MpGetMethodName(MP_METHOD_DRAW_POLYLINE),
+                     "drawPolyline") != 0);
+    nerrs += (strcmp(MpGetMethodName(MP_METHOD_COUNT), "unknown") != 0);
+#ifdef MP_ENABLE_STATS
+    nerrs += (MpGetDeviceStats(dev, &stats) != MP_OK ||
+              stats.calls[MP_METHOD_INITIALIZE] != 1);
+    nerrs += (MpResetDeviceStats(dev) != MP_OK);
+
+    /* The polyline leaves the device after its second vertex, setting the
+       current color index again is suppressed. */
+    double x[] = {0.1, 0.5, 3, 4}, y[] = {0.1, 0.2, 3, 4};
+    nerrs += (MpSetColorIndex(dev, 3) != MP_OK);
+    nerrs += (MpSetColorIndex(dev, 3) != MP_OK);
+    nerrs += (MpDrawPolylineDbl(dev, x, y, 4) != MP_OK);
+    nerrs += (MpDrawPolylineDbl(dev, x, y, 2) != MP_OK);
+    checkTestDevice(dev, 0, NULL, 0);
+    nerrs += (MpGetDeviceStats(dev, &stats) != MP_OK);
+    nerrs += (stats.calls[MP_METHOD_DRAW_POLYLINE] != 2 ||
+              stats.calls[MP_METHOD_SET_COLOR_INDEX] != 1 ||
+              stats.calls[MP_METHOD_INITIALIZE] != 0);
+    nerrs += (stats.submittedVertices != 6 || stats.emittedVertices != 5);
+    nerrs += (stats.suppressedSettings != 1);
+    nerrs += (stats.seconds[MP_METHOD_DRAW_POLYLINE] < 0);
+    nerrs += (MpResetDeviceStats(dev) != MP_OK ||
+              MpGetDeviceStats(dev, &stats) != MP_OK ||
+              stats.calls[MP_METHOD_DRAW_POLYLINE] != 0);
+    MpCloseDevice(&dev);
+
+    /* Bytes written to the output file. */
+    char name[24];
+    if (! makeTemporaryNames(&name, 1)) {
+        return 1;
+    }
+    if (MpOpenDevice(&dev, "xfig", name) == MP_OK) {
+        nerrs += (MpBeginPage(dev) != MP_OK);
+        nerrs += (MpDrawPolylineDbl(dev, x, y, 2) != MP_OK);
+        nerrs += (MpEndPage(dev) != MP_OK);
+        nerrs += (MpFlush(dev) != MP_OK);
+        nerrs += (MpGetDeviceStats(dev, &stats) != MP_OK);
+        nerrs += (stats.calls[MP_METHOD_END_PAGE] != 1);
+        nerrs += (MpCloseDevice(&dev) != MP_OK);
+        struct stat st;
+        nerrs += (stat(name, &st) != 0 || st.st_size == 0 ||
+                  stats.bytesWritten != (uint64_t)st.st_size);
+    } else {
+        ++nerrs;
+    }
+    remove(name);
+#else
+    nerrs += (MpGetDeviceStats(dev, &stats) != MP_NOT_IMPLEMENTED);
+    nerrs += (MpResetDeviceStats(dev) != MP_NOT_IMPLEMENTED);
+#endif
+    MpCloseDevice(&dev);
+    printf("MpGetDeviceStats -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+static int
+testTransformKinds(void)
+{
+    const MpAffineTransformDbl As[4] = {
+        {1.0, 0.0,  0.0, 0.0,  1.0,  0.0}, /* identity */
+        {1.0, 0.0, -2.5, 0.0,  1.0,  4.0}, /* translation */
+        {2.0, 0.0, -1.0, 0.0, -3.0,  5.0}, /* no shear nor rotation */
+        {1.5, 0.3,  7.0, -.2,  0.7, -4.0}, /* general */
+    };
+    const MpTransformKind kinds[4] = {
+        MP_IDENTITY_TRANSFORM, MP_TRANSLATION_TRANSFORM,
+        MP_DIAGONAL_TRANSFORM, MP_GENERAL_TRANSFORM,
+    };
+    double x[NPTS], y[NPTS], xd[NPTS], yd[NPTS];
+    float xf[NPTS], yf[NPTS], xo[NPTS], yo[NPTS];
+    int nerrs = 0;
+    for (int k = 0; k < 4; ++k) {
+        const MpAffineTransformDbl* A = &As[k];
+        MpAffineTransformFlt B = {A->xx, A->xy, A->x, A->yx, A->yy, A->y};
+        nerrs += (MpClassifyAffineTransformDbl(A) != kinds[k]);
+        nerrs += (MpClassifyAffineTransformFlt(&B) != kinds[k]);
+        for (int i = 0; i < NPTS; ++i) {
+            xf[i] = x[i] = i - 11.25;
+            yf[i] = y[i] = 0.5*i*i - 3;
+        }
+        MpApplyAffineTransformDbl(A, xd, yd, x, y, NPTS);
+        MpApplyAffineTransformFlt(&B, xo, yo, xf, yf, NPTS);
+        MpApplyAffineTransformInPlaceDbl(A, x, y, NPTS);
+        MpApplyAffineTransformInPlaceFlt(&B, xf, yf, NPTS);
+        for (int i = 0; i < NPTS; ++i) {
+            double xi = i - 11.25, yi = 0.5*i*i - 3;
+            double xp = A->xx*xi + A->xy*yi + A->x;
+            double yp = A->yx*xi + A->yy*yi + A->y;
+            if (xd[i] != xp || yd[i] != yp || x[i] != xp || y[i] != yp ||
+                xf[i] != xo[i] || yf[i] != yo[i]) {
+                ++nerrs;
+            }
+        }
+    }
+
+    /* Right-translating is composing with a translation, right-dividing is
+       composing with the inverse. */
+    const MpAffineTransformDbl* A = &As[3];
+    const MpAffineTransformDbl* B = &As[2];
+    MpAffineTransformDbl T = {1.0, 0.0, 0.75, 0.0, 1.0, -2.0}, C, D;
+    MpRightTranslateAffineTransformDbl(&C, A, T.x, T.y);
+    MpComposeAffineTransformsDbl(&D, A, &T);
+    nerrs += (C.xx != D.xx || C.xy != D.xy || fabs(C.x - D.x) > 1e-12 ||
+              C.yx != D.yx || C.yy != D.yy || fabs(C.y - D.y) > 1e-12);
+    nerrs += (MpRightDivideAffineTransformsDbl(&C, A, B) != MP_OK);
+    MpComposeAffineTransformsDbl(&D, &C, B);
+    nerrs += (fabs(D.xx - A->xx) > 1e-12 || fabs(D.xy - A->xy) > 1e-12 ||
+              fabs(D.x  - A->x)  > 1e-12 || fabs(D.yx - A->yx) > 1e-12 ||
+              fabs(D.yy - A->yy) > 1e-12 || fabs(D.y  - A->y)  > 1e-12);
+
+    /* The device caches the kind and a single precision copy of its data to
+       device transform. */
+    MpDevice* dev;
+    MpStatus status = MpOpenDevice(&dev, "test", NULL);
+    if (status != MP_OK) {
+        printf("MpOpenDevice -> %d: %s\n", (int)status, MpGetReason(status));
+        return 1;
+    }
+    for (int k = 0; k < 4; ++k) {
+        nerrs += (MpSetCoordinateTransform(dev, &As[k]) != MP_OK);
+        const MpCoordinateTransform* Cd = MpGetDataToDeviceTransform(dev);
+        const MpAffineTransformFlt* Cf = MpGetDataToDeviceTransformFlt(dev);
+        nerrs += (dev->dataToDeviceKind != MpClassifyAffineTransformDbl(Cd));
+        nerrs += (Cf->xx != (float)Cd->xx || Cf->xy != (float)Cd->xy ||
+                  Cf->x  != (float)Cd->x  || Cf->yx != (float)Cd->yx ||
+                  Cf->yy != (float)Cd->yy || Cf->y  != (float)Cd->y);
+    }
+    MpCloseDevice(&dev);
+    printf("MpClassifyAffineTransform* -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+/* Draw a dense figure with `npages` pages. */
+static void
+drawDensePage(MpDevice* dev, int page)
+{
+    double x[500], y[500];
+    for (int k = 0; k < 20; ++k) {
+        for (int i = 0; i < 500; ++i) {
+            x[i] = i/499.0;
+            y[i] = 0.5 + 0.4*sin(0.05*i*(k + 1) + page)*exp(-x[i]*k/10);
+        }
+        MpSetColorIndex(dev, 2 + k%8);
+        MpSetLineStyle(dev, (MpLineStyle)(k%3));
+        MpDrawPolylineDbl(dev, x, y, 500);
+    }
+    uint8_t z[6] = {0, 1, 2, 3, 4, 5};
+    MpDrawCells8(dev, z, 3, 2, 3, 10, 10, 40, 30);
+}
+
+static void
+drawDenseFigure(MpDevice* dev, int npages)
+{
+    for (int page = 0; page < npages; ++page) {
+        MpBeginPage(dev);
+        drawDensePage(dev, page);
+        MpEndPage(dev);
+    }
+}
+
+/* Check the structure of a PDF file: its header, its trailer and the offsets
+   of its objects. */
+static int
+checkPDFFile(const char* name, int npages)
+{
+    size_t n;
+    char* buf = readWholeFile(name, &n);
+    if (buf == NULL) {
+        return 1;
+    }
+    int nerrs = (n < 32 || memcmp(buf, "%PDF-1.4\n", 9) != 0 ||
+                 memcmp(buf + n - 6, "%%EOF\n", 6) != 0);
+    char* p = NULL;
+    for (size_t i = 0; i + 10 <= n; ++i) {
+        if (memcmp(buf + i, "startxref\n", 10) == 0) {
+            p = buf + i + 10;
+        }
+    }
+    unsigned long xref = (p == NULL ? 0 : strtoul(p, NULL, 10));
+    long size = 0;
+    if (xref + 20 < n && memcmp(buf + xref, "xref\n0 ", 7) == 0) {
+        size = strtol(buf + xref + 7, &p, 10);
+        p += 21; /* skip newline and free entry */
+        for (long num = 1; num < size && p + 20 <= buf + n; ++num, p += 20) {
+            unsigned long offset = strtoul(p, NULL, 10);
+            char obj[32];
+            int len = sprintf(obj, "%ld 0 obj\n", num);
+            nerrs += (offset + len > n || memcmp(buf + offset, obj, len) != 0);
+        }
+    }
+    char count[32];
+    sprintf(count, "/Count %d>>", npages);
+    nerrs += (size < 4 || strstr(buf + xref - (xref > 200 ? 200 : xref),
+                                 count) == NULL);
+    free((void*)buf);
+    return nerrs;
+}
+
+static int
+testPDF(void)
+{
+    char names[3][24];
+    if (! makeTemporaryNames(names, 3)) {
+        return 1;
+    }
+    int nerrs = 0;
+    MpDevice* dev = NULL;
+    MpStatus status = MpInstallDriver("pdf", MpOpenPDFDevice);
+    if (status == MP_OK) {
+        status = MpOpenDevice(&dev, "pdf", names[0]);
+    }
+    if (status != MP_OK) {
+        printf("MpOpenDevice(\"pdf\") -> %d: %s\n",
+               (int)status, MpGetReason(status));
+        return 1;
+    }
+    drawDenseFigure(dev, 1);
+
+    /* Bad cells are rejected without breaking the document. */
+    nerrs += (MpBeginPage(dev) != MP_OK);
+    uint16_t bad[4] = {1, 2, 1000, 3};
+    nerrs += (MpDrawCells16(dev, bad, 2, 2, 2, 10, 10, 40, 30)
+              != MP_OUT_OF_RANGE);
+    drawDensePage(dev, 1);
+    nerrs += (MpEndPage(dev) != MP_OK);
+    nerrs += (MpReopenDevice(dev, names[1], true) != MP_OK);
+    drawDenseFigure(dev, 1);
+    nerrs += (MpCloseDevice(&dev) != MP_OK);
+    nerrs += checkPDFFile(names[0], 2);
+    nerrs += checkPDFFile(names[1], 1);
+
+    /* The same figure is much smaller than with the XFig driver. */
+    if (MpOpenDevice(&dev, "xfig", names[2]) == MP_OK) {
+        drawDenseFigure(dev, 1);
+        nerrs += (MpCloseDevice(&dev) != MP_OK);
+        struct stat pdf, fig;
+        nerrs += (stat(names[1], &pdf) != 0 || stat(names[2], &fig) != 0 ||
+                  pdf.st_size*2 > fig.st_size);
+    } else {
+        ++nerrs;
+    }
+    for (int k = 0; k < 3; ++k) {
+        remove(names[k]);
+    }
+    /* The XFig figure refers to a picture file for the cells. */
+    char picture[32];
+    sprintf(picture, "%s-1.ppm", names[2]);
+    remove(picture);
+    printf("MpOpenPDFDevice -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
+static MpStatus
+drawRecordedPage(void* ctx, MpDevice* dev, MpInt page)
+{
+    MpInt* failing = (MpInt*)ctx;
+    if (page == *failing) {
+        return MP_BAD_ARGUMENT;
+    }
+    drawDensePage(dev, page - 1);
+    return MP_OK;
+}
+
+/* Draw a document with pages recorded in parallel and compare it with the
+   same document drawn sequentially. */
+static int
+testPageRecorders(void)
+{
+    char names[4][24];
+    if (! makeTemporaryNames(names, 4)) {
+        return 1;
+    }
+    const MpInt npages = 11;
+    int nerrs = 0;
+    MpDevice* dev = NULL;
+    MpStatus status = MpOpenDevice(&dev, "pdf", names[0]);
+    if (status != MP_OK) {
+        printf("MpOpenDevice(\"pdf\") -> %d: %s\n",
+               (int)status, MpGetReason(status));
+        return 1;
+    }
+    drawDenseFigure(dev, npages);
+    MpInt failing = 0;
+    const MpInt nthreads[3] = {1, 4, 0};
+    for (int k = 0; k < 3; ++k) {
+        nerrs += (MpReopenDevice(dev, names[k + 1], true) != MP_OK);
+        nerrs += (MpDrawPages(dev, npages, drawRecordedPage, &failing,
+                              nthreads[k]) != MP_OK);
+    }
+    nerrs += (MpCloseDevice(&dev) != MP_OK);
+    for (int k = 1; k < 4; ++k) {
+        nerrs += ! sameFiles(names[0], names[k]);
+    }
+
+    /* The pages before a failing page are merged. */
+    MpDevice* lst = NULL;
+    MpInt ncmds = -1;
+    nerrs += (MpOpenDevice(&lst, "list", NULL) != MP_OK);
+    failing = 6;
+    nerrs += (MpDrawPages(lst, npages, drawRecordedPage, &failing,
+                          4) != MP_BAD_ARGUMENT);
+    nerrs += (lst->pageNumber != 5);
+    nerrs += (MpGetDisplayListSize(lst, &ncmds) != MP_OK || ncmds <= 0);
+
+    /* Bad arguments. */
+    MpDevice* rec = lst;
+    nerrs += (MpOpenPageRecorder(&rec, NULL) != MP_BAD_ADDRESS || rec != NULL);
+    nerrs += (MpOpenPageRecorder(NULL, lst) != MP_BAD_ADDRESS);
+    nerrs += (MpDrawPages(lst, -1, drawRecordedPage, &failing, 1)
+              != MP_BAD_SIZE);
+    nerrs += (MpDrawPages(lst, 1, drawRecordedPage, &failing, -1)
+              != MP_BAD_ARGUMENT);
+    nerrs += (MpDrawPages(lst, 1, NULL, &failing, 1) != MP_BAD_ADDRESS);
+    nerrs += (MpMergePages(lst, NULL, 1) != MP_BAD_ADDRESS);
+    nerrs += (MpMergePages(lst, &rec, -1) != MP_BAD_SIZE);
+    nerrs += (MpCloseDevice(&lst) != MP_OK);
+    for (int k = 0; k < 4; ++k) {
+        remove(names[k]);
+    }
+    printf("MpDrawPages -> %d error(s)\n", nerrs);
+    return nerrs;
+}
+
 int main(int argc, char** argv)
 {
     MpInt cnt;
@@ -55,5 +2100,75 @@ int main(int argc, char** argv)
     printDriverList(cnt, lst);
     MpFreeDriverList(lst);
 
+    if (testAffineTransforms() != 0) {
+        return 1;
+    }
+    if (testWriter() != 0) {
+        return 1;
+    }
+    if (testRaster() != 0) {
+        return 1;
+    }
+    if (testRasterPNG() != 0) {
+        return 1;
+    }
+    if (testTiledRaster() != 0) {
+        return 1;
+    }
+    if (testDisplayList() != 0) {
+        return 1;
+    }
+    if (testAsyncDevice() != 0) {
+        return 1;
+    }
+    if (testMetafile() != 0) {
+        return 1;
+    }
+    if (testClipping() != 0) {
+        return 1;
+    }
+    if (testImageMapping() != 0) {
+        return 1;
+    }
+    if (testDrawPolyline() != 0) {
+        return 1;
+    }
+    if (testPlotFarm() != 0) {
+        return 1;
+    }
+    if (testReopenDevice() != 0) {
+        return 1;
+    }
+    if (testAsyncColors() != 0) {
+        return 1;
+    }
+    if (testXFigColors() != 0) {
+        return 1;
+    }
+    if (testChunkBounds() != 0) {
+        return 1;
+    }
+    if (testAxisScales() != 0) {
+        return 1;
+    }
+    if (testStroker() != 0) {
+        return 1;
+    }
+    if (testText() != 0) {
+        return 1;
+    }
+    if (testDeviceStats() != 0) {
+        return 1;
+    }
+    if (testTransformKinds() != 0) {
+        return 1;
+    }
+    if (testPDF() != 0) {
+        return 1;
+    }
+    if (testPageRecorders() != 0) {
+        return 1;
+    }
+
     return 0;
 }
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
 #include <math.h>
 #include "muPlotPriv.h"
 
@@ -60,12 +61,12 @@
  */
 #define XFIG_COLORMAP_SIZE_1  34
 #define XFIG_COLORMAP_SIZE_2 512 /* This is the maximum value. */
-#define XFIG_COLOR_INDEX(ci)  ((ci) < 10 ? standardColors[ci] : (int)(ci) - 1)
+#define XFIG_COLOR_INDEX(ci)  ((ci) < 10 ? standardColors[ci] : (int)(ci) - 2)
 
 /*
  * The following table maps standard µPlot color indices to XFig colors.
  */
-static int standardColors[] = {
+static const int standardColors[] = {
     XFIG_COLOR_WHITE,   /* MP_COLOR_BACKGROUND */
     XFIG_COLOR_DEFAULT, /* MP_COLOR_FOREGROUND */
     XFIG_COLOR_RED,
@@ -145,9 +146,9 @@ typedef struct _XFigDevice XFigDevice;
 struct _XFigDevice {
     MpDevice pub;
 
-    int stage; /* Initially 0, becomes 1 after the first graphic object has
-                  been written; user defined colors can only be written at
-                  stage = 0. */
+    int stage; /* Initially 0, becomes 1 after the page has been written;
+                  colors can only be changed and objects drawn at stage =
+                  0. */
     int          dotsPerInch;
     XFigLineStyle  lineStyle;
     int            lineWidth;
@@ -164,6 +165,14 @@ struct _XFigDevice {
     const char*  pictureName;
     const char*    paperSize;
     FILE* file;
+    MpWriter out; /* Buffered output to `file` */
+    MpWriter spool; /* Objects of the page, in memory until the page has been
+                       written */
+    MpBool usedColors[XFIG_C1MAX + 1 - XFIG_C1MIN]; /* Which user defined
+                                                        colors are used by
+                                                        the objects? */
+    int     numberOfPictures; /* Number of picture files written so far */
+    char*           fileName; /* Name of the output file */
 };
 
 
@@ -173,6 +182,24 @@ struct _XFigDevice {
     MpEncodeColor(dst, (MpReal)(r)/(MpReal)255,                         \
                       (MpReal)(g)/(MpReal)255, (MpReal)(b)/(MpReal)255)
 
+static unsigned
+colorant(MpReal val)
+{
+    return (val <= (MpReal)0 ? (unsigned)0 :
+            (val >= (MpReal)1 ? (unsigned)255 :
+             (MP_IS_SINGLE_PRECISION(val) ?
+              (unsigned)roundf((float)val*(float)255) :
+              (unsigned)round((double)val*(double)255))));
+}
+
+/* Encode a color as `0xRRGGBB` for the color objects of XFig. */
+static uint32_t
+encodeXFigColor(const MpColor* c)
+{
+    return ((colorant(c->red) << 16) | (colorant(c->green) << 8) |
+            colorant(c->blue));
+}
+
 static void
 warnColorMismatch(const char* A, const char* B)
 {
@@ -193,10 +220,19 @@ initializeXFigDevice(MpDevice* dev)
 {
     MpStatus status = MP_OK;
 
-    if (dev->colormapSize != XFIG_NCOLORS) {
+    if (dev->colormapSize != XFIG_COLORMAP_SIZE_1 + XFIG_COLORMAP_SIZE_2) {
         return MP_BAD_SIZE;
     }
 
+    /* XFig coordinate system has its origin at the upper left corner. */
+    MpCoordinateTransform B = {dev->horizontalSamples - 1, 0, 0,
+                               0, 1 - dev->verticalSamples,
+                               dev->verticalSamples - 1};
+    status = MpSetNDCToDeviceTransform(dev, &B);
+    if (status != MP_OK) {
+        return status;
+    }
+
     /* Check mapping of color indices. */
     CHECK_COLOR(BACKGROUND, WHITE);
     CHECK_COLOR(FOREGROUND, DEFAULT);
@@ -219,7 +255,7 @@ initializeXFigDevice(MpDevice* dev)
     /*   27-30 = four shades of pink (dark to lighter) */
     if (dev->colormapSize1 > 31+2) {
         /* 31 = Gold, +2 to match µPlot color index */
-        MpEncodeColor(&dev->colormap[31+2], 255, 215, 0);
+        encodeColor(&dev->colormap[31+2], 255, 215, 0);
     }
 
     /* Initialize colormap CMAP1 with a ramp of grays. */
@@ -236,20 +272,33 @@ initializeXFigDevice(MpDevice* dev)
             MpEncodeColor(&dev->colormap[dev->colormapSize1 + i], g,g,g);
         }
     }
-    return status;
+
+    /* The color objects are written from the encoded colors. */
+    return MpSetColorEncoder(dev, encodeXFigColor);
 }
 
+static MpStatus writeXFigPage(XFigDevice* xfig);
+
 static MpStatus
 finalizeXFigDevice(MpDevice* dev)
 {
     MpStatus status = MP_OK;
     XFigDevice* xfig = (XFigDevice*)dev;
+    status = writeXFigPage(xfig);
+    MpFinalizeWriter(&xfig->spool);
+    if (MpFinalizeWriter(&xfig->out) != MP_OK && status == MP_OK) {
+        status = xfig->out.status;
+    }
     if (xfig->file != NULL) {
         if (fclose(xfig->file) != 0 && status == MP_OK) {
             status = MpSystemError();
         }
         xfig->file = NULL;
     }
+    if (xfig->fileName != NULL) {
+        free((void*)xfig->fileName);
+        xfig->fileName = NULL;
+    }
     return status;
 }
 
@@ -293,10 +342,10 @@ static MpStatus setXFigColorIndex(MpDevice* dev, MpColorIndex ci)
 static MpStatus setXFigColor(MpDevice* dev, MpColorIndex ci, MpReal rd, MpReal gr, MpReal bl)
 {
     XFigDevice* xfig = (XFigDevice*)dev;
-    if (ci < XFIG_C0MIN || ci > XFIG_CMAX) {
+    if (XFIG_COLOR_INDEX(ci) < XFIG_C0MIN || XFIG_COLOR_INDEX(ci) > XFIG_CMAX) {
         return MP_OUT_OF_RANGE;
     }
-    if (xfig->stage > 0 || ci < XFIG_C1MIN) {
+    if (xfig->stage > 0 || ci < dev->colormapSize1) {
         return MP_READ_ONLY;
     }
     /* Note: Color levels have already been clamped. */
@@ -306,56 +355,99 @@ static MpStatus setXFigColor(MpDevice* dev, MpColorIndex ci, MpReal rd, MpReal g
     return MP_OK;
 }
 
-static unsigned
-colorant(MpReal val)
-{
-    return (val <= (MpReal)0 ? (unsigned)0 :
-            (val >= (MpReal)255 ? (unsigned)255 :
-             (MP_IS_SINGLE_PRECISION(val) ?
-              (unsigned)roundf((float)val*(float)255) :
-              (unsigned)round((double)val*(double)255))));
-}
-
+/*
+ * Write the page: the header, the definitions of the user defined colors
+ * which are used and the spooled objects.  Colors cannot be changed and
+ * objects cannot be drawn after that.
+ */
 static MpStatus
-bumpXFigStage(XFigDevice* xfig)
+writeXFigPage(XFigDevice* xfig)
 {
     if (xfig->stage == 0) {
         /* Write XFig header information. */
-        fprintf(xfig->file, "#FIG 3.2\n");
-        fprintf(xfig->file, "%s\n",
-                xfig->pub.pageWidth <= xfig->pub.pageHeight ? "Portrait" : "Landscape");
-        fprintf(xfig->file, "Center\n"); /* "Center" or "Flush Left" */
-        fprintf(xfig->file, "Metric\n"); /* "Metric" or "Inches" */
-        fprintf(xfig->file, "%s\n", xfig->paperSize); /* papersize */
-        fprintf(xfig->file, "%.2f\n", 100.0); /* magnification */
-        fprintf(xfig->file, "Single\n"); /* multiple-page ("Single" or "Multiple" pages) */
-        fprintf(xfig->file, "%d\n", -2); /*  transparent color (color number for
-                                             transparent color for GIF
-                                             export. -3=background, -2=None,
-                                             -1=Default, 0-31 for standard colors
-                                             or 32- for user colors) */
-        fprintf(xfig->file, "# Created by muPlot.\n"); /* comment (An optional set of comments may be here,
+        MpWriter* out = &xfig->out;
+        MpWriteString(out, "#FIG 3.2\n");
+        MpWriteFormatted(out, "%s\n",
+                         (xfig->pub.pageWidth <= xfig->pub.pageHeight ?
+                          "Portrait" : "Landscape"));
+        MpWriteString(out, "Center\n"); /* "Center" or "Flush Left" */
+        MpWriteString(out, "Metric\n"); /* "Metric" or "Inches" */
+        MpWriteFormatted(out, "%s\n", xfig->paperSize); /* papersize */
+        MpWriteFormatted(out, "%.2f\n", 100.0); /* magnification */
+        MpWriteString(out, "Single\n"); /* multiple-page ("Single" or "Multiple" pages) */
+        MpWriteFormatted(out, "%d\n", -2); /*  transparent color (color number for
+                                                transparent color for GIF
+                                                export. -3=background, -2=None,
+                                                -1=Default, 0-31 for standard colors
+                                                or 32- for user colors) */
+        MpWriteString(out, "# Created by muPlot.\n"); /* comment (An optional set of comments may be here,
                                                           which are associated with the whole figure) */
-        fprintf(xfig->file, "%d %d\n", xfig->dotsPerInch, 2);
+        MpWriteFormatted(out, "%d %d\n", xfig->dotsPerInch, 2);
         /* resolution coord_system (Fig units/inch and coordinate system:
            1: origin at lower left corner (NOT USED)
            2: upper left) */
 
-        /* Write definitions of arbitrary user defined colors beyond the 32
-           standard colors.  The color objects must be defined before any other
-           Fig objects. */
+        /* Write definitions of the user defined colors beyond the 32 standard
+           colors which are used.  The color objects must be defined before
+           any other Fig objects. */
         for (int ci = XFIG_C1MIN; ci <= XFIG_C1MAX; ++ci) {
-            fprintf(xfig->file, "%d %d #%02x%02x%02x\n",
-                    XFIG_COLOR_OBJECT_TYPE, ci,
-                    colorant(xfig->pub.colormap[ci].red),
-                    colorant(xfig->pub.colormap[ci].green),
-                    colorant(xfig->pub.colormap[ci].blue));
+            if (! xfig->usedColors[ci - XFIG_C1MIN]) {
+                continue;
+            }
+            MpWriteFormatted(out, "%d %d #%06x\n", XFIG_COLOR_OBJECT_TYPE, ci,
+                             (unsigned)xfig->pub.encodedColors[ci + 2]);
         }
+
+        /* Write the objects. */
+        MpWriteBytes(out, xfig->spool.buffer, xfig->spool.count);
+        xfig->spool.count = 0;
         xfig->stage = 1;
+        return MpSyncWriter(out);
     }
     return MP_OK;
 }
 
+/*
+ * Format the header of a polyline object with the current settings in `buf`
+ * and return its length.  The colors of the object are marked as used.
+ */
+#define XFIG_HEADER_SIZE 256
+static int
+formatXFigPolylineHeader(char* buf, XFigDevice* xfig, int subType, int depth,
+                         MpInt npts)
+{
+    if (depth < 0) {
+        depth = 0;
+    } else if (depth > 999) {
+        depth = 999;
+    }
+    int color = XFIG_COLOR_INDEX(xfig->pub.colorIndex);
+    if (color >= XFIG_C1MIN) {
+        xfig->usedColors[color - XFIG_C1MIN] = true;
+    }
+    if (xfig->fillColor >= XFIG_C1MIN) {
+        xfig->usedColors[xfig->fillColor - XFIG_C1MIN] = true;
+    }
+    return snprintf(buf, XFIG_HEADER_SIZE,
+                    "%d %d %d %d %d %d %d %d %d %.3f %d %d %d %d %d %ld\n",
+                    XFIG_POLYLINE_OBJECT_TYPE,
+                    subType,
+                    xfig->lineStyle,
+                    xfig->lineWidth,
+                    color,
+                    (int)xfig->fillColor,
+                    depth,
+                    xfig->penStyle, // pen style, not used
+                    xfig->areaFill, // enumeration
+                    xfig->styleVal, // 1/80 inch, specification for dash/dotted lines
+                    xfig->joinStyle,   // enumeration type)
+                    xfig->capStyle,    // enumeration type, only used for POLYLINE
+                    xfig->radius,        // 1/80 inch, radius of arc-boxes)
+                    xfig->forwardArrow, // forwardArrow (0: off, 1: on)
+                    xfig->backwardArrow, // backwardArrow (0: off, 1: on)
+                    (long)npts); // number of points
+}
+
 static MpStatus
 drawXFigPolylineObject(XFigDevice* xfig, int subType, int depth,
                        const MpPoint* x, const MpPoint* y, MpInt n,
@@ -364,32 +456,15 @@ drawXFigPolylineObject(XFigDevice* xfig, int subType, int depth,
     if (n < 1) {
         return MP_OK;
     }
-    if (depth < 0) {
-        depth = 0;
-    } else if (depth > 999) {
-        depth = 999;
-    }
-    MpStatus status = bumpXFigStage(xfig);
-    if (status != MP_OK) {
-        return status;
+    if (xfig->stage > 0) {
+        /* The page has already been written. */
+        return MP_NOT_PERMITTED;
     }
-    fprintf(xfig->file, "2 %d %d %d %d %d %d %d %d %d %.3f %d %d %d %d %d %ld\n",
-            XFIG_POLYLINE_OBJECT_TYPE,
-            subType,
-            xfig->lineStyle,
-            xfig->lineWidth,
-            XFIG_COLOR_INDEX(xfig->pub.colorIndex),
-            (int)xfig->fillColor,
-            depth,
-            xfig->penStyle, // pen style, not used
-            xfig->areaFill, // enumeration
-            xfig->styleVal, // 1/80 inch, specification for dash/dotted lines
-            xfig->joinStyle,   // enumeration type)
-            xfig->capStyle,    // enumeration type, only used for POLYLINE
-            xfig->radius,        // 1/80 inch, radius of arc-boxes)
-            xfig->forwardArrow, // forwardArrow (0: off, 1: on)
-            xfig->backwardArrow, // backwardArrow (0: off, 1: on)
-            (long)(closed ? n + 1 : n)); // number of points
+    MpWriter* out = &xfig->spool;
+    char header[XFIG_HEADER_SIZE];
+    int len = formatXFigPolylineHeader(header, xfig, subType, depth,
+                                       (closed ? n + 1 : n));
+    MpWriteBytes(out, header, len);
     if (xfig->forwardArrow) {
         /* Write forward-arraow specifications. */
     }
@@ -398,23 +473,37 @@ drawXFigPolylineObject(XFigDevice* xfig, int subType, int depth,
     }
     if (subType == XFIG_PICTURE_SUBTYPE) {
         /* Write linked picture specifications. */
-        fprintf(xfig->file, "%d\n%s\n",
-                xfig->pictureOrientation, // orientation = normal (0) or flipped (1)
-                xfig->pictureName); // name of picture file to import
+        MpWriteFormatted(out, "        %d %s\n",
+                         xfig->pictureOrientation, // orientation = normal (0) or flipped (1)
+                         xfig->pictureName); // name of picture file to import
     }
-    for (MpInt i = 0; i < n; ++i) {
-        fprintf(xfig->file, "%s%d %d",
-                ((i%6) == 0 ? (i == 0 ? "        " : "\n        ") : " "),
-                (int)x[i], (int)y[i]);
-    }
-    if (closed) {
-        fprintf(xfig->file, "%s%d %d\n",
-                ((n%6) == 0 ? "\n        " : " "),
-                (int)x[0], (int)y[0]);
-    } else {
-        fputs("\n", xfig->file);
+
+    /* Write the coordinates, 6 pairs per line, directly in the output
+       buffer. */
+    MpInt m = (closed ? n + 1 : n);
+    for (MpInt i = 0; i < m; ++i) {
+        /* At most 9 characters for the separator, 6 characters for each
+           coordinate and 1 for the space between the coordinates. */
+        char* p = MpReserveWriter(out, 9 + 6 + 1 + 6);
+        if (p == NULL) {
+            break;
+        }
+        MpInt k = (i < n ? i : 0);
+        if ((i%6) == 0) {
+            if (i > 0) {
+                *p++ = '\n';
+            }
+            memcpy(p, "        ", 8);
+            p += 8;
+        } else {
+            *p++ = ' ';
+        }
+        p = MpFormatInteger(p, x[k]);
+        *p++ = ' ';
+        p = MpFormatInteger(p, y[k]);
+        out->count = p - out->buffer;
     }
-    return status;
+    return MpWriteBytes(out, "\n", 1);
 }
 
 static MpStatus
@@ -425,6 +514,56 @@ drawXFigPoint(MpDevice* dev, MpPoint x, MpPoint y)
                                   dev->groupLevel, &x, &y, 1, true);
 }
 
+/*
+ * The points are grouped in a compound object.  As they all have the same
+ * settings, the header of their objects is formatted once.
+ */
+static MpStatus
+drawXFigPoints(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
+{
+    XFigDevice* xfig = (XFigDevice*)dev;
+    if (n < 2) {
+        return (n == 1 ? drawXFigPoint(dev, x[0], y[0]) : MP_OK);
+    }
+    if (xfig->stage > 0) {
+        /* The page has already been written. */
+        return MP_NOT_PERMITTED;
+    }
+    MpPoint xmin = x[0], xmax = x[0], ymin = y[0], ymax = y[0];
+    for (MpInt i = 1; i < n; ++i) {
+        xmin = (x[i] < xmin ? x[i] : xmin);
+        xmax = (x[i] > xmax ? x[i] : xmax);
+        ymin = (y[i] < ymin ? y[i] : ymin);
+        ymax = (y[i] > ymax ? y[i] : ymax);
+    }
+    MpWriter* out = &xfig->spool;
+    MpWriteFormatted(out, "%d %d %d %d %d\n", XFIG_COMPOUND_OBJECT_TYPE,
+                     (int)xmin, (int)ymin, (int)xmax, (int)ymax);
+    char header[XFIG_HEADER_SIZE];
+    int len = formatXFigPolylineHeader(header, xfig, XFIG_POLYLINE_SUBTYPE,
+                                       dev->groupLevel, 2);
+    for (MpInt i = 0; i < n; ++i) {
+        /* The header, 8 spaces, 4 coordinates of at most 6 characters, 3
+           spaces and a newline. */
+        char* p = MpReserveWriter(out, len + 8 + 4*6 + 4);
+        if (p == NULL) {
+            return out->status;
+        }
+        memcpy(p, header, len);
+        p += len;
+        memcpy(p, "        ", 8);
+        p += 8;
+        for (int k = 0; k < 2; ++k) {
+            p = MpFormatInteger(p, x[i]);
+            *p++ = ' ';
+            p = MpFormatInteger(p, y[i]);
+            *p++ = (k == 0 ? ' ' : '\n');
+        }
+        out->count = p - out->buffer;
+    }
+    return MpWriteFormatted(out, "%d\n", -XFIG_COMPOUND_OBJECT_TYPE);
+}
+
 static MpStatus
 drawXFigRectangle(MpDevice* dev, MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
 {
@@ -457,6 +596,238 @@ drawXFigPolygon(MpDevice* dev, const MpPoint* x, const MpPoint* y, MpInt n)
     return MP_OK;
 }
 
+/*
+ * Cells are drawn as a picture object referring to a PPM image written in a
+ * side file named after the output file.  Each cell is a pixel of the image.
+ * The index of the cell at offset `k` is given by the macro `GET_INDEX`.
+ */
+#define GET_INDEX(z,nbytes,k)                                   \
+    ((nbytes) == 1 ? (MpColorIndex)((const uint8_t*)(z))[k] :   \
+     (nbytes) == 2 ? (MpColorIndex)((const uint16_t*)(z))[k] :  \
+     ((const MpColorIndex*)(z))[k])
+
+static MpStatus
+drawXFigCellsPicture(XFigDevice* xfig, const void* z, int nbytes,
+                     MpInt n1, MpInt n2, MpInt stride,
+                     MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    if (xfig->stage > 0) {
+        /* The page has already been written. */
+        return MP_NOT_PERMITTED;
+    }
+    if (n1 < 1 || n2 < 1 || x0 == x1 || y0 == y1) {
+        return MP_OK;
+    }
+
+    /* Build the name of the picture file. */
+    const char* base = xfig->fileName;
+    size_t len = strlen(base);
+    if (len > 4 && strcmp(base + len - 4, ".fig") == 0) {
+        len -= 4;
+    }
+    char* path = (char*)malloc(len + 24);
+    if (path == NULL) {
+        return MP_NO_MEMORY;
+    }
+    memcpy(path, base, len);
+    sprintf(path + len, "-%d.ppm", ++xfig->numberOfPictures);
+
+    /* Write the image, the first pixel is at the upper left corner. */
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        free((void*)path);
+        return MpSystemError();
+    }
+    MpWriter out;
+    MpStatus status = MpInitializeWriter(&out, file, 0);
+    out.device = &xfig->pub;
+    MpWriteFormatted(&out, "P6\n%ld %ld\n255\n", (long)n1, (long)n2);
+    MpColorIndex ncolors = xfig->pub.colormapSize;
+    const uint32_t* colors = xfig->pub.encodedColors;
+    for (MpInt k2 = 0; k2 < n2 && status == MP_OK; ++k2) {
+        MpInt i2 = (y0 <= y1 ? k2 : n2 - 1 - k2);
+        for (MpInt k1 = 0; k1 < n1; ++k1) {
+            MpInt i1 = (x0 <= x1 ? k1 : n1 - 1 - k1);
+            MpColorIndex ci = GET_INDEX(z, nbytes, i1 + i2*stride);
+            if (ci < 0 || ci >= ncolors) {
+                status = MP_OUT_OF_RANGE;
+                break;
+            }
+            unsigned char* p = (unsigned char*)MpReserveWriter(&out, 3);
+            if (p == NULL) {
+                status = out.status;
+                break;
+            }
+            uint32_t color = colors[ci];
+            p[0] = (unsigned char)(color >> 16);
+            p[1] = (unsigned char)(color >> 8);
+            p[2] = (unsigned char)color;
+            out.count += 3;
+        }
+    }
+    if (MpFinalizeWriter(&out) != MP_OK && status == MP_OK) {
+        status = out.status;
+    }
+    if (fclose(file) != 0 && status == MP_OK) {
+        status = MpSystemError();
+    }
+
+    /* Draw the picture object. */
+    if (status == MP_OK) {
+        const char* name = strrchr(path, '/');
+        MpPoint xmin = (x0 <= x1 ? x0 : x1), xmax = (x0 <= x1 ? x1 : x0);
+        MpPoint ymin = (y0 <= y1 ? y0 : y1), ymax = (y0 <= y1 ? y1 : y0);
+        MpPoint x[4] = {xmin, xmax, xmax, xmin};
+        MpPoint y[4] = {ymin, ymin, ymax, ymax};
+        xfig->pictureOrientation = 0;
+        xfig->pictureName = (name == NULL ? path : name + 1);
+        status = drawXFigPolylineObject(xfig, XFIG_PICTURE_SUBTYPE,
+                                        xfig->pub.groupLevel, x, y, 4, true);
+        xfig->pictureName = NULL;
+    } else {
+        remove(path);
+    }
+    free((void*)path);
+    return status;
+}
+
+static MpStatus
+drawXFigCells(MpDevice* dev,
+              const MpColorIndex* z, MpInt n1, MpInt n2, MpInt stride,
+              MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return drawXFigCellsPicture((XFigDevice*)dev, z, sizeof(z[0]),
+                                n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawXFigCells8(MpDevice* dev,
+               const uint8_t* z, MpInt n1, MpInt n2, MpInt stride,
+               MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return drawXFigCellsPicture((XFigDevice*)dev, z, sizeof(z[0]),
+                                n1, n2, stride, x0, y0, x1, y1);
+}
+
+static MpStatus
+drawXFigCells16(MpDevice* dev,
+                const uint16_t* z, MpInt n1, MpInt n2, MpInt stride,
+                MpPoint x0, MpPoint y0, MpPoint x1, MpPoint y1)
+{
+    return drawXFigCellsPicture((XFigDevice*)dev, z, sizeof(z[0]),
+                                n1, n2, stride, x0, y0, x1, y1);
+}
+
+/*
+ * The objects are spooled in memory until the page is written, so buffering
+ * is implicit for them.  Buffering only decides whether the page is written
+ * to the file when it ends or when buffering stops.
+ */
+static MpStatus
+startXFigBuffering(MpDevice* dev)
+{
+    XFigDevice* xfig = (XFigDevice*)dev;
+    xfig->out.buffering = true;
+    return MP_OK;
+}
+
+static MpStatus
+stopXFigBuffering(MpDevice* dev)
+{
+    XFigDevice* xfig = (XFigDevice*)dev;
+    xfig->out.buffering = false;
+    return MpFlushWriter(&xfig->out);
+}
+
+static MpStatus
+endXFigPage(MpDevice* dev)
+{
+    /* XFig files have a single page. */
+    return writeXFigPage((XFigDevice*)dev);
+}
+
+/*
+ * Set the initial settings of a new XFig device.
+ */
+static void
+setXFigDefaults(XFigDevice* xfig)
+{
+    MpDevice* dev = &xfig->pub;
+
+    /* Initialize private settings (assuming A4 paper). */
+    xfig->paperSize = "A4";
+    xfig->dotsPerInch = 1200;
+
+    /* Initialize some public device settings.  Set the size of the secondary
+       colormap to be the maximum possible. */
+    double dotsPerMillimeter = (double)xfig->dotsPerInch/MILLIMETERS_PER_INCH;
+    dev->pageWidth = MP_A4_PAPER_WIDTH;
+    dev->pageHeight = MP_A4_PAPER_HEIGHT;
+    dev->horizontalResolution = dotsPerMillimeter;
+    dev->verticalResolution = dotsPerMillimeter;
+    dev->horizontalSamples = round(dev->pageWidth*dev->horizontalResolution);
+    dev->verticalSamples = round(dev->pageHeight*dev->verticalResolution);
+    dev->colormapSize1 = XFIG_COLORMAP_SIZE_1;
+    dev->colormapSize2 = XFIG_COLORMAP_SIZE_2;
+    dev->colorIndex = MP_COLOR_FOREGROUND;
+    dev->lineStyle = MP_SOLID_LINE;
+    dev->lineWidth = 0;
+}
+
+/*
+ * Write the figure to the current file and start a new figure in the file
+ * `arg`, the buffers of the device are kept.
+ */
+static MpStatus
+reopenXFigDevice(MpDevice* dev, const char* arg, MpBool reset)
+{
+    if (arg == NULL || arg[0] == '\0') {
+        return MP_BAD_FILENAME;
+    }
+
+    /* Finish the current figure. */
+    XFigDevice* xfig = (XFigDevice*)dev;
+    MpStatus status = writeXFigPage(xfig);
+    MpStatus code = MpResetWriter(&xfig->out, NULL);
+    if (status == MP_OK) {
+        status = code;
+    }
+    if (xfig->file != NULL) {
+        if (fclose(xfig->file) != 0 && status == MP_OK) {
+            status = MpSystemError();
+        }
+        xfig->file = NULL;
+    }
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Start a new figure. */
+    size_t len = strlen(arg);
+    char* fileName = (char*)realloc(xfig->fileName, len + 1);
+    if (fileName == NULL) {
+        return MP_NO_MEMORY;
+    }
+    memcpy(fileName, arg, len + 1);
+    xfig->fileName = fileName;
+    xfig->file = fopen(arg, "w");
+    if (xfig->file == NULL) {
+        return MpSystemError();
+    }
+    MpResetWriter(&xfig->out, xfig->file);
+    status = MpResetWriter(&xfig->spool, NULL);
+    if (status != MP_OK) {
+        return status;
+    }
+    memset(xfig->usedColors, 0, sizeof(xfig->usedColors));
+    xfig->numberOfPictures = 0;
+    xfig->stage = 0;
+    if (reset) {
+        setXFigDefaults(xfig);
+    }
+    return MP_OK;
+}
+
 MpStatus
 MpOpenXFigDevice(MpDevice** devptr, const char* ident, const char* arg)
 {
@@ -474,13 +845,21 @@ MpOpenXFigDevice(MpDevice** devptr, const char* ident, const char* arg)
     }
     dev->initialize = initializeXFigDevice;
     dev->finalize = finalizeXFigDevice;
+    dev->reopen = reopenXFigDevice;
     dev->setColorIndex = setXFigColorIndex;
     dev->setColormapSizes = setXFigColormapSizes;
     dev->setColor = setXFigColor;
+    dev->startBuffering = startXFigBuffering;
+    dev->stopBuffering = stopXFigBuffering;
+    dev->endPage = endXFigPage;
     dev->drawPoint = drawXFigPoint;
+    dev->drawPoints = drawXFigPoints;
     dev->drawRectangle = drawXFigRectangle;
     dev->drawPolyline = drawXFigPolyline;
     dev->drawPolygon = drawXFigPolygon;
+    dev->drawCells = drawXFigCells;
+    dev->drawCells8 = drawXFigCells8;
+    dev->drawCells16 = drawXFigCells16;
 
     /* Open output file. */
     XFigDevice* xfig = (XFigDevice*)dev;
@@ -489,22 +868,27 @@ MpOpenXFigDevice(MpDevice** devptr, const char* ident, const char* arg)
         free((void*)dev);
         return MpSystemError();
     }
+    MpStatus status = MpInitializeWriter(&xfig->out, xfig->file, 0);
+    xfig->out.device = dev;
+    if (status == MP_OK) {
+        status = MpInitializeWriter(&xfig->spool, NULL, 4096);
+    }
+    if (status == MP_OK) {
+        xfig->fileName = (char*)malloc(strlen(arg) + 1);
+        if (xfig->fileName == NULL) {
+            status = MP_NO_MEMORY;
+        } else {
+            strcpy(xfig->fileName, arg);
+        }
+    }
+    if (status != MP_OK) {
+        MpFinalizeWriter(&xfig->spool);
+        MpFinalizeWriter(&xfig->out);
+        fclose(xfig->file);
+        free((void*)dev);
+        return status;
+    }
 
-    /* Initialize private settings (assuming A4 paper). */
-    xfig->paperSize = "A4";
-    xfig->dotsPerInch = 1200;
-
-    /* Initialize some public device settings.  Set the size of the secondary
-       colormap to be the maximum possible. */
-    double dotsPerMillimeter = (double)xfig->dotsPerInch/MILLIMETERS_PER_INCH;
-    dev->pageWidth = MP_A4_PAPER_WIDTH;
-    dev->pageWidth = MP_A4_PAPER_HEIGHT;
-    dev->horizontalResolution = dotsPerMillimeter;
-    dev->verticalResolution = dotsPerMillimeter;
-    dev->horizontalSamples = round(dev->pageWidth*dev->horizontalResolution);
-    dev->verticalSamples = round(dev->pageHeight*dev->verticalResolution);
-    dev->colormapSize1 = XFIG_COLORMAP_SIZE_1;
-    dev->colormapSize2 = XFIG_COLORMAP_SIZE_2;
-    dev->colorIndex = MP_COLOR_FOREGROUND;
+    setXFigDefaults(xfig);
     return MP_OK;
 }
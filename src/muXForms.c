@@ -12,8 +12,24 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include "muPlotXForms.h"
 
+/*--------------------------------------------------------------------------*/
+/* Classify affine transforms. */
+
+MpTransformKind
+MpClassifyAffineTransformFlt(const MpAffineTransformFlt* A)
+{
+    return MP_XFORM_CLASSIFY(MP_GET_FIELD_PTR, A);
+}
+
+MpTransformKind
+MpClassifyAffineTransformDbl(const MpAffineTransformDbl* A)
+{
+    return MP_XFORM_CLASSIFY(MP_GET_FIELD_PTR, A);
+}
+
 /*--------------------------------------------------------------------------*/
 /* Compose affine transforms. */
 
@@ -88,7 +104,7 @@ ENCODE(double,Dbl)
                                          const MpAffineTransform##SFX* A, \
                                          T x, T y)                        \
     {                                                                     \
-        MP_XFORM_LEFT_TRANSLATE(MP_GET_FIELD_PTR, dst, x, y, A);          \
+        MP_XFORM_RIGHT_TRANSLATE(MP_GET_FIELD_PTR, dst, A, x, y);         \
         return MP_OK;                                                     \
     }
 
@@ -208,3 +224,233 @@ ENCODE(float,  Flt)
 ENCODE(double, Dbl)
 
 #undef ENCODE
+
+/*--------------------------------------------------------------------------*/
+/* Apply affine transforms to arrays of coordinates. */
+
+/*
+ * The following kernels are written so that the compiler is able to vectorize
+ * them: coefficients are passed as local values, loops have no branches and
+ * pointers are `restrict` qualified.  Arguments `T`, `TI` and `TO` are the
+ * floating-point types of the coefficients (and computations), of the inputs
+ * and of the outputs.  In-place operations have their own kernels so that
+ * `restrict` remains valid.
+ */
+#define ENCODE(PFX, T, TI, TO)                                          \
+                                                                        \
+    static void                                                         \
+    PFX##Translation(TO* restrict xout, TO* restrict yout,              \
+                     const TI* restrict xin, const TI* restrict yin,    \
+                     MpInt n, T Ax, T Ay)                               \
+    {                                                                   \
+        for (MpInt i = 0; i < n; ++i) {                                 \
+            xout[i] = (TO)((T)xin[i] + Ax);                             \
+            yout[i] = (TO)((T)yin[i] + Ay);                             \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void                                                         \
+    PFX##Diagonal(TO* restrict xout, TO* restrict yout,                 \
+                  const TI* restrict xin, const TI* restrict yin,       \
+                  MpInt n, T Axx, T Ax, T Ayy, T Ay)                    \
+    {                                                                   \
+        for (MpInt i = 0; i < n; ++i) {                                 \
+            xout[i] = (TO)(Axx*(T)xin[i] + Ax);                         \
+            yout[i] = (TO)(Ayy*(T)yin[i] + Ay);                         \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void                                                         \
+    PFX##General(TO* restrict xout, TO* restrict yout,                  \
+                 const TI* restrict xin, const TI* restrict yin,        \
+                 MpInt n, T Axx, T Axy, T Ax, T Ayx, T Ayy, T Ay)       \
+    {                                                                   \
+        for (MpInt i = 0; i < n; ++i) {                                 \
+            T x = (T)xin[i];                                            \
+            T y = (T)yin[i];                                            \
+            xout[i] = (TO)(Axx*x + Axy*y + Ax);                         \
+            yout[i] = (TO)(Ayx*x + Ayy*y + Ay);                         \
+        }                                                               \
+    }
+
+ENCODE(applyFlt,      float,  float,  float)
+ENCODE(applyDbl,      double, double, double)
+ENCODE(applyDblToFlt, double, double, float)
+
+#undef ENCODE
+
+#define ENCODE(PFX, T)                                                  \
+                                                                        \
+    static void                                                         \
+    PFX##TranslationInPlace(T* restrict x, T* restrict y, MpInt n,      \
+                            T Ax, T Ay)                                 \
+    {                                                                   \
+        for (MpInt i = 0; i < n; ++i) {                                 \
+            x[i] += Ax;                                                 \
+            y[i] += Ay;                                                 \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void                                                         \
+    PFX##DiagonalInPlace(T* restrict x, T* restrict y, MpInt n,         \
+                         T Axx, T Ax, T Ayy, T Ay)                      \
+    {                                                                   \
+        for (MpInt i = 0; i < n; ++i) {                                 \
+            x[i] = Axx*x[i] + Ax;                                       \
+            y[i] = Ayy*y[i] + Ay;                                       \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void                                                         \
+    PFX##GeneralInPlace(T* restrict x, T* restrict y, MpInt n,          \
+                        T Axx, T Axy, T Ax, T Ayx, T Ayy, T Ay)         \
+    {                                                                   \
+        for (MpInt i = 0; i < n; ++i) {                                 \
+            T xi = x[i];                                                \
+            T yi = y[i];                                                \
+            x[i] = Axx*xi + Axy*yi + Ax;                                \
+            y[i] = Ayx*xi + Ayy*yi + Ay;                                \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void                                                         \
+    PFX##Strided(T* xout, T* yout, MpInt outc,                          \
+                 const T* xin, const T* yin, MpInt inc, MpInt n,        \
+                 T Axx, T Axy, T Ax, T Ayx, T Ayy, T Ay)                \
+    {                                                                   \
+        if (Axy == 0 && Ayx == 0) {                                     \
+            for (MpInt i = 0; i < n; ++i) {                             \
+                T xi = xin[i*inc];                                      \
+                T yi = yin[i*inc];                                      \
+                xout[i*outc] = Axx*xi + Ax;                             \
+                yout[i*outc] = Ayy*yi + Ay;                             \
+            }                                                           \
+        } else {                                                        \
+            for (MpInt i = 0; i < n; ++i) {                             \
+                T xi = xin[i*inc];                                      \
+                T yi = yin[i*inc];                                      \
+                xout[i*outc] = Axx*xi + Axy*yi + Ax;                    \
+                yout[i*outc] = Ayx*xi + Ayy*yi + Ay;                    \
+            }                                                           \
+        }                                                               \
+    }
+
+ENCODE(applyFlt, float)
+ENCODE(applyDbl, double)
+
+#undef ENCODE
+
+/* Check arguments common to all the array versions. */
+#define CHECK_ARGUMENTS(A, xout, yout, xin, yin, n)     \
+    do {                                                \
+        if (A == NULL) {                                \
+            return MP_BAD_ADDRESS;                      \
+        }                                               \
+        if (n <= 0) {                                   \
+            return (n == 0 ? MP_OK : MP_BAD_SIZE);      \
+        }                                               \
+        if (xout == NULL || yout == NULL ||             \
+            xin == NULL || yin == NULL) {               \
+            return MP_BAD_ADDRESS;                      \
+        }                                               \
+    } while (0)
+
+#define ENCODE(T, SFX)                                                  \
+                                                                        \
+    MpStatus                                                            \
+    MpApplyAffineTransformInPlace##SFX(const MpAffineTransform##SFX* A, \
+                                       T* x, T* y, MpInt n)             \
+    {                                                                   \
+        CHECK_ARGUMENTS(A, x, y, x, y, n);                              \
+        switch (MP_XFORM_CLASSIFY(MP_GET_FIELD_PTR, A)) {               \
+        case MP_IDENTITY_TRANSFORM:                                     \
+            break;                                                      \
+        case MP_TRANSLATION_TRANSFORM:                                  \
+            apply##SFX##TranslationInPlace(x, y, n, A->x, A->y);        \
+            break;                                                      \
+        case MP_DIAGONAL_TRANSFORM:                                     \
+            apply##SFX##DiagonalInPlace(x, y, n,                        \
+                                        A->xx, A->x, A->yy, A->y);      \
+            break;                                                      \
+        default:                                                        \
+            apply##SFX##GeneralInPlace(x, y, n,                         \
+                                       A->xx, A->xy, A->x,              \
+                                       A->yx, A->yy, A->y);             \
+        }                                                               \
+        return MP_OK;                                                   \
+    }                                                                   \
+                                                                        \
+    MpStatus                                                            \
+    MpApplyAffineTransform##SFX(const MpAffineTransform##SFX* A,        \
+                                T* xout, T* yout,                       \
+                                const T* xin, const T* yin, MpInt n)    \
+    {                                                                   \
+        if (xout == xin && yout == yin) {                               \
+            return MpApplyAffineTransformInPlace##SFX(A, xout, yout, n); \
+        }                                                               \
+        CHECK_ARGUMENTS(A, xout, yout, xin, yin, n);                    \
+        switch (MP_XFORM_CLASSIFY(MP_GET_FIELD_PTR, A)) {               \
+        case MP_IDENTITY_TRANSFORM:                                     \
+            memcpy(xout, xin, n*sizeof(T));                             \
+            memcpy(yout, yin, n*sizeof(T));                             \
+            break;                                                      \
+        case MP_TRANSLATION_TRANSFORM:                                  \
+            apply##SFX##Translation(xout, yout, xin, yin, n,            \
+                                    A->x, A->y);                        \
+            break;                                                      \
+        case MP_DIAGONAL_TRANSFORM:                                     \
+            apply##SFX##Diagonal(xout, yout, xin, yin, n,               \
+                                 A->xx, A->x, A->yy, A->y);             \
+            break;                                                      \
+        default:                                                        \
+            apply##SFX##General(xout, yout, xin, yin, n,                \
+                                A->xx, A->xy, A->x,                     \
+                                A->yx, A->yy, A->y);                    \
+        }                                                               \
+        return MP_OK;                                                   \
+    }                                                                   \
+                                                                        \
+    MpStatus                                                            \
+    MpApplyAffineTransformStrided##SFX(const MpAffineTransform##SFX* A, \
+                                       T* xout, T* yout, MpInt outc,    \
+                                       const T* xin, const T* yin,      \
+                                       MpInt inc, MpInt n)              \
+    {                                                                   \
+        if (outc == 1 && inc == 1) {                                    \
+            return MpApplyAffineTransform##SFX(A, xout, yout,           \
+                                               xin, yin, n);            \
+        }                                                               \
+        CHECK_ARGUMENTS(A, xout, yout, xin, yin, n);                    \
+        apply##SFX##Strided(xout, yout, outc, xin, yin, inc, n,         \
+                            A->xx, A->xy, A->x, A->yx, A->yy, A->y);    \
+        return MP_OK;                                                   \
+    }
+
+ENCODE(float,  Flt)
+ENCODE(double, Dbl)
+
+#undef ENCODE
+
+MpStatus
+MpApplyAffineTransformDblToFlt(const MpAffineTransformDbl* A,
+                               float* xout, float* yout,
+                               const double* xin, const double* yin, MpInt n)
+{
+    CHECK_ARGUMENTS(A, xout, yout, xin, yin, n);
+    switch (MP_XFORM_CLASSIFY(MP_GET_FIELD_PTR, A)) {
+    case MP_IDENTITY_TRANSFORM:
+    case MP_TRANSLATION_TRANSFORM:
+        applyDblToFltTranslation(xout, yout, xin, yin, n, A->x, A->y);
+        break;
+    case MP_DIAGONAL_TRANSFORM:
+        applyDblToFltDiagonal(xout, yout, xin, yin, n,
+                              A->xx, A->x, A->yy, A->y);
+        break;
+    default:
+        applyDblToFltGeneral(xout, yout, xin, yin, n,
+                             A->xx, A->xy, A->x, A->yx, A->yy, A->y);
+    }
+    return MP_OK;
+}
+
+#undef CHECK_ARGUMENTS
@@ -0,0 +1,204 @@
+/*
+ * stroking.c --
+ *
+ * Implementation of a software line stroker for wide and dashed lines in
+ * integer device coordinates.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <math.h>
+#include "muPlotPriv.h"
+
+/* Number of fractional bits of the lengths along the segments. */
+#define FRACTION_BITS 8
+
+/*
+ * Dash patterns of the line styles: lengths of alternate dashes and gaps in
+ * units of the line width.  For wide lines, the square caps of the dashes
+ * overlap the gaps by the line width.
+ */
+static const struct {
+    MpInt count;
+    unsigned char lengths[MP_MAX_DASHES];
+} patterns[] = {
+    [MP_SOLID_LINE]              = {0, {0}},
+    [MP_DASHED_LINE]             = {2, {8, 5}},
+    [MP_DOTTED_LINE]             = {2, {1, 3}},
+    [MP_DASH_DOTTED_LINE]        = {4, {8, 4, 1, 4}},
+    [MP_DASH_DOUBLE_DOTTED_LINE] = {6, {8, 4, 1, 4, 1, 4}},
+    [MP_DASH_TRIPLE_DOTTED_LINE] = {8, {8, 4, 1, 4, 1, 4, 1, 4}},
+};
+
+MpStatus
+MpSetStrokerStyle(MpStroker* s, MpLineStyle ls, MpReal lw)
+{
+    if (s == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (ls < 0 || ls > MP_DASH_TRIPLE_DOTTED_LINE) {
+        return MP_OUT_OF_RANGE;
+    }
+    if (MP_IS_NAN(lw) || lw < 0) {
+        return MP_BAD_SETTINGS;
+    }
+    MpInt thickness = (lw > 1 ? (MpInt)(lw + 0.5) : 1);
+    if (ls != s->style || thickness != s->thickness || s->thickness < 1) {
+        s->style = ls;
+        s->thickness = thickness;
+        s->count = patterns[ls].count;
+        for (MpInt k = 0; k < s->count; ++k) {
+            s->dashes[k] = ((int64_t)patterns[ls].lengths[k]*thickness)
+                << FRACTION_BITS;
+        }
+    }
+    MpResetStroker(s);
+    return MP_OK;
+}
+
+void
+MpResetStroker(MpStroker* s)
+{
+    s->index = 0;
+    s->remaining = (s->count > 0 ? s->dashes[0] : 0);
+    s->moved = false;
+}
+
+void
+MpBeginStroke(MpStroker* s, MpPoint x0, MpPoint y0)
+{
+    if (! s->moved || x0 != s->xlast || y0 != s->ylast) {
+        s->index = 0;
+        s->remaining = (s->count > 0 ? s->dashes[0] : 0);
+    }
+}
+
+/* Integer division rounded to the nearest integer, `den` must be positive. */
+static inline MpInt
+roundedDivide(int64_t num, int64_t den)
+{
+    return (MpInt)(num >= 0 ?  (2*num + den)/(2*den) :
+                   -((den - 2*num)/(2*den)));
+}
+
+/* Fill a square of `t` samples centered at `(x,y)`. */
+static inline void
+fillSquare(MpStrokeFiller* fill, void* ctx, MpInt t, MpInt x, MpInt y)
+{
+    MpInt lo = (t - 1)/2, hi = t/2;
+    fill(ctx, x - lo, y - lo, x + hi, y + hi);
+}
+
+/*
+ * Stroke the segment from `(xa,ya)` to `(xb,yb)` with a thick Bresenham
+ * algorithm.  The samples of the steps along the major axis which have the
+ * same minor coordinate are merged in a single rectangle of `tm` samples
+ * along the minor axis (the line width divided by the cosine of the slope of
+ * the supporting segment).
+ */
+static void
+strokeSegment(MpStrokeFiller* fill, void* ctx, MpInt tm,
+              MpInt xa, MpInt ya, MpInt xb, MpInt yb)
+{
+    MpInt lo = (tm - 1)/2, hi = tm/2;
+    MpInt adx = (xb >= xa ? xb - xa : xa - xb), sx = (xa <= xb ? 1 : -1);
+    MpInt ady = (yb >= ya ? yb - ya : ya - yb), sy = (ya <= yb ? 1 : -1);
+    if (adx >= ady) {
+        MpInt x0 = xa, y = ya, d = 2*ady - adx;
+        for (MpInt x = xa; ; x += sx) {
+            if (x == xb) {
+                fill(ctx, (x0 <= x ? x0 : x), y - lo,
+                     (x0 <= x ? x : x0), y + hi);
+                break;
+            }
+            if (d > 0) {
+                fill(ctx, (x0 <= x ? x0 : x), y - lo,
+                     (x0 <= x ? x : x0), y + hi);
+                x0 = x + sx;
+                y += sy;
+                d -= 2*adx;
+            }
+            d += 2*ady;
+        }
+    } else {
+        MpInt y0 = ya, x = xa, d = 2*adx - ady;
+        for (MpInt y = ya; ; y += sy) {
+            if (y == yb) {
+                fill(ctx, x - lo, (y0 <= y ? y0 : y),
+                     x + hi, (y0 <= y ? y : y0));
+                break;
+            }
+            if (d > 0) {
+                fill(ctx, x - lo, (y0 <= y ? y0 : y),
+                     x + hi, (y0 <= y ? y : y0));
+                y0 = y + sy;
+                x += sx;
+                d -= 2*ady;
+            }
+            d += 2*adx;
+        }
+    }
+}
+
+void
+MpStrokePolyline(MpStroker* s, const MpPoint* x, const MpPoint* y, MpInt n,
+                 MpStrokeFiller* fill, void* ctx)
+{
+    if (n < 1) {
+        return;
+    }
+    const MpInt t = s->thickness;
+    for (MpInt i = 1; i < n; ++i) {
+        MpInt xa = x[i-1], ya = y[i-1], xb = x[i], yb = y[i];
+        MpInt dx = xb - xa, dy = yb - ya;
+        if (dx == 0 && dy == 0) {
+            continue;
+        }
+        double len = sqrt((double)dx*(double)dx + (double)dy*(double)dy);
+        MpInt adx = (dx >= 0 ? dx : -dx), ady = (dy >= 0 ? dy : -dy);
+        MpInt tm = (t > 1 ? (MpInt)(t*len/(adx >= ady ? adx : ady) + 0.5)
+                    : 1);
+        if (s->count == 0) {
+            /* Solid line. */
+            if (fill != NULL) {
+                strokeSegment(fill, ctx, tm, xa, ya, xb, yb);
+                if (t > 1) {
+                    fillSquare(fill, ctx, t, xa, ya);
+                    fillSquare(fill, ctx, t, xb, yb);
+                }
+            }
+            continue;
+        }
+
+        /* Split the segment in dashes and gaps. */
+        int64_t L = (int64_t)(len*(1 << FRACTION_BITS) + 0.5);
+        for (int64_t pos = 0; pos < L; ) {
+            int64_t step = (s->remaining < L - pos ? s->remaining : L - pos);
+            if ((s->index & 1) == 0 && fill != NULL) {
+                MpInt x0 = xa + roundedDivide(dx*pos, L);
+                MpInt y0 = ya + roundedDivide(dy*pos, L);
+                MpInt x1 = xa + roundedDivide(dx*(pos + step), L);
+                MpInt y1 = ya + roundedDivide(dy*(pos + step), L);
+                strokeSegment(fill, ctx, tm, x0, y0, x1, y1);
+                if (t > 1) {
+                    fillSquare(fill, ctx, t, x0, y0);
+                    fillSquare(fill, ctx, t, x1, y1);
+                }
+            }
+            pos += step;
+            s->remaining -= step;
+            if (s->remaining <= 0) {
+                s->index = (s->index + 1 < s->count ? s->index + 1 : 0);
+                s->remaining = s->dashes[s->index];
+            }
+        }
+    }
+    s->moved = true;
+    s->xlast = x[n-1];
+    s->ylast = y[n-1];
+}
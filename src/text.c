@@ -0,0 +1,823 @@
+/*
+ * text.c --
+ *
+ * Implementation of text drawing with the Hershey simplex Roman font.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "muPlotPriv.h"
+
+/*
+ * The glyphs are stored as static tables so that there is no file to parse
+ * and nothing to initialize at run-time.  The coordinates of the vertices of
+ * the strokes of a glyph are stored as successive pairs of values in
+ * `glyphData`, strokes are separated by `PEN_UP`.  Coordinates are in font
+ * units: the baseline is at 0, capital letters are `CAP_HEIGHT` units high
+ * and the glyphs of the printable ASCII characters span abscissae from 0 to
+ * their advance width.  Accents have a null advance width and are centered at
+ * 0 over lowercase letters, they are raised by `ACCENT_RAISE` units over
+ * capital letters.
+ */
+#define PEN_UP       (-128)
+#define CAP_HEIGHT     21
+#define ACCENT_RAISE    7
+
+/* Number of laid out strings cached per device (a power of 2). */
+#define TEXT_CACHE_SIZE 256
+
+/* Index of the glyph of a printable ASCII character and of the other
+   glyphs. */
+#define GLYPH(c) ((c) - ' ')
+enum {
+    GLYPH_DOTLESS_I = GLYPH('~') + 1,
+    GLYPH_DEGREE,
+    GLYPH_PLUS_MINUS,
+    GLYPH_MULTIPLY,
+    GLYPH_MICRO,
+    ACCENT_ACUTE,
+    ACCENT_GRAVE,
+    ACCENT_CIRCUMFLEX,
+    ACCENT_DIAERESIS,
+    ACCENT_TILDE,
+    ACCENT_RING,
+    ACCENT_CEDILLA,
+};
+
+static const signed char glyphData[] = {
+    /* ' ' */
+    /* '!' */ 5, 21, 5, 7, PEN_UP, 5, 2, 4, 1, 5, 0, 6, 1, 5, 2,
+    /* '"' */ 4, 21, 4, 14, PEN_UP, 12, 21, 12, 14,
+    /* '#' */ 11, 25, 4, -7, PEN_UP, 17, 25, 10, -7, PEN_UP, 4, 12, 18, 12,
+        PEN_UP, 3, 6, 17, 6,
+    /* '$' */ 8, 25, 8, -4, PEN_UP, 12, 25, 12, -4, PEN_UP, 17, 18, 15, 20,
+        12, 21, 8, 21, 5, 20, 3, 18, 3, 16, 4, 14, 5, 13, 7, 12, 13, 10, 15,
+        9, 16, 8, 17, 6, 17, 3, 15, 1, 12, 0, 8, 0, 5, 1, 3, 3,
+    /* '%' */ 21, 21, 3, 0, PEN_UP, 8, 21, 10, 19, 10, 17, 9, 15, 7, 14, 5,
+        14, 3, 16, 3, 18, 4, 20, 6, 21, 8, 21, 10, 20, 13, 19, 16, 19, 19, 20,
+        21, 21, PEN_UP, 17, 7, 15, 6, 14, 4, 14, 2, 16, 0, 18, 0, 20, 1, 21,
+        3, 21, 5, 19, 7, 17, 7,
+    /* '&' */ 23, 12, 23, 13, 22, 14, 21, 14, 20, 13, 19, 11, 17, 6, 15, 3,
+        13, 1, 11, 0, 7, 0, 5, 1, 4, 2, 3, 4, 3, 6, 4, 8, 5, 9, 12, 13, 13,
+        14, 14, 16, 14, 18, 13, 20, 11, 21, 9, 20, 8, 18, 8, 16, 9, 13, 11,
+        10, 16, 3, 18, 1, 20, 0, 22, 0, 23, 1, 23, 2,
+    /* '\'' */ 5, 19, 4, 20, 5, 21, 6, 20, 6, 18, 5, 16, 4, 15,
+    /* '(' */ 11, 25, 9, 23, 7, 20, 5, 16, 4, 11, 4, 7, 5, 2, 7, -2, 9, -5,
+        11, -7,
+    /* ')' */ 3, 25, 5, 23, 7, 20, 9, 16, 10, 11, 10, 7, 9, 2, 7, -2, 5, -5,
+        3, -7,
+    /* '*' */ 8, 21, 8, 9, PEN_UP, 3, 18, 13, 12, PEN_UP, 13, 18, 3, 12,
+    /* '+' */ 13, 18, 13, 0, PEN_UP, 4, 9, 22, 9,
+    /* ',' */ 6, 1, 5, 0, 4, 1, 5, 2, 6, 1, 6, -1, 5, -3, 4, -4,
+    /* '-' */ 4, 9, 22, 9,
+    /* '.' */ 5, 2, 4, 1, 5, 0, 6, 1, 5, 2,
+    /* '/' */ 20, 25, 2, -7,
+    /* '0' */ 9, 21, 6, 20, 4, 17, 3, 12, 3, 9, 4, 4, 6, 1, 9, 0, 11, 0, 14,
+        1, 16, 4, 17, 9, 17, 12, 16, 17, 14, 20, 11, 21, 9, 21,
+    /* '1' */ 6, 17, 8, 18, 11, 21, 11, 0,
+    /* '2' */ 4, 16, 4, 17, 5, 19, 6, 20, 8, 21, 12, 21, 14, 20, 15, 19, 16,
+        17, 16, 15, 15, 13, 13, 10, 3, 0, 17, 0,
+    /* '3' */ 5, 21, 16, 21, 10, 13, 13, 13, 15, 12, 16, 11, 17, 8, 17, 6, 16,
+        3, 14, 1, 11, 0, 8, 0, 5, 1, 4, 2, 3, 4,
+    /* '4' */ 13, 21, 3, 7, 18, 7, PEN_UP, 13, 21, 13, 0,
+    /* '5' */ 15, 21, 5, 21, 4, 12, 5, 13, 8, 14, 11, 14, 14, 13, 16, 11, 17,
+        8, 17, 6, 16, 3, 14, 1, 11, 0, 8, 0, 5, 1, 4, 2, 3, 4,
+    /* '6' */ 16, 18, 15, 20, 12, 21, 10, 21, 7, 20, 5, 17, 4, 12, 4, 7, 5, 3,
+        7, 1, 10, 0, 11, 0, 14, 1, 16, 3, 17, 6, 17, 7, 16, 10, 14, 12, 11,
+        13, 10, 13, 7, 12, 5, 10, 4, 7,
+    /* '7' */ 17, 21, 7, 0, PEN_UP, 3, 21, 17, 21,
+    /* '8' */ 8, 21, 5, 20, 4, 18, 4, 16, 5, 14, 7, 13, 11, 12, 14, 11, 16, 9,
+        17, 7, 17, 4, 16, 2, 15, 1, 12, 0, 8, 0, 5, 1, 4, 2, 3, 4, 3, 7, 4, 9,
+        6, 11, 9, 12, 13, 13, 15, 14, 16, 16, 16, 18, 15, 20, 12, 21, 8, 21,
+    /* '9' */ 16, 14, 15, 11, 13, 9, 10, 8, 9, 8, 6, 9, 4, 11, 3, 14, 3, 15,
+        4, 18, 6, 20, 9, 21, 10, 21, 13, 20, 15, 18, 16, 14, 16, 9, 15, 4, 13,
+        1, 10, 0, 8, 0, 5, 1, 4, 3,
+    /* ':' */ 5, 14, 4, 13, 5, 12, 6, 13, 5, 14, PEN_UP, 5, 2, 4, 1, 5, 0, 6,
+        1, 5, 2,
+    /* ';' */ 5, 14, 4, 13, 5, 12, 6, 13, 5, 14, PEN_UP, 6, 1, 5, 0, 4, 1, 5,
+        2, 6, 1, 6, -1, 5, -3, 4, -4,
+    /* '<' */ 20, 18, 4, 9, 20, 0,
+    /* '=' */ 4, 12, 22, 12, PEN_UP, 4, 6, 22, 6,
+    /* '>' */ 4, 18, 20, 9, 4, 0,
+    /* '?' */ 3, 16, 3, 17, 4, 19, 5, 20, 7, 21, 11, 21, 13, 20, 14, 19, 15,
+        17, 15, 15, 14, 13, 13, 12, 9, 10, 9, 7, PEN_UP, 9, 2, 8, 1, 9, 0, 10,
+        1, 9, 2,
+    /* '@' */ 18, 13, 17, 15, 15, 16, 12, 16, 10, 15, 9, 14, 8, 11, 8, 8, 9,
+        6, 11, 5, 14, 5, 16, 6, 17, 8, PEN_UP, 12, 16, 10, 14, 9, 11, 9, 8,
+        10, 6, 11, 5, PEN_UP, 18, 16, 17, 8, 17, 6, 19, 5, 21, 5, 23, 7, 24,
+        10, 24, 12, 23, 15, 22, 17, 20, 19, 18, 20, 15, 21, 12, 21, 9, 20, 7,
+        19, 5, 17, 4, 15, 3, 12, 3, 9, 4, 6, 5, 4, 7, 2, 9, 1, 12, 0, 15, 0,
+        18, 1, 20, 2, 21, 3, PEN_UP, 19, 16, 18, 8, 18, 6, 19, 5,
+    /* 'A' */ 9, 21, 1, 0, PEN_UP, 9, 21, 17, 0, PEN_UP, 4, 7, 14, 7,
+    /* 'B' */ 4, 21, 4, 0, PEN_UP, 4, 21, 13, 21, 16, 20, 17, 19, 18, 17, 18,
+        15, 17, 13, 16, 12, 13, 11, PEN_UP, 4, 11, 13, 11, 16, 10, 17, 9, 18,
+        7, 18, 4, 17, 2, 16, 1, 13, 0, 4, 0,
+    /* 'C' */ 18, 16, 17, 18, 15, 20, 13, 21, 9, 21, 7, 20, 5, 18, 4, 16, 3,
+        13, 3, 8, 4, 5, 5, 3, 7, 1, 9, 0, 13, 0, 15, 1, 17, 3, 18, 5,
+    /* 'D' */ 4, 21, 4, 0, PEN_UP, 4, 21, 11, 21, 14, 20, 16, 18, 17, 16, 18,
+        13, 18, 8, 17, 5, 16, 3, 14, 1, 11, 0, 4, 0,
+    /* 'E' */ 4, 21, 4, 0, PEN_UP, 4, 21, 17, 21, PEN_UP, 4, 11, 12, 11,
+        PEN_UP, 4, 0, 17, 0,
+    /* 'F' */ 4, 21, 4, 0, PEN_UP, 4, 21, 17, 21, PEN_UP, 4, 11, 12, 11,
+    /* 'G' */ 18, 16, 17, 18, 15, 20, 13, 21, 9, 21, 7, 20, 5, 18, 4, 16, 3,
+        13, 3, 8, 4, 5, 5, 3, 7, 1, 9, 0, 13, 0, 15, 1, 17, 3, 18, 5, 18, 8,
+        PEN_UP, 13, 8, 18, 8,
+    /* 'H' */ 4, 21, 4, 0, PEN_UP, 18, 21, 18, 0, PEN_UP, 4, 11, 18, 11,
+    /* 'I' */ 4, 21, 4, 0,
+    /* 'J' */ 12, 21, 12, 5, 11, 2, 10, 1, 8, 0, 6, 0, 4, 1, 3, 2, 2, 5, 2, 7,
+    /* 'K' */ 4, 21, 4, 0, PEN_UP, 18, 21, 4, 7, PEN_UP, 9, 12, 18, 0,
+    /* 'L' */ 4, 21, 4, 0, PEN_UP, 4, 0, 16, 0,
+    /* 'M' */ 4, 21, 4, 0, PEN_UP, 4, 21, 12, 0, PEN_UP, 20, 21, 12, 0,
+        PEN_UP, 20, 21, 20, 0,
+    /* 'N' */ 4, 21, 4, 0, PEN_UP, 4, 21, 18, 0, PEN_UP, 18, 21, 18, 0,
+    /* 'O' */ 9, 21, 7, 20, 5, 18, 4, 16, 3, 13, 3, 8, 4, 5, 5, 3, 7, 1, 9, 0,
+        13, 0, 15, 1, 17, 3, 18, 5, 19, 8, 19, 13, 18, 16, 17, 18, 15, 20, 13,
+        21, 9, 21,
+    /* 'P' */ 4, 21, 4, 0, PEN_UP, 4, 21, 13, 21, 16, 20, 17, 19, 18, 17, 18,
+        14, 17, 12, 16, 11, 13, 10, 4, 10,
+    /* 'Q' */ 9, 21, 7, 20, 5, 18, 4, 16, 3, 13, 3, 8, 4, 5, 5, 3, 7, 1, 9, 0,
+        13, 0, 15, 1, 17, 3, 18, 5, 19, 8, 19, 13, 18, 16, 17, 18, 15, 20, 13,
+        21, 9, 21, PEN_UP, 12, 4, 18, -2,
+    /* 'R' */ 4, 21, 4, 0, PEN_UP, 4, 21, 13, 21, 16, 20, 17, 19, 18, 17, 18,
+        15, 17, 13, 16, 12, 13, 11, 4, 11, PEN_UP, 11, 11, 18, 0,
+    /* 'S' */ 17, 18, 15, 20, 12, 21, 8, 21, 5, 20, 3, 18, 3, 16, 4, 14, 5,
+        13, 7, 12, 13, 10, 15, 9, 16, 8, 17, 6, 17, 3, 15, 1, 12, 0, 8, 0, 5,
+        1, 3, 3,
+    /* 'T' */ 8, 21, 8, 0, PEN_UP, 1, 21, 15, 21,
+    /* 'U' */ 4, 21, 4, 6, 5, 3, 7, 1, 10, 0, 12, 0, 15, 1, 17, 3, 18, 6, 18,
+        21,
+    /* 'V' */ 1, 21, 9, 0, PEN_UP, 17, 21, 9, 0,
+    /* 'W' */ 2, 21, 7, 0, PEN_UP, 12, 21, 7, 0, PEN_UP, 12, 21, 17, 0,
+        PEN_UP, 22, 21, 17, 0,
+    /* 'X' */ 3, 21, 17, 0, PEN_UP, 17, 21, 3, 0,
+    /* 'Y' */ 1, 21, 9, 11, 9, 0, PEN_UP, 17, 21, 9, 11,
+    /* 'Z' */ 17, 21, 3, 0, PEN_UP, 3, 21, 17, 21, PEN_UP, 3, 0, 17, 0,
+    /* '[' */ 4, 25, 4, -7, PEN_UP, 5, 25, 5, -7, PEN_UP, 4, 25, 11, 25,
+        PEN_UP, 4, -7, 11, -7,
+    /* '\\' */ 0, 21, 14, -3,
+    /* ']' */ 9, 25, 9, -7, PEN_UP, 10, 25, 10, -7, PEN_UP, 3, 25, 10, 25,
+        PEN_UP, 3, -7, 10, -7,
+    /* '^' */ 6, 15, 8, 18, 10, 15, PEN_UP, 3, 12, 8, 17, 13, 12, PEN_UP, 8,
+        17, 8, 0,
+    /* '_' */ 0, -2, 16, -2,
+    /* '`' */ 6, 21, 5, 20, 4, 18, 4, 16, 5, 15, 6, 16, 5, 17,
+    /* 'a' */ 15, 14, 15, 0, PEN_UP, 15, 11, 13, 13, 11, 14, 8, 14, 6, 13, 4,
+        11, 3, 8, 3, 6, 4, 3, 6, 1, 8, 0, 11, 0, 13, 1, 15, 3,
+    /* 'b' */ 4, 21, 4, 0, PEN_UP, 4, 11, 6, 13, 8, 14, 11, 14, 13, 13, 15,
+        11, 16, 8, 16, 6, 15, 3, 13, 1, 11, 0, 8, 0, 6, 1, 4, 3,
+    /* 'c' */ 15, 11, 13, 13, 11, 14, 8, 14, 6, 13, 4, 11, 3, 8, 3, 6, 4, 3,
+        6, 1, 8, 0, 11, 0, 13, 1, 15, 3,
+    /* 'd' */ 15, 21, 15, 0, PEN_UP, 15, 11, 13, 13, 11, 14, 8, 14, 6, 13, 4,
+        11, 3, 8, 3, 6, 4, 3, 6, 1, 8, 0, 11, 0, 13, 1, 15, 3,
+    /* 'e' */ 3, 8, 15, 8, 15, 10, 14, 12, 13, 13, 11, 14, 8, 14, 6, 13, 4,
+        11, 3, 8, 3, 6, 4, 3, 6, 1, 8, 0, 11, 0, 13, 1, 15, 3,
+    /* 'f' */ 10, 21, 8, 21, 6, 20, 5, 17, 5, 0, PEN_UP, 2, 14, 9, 14,
+    /* 'g' */ 15, 14, 15, -2, 14, -5, 13, -6, 11, -7, 8, -7, 6, -6, PEN_UP,
+        15, 11, 13, 13, 11, 14, 8, 14, 6, 13, 4, 11, 3, 8, 3, 6, 4, 3, 6, 1,
+        8, 0, 11, 0, 13, 1, 15, 3,
+    /* 'h' */ 4, 21, 4, 0, PEN_UP, 4, 10, 7, 13, 9, 14, 12, 14, 14, 13, 15,
+        10, 15, 0,
+    /* 'i' */ 3, 21, 4, 20, 5, 21, 4, 22, 3, 21, PEN_UP, 4, 14, 4, 0,
+    /* 'j' */ 5, 21, 6, 20, 7, 21, 6, 22, 5, 21, PEN_UP, 6, 14, 6, -3, 5, -6,
+        3, -7, 1, -7,
+    /* 'k' */ 4, 21, 4, 0, PEN_UP, 14, 14, 4, 4, PEN_UP, 8, 8, 15, 0,
+    /* 'l' */ 4, 21, 4, 0,
+    /* 'm' */ 4, 14, 4, 0, PEN_UP, 4, 10, 7, 13, 9, 14, 12, 14, 14, 13, 15,
+        10, 15, 0, PEN_UP, 15, 10, 18, 13, 20, 14, 23, 14, 25, 13, 26, 10, 26,
+        0,
+    /* 'n' */ 4, 14, 4, 0, PEN_UP, 4, 10, 7, 13, 9, 14, 12, 14, 14, 13, 15,
+        10, 15, 0,
+    /* 'o' */ 8, 14, 6, 13, 4, 11, 3, 8, 3, 6, 4, 3, 6, 1, 8, 0, 11, 0, 13, 1,
+        15, 3, 16, 6, 16, 8, 15, 11, 13, 13, 11, 14, 8, 14,
+    /* 'p' */ 4, 14, 4, -7, PEN_UP, 4, 11, 6, 13, 8, 14, 11, 14, 13, 13, 15,
+        11, 16, 8, 16, 6, 15, 3, 13, 1, 11, 0, 8, 0, 6, 1, 4, 3,
+    /* 'q' */ 15, 14, 15, -7, PEN_UP, 15, 11, 13, 13, 11, 14, 8, 14, 6, 13, 4,
+        11, 3, 8, 3, 6, 4, 3, 6, 1, 8, 0, 11, 0, 13, 1, 15, 3,
+    /* 'r' */ 4, 14, 4, 0, PEN_UP, 4, 8, 5, 11, 7, 13, 9, 14, 12, 14,
+    /* 's' */ 14, 11, 13, 13, 10, 14, 7, 14, 4, 13, 3, 11, 4, 9, 6, 8, 11, 7,
+        13, 6, 14, 4, 14, 3, 13, 1, 10, 0, 7, 0, 4, 1, 3, 3,
+    /* 't' */ 5, 21, 5, 4, 6, 1, 8, 0, 10, 0, PEN_UP, 2, 14, 9, 14,
+    /* 'u' */ 4, 14, 4, 4, 5, 1, 7, 0, 10, 0, 12, 1, 15, 4, PEN_UP, 15, 14,
+        15, 0,
+    /* 'v' */ 2, 14, 8, 0, PEN_UP, 14, 14, 8, 0,
+    /* 'w' */ 3, 14, 7, 0, PEN_UP, 11, 14, 7, 0, PEN_UP, 11, 14, 15, 0,
+        PEN_UP, 19, 14, 15, 0,
+    /* 'x' */ 3, 14, 14, 0, PEN_UP, 14, 14, 3, 0,
+    /* 'y' */ 2, 14, 8, 0, PEN_UP, 14, 14, 8, 0, 6, -4, 4, -6, 2, -7, 1, -7,
+    /* 'z' */ 14, 14, 3, 0, PEN_UP, 3, 14, 14, 14, PEN_UP, 3, 0, 14, 0,
+    /* '{' */ 9, 25, 7, 24, 6, 23, 5, 21, 5, 19, 6, 17, 7, 16, 8, 14, 8, 12,
+        6, 10, PEN_UP, 7, 24, 6, 22, 6, 20, 7, 18, 8, 17, 9, 15, 9, 13, 8, 11,
+        4, 9, 8, 7, 9, 5, 9, 3, 8, 1, 7, 0, 6, -2, 6, -4, 7, -6, PEN_UP, 6, 8,
+        8, 6, 8, 4, 7, 2, 6, 1, 5, -1, 5, -3, 6, -5, 7, -6, 9, -7,
+    /* '|' */ 4, 25, 4, -7,
+    /* '}' */ 5, 25, 7, 24, 8, 23, 9, 21, 9, 19, 8, 17, 7, 16, 6, 14, 6, 12,
+        8, 10, PEN_UP, 7, 24, 8, 22, 8, 20, 7, 18, 6, 17, 5, 15, 5, 13, 6, 11,
+        10, 9, 6, 7, 5, 5, 5, 3, 6, 1, 7, 0, 8, -2, 8, -4, 7, -6, PEN_UP, 8,
+        8, 6, 6, 6, 4, 7, 2, 8, 1, 9, -1, 9, -3, 8, -5, 7, -6, 5, -7,
+    /* '~' */ 3, 6, 3, 8, 4, 11, 6, 12, 8, 12, 10, 11, 14, 8, 16, 7, 18, 7,
+        20, 8, 21, 10, PEN_UP, 3, 8, 4, 10, 6, 11, 8, 11, 10, 10, 14, 7, 16,
+        6, 18, 6, 20, 7, 21, 10, 21, 12,
+    /* dotless i */ 4, 14, 4, 0,
+    /* degree */ 6, 21, 4, 20, 4, 18, 6, 17, 8, 17, 10, 18, 10, 20, 8, 21, 6,
+        21,
+    /* plus-minus */ 13, 18, 13, 4, PEN_UP, 4, 11, 22, 11, PEN_UP, 4, 1, 22,
+        1,
+    /* multiply */ 6, 16, 20, 2, PEN_UP, 20, 16, 6, 2,
+    /* micro */ 4, 14, 4, -7, PEN_UP, 4, 4, 5, 1, 7, 0, 10, 0, 12, 1, 15, 4,
+        PEN_UP, 15, 14, 15, 0,
+    /* acute */ -1, 16, 2, 19,
+    /* grave */ 1, 16, -2, 19,
+    /* circumflex */ -3, 16, 0, 19, 3, 16,
+    /* diaeresis */ -3, 17, -3, 18, PEN_UP, 3, 17, 3, 18,
+    /* tilde */ -4, 17, -2, 19, 2, 17, 4, 19,
+    /* ring */ -1, 16, -2, 17, -2, 19, -1, 20, 1, 20, 2, 19, 2, 17, 1, 16, -1,
+        16,
+    /* cedilla */ 0, 0, 0, -2, 2, -3, 2, -4, 0, -5,
+};
+
+static const struct {
+    uint16_t offset; /* Index of first value in glyphData */
+    uint8_t    size; /* Number of values */
+    uint8_t advance; /* Advance width */
+} glyphs[] = {
+    {0, 0, 16},       /* ' ' */
+    {0, 15, 10},      /* '!' */
+    {15, 9, 16},      /* '"' */
+    {24, 19, 21},     /* '#' */
+    {43, 50, 20},     /* '$' */
+    {93, 60, 24},     /* '%' */
+    {153, 68, 26},    /* '&' */
+    {221, 14, 10},    /* '\'' */
+    {235, 20, 14},    /* '(' */
+    {255, 20, 14},    /* ')' */
+    {275, 14, 16},    /* '*' */
+    {289, 9, 26},     /* '+' */
+    {298, 16, 10},    /* ',' */
+    {314, 4, 26},     /* '-' */
+    {318, 10, 10},    /* '.' */
+    {328, 4, 22},     /* '/' */
+    {332, 34, 20},    /* '0' */
+    {366, 8, 20},     /* '1' */
+    {374, 28, 20},    /* '2' */
+    {402, 30, 20},    /* '3' */
+    {432, 11, 20},    /* '4' */
+    {443, 34, 20},    /* '5' */
+    {477, 46, 20},    /* '6' */
+    {523, 9, 20},     /* '7' */
+    {532, 58, 20},    /* '8' */
+    {590, 46, 20},    /* '9' */
+    {636, 21, 10},    /* ':' */
+    {657, 27, 10},    /* ';' */
+    {684, 6, 24},     /* '<' */
+    {690, 9, 26},     /* '=' */
+    {699, 6, 24},     /* '>' */
+    {705, 39, 18},    /* '?' */
+    {744, 107, 27},   /* '@' */
+    {851, 14, 18},    /* 'A' */
+    {865, 44, 21},    /* 'B' */
+    {909, 36, 21},    /* 'C' */
+    {945, 29, 21},    /* 'D' */
+    {974, 19, 19},    /* 'E' */
+    {993, 14, 18},    /* 'F' */
+    {1007, 43, 21},   /* 'G' */
+    {1050, 14, 22},   /* 'H' */
+    {1064, 4, 8},     /* 'I' */
+    {1068, 20, 16},   /* 'J' */
+    {1088, 14, 21},   /* 'K' */
+    {1102, 9, 17},    /* 'L' */
+    {1111, 19, 24},   /* 'M' */
+    {1130, 14, 22},   /* 'N' */
+    {1144, 42, 22},   /* 'O' */
+    {1186, 25, 21},   /* 'P' */
+    {1211, 47, 22},   /* 'Q' */
+    {1258, 30, 21},   /* 'R' */
+    {1288, 40, 20},   /* 'S' */
+    {1328, 9, 16},    /* 'T' */
+    {1337, 20, 22},   /* 'U' */
+    {1357, 9, 18},    /* 'V' */
+    {1366, 19, 24},   /* 'W' */
+    {1385, 9, 20},    /* 'X' */
+    {1394, 11, 18},   /* 'Y' */
+    {1405, 14, 20},   /* 'Z' */
+    {1419, 19, 14},   /* '[' */
+    {1438, 4, 14},    /* '\\' */
+    {1442, 19, 14},   /* ']' */
+    {1461, 18, 16},   /* '^' */
+    {1479, 4, 16},    /* '_' */
+    {1483, 14, 10},   /* '`' */
+    {1497, 33, 19},   /* 'a' */
+    {1530, 33, 19},   /* 'b' */
+    {1563, 28, 18},   /* 'c' */
+    {1591, 33, 19},   /* 'd' */
+    {1624, 34, 18},   /* 'e' */
+    {1658, 15, 12},   /* 'f' */
+    {1673, 43, 19},   /* 'g' */
+    {1716, 19, 19},   /* 'h' */
+    {1735, 15, 8},    /* 'i' */
+    {1750, 21, 10},   /* 'j' */
+    {1771, 14, 17},   /* 'k' */
+    {1785, 4, 8},     /* 'l' */
+    {1789, 34, 30},   /* 'm' */
+    {1823, 19, 19},   /* 'n' */
+    {1842, 34, 19},   /* 'o' */
+    {1876, 33, 19},   /* 'p' */
+    {1909, 33, 19},   /* 'q' */
+    {1942, 15, 13},   /* 'r' */
+    {1957, 34, 17},   /* 's' */
+    {1991, 15, 12},   /* 't' */
+    {2006, 19, 19},   /* 'u' */
+    {2025, 9, 16},    /* 'v' */
+    {2034, 19, 22},   /* 'w' */
+    {2053, 9, 17},    /* 'x' */
+    {2062, 17, 16},   /* 'y' */
+    {2079, 14, 17},   /* 'z' */
+    {2093, 76, 14},   /* '{' */
+    {2169, 4, 8},     /* '|' */
+    {2173, 76, 14},   /* '}' */
+    {2249, 45, 24},   /* '~' */
+    {2294, 4, 8},     /* dotless i */
+    {2298, 18, 14},   /* degree */
+    {2316, 14, 26},   /* plus-minus */
+    {2330, 9, 26},    /* multiply */
+    {2339, 22, 19},   /* micro */
+    {2361, 4, 0},     /* acute */
+    {2365, 4, 0},     /* grave */
+    {2369, 6, 0},     /* circumflex */
+    {2375, 9, 0},     /* diaeresis */
+    {2384, 8, 0},     /* tilde */
+    {2392, 18, 0},    /* ring */
+    {2410, 10, 0}     /* cedilla */
+};
+
+/* Glyphs of the Latin-1 characters U+00C0 to U+00FF: base glyph and accent
+   (0 for none). */
+#define NO_GLYPH {GLYPH('?'), 0}
+static const uint8_t latin1Glyphs[64][2] = {
+    {GLYPH('A'), ACCENT_GRAVE},        /* U+00C0 */
+    {GLYPH('A'), ACCENT_ACUTE},        /* U+00C1 */
+    {GLYPH('A'), ACCENT_CIRCUMFLEX},   /* U+00C2 */
+    {GLYPH('A'), ACCENT_TILDE},        /* U+00C3 */
+    {GLYPH('A'), ACCENT_DIAERESIS},    /* U+00C4 */
+    {GLYPH('A'), ACCENT_RING},         /* U+00C5 */
+    NO_GLYPH,                          /* U+00C6 */
+    {GLYPH('C'), ACCENT_CEDILLA},      /* U+00C7 */
+    {GLYPH('E'), ACCENT_GRAVE},        /* U+00C8 */
+    {GLYPH('E'), ACCENT_ACUTE},        /* U+00C9 */
+    {GLYPH('E'), ACCENT_CIRCUMFLEX},   /* U+00CA */
+    {GLYPH('E'), ACCENT_DIAERESIS},    /* U+00CB */
+    {GLYPH('I'), ACCENT_GRAVE},        /* U+00CC */
+    {GLYPH('I'), ACCENT_ACUTE},        /* U+00CD */
+    {GLYPH('I'), ACCENT_CIRCUMFLEX},   /* U+00CE */
+    {GLYPH('I'), ACCENT_DIAERESIS},    /* U+00CF */
+    NO_GLYPH,                          /* U+00D0 */
+    {GLYPH('N'), ACCENT_TILDE},        /* U+00D1 */
+    {GLYPH('O'), ACCENT_GRAVE},        /* U+00D2 */
+    {GLYPH('O'), ACCENT_ACUTE},        /* U+00D3 */
+    {GLYPH('O'), ACCENT_CIRCUMFLEX},   /* U+00D4 */
+    {GLYPH('O'), ACCENT_TILDE},        /* U+00D5 */
+    {GLYPH('O'), ACCENT_DIAERESIS},    /* U+00D6 */
+    {GLYPH_MULTIPLY, 0},               /* U+00D7 */
+    NO_GLYPH,                          /* U+00D8 */
+    {GLYPH('U'), ACCENT_GRAVE},        /* U+00D9 */
+    {GLYPH('U'), ACCENT_ACUTE},        /* U+00DA */
+    {GLYPH('U'), ACCENT_CIRCUMFLEX},   /* U+00DB */
+    {GLYPH('U'), ACCENT_DIAERESIS},    /* U+00DC */
+    {GLYPH('Y'), ACCENT_ACUTE},        /* U+00DD */
+    NO_GLYPH,                          /* U+00DE */
+    NO_GLYPH,                          /* U+00DF */
+    {GLYPH('a'), ACCENT_GRAVE},        /* U+00E0 */
+    {GLYPH('a'), ACCENT_ACUTE},        /* U+00E1 */
+    {GLYPH('a'), ACCENT_CIRCUMFLEX},   /* U+00E2 */
+    {GLYPH('a'), ACCENT_TILDE},        /* U+00E3 */
+    {GLYPH('a'), ACCENT_DIAERESIS},    /* U+00E4 */
+    {GLYPH('a'), ACCENT_RING},         /* U+00E5 */
+    NO_GLYPH,                          /* U+00E6 */
+    {GLYPH('c'), ACCENT_CEDILLA},      /* U+00E7 */
+    {GLYPH('e'), ACCENT_GRAVE},        /* U+00E8 */
+    {GLYPH('e'), ACCENT_ACUTE},        /* U+00E9 */
+    {GLYPH('e'), ACCENT_CIRCUMFLEX},   /* U+00EA */
+    {GLYPH('e'), ACCENT_DIAERESIS},    /* U+00EB */
+    {GLYPH_DOTLESS_I, ACCENT_GRAVE},   /* U+00EC */
+    {GLYPH_DOTLESS_I, ACCENT_ACUTE},   /* U+00ED */
+    {GLYPH_DOTLESS_I, ACCENT_CIRCUMFLEX}, /* U+00EE */
+    {GLYPH_DOTLESS_I, ACCENT_DIAERESIS}, /* U+00EF */
+    NO_GLYPH,                          /* U+00F0 */
+    {GLYPH('n'), ACCENT_TILDE},        /* U+00F1 */
+    {GLYPH('o'), ACCENT_GRAVE},        /* U+00F2 */
+    {GLYPH('o'), ACCENT_ACUTE},        /* U+00F3 */
+    {GLYPH('o'), ACCENT_CIRCUMFLEX},   /* U+00F4 */
+    {GLYPH('o'), ACCENT_TILDE},        /* U+00F5 */
+    {GLYPH('o'), ACCENT_DIAERESIS},    /* U+00F6 */
+    NO_GLYPH,                          /* U+00F7 */
+    NO_GLYPH,                          /* U+00F8 */
+    {GLYPH('u'), ACCENT_GRAVE},        /* U+00F9 */
+    {GLYPH('u'), ACCENT_ACUTE},        /* U+00FA */
+    {GLYPH('u'), ACCENT_CIRCUMFLEX},   /* U+00FB */
+    {GLYPH('u'), ACCENT_DIAERESIS},    /* U+00FC */
+    {GLYPH('y'), ACCENT_ACUTE},        /* U+00FD */
+    NO_GLYPH,                          /* U+00FE */
+    {GLYPH('y'), ACCENT_DIAERESIS},    /* U+00FF */
+};
+#undef NO_GLYPH
+
+/*
+ * A laid out string.  The vertices of the strokes are stored as offsets in
+ * device coordinates relative to the start of the baseline.  The layout
+ * depends on the linear part of the NDC to device transform and on the page
+ * size which are checked when the layout is retrieved from the cache.
+ */
+typedef struct _TextLayout {
+    uint64_t       hash; /* Hash of the string, size and angle */
+    char*          text; /* Copy of the string */
+    double         size; /* Height of capital letters in millimeters */
+    double        angle; /* Angle of the baseline in degrees */
+    double  bxx, bxy, byx, byy; /* Linear part of the NDC to device transform */
+    double  pageWidth, pageHeight; /* Page size */
+    MpInt      nstrokes; /* Number of strokes */
+    MpInt     nvertices; /* Number of vertices */
+    MpInt     maxLength; /* Maximum number of vertices of a stroke */
+    MpInt*      lengths; /* Number of vertices of each stroke */
+    double*           x; /* Abscissae of the vertices */
+    double*           y; /* Ordinates of the vertices */
+    double       ax, ay; /* Offset of the end of the baseline */
+    double   xmin, xmax, ymin, ymax; /* Bounding box of the vertices */
+} TextLayout;
+
+/* Direct-mapped cache of laid out strings. */
+struct _MpTextCache {
+    TextLayout* slots[TEXT_CACHE_SIZE];
+};
+
+/* Decode the next character of a UTF-8 string and move the pointer after it.
+   Invalid sequences yield a question mark. */
+static uint32_t
+decodeUTF8(const unsigned char** ptr)
+{
+    const unsigned char* p = *ptr;
+    uint32_t c = p[0], min;
+    int n;
+    if (c < 0x80) {
+        *ptr = p + 1;
+        return c;
+    } else if ((c & 0xe0) == 0xc0) {
+        n = 1;
+        c &= 0x1f;
+        min = 0x80;
+    } else if ((c & 0xf0) == 0xe0) {
+        n = 2;
+        c &= 0x0f;
+        min = 0x800;
+    } else if ((c & 0xf8) == 0xf0) {
+        n = 3;
+        c &= 0x07;
+        min = 0x10000;
+    } else {
+        *ptr = p + 1;
+        return '?';
+    }
+    for (int k = 1; k <= n; ++k) {
+        if ((p[k] & 0xc0) != 0x80) {
+            /* Truncated sequence (this stops at the final null). */
+            *ptr = p + k;
+            return '?';
+        }
+        c = (c << 6) | (p[k] & 0x3f);
+    }
+    *ptr = p + n + 1;
+    return (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff) ?
+            '?' : c);
+}
+
+/* Get the glyph and the accent (0 if none) of a character. */
+static void
+lookupGlyph(uint32_t c, int* glyph, int* accent)
+{
+    *accent = 0;
+    if (c >= ' ' && c <= '~') {
+        *glyph = GLYPH(c);
+    } else if (c >= 0xc0 && c <= 0xff) {
+        *glyph = latin1Glyphs[c - 0xc0][0];
+        *accent = latin1Glyphs[c - 0xc0][1];
+    } else {
+        switch (c) {
+        case 0xa0: *glyph = GLYPH(' ');        break;
+        case 0xb0: *glyph = GLYPH_DEGREE;      break;
+        case 0xb1: *glyph = GLYPH_PLUS_MINUS;  break;
+        case 0xb5: *glyph = GLYPH_MICRO;       break;
+        default:   *glyph = GLYPH('?');
+        }
+    }
+}
+
+/* Append the strokes of a glyph at offset `(u,v)`.  The vertices and the
+   lengths of the strokes are only stored if `x` is not `NULL`. */
+static void
+appendGlyph(int g, int u, int v, double* x, double* y, MpInt* lengths,
+            MpInt* nstrokes, MpInt* nvertices)
+{
+    const signed char* d = glyphData + glyphs[g].offset;
+    const int n = glyphs[g].size;
+    MpInt ns = *nstrokes, nv = *nvertices, start = -1;
+    for (int k = 0; k <= n; ) {
+        if (k == n || d[k] == PEN_UP) {
+            if (start >= 0) {
+                if (x != NULL) {
+                    lengths[ns] = nv - start;
+                }
+                ++ns;
+                start = -1;
+            }
+            ++k;
+            continue;
+        }
+        if (start < 0) {
+            start = nv;
+        }
+        if (x != NULL) {
+            x[nv] = u + d[k];
+            y[nv] = v + d[k+1];
+        }
+        ++nv;
+        k += 2;
+    }
+    *nstrokes = ns;
+    *nvertices = nv;
+}
+
+/* Lay out the glyphs of a string in font units, return the advance width of
+   the string.  The vertices and the lengths of the strokes are only stored
+   if `x` is not `NULL`, so that a first pass counts them. */
+static MpInt
+layoutGlyphs(const char* text, double* x, double* y, MpInt* lengths,
+             MpInt* nstrokes, MpInt* nvertices)
+{
+    const unsigned char* p = (const unsigned char*)text;
+    MpInt pen = 0;
+    *nstrokes = 0;
+    *nvertices = 0;
+    while (*p != '\0') {
+        int g, a;
+        lookupGlyph(decodeUTF8(&p), &g, &a);
+        appendGlyph(g, pen, 0, x, y, lengths, nstrokes, nvertices);
+        if (a != 0) {
+            int raise = (a != ACCENT_CEDILLA &&
+                         g >= GLYPH('A') && g <= GLYPH('Z') ?
+                         ACCENT_RAISE : 0);
+            appendGlyph(a, pen + glyphs[g].advance/2, raise,
+                        x, y, lengths, nstrokes, nvertices);
+        }
+        pen += glyphs[g].advance;
+    }
+    return pen;
+}
+
+/* Hash a string, a size and an angle with the FNV-1a algorithm. */
+static uint64_t
+hashText(const char* text, double size, double angle)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (const unsigned char* p = (const unsigned char*)text; *p; ++p) {
+        h = (h ^ *p)*1099511628211ULL;
+    }
+    unsigned char buf[2*sizeof(double)];
+    memcpy(buf, &size, sizeof(double));
+    memcpy(buf + sizeof(double), &angle, sizeof(double));
+    for (size_t k = 0; k < sizeof(buf); ++k) {
+        h = (h ^ buf[k])*1099511628211ULL;
+    }
+    return h;
+}
+
+/* Lay out a string for a device. */
+static TextLayout*
+newLayout(const MpDevice* dev, uint64_t hash, const char* text,
+          double size, double angle)
+{
+    MpInt ns, nv;
+    MpInt pen = layoutGlyphs(text, NULL, NULL, NULL, &ns, &nv);
+    size_t len = strlen(text);
+    size_t offset = (sizeof(TextLayout) + 7) & ~(size_t)7;
+    size_t bytes = offset + 2*nv*sizeof(double) + ns*sizeof(MpInt) + len + 1;
+    TextLayout* t = (TextLayout*)malloc(bytes);
+    if (t == NULL) {
+        return NULL;
+    }
+    t->x = (double*)((char*)t + offset);
+    t->y = t->x + nv;
+    t->lengths = (MpInt*)(t->y + nv);
+    t->text = (char*)(t->lengths + ns);
+    memcpy(t->text, text, len + 1);
+    t->hash = hash;
+    t->size = size;
+    t->angle = angle;
+    const MpCoordinateTransform* B = &dev->ndcToDevice;
+    t->bxx = B->xx;
+    t->bxy = B->xy;
+    t->byx = B->yx;
+    t->byy = B->yy;
+    t->pageWidth = dev->pageWidth;
+    t->pageHeight = dev->pageHeight;
+    layoutGlyphs(text, t->x, t->y, t->lengths, &t->nstrokes, &t->nvertices);
+
+    /* Matrix converting font units into device offsets: scaling to
+       millimeters, rotation, conversion to NDC and to device coordinates. */
+    double r = size/CAP_HEIGHT;
+    double c = r*cos(angle*(M_PI/180)), s = r*sin(angle*(M_PI/180));
+    double w = 1/(double)dev->pageWidth, h = 1/(double)dev->pageHeight;
+    double mxx = (B->xx*c*w + B->xy*s*h), mxy = (B->xy*c*h - B->xx*s*w);
+    double myx = (B->yx*c*w + B->yy*s*h), myy = (B->yy*c*h - B->yx*s*w);
+    double xmin = 0, xmax = 0, ymin = 0, ymax = 0;
+    for (MpInt i = 0; i < nv; ++i) {
+        double u = t->x[i], v = t->y[i];
+        double xi = mxx*u + mxy*v, yi = myx*u + myy*v;
+        t->x[i] = xi;
+        t->y[i] = yi;
+        xmin = (xi < xmin ? xi : xmin);
+        xmax = (xi > xmax ? xi : xmax);
+        ymin = (yi < ymin ? yi : ymin);
+        ymax = (yi > ymax ? yi : ymax);
+    }
+    t->xmin = xmin;
+    t->xmax = xmax;
+    t->ymin = ymin;
+    t->ymax = ymax;
+    t->ax = mxx*pen;
+    t->ay = myx*pen;
+    t->maxLength = 0;
+    for (MpInt k = 0; k < ns; ++k) {
+        if (t->lengths[k] > t->maxLength) {
+            t->maxLength = t->lengths[k];
+        }
+    }
+    return t;
+}
+
+/* Retrieve the layout of a string from the cache of the device or lay it out
+   (replacing the cached string with the same slot). */
+static MpStatus
+getLayout(MpDevice* dev, const char* text, double size, double angle,
+          const TextLayout** tptr)
+{
+    if (dev->textCache == NULL) {
+        dev->textCache = (struct _MpTextCache*)calloc(
+            1, sizeof(struct _MpTextCache));
+        if (dev->textCache == NULL) {
+            return MP_NO_MEMORY;
+        }
+    }
+    uint64_t hash = hashText(text, size, angle);
+    TextLayout** slot = &dev->textCache->slots[hash & (TEXT_CACHE_SIZE - 1)];
+    TextLayout* t = *slot;
+    const MpCoordinateTransform* B = &dev->ndcToDevice;
+    if (t != NULL && t->hash == hash && t->size == size &&
+        t->angle == angle && t->bxx == B->xx && t->bxy == B->xy &&
+        t->byx == B->yx && t->byy == B->yy &&
+        t->pageWidth == dev->pageWidth && t->pageHeight == dev->pageHeight &&
+        strcmp(t->text, text) == 0) {
+        *tptr = t;
+        return MP_OK;
+    }
+    TextLayout* u = newLayout(dev, hash, text, size, angle);
+    if (u == NULL) {
+        return MP_NO_MEMORY;
+    }
+    free((void*)t);
+    *slot = u;
+    *tptr = u;
+    return MP_OK;
+}
+
+void
+MpFreeTextCache(MpDevice* dev)
+{
+    if (dev->textCache != NULL) {
+        for (int k = 0; k < TEXT_CACHE_SIZE; ++k) {
+            free((void*)dev->textCache->slots[k]);
+        }
+        free((void*)dev->textCache);
+        dev->textCache = NULL;
+    }
+}
+
+#define ROUND_POINT(u) ((MpPoint)((u) + 0.5))
+
+MpStatus
+MpDrawText(MpDevice* dev, double x, double y, const char* text,
+           double size, double angle, double just)
+{
+    /* Check arguments. */
+    if (dev == NULL || text == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (! MP_IS_FINITE(size) || size <= 0 || ! MP_IS_FINITE(angle) ||
+        ! MP_IS_FINITE(just)) {
+        return MP_BAD_ARGUMENT;
+    }
+
+    /* Device coordinates of the start of the baseline. */
+    if (dev->scaledAxes) {
+        x = MpScaleCoordinate(&dev->xscale, x);
+        y = MpScaleCoordinate(&dev->yscale, y);
+    }
+    const MpCoordinateTransform* C = MpGetDataToDeviceTransform(dev);
+    double u0 = C->xx*x + C->xy*y + C->x;
+    double v0 = C->yx*x + C->yy*y + C->y;
+    if (! MP_IS_FINITE(u0) || ! MP_IS_FINITE(v0)) {
+        return MP_OK;
+    }
+    const TextLayout* t;
+    MpStatus status = getLayout(dev, text, size, angle, &t);
+    if (status != MP_OK || t->nstrokes < 1) {
+        return status;
+    }
+    u0 -= just*t->ax;
+    v0 -= just*t->ay;
+
+    /* Reserve buffers and apply settings. */
+    MpInt len = t->maxLength;
+    status = MpReserveScratch(dev, len);
+    if (status == MP_OK) {
+        status = MpReserveWorkspace(dev, 6*len*sizeof(double));
+    }
+    if (status == MP_OK) {
+        status = MpApplySettings(dev);
+    }
+    if (status != MP_OK) {
+        return status;
+    }
+
+    /* Send the strokes to the driver, clipping them if the string is not
+       entirely inside the device. */
+    const MpBoxDbl box = {0, dev->horizontalSamples - 1,
+                          0, dev->verticalSamples - 1};
+    MpBool inside = (u0 + t->xmin >= box.xmin && u0 + t->xmax <= box.xmax &&
+                     v0 + t->ymin >= box.ymin && v0 + t->ymax <= box.ymax);
+    MpPoint* xs = dev->xscratch;
+    MpPoint* ys = dev->yscratch;
+    double* xd = (double*)dev->workspace;
+    double* yd = xd + len;
+    double* xc = yd + len;
+    double* yc = xc + 2*len;
+    const double* xv = t->x;
+    const double* yv = t->y;
+    for (MpInt k = 0; k < t->nstrokes && status == MP_OK; ++k) {
+        MpInt n = t->lengths[k];
+        if (inside) {
+            for (MpInt i = 0; i < n; ++i) {
+                xs[i] = ROUND_POINT(u0 + xv[i]);
+                ys[i] = ROUND_POINT(v0 + yv[i]);
+            }
+            status = dev->drawPolyline(dev, xs, ys, n);
+        } else {
+            /* Clip the stroke and merge the visible segments which are
+               joined into polylines. */
+            for (MpInt i = 0; i < n; ++i) {
+                xd[i] = u0 + xv[i];
+                yd[i] = v0 + yv[i];
+            }
+            MpInt m = MpClipPolylineDbl(xc, yc, &box, xd, yd, n), j = 0;
+            for (MpInt i = 0; i < m && status == MP_OK; ++i) {
+                if (j > 0 && (xc[2*i] != xc[2*i-1] || yc[2*i] != yc[2*i-1])) {
+                    status = dev->drawPolyline(dev, xs, ys, j);
+                    j = 0;
+                }
+                if (j == 0) {
+                    xs[0] = ROUND_POINT(xc[2*i]);
+                    ys[0] = ROUND_POINT(yc[2*i]);
+                    j = 1;
+                }
+                xs[j] = ROUND_POINT(xc[2*i+1]);
+                ys[j] = ROUND_POINT(yc[2*i+1]);
+                ++j;
+            }
+            if (status == MP_OK && j > 0) {
+                status = dev->drawPolyline(dev, xs, ys, j);
+            }
+        }
+        xv += n;
+        yv += n;
+    }
+    return status;
+}
+
+MpStatus
+MpMeasureText(const char* text, double size, double* width)
+{
+    if (text == NULL || width == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (! MP_IS_FINITE(size) || size <= 0) {
+        return MP_BAD_ARGUMENT;
+    }
+    MpInt ns, nv;
+    *width = layoutGlyphs(text, NULL, NULL, NULL, &ns, &nv)*size/CAP_HEIGHT;
+    return MP_OK;
+}
@@ -0,0 +1,230 @@
+/*
+ * writer.c --
+ *
+ * Implementation of buffered output for the drivers of µPlot.
+ *
+ *------------------------------------------------------------------------------
+ *
+ * This file if part of the µPlot software licensed under the MIT license
+ * (https://github.com/emmt/muPlot.jl).
+ *
+ * Copyright (C) 2020, Éric Thiébaut.
+ */
+
+#include <stdarg.h>
+#include <string.h>
+#include "muPlotPriv.h"
+
+/* Default and minimal sizes of the buffer of a writer. */
+#define DEFAULT_SIZE (1 << 16)
+#define MINIMAL_SIZE 64
+
+MpStatus
+MpInitializeWriter(MpWriter* w, FILE* file, size_t size)
+{
+    if (w == NULL) {
+        return MP_BAD_ADDRESS;
+    }
+    if (size == 0) {
+        size = DEFAULT_SIZE;
+    } else if (size < MINIMAL_SIZE) {
+        size = MINIMAL_SIZE;
+    }
+    w->file = file;
+    w->buffer = (char*)malloc(size);
+    w->size = (w->buffer == NULL ? 0 : size);
+    w->count = 0;
+    w->buffering = false;
+    w->status = (w->buffer == NULL ? MP_NO_MEMORY : MP_OK);
+    w->device = NULL;
+    w->written = 0;
+    return w->status;
+}
+
+MpStatus
+MpFinalizeWriter(MpWriter* w)
+{
+    MpStatus status = MpFlushWriter(w);
+    if (w->buffer != NULL) {
+        free((void*)w->buffer);
+        w->buffer = NULL;
+    }
+    w->size = 0;
+    w->count = 0;
+    return status;
+}
+
+MpStatus
+MpResetWriter(MpWriter* w, FILE* file)
+{
+    MpStatus status = MpFlushWriter(w);
+    w->file = file;
+    w->count = 0;
+    w->written = 0;
+    w->buffering = false;
+    w->status = (w->buffer == NULL ? MP_NO_MEMORY : MP_OK);
+    return status;
+}
+
+/*
+ * Make room for `n` more bytes in the buffer of a writer.  For a file writer,
+ * the pending bytes are written if needed and the result is whether `n` bytes
+ * fit in the buffer.  For a memory writer, the buffer is enlarged if needed.
+ */
+static MpBool
+makeRoom(MpWriter* w, size_t n)
+{
+    if (w->status != MP_OK) {
+        return false;
+    }
+    if (w->count + n <= w->size) {
+        return true;
+    }
+    if (w->file != NULL) {
+        return (MpFlushWriter(w) == MP_OK && n <= w->size);
+    }
+    size_t size = 2*w->size;
+    if (size < w->count + n) {
+        size = w->count + n;
+    }
+    char* buffer = (char*)realloc((void*)w->buffer, size);
+    if (buffer == NULL) {
+        w->status = MP_NO_MEMORY;
+        return false;
+    }
+    w->buffer = buffer;
+    w->size = size;
+    return true;
+}
+
+MpStatus
+MpFlushWriter(MpWriter* w)
+{
+    if (w->file == NULL) {
+        /* Nothing to do for a memory writer. */
+        return w->status;
+    }
+    if (w->status == MP_OK && w->count > 0) {
+        if (fwrite(w->buffer, 1, w->count, w->file) != w->count) {
+            w->status = MpSystemError();
+        }
+        w->written += w->count;
+        if (w->device != NULL) {
+            MP_COUNT(w->device, bytesWritten, w->count);
+        }
+    }
+    w->count = 0;
+    return w->status;
+}
+
+MpStatus
+MpSyncWriter(MpWriter* w)
+{
+    return (w->buffering ? w->status : MpFlushWriter(w));
+}
+
+char*
+MpReserveWriter(MpWriter* w, size_t n)
+{
+    return (makeRoom(w, n) ? w->buffer + w->count : NULL);
+}
+
+MpStatus
+MpWriteBytes(MpWriter* w, const void* ptr, size_t n)
+{
+    const char* src = (const char*)ptr;
+    if (w->file == NULL) {
+        if (makeRoom(w, n)) {
+            memcpy(w->buffer + w->count, src, n);
+            w->count += n;
+        }
+        return w->status;
+    }
+    while (n > 0 && w->status == MP_OK) {
+        if (w->count >= w->size && MpFlushWriter(w) != MP_OK) {
+            break;
+        }
+        size_t m = w->size - w->count;
+        if (m > n) {
+            m = n;
+        }
+        memcpy(w->buffer + w->count, src, m);
+        w->count += m;
+        src += m;
+        n -= m;
+    }
+    return w->status;
+}
+
+MpStatus
+MpWriteString(MpWriter* w, const char* str)
+{
+    return MpWriteBytes(w, str, strlen(str));
+}
+
+char*
+MpFormatInteger(char* dst, long val)
+{
+    /* Write digits in reverse order in a small buffer, then copy them. */
+    char buf[20];
+    unsigned long u = (val < 0 ? -(unsigned long)val : (unsigned long)val);
+    int n = 0;
+    do {
+        buf[n++] = (char)('0' + u%10);
+        u /= 10;
+    } while (u != 0);
+    if (val < 0) {
+        *dst++ = '-';
+    }
+    while (n > 0) {
+        *dst++ = buf[--n];
+    }
+    return dst;
+}
+
+MpStatus
+MpWriteInteger(MpWriter* w, long val)
+{
+    char* p = MpReserveWriter(w, 21);
+    if (p != NULL) {
+        w->count = MpFormatInteger(p, val) - w->buffer;
+    }
+    return w->status;
+}
+
+MpStatus
+MpWriteFormatted(MpWriter* w, const char* format, ...)
+{
+    /* Try to format directly in the buffer, flush and retry if the buffer is
+       too small, use a temporary buffer as a last resort. */
+    for (int pass = 1; w->status == MP_OK; ++pass) {
+        size_t avail = w->size - w->count;
+        va_list ap;
+        va_start(ap, format);
+        int len = vsnprintf(w->buffer + w->count, avail, format, ap);
+        va_end(ap);
+        if (len < 0) {
+            w->status = MpSystemError();
+        } else if ((size_t)len < avail) {
+            w->count += len;
+            break;
+        } else if (pass == 1 && w->file == NULL) {
+            makeRoom(w, len + 1);
+        } else if (pass == 1 && w->count > 0) {
+            MpFlushWriter(w);
+        } else {
+            char* tmp = (char*)malloc(len + 1);
+            if (tmp == NULL) {
+                w->status = MP_NO_MEMORY;
+                break;
+            }
+            va_start(ap, format);
+            vsnprintf(tmp, len + 1, format, ap);
+            va_end(ap);
+            MpWriteBytes(w, tmp, len);
+            free((void*)tmp);
+            break;
+        }
+    }
+    return w->status;
+}